@@ -0,0 +1,561 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Vector types of the batch camera model: 8 lanes with AVX, 4 with SSE2 and NEON, otherwise 1
+namespace BrownConradyDetail
+{
+#if defined(__AVX__)
+    struct Floats { __m256 v; };
+    struct Mask { __m256 v; };
+    static const size_t Lanes = 8;
+
+    inline Floats Set(float value) { return { _mm256_set1_ps(value) }; }
+    inline Floats Load(const float* data) { return { _mm256_loadu_ps(data) }; }
+    inline void Store(float* data, Floats a) { _mm256_storeu_ps(data, a.v); }
+    inline Floats operator+(Floats a, Floats b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline Floats operator-(Floats a, Floats b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline Floats operator*(Floats a, Floats b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    inline Floats operator/(Floats a, Floats b) { return { _mm256_div_ps(a.v, b.v) }; }
+    inline Mask operator<(Floats a, Floats b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline Mask operator>(Floats a, Floats b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline Mask operator<=(Floats a, Floats b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline Mask operator>=(Floats a, Floats b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    inline Mask operator!=(Floats a, Floats b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) }; }
+    inline Mask operator&(Mask a, Mask b) { return { _mm256_and_ps(a.v, b.v) }; }
+    inline Mask operator|(Mask a, Mask b) { return { _mm256_or_ps(a.v, b.v) }; }
+    inline Mask AndNot(Mask a, Mask b) { return { _mm256_andnot_ps(b.v, a.v) }; }
+    inline Mask AllLanes() { return { _mm256_castsi256_ps(_mm256_set1_epi32(-1)) }; }
+    inline bool Any(Mask a) { return _mm256_movemask_ps(a.v) != 0; }
+    inline Floats Select(Mask mask, Floats a, Floats b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+    inline void StoreMask(int* data, Mask a)
+    {
+        // Without AVX2 there are no 256 bit integer shifts
+        const int bits = _mm256_movemask_ps(a.v);
+        for (int i = 0; i < 8; i++)
+        {
+            data[i] = (bits >> i) & 1;
+        }
+    }
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+    struct Floats { __m128 v; };
+    struct Mask { __m128 v; };
+    static const size_t Lanes = 4;
+
+    inline Floats Set(float value) { return { _mm_set1_ps(value) }; }
+    inline Floats Load(const float* data) { return { _mm_loadu_ps(data) }; }
+    inline void Store(float* data, Floats a) { _mm_storeu_ps(data, a.v); }
+    inline Floats operator+(Floats a, Floats b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline Floats operator-(Floats a, Floats b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline Floats operator*(Floats a, Floats b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline Floats operator/(Floats a, Floats b) { return { _mm_div_ps(a.v, b.v) }; }
+    inline Mask operator<(Floats a, Floats b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    inline Mask operator>(Floats a, Floats b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline Mask operator<=(Floats a, Floats b) { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline Mask operator>=(Floats a, Floats b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+    inline Mask operator!=(Floats a, Floats b) { return { _mm_cmpneq_ps(a.v, b.v) }; }
+    inline Mask operator&(Mask a, Mask b) { return { _mm_and_ps(a.v, b.v) }; }
+    inline Mask operator|(Mask a, Mask b) { return { _mm_or_ps(a.v, b.v) }; }
+    inline Mask AndNot(Mask a, Mask b) { return { _mm_andnot_ps(b.v, a.v) }; }
+    inline Mask AllLanes() { return { _mm_castsi128_ps(_mm_set1_epi32(-1)) }; }
+    inline bool Any(Mask a) { return _mm_movemask_ps(a.v) != 0; }
+    inline Floats Select(Mask mask, Floats a, Floats b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+    inline void StoreMask(int* data, Mask a)
+    {
+        _mm_storeu_si128((__m128i*)data, _mm_srli_epi32(_mm_castps_si128(a.v), 31));
+    }
+#elif defined(_M_ARM64) || defined(__aarch64__)
+    struct Floats { float32x4_t v; };
+    struct Mask { uint32x4_t v; };
+    static const size_t Lanes = 4;
+
+    inline Floats Set(float value) { return { vdupq_n_f32(value) }; }
+    inline Floats Load(const float* data) { return { vld1q_f32(data) }; }
+    inline void Store(float* data, Floats a) { vst1q_f32(data, a.v); }
+    inline Floats operator+(Floats a, Floats b) { return { vaddq_f32(a.v, b.v) }; }
+    inline Floats operator-(Floats a, Floats b) { return { vsubq_f32(a.v, b.v) }; }
+    inline Floats operator*(Floats a, Floats b) { return { vmulq_f32(a.v, b.v) }; }
+    inline Floats operator/(Floats a, Floats b) { return { vdivq_f32(a.v, b.v) }; }
+    inline Mask operator<(Floats a, Floats b) { return { vcltq_f32(a.v, b.v) }; }
+    inline Mask operator>(Floats a, Floats b) { return { vcgtq_f32(a.v, b.v) }; }
+    inline Mask operator<=(Floats a, Floats b) { return { vcleq_f32(a.v, b.v) }; }
+    inline Mask operator>=(Floats a, Floats b) { return { vcgeq_f32(a.v, b.v) }; }
+    inline Mask operator!=(Floats a, Floats b) { return { vmvnq_u32(vceqq_f32(a.v, b.v)) }; }
+    inline Mask operator&(Mask a, Mask b) { return { vandq_u32(a.v, b.v) }; }
+    inline Mask operator|(Mask a, Mask b) { return { vorrq_u32(a.v, b.v) }; }
+    inline Mask AndNot(Mask a, Mask b) { return { vbicq_u32(a.v, b.v) }; }
+    inline Mask AllLanes() { return { vdupq_n_u32(0xffffffff) }; }
+    inline bool Any(Mask a) { return vmaxvq_u32(a.v) != 0; }
+    inline Floats Select(Mask mask, Floats a, Floats b) { return { vbslq_f32(mask.v, a.v, b.v) }; }
+    inline void StoreMask(int* data, Mask a) { vst1q_s32(data, vreinterpretq_s32_u32(vshrq_n_u32(a.v, 31))); }
+#else
+    struct Floats { float v; };
+    struct Mask { bool v; };
+    static const size_t Lanes = 1;
+
+    inline Floats Set(float value) { return { value }; }
+    inline Floats Load(const float* data) { return { *data }; }
+    inline void Store(float* data, Floats a) { *data = a.v; }
+    inline Floats operator+(Floats a, Floats b) { return { a.v + b.v }; }
+    inline Floats operator-(Floats a, Floats b) { return { a.v - b.v }; }
+    inline Floats operator*(Floats a, Floats b) { return { a.v * b.v }; }
+    inline Floats operator/(Floats a, Floats b) { return { a.v / b.v }; }
+    inline Mask operator<(Floats a, Floats b) { return { a.v < b.v }; }
+    inline Mask operator>(Floats a, Floats b) { return { a.v > b.v }; }
+    inline Mask operator<=(Floats a, Floats b) { return { a.v <= b.v }; }
+    inline Mask operator>=(Floats a, Floats b) { return { a.v >= b.v }; }
+    inline Mask operator!=(Floats a, Floats b) { return { a.v != b.v }; }
+    inline Mask operator&(Mask a, Mask b) { return { a.v && b.v }; }
+    inline Mask operator|(Mask a, Mask b) { return { a.v || b.v }; }
+    inline Mask AndNot(Mask a, Mask b) { return { a.v && !b.v }; }
+    inline Mask AllLanes() { return { true }; }
+    inline bool Any(Mask a) { return a.v; }
+    inline Floats Select(Mask mask, Floats a, Floats b) { return { mask.v ? a.v : b.v }; }
+    inline void StoreMask(int* data, Mask a) { *data = a.v ? 1 : 0; }
+#endif
+}
+
+// Batch version of the Brown Conrady and rational 6KT lens models of the Azure Kinect SDK. Projects and unprojects
+// arrays of points with the same operations as k4a_calibration_3d_to_2d and k4a_calibration_2d_to_3d of a single
+// camera, including the metric radius and the iterative undistortion with the same stop criteria, a few lanes at a
+// time. Validate compares the results with the SDK.
+//
+// The x/y arrays are on the unit plane (z = 1) of the camera, the u/v arrays in pixels. Invalid points get valid 0
+// and the coordinates (0, 0).
+//
+//    BrownConradyCamera camera;
+//    if (camera.Initialize(calibration.depth_camera_calibration))
+//    {
+//        camera.Unproject(u, v, x, y, valid, count);
+//    }
+class BrownConradyCamera
+{
+public:
+    // Returns false for the lens models the SDK does not project either
+    bool Initialize(const k4a_calibration_camera_t& cameraCalibration)
+    {
+        const k4a_calibration_intrinsics_t& intrinsics = cameraCalibration.intrinsics;
+        if (intrinsics.type != K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT &&
+            intrinsics.type != K4A_CALIBRATION_LENS_DISTORTION_MODEL_BROWN_CONRADY)
+        {
+            return false;
+        }
+
+        m_parameters = intrinsics.parameters;
+        m_isRational6kt = intrinsics.type == K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT;
+        m_maxRadiusSquared = cameraCalibration.metric_radius * cameraCalibration.metric_radius;
+        return true;
+    }
+
+    // Distorts points of the unit plane into pixels, k4a_calibration_3d_to_2d with z = 1
+    void Distort(const float* x, const float* y, float* u, float* v, int* valid, size_t count) const
+    {
+        using namespace BrownConradyDetail;
+
+        size_t i = 0;
+        for (; i + Lanes <= count; i += Lanes)
+        {
+            DistortLanes(x + i, y + i, u + i, v + i, valid + i);
+        }
+        ForRemainder(i, count, [&](const float* const* in, float* const* out, int* outValid) {
+            DistortLanes(in[0], in[1], out[0], out[1], outValid);
+        }, x, y, u, v, valid);
+    }
+
+    // Undistorts pixels onto the unit plane, k4a_calibration_2d_to_3d with depth 1
+    void Undistort(const float* u, const float* v, float* x, float* y, int* valid, size_t count) const
+    {
+        using namespace BrownConradyDetail;
+
+        size_t i = 0;
+        for (; i + Lanes <= count; i += Lanes)
+        {
+            UndistortLanes(u + i, v + i, x + i, y + i, valid + i);
+        }
+        ForRemainder(i, count, [&](const float* const* in, float* const* out, int* outValid) {
+            UndistortLanes(in[0], in[1], out[0], out[1], outValid);
+        }, u, v, x, y, valid);
+    }
+
+    // k4a_calibration_3d_to_2d within the camera, points with z <= 0 are invalid
+    void Project(const k4a_float3_t* points3d, k4a_float2_t* points2d, int* valid, size_t count) const
+    {
+        ForChunks(count, [&](size_t begin, size_t size, float* a, float* b, float* c, float* d, int* chunkValid) {
+            for (size_t i = 0; i < size; i++)
+            {
+                const k4a_float3_t& point = points3d[begin + i];
+                // Replaced by 0 below, avoids the division by 0
+                const float z = point.xyz.z > 0.f ? point.xyz.z : 1.f;
+                a[i] = point.xyz.x / z;
+                b[i] = point.xyz.y / z;
+            }
+            Distort(a, b, c, d, chunkValid, size);
+            for (size_t i = 0; i < size; i++)
+            {
+                const bool isValid = chunkValid[i] != 0 && points3d[begin + i].xyz.z > 0.f;
+                valid[begin + i] = isValid ? 1 : 0;
+                points2d[begin + i].xy.x = isValid ? c[i] : 0.f;
+                points2d[begin + i].xy.y = isValid ? d[i] : 0.f;
+            }
+        });
+    }
+
+    // k4a_calibration_2d_to_3d within the camera at the same depth for all points, depth 0 is invalid
+    void Unproject(const k4a_float2_t* points2d, float depth, k4a_float3_t* points3d, int* valid, size_t count) const
+    {
+        ForChunks(count, [&](size_t begin, size_t size, float* a, float* b, float* c, float* d, int* chunkValid) {
+            for (size_t i = 0; i < size; i++)
+            {
+                a[i] = points2d[begin + i].xy.x;
+                b[i] = points2d[begin + i].xy.y;
+            }
+            Undistort(a, b, c, d, chunkValid, size);
+            for (size_t i = 0; i < size; i++)
+            {
+                const bool isValid = chunkValid[i] != 0 && depth != 0.f;
+                valid[begin + i] = isValid ? 1 : 0;
+                points3d[begin + i].xyz.x = isValid ? c[i] * depth : 0.f;
+                points3d[begin + i].xyz.y = isValid ? d[i] * depth : 0.f;
+                points3d[begin + i].xyz.z = isValid ? depth : 0.f;
+            }
+        });
+    }
+
+    // Differences to the SDK on a grid of pixels of the camera, every step pixels. The unproject error is on the unit
+    // plane, the project error in pixels. The validity of points close to the metric radius may differ by rounding.
+    struct Validation
+    {
+        size_t SampleCount = 0;
+        size_t ValidityMismatches = 0;
+        float MaxUnprojectError = 0.f;
+        float MaxProjectError = 0.f;
+
+        // Rounding differences to the compiled SDK, far below what a lut or a depth pixel can resolve
+        bool IsWithinTolerance() const
+        {
+            return SampleCount > 0 &&
+                MaxUnprojectError <= 1e-5f &&
+                MaxProjectError <= 1e-3f &&
+                ValidityMismatches * 1000 <= SampleCount;
+        }
+    };
+
+    // Every row of the grid goes through the lanes of the batch functions at once, the SDK gets the points one by one.
+    // Returns false when the lens model is not supported or the SDK fails.
+    static bool Validate(const k4a_calibration_t& calibration, k4a_calibration_type_t camera, int step, Validation& validation)
+    {
+        const k4a_calibration_camera_t& cameraCalibration = camera == K4A_CALIBRATION_TYPE_COLOR ?
+            calibration.color_camera_calibration : calibration.depth_camera_calibration;
+
+        BrownConradyCamera model;
+        if (step <= 0 || !model.Initialize(cameraCalibration))
+        {
+            return false;
+        }
+
+        const size_t rowSize = (size_t)(cameraCalibration.resolution_width + step - 1) / step;
+        std::vector<k4a_float2_t> pixels(rowSize);
+        std::vector<k4a_float3_t> points(rowSize);
+        std::vector<k4a_float3_t> sdkPoints(rowSize);
+        std::vector<k4a_float2_t> projected(rowSize);
+        std::vector<int> valid(rowSize);
+        std::vector<int> sdkValid(rowSize);
+
+        validation = Validation();
+        for (int v = 0; v < cameraCalibration.resolution_height; v += step)
+        {
+            for (size_t i = 0; i < rowSize; i++)
+            {
+                pixels[i].xy.x = (float)(i * step);
+                pixels[i].xy.y = (float)v;
+                if (k4a_calibration_2d_to_3d(&calibration, &pixels[i], 1.f, camera, camera, &sdkPoints[i], &sdkValid[i]) != K4A_RESULT_SUCCEEDED)
+                {
+                    return false;
+                }
+            }
+            model.Unproject(pixels.data(), 1.f, points.data(), valid.data(), rowSize);
+
+            for (size_t i = 0; i < rowSize; i++)
+            {
+                validation.SampleCount++;
+                if ((valid[i] != 0) != (sdkValid[i] != 0))
+                {
+                    validation.ValidityMismatches++;
+                }
+                else if (valid[i] != 0)
+                {
+                    validation.MaxUnprojectError = std::max(validation.MaxUnprojectError,
+                        std::max(std::fabs(points[i].xyz.x - sdkPoints[i].xyz.x), std::fabs(points[i].xyz.y - sdkPoints[i].xyz.y)));
+                }
+            }
+
+            // Projecting back the points of the SDK compares the forward model on its own. Points the SDK could not
+            // unproject are (0, 0, 0), invalid for both.
+            model.Project(sdkPoints.data(), projected.data(), valid.data(), rowSize);
+            for (size_t i = 0; i < rowSize; i++)
+            {
+                if (sdkValid[i] == 0)
+                {
+                    continue;
+                }
+
+                k4a_float2_t sdkPixel;
+                int sdkProjectValid = 0;
+                if (k4a_calibration_3d_to_2d(&calibration, &sdkPoints[i], camera, camera, &sdkPixel, &sdkProjectValid) != K4A_RESULT_SUCCEEDED)
+                {
+                    return false;
+                }
+
+                if ((valid[i] != 0) != (sdkProjectValid != 0))
+                {
+                    validation.ValidityMismatches++;
+                }
+                else if (valid[i] != 0)
+                {
+                    validation.MaxProjectError = std::max(validation.MaxProjectError,
+                        std::max(std::fabs(projected[i].xy.x - sdkPixel.xy.x), std::fabs(projected[i].xy.y - sdkPixel.xy.y)));
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t ChunkSize = 256;
+
+    // Runs function on the stack buffers of chunks of at most ChunkSize points
+    template<typename Function> static void ForChunks(size_t count, const Function& function)
+    {
+        float a[ChunkSize], b[ChunkSize], c[ChunkSize], d[ChunkSize];
+        int chunkValid[ChunkSize];
+        for (size_t begin = 0; begin < count; begin += ChunkSize)
+        {
+            function(begin, std::min(ChunkSize, count - begin), a, b, c, d, chunkValid);
+        }
+    }
+
+    // The last points that do not fill all lanes go through padded copies
+    template<typename Function>
+    static void ForRemainder(size_t begin, size_t count, const Function& function,
+        const float* in0, const float* in1, float* out0, float* out1, int* valid)
+    {
+        using namespace BrownConradyDetail;
+
+        if (begin >= count)
+        {
+            return;
+        }
+
+        float paddedIn[2][Lanes] = {};
+        float paddedOut[2][Lanes];
+        int paddedValid[Lanes];
+        const size_t size = count - begin;
+        std::copy(in0 + begin, in0 + count, paddedIn[0]);
+        std::copy(in1 + begin, in1 + count, paddedIn[1]);
+
+        const float* const in[2] = { paddedIn[0], paddedIn[1] };
+        float* const out[2] = { paddedOut[0], paddedOut[1] };
+        function(in, out, paddedValid);
+
+        std::copy(paddedOut[0], paddedOut[0] + size, out0 + begin);
+        std::copy(paddedOut[1], paddedOut[1] + size, out1 + begin);
+        std::copy(paddedValid, paddedValid + size, valid + begin);
+    }
+
+    // transformation_project_internal of the SDK, optionally with the Jacobian of (u, v) by (x, y)
+    void DistortLanes(
+        BrownConradyDetail::Floats x,
+        BrownConradyDetail::Floats y,
+        BrownConradyDetail::Floats& u,
+        BrownConradyDetail::Floats& v,
+        BrownConradyDetail::Mask& valid,
+        BrownConradyDetail::Floats* jacobian) const
+    {
+        using namespace BrownConradyDetail;
+        const auto& p = m_parameters.param;
+
+        const Floats one = Set(1.f);
+        const Floats two = Set(2.f);
+        const Floats p1 = Set(p.p1);
+        const Floats p2 = Set(p.p2);
+
+        const Floats xp = x - Set(p.codx);
+        const Floats yp = y - Set(p.cody);
+        const Floats xp2 = xp * xp;
+        const Floats yp2 = yp * yp;
+        const Floats xyp = xp * yp;
+        const Floats rs = xp2 + yp2;
+        valid = rs <= Set(m_maxRadiusSquared);
+
+        const Floats rss = rs * rs;
+        const Floats rsc = rss * rs;
+        const Floats a = one + Set(p.k1) * rs + Set(p.k2) * rss + Set(p.k3) * rsc;
+        const Floats b = one + Set(p.k4) * rs + Set(p.k5) * rss + Set(p.k6) * rsc;
+        const Floats bi = Select(b != Set(0.f), one / b, one);
+        const Floats d = a * bi;
+
+        Floats xp_d = xp * d;
+        Floats yp_d = yp * d;
+        const Floats rs_2xp2 = rs + two * xp2;
+        const Floats rs_2yp2 = rs + two * yp2;
+
+        // The only difference of Brown Conrady is the factor 2 of the tangential terms xyp * p1 and xyp * p2
+        if (m_isRational6kt)
+        {
+            xp_d = xp_d + (rs_2xp2 * p2 + xyp * p1);
+            yp_d = yp_d + (rs_2yp2 * p1 + xyp * p2);
+        }
+        else
+        {
+            xp_d = xp_d + (rs_2xp2 * p2 + two * xyp * p1);
+            yp_d = yp_d + (rs_2yp2 * p1 + two * xyp * p2);
+        }
+
+        const Floats fx = Set(p.fx);
+        const Floats fy = Set(p.fy);
+        u = (xp_d + Set(p.codx)) * fx + Set(p.cx);
+        v = (yp_d + Set(p.cody)) * fy + Set(p.cy);
+
+        if (jacobian == nullptr)
+        {
+            return;
+        }
+
+        const Floats dudrs = Set(p.k1) + two * Set(p.k2) * rs + Set(3.f) * Set(p.k3) * rss;
+        const Floats dvdrs = Set(p.k4) + two * Set(p.k5) * rs + Set(3.f) * Set(p.k6) * rss;
+        const Floats bis = bi * bi;
+        const Floats dddrs = (dudrs * b - a * dvdrs) * bis;
+        const Floats dddrs_2 = dddrs * two;
+        const Floats xp_dddrs_2 = xp * dddrs_2;
+        const Floats yp_xp_dddrs_2 = yp * xp_dddrs_2;
+        const Floats six = Set(6.f);
+
+        if (m_isRational6kt)
+        {
+            jacobian[0] = fx * (d + xp * xp_dddrs_2 + six * xp * p2 + yp * p1);
+            jacobian[1] = fx * (yp_xp_dddrs_2 + two * yp * p2 + xp * p1);
+            jacobian[2] = fy * (yp_xp_dddrs_2 + two * xp * p1 + yp * p2);
+            jacobian[3] = fy * (d + yp * yp * dddrs_2 + six * yp * p1 + xp * p2);
+        }
+        else
+        {
+            jacobian[0] = fx * (d + xp * xp_dddrs_2 + six * xp * p2 + two * yp * p1);
+            jacobian[1] = fx * (yp_xp_dddrs_2 + two * yp * p2 + two * xp * p1);
+            jacobian[2] = fy * (yp_xp_dddrs_2 + two * xp * p1 + two * yp * p2);
+            jacobian[3] = fy * (d + yp * yp * dddrs_2 + six * yp * p1 + two * xp * p2);
+        }
+    }
+
+    void DistortLanes(const float* x, const float* y, float* u, float* v, int* valid) const
+    {
+        using namespace BrownConradyDetail;
+
+        Floats laneU, laneV;
+        Mask laneValid;
+        DistortLanes(Load(x), Load(y), laneU, laneV, laneValid, nullptr);
+        Store(u, Select(laneValid, laneU, Set(0.f)));
+        Store(v, Select(laneValid, laneV, Set(0.f)));
+        StoreMask(valid, laneValid);
+    }
+
+    // transformation_unproject_internal and transformation_iterative_unproject of the SDK. Every lane leaves the
+    // Gauss Newton iterations on its own, the loop runs until all lanes are done.
+    void UndistortLanes(const float* uData, const float* vData, float* xData, float* yData, int* validData) const
+    {
+        using namespace BrownConradyDetail;
+        const auto& p = m_parameters.param;
+
+        const Floats u = Load(uData);
+        const Floats v = Load(vData);
+        const Floats one = Set(1.f);
+
+        // Initial guess: inverse of the radial distortion and an approximate correction of the tangential one
+        const Floats xp_d = (u - Set(p.cx)) / Set(p.fx) - Set(p.codx);
+        const Floats yp_d = (v - Set(p.cy)) / Set(p.fy) - Set(p.cody);
+        const Floats rs = xp_d * xp_d + yp_d * yp_d;
+        const Floats rss = rs * rs;
+        const Floats rsc = rss * rs;
+        const Floats a = one + Set(p.k1) * rs + Set(p.k2) * rss + Set(p.k3) * rsc;
+        const Floats b = one + Set(p.k4) * rs + Set(p.k5) * rss + Set(p.k6) * rsc;
+        const Floats ai = Select(a != Set(0.f), one / a, one);
+        const Floats di = ai * b;
+
+        Floats x = xp_d * di;
+        Floats y = yp_d * di;
+        const Floats two_xy = Set(2.f) * x * y;
+        const Floats xx = x * x;
+        const Floats yy = y * y;
+        x = x - ((yy + Set(3.f) * xx) * Set(p.p2) + two_xy * Set(p.p1));
+        y = y - ((xx + Set(3.f) * yy) * Set(p.p1) + two_xy * Set(p.p2));
+        x = x + Set(p.codx);
+        y = y + Set(p.cody);
+
+        Floats bestX = Set(0.f);
+        Floats bestY = Set(0.f);
+        Floats bestError = Set(FLT_MAX);
+        Mask valid = AllLanes();
+        Mask active = AllLanes();
+
+        const unsigned int maxPasses = 20;
+        for (unsigned int pass = 0; pass < maxPasses && Any(active); pass++)
+        {
+            Floats projectedU, projectedV;
+            Floats jacobian[4];
+            Mask projectedValid;
+            DistortLanes(x, y, projectedU, projectedV, projectedValid, jacobian);
+
+            // Leaving the metric radius ends the iterations of a lane as invalid
+            valid = AndNot(valid, AndNot(active, projectedValid));
+            active = active & projectedValid;
+
+            const Floats errorX = u - projectedU;
+            const Floats errorY = v - projectedV;
+            const Floats error = errorX * errorX + errorY * errorY;
+
+            // A lane that got worse keeps its best point
+            active = AndNot(active, error >= bestError);
+            bestError = Select(active, error, bestError);
+            bestX = Select(active, x, bestX);
+            bestY = Select(active, y, bestY);
+
+            if (pass + 1 == maxPasses)
+            {
+                break;
+            }
+            active = AndNot(active, bestError < Set(1e-22f));
+
+            const Floats inverseDeterminant = one / (jacobian[0] * jacobian[3] - jacobian[1] * jacobian[2]);
+            const Floats dx = (inverseDeterminant * jacobian[3]) * errorX + (Set(0.f) - inverseDeterminant * jacobian[1]) * errorY;
+            const Floats dy = (Set(0.f) - inverseDeterminant * jacobian[2]) * errorX + (inverseDeterminant * jacobian[0]) * errorY;
+            x = Select(active, x + dx, x);
+            y = Select(active, y + dy, y);
+        }
+
+        valid = AndNot(valid, bestError > Set(1e-6f));
+        Store(xData, Select(valid, bestX, Set(0.f)));
+        Store(yData, Select(valid, bestY, Set(0.f)));
+        StoreMask(validData, valid);
+    }
+
+    k4a_calibration_intrinsic_parameters_t m_parameters = {};
+    bool m_isRational6kt = true;
+    float m_maxRadiusSquared = 0.f;
+};
@@ -0,0 +1,409 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <k4a/k4atypes.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Lookup table derived from a sensor calibration, e.g. the 2D to 3D unprojection table of the depth camera.
+// Computing such a table takes one k4a_calibration_* call per pixel. LoadOrCreate computes it once on all cores
+// and stores it in the cache directory, later launches map the file instead.
+//
+// Tables are keyed by a hash of the table name, the algorithm version of the table, the k4a_calibration_t (which is
+// derived from the raw calibration blob and the depth and color modes), the parameters of the table and its size.
+// Whoever changes how a table is computed bumps its algorithm version, tables of older versions are then never
+// mapped again.
+//
+// The cache directory is K4A_LUT_CACHE_DIR, or on Windows k4a_lut_cache in the per user temp directory and
+// elsewhere k4a_lut_cache in $XDG_CACHE_HOME (~/.cache). Outside of Windows the directory has to be owned by the user
+// and must not be accessible by anybody else, tables in a directory that other users can write to are not trusted.
+// Without a usable cache directory the table is only kept in memory.
+//
+//    CalibrationLut lut;
+//    lut.LoadOrCreate(calibration, "xy_table", 1, nullptr, 0, width * height * sizeof(XY), height,
+//        [&](uint8_t* data, int rowBegin, int rowEnd) { ... });
+//    const XY* table = reinterpret_cast<const XY*>(lut.GetData());
+class CalibrationLut
+{
+public:
+    // Fills the rows [rowBegin, rowEnd) of the table. Called concurrently for disjoint row ranges.
+    using ComputeRowsFunction = std::function<bool(uint8_t* data, int rowBegin, int rowEnd)>;
+
+    CalibrationLut() = default;
+
+    ~CalibrationLut()
+    {
+        Close();
+    }
+
+    CalibrationLut(const CalibrationLut&) = delete;
+    CalibrationLut& operator=(const CalibrationLut&) = delete;
+
+    // Returns false when computeRows fails, the cache itself never fails
+    bool LoadOrCreate(
+        const k4a_calibration_t& calibration,
+        const char* name,
+        uint32_t algorithmVersion,
+        const void* parameters,
+        size_t parametersSize,
+        size_t size,
+        int rowCount,
+        const ComputeRowsFunction& computeRows)
+    {
+        Close();
+
+        uint64_t key = HashBytes(FnvOffsetBasis, name, strlen(name));
+        key = HashBytes(key, &algorithmVersion, sizeof(algorithmVersion));
+        // k4a_calibration_t only has 4 byte members, there are no padding bytes in the hash
+        key = HashBytes(key, &calibration, sizeof(calibration));
+        key = HashBytes(key, parameters, parametersSize);
+        key = HashBytes(key, &size, sizeof(size));
+
+        char fileName[128];
+        snprintf(fileName, sizeof(fileName), "%s_%016llx.lut", name, (unsigned long long)key);
+        const std::string directory = GetCacheDirectory();
+        const std::string path = directory.empty() ? std::string() : directory + fileName;
+
+        if (!path.empty() && Map(path, key, size))
+        {
+            m_isFromCache = true;
+            return true;
+        }
+
+        m_buffer.resize(size);
+        if (!ComputeRows(m_buffer.data(), rowCount, computeRows))
+        {
+            m_buffer.clear();
+            return false;
+        }
+        m_data = m_buffer.data();
+        m_size = size;
+
+        if (!path.empty())
+        {
+            StoreFile(path, key, m_data, m_size);
+        }
+        return true;
+    }
+
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+    // True when the table was mapped from the cache instead of computed
+    bool IsFromCache() const { return m_isFromCache; }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_view != nullptr)
+        {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_view != nullptr)
+        {
+            munmap(m_view, m_viewSize);
+            m_view = nullptr;
+        }
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+#endif
+        m_buffer.clear();
+        m_data = nullptr;
+        m_size = 0;
+        m_isFromCache = false;
+    }
+
+private:
+    static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+    static const uint32_t FileVersion = 1;
+
+    // The data starts after the header at a 64 byte boundary, so the tables can be read with aligned vector loads
+    struct FileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t HeaderSize;
+        uint64_t Key;
+        uint64_t DataSize;
+        uint8_t Reserved[32];
+    };
+    static_assert(sizeof(FileHeader) == 64, "The data has to start at a 64 byte boundary");
+
+    static void InitializeHeader(FileHeader& header, uint64_t key, uint64_t dataSize)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.Magic, "K4ALUT\0\0", sizeof(header.Magic));
+        header.Version = FileVersion;
+        header.HeaderSize = sizeof(FileHeader);
+        header.Key = key;
+        header.DataSize = dataSize;
+    }
+
+    // 64 bit FNV-1a
+    static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Rows are handed out in small batches, the cost per row varies with the number of invalid pixels
+    static bool ComputeRows(uint8_t* data, int rowCount, const ComputeRowsFunction& computeRows)
+    {
+        const int batchSize = 16;
+        const int threadCount = (int)std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned)(rowCount + batchSize - 1) / batchSize));
+
+        std::atomic<int> nextRow(0);
+        std::atomic<bool> succeeded(true);
+        auto worker = [&]() {
+            for (int row = nextRow.fetch_add(batchSize); row < rowCount && succeeded; row = nextRow.fetch_add(batchSize))
+            {
+                if (!computeRows(data, row, std::min(row + batchSize, rowCount)))
+                {
+                    succeeded = false;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < threadCount; i++)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        return succeeded;
+    }
+
+#ifdef _WIN32
+    static std::string GetCacheDirectory()
+    {
+        std::string directory;
+        const char* configured = getenv("K4A_LUT_CACHE_DIR");
+        if (configured != nullptr && configured[0] != '\0')
+        {
+            directory = configured;
+        }
+        else
+        {
+            char tempPath[MAX_PATH + 1];
+            const DWORD length = GetTempPathA(sizeof(tempPath), tempPath);
+            if (length == 0 || length > sizeof(tempPath))
+            {
+                return std::string();
+            }
+            directory = std::string(tempPath) + "k4a_lut_cache";
+        }
+
+        if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            return std::string();
+        }
+        return directory + "\\";
+    }
+
+    bool Map(const std::string& path, uint64_t key, size_t size)
+    {
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_file, &fileSize) || (uint64_t)fileSize.QuadPart != sizeof(FileHeader) + size)
+        {
+            Close();
+            return false;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = m_mapping != nullptr ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        return ValidateView(key, size);
+    }
+
+    static bool StoreFile(const std::string& path, uint64_t key, const uint8_t* data, size_t size)
+    {
+        // Written next to the final file and renamed, so a concurrent launch never maps a partial table
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)GetCurrentProcessId());
+        const std::string tempPath = path + suffix;
+        if (!WriteTableFile(tempPath, key, data, size))
+        {
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+        if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    void* m_view = nullptr;
+#else
+    static std::string GetCacheDirectory()
+    {
+        std::string directory;
+        const char* configured = getenv("K4A_LUT_CACHE_DIR");
+        const char* cacheHome = getenv("XDG_CACHE_HOME");
+        const char* home = getenv("HOME");
+        if (configured != nullptr && configured[0] != '\0')
+        {
+            directory = configured;
+        }
+        else if (cacheHome != nullptr && cacheHome[0] == '/')
+        {
+            mkdir(cacheHome, 0700);
+            directory = std::string(cacheHome) + "/k4a_lut_cache";
+        }
+        else if (home != nullptr && home[0] == '/')
+        {
+            const std::string cacheDirectory = std::string(home) + "/.cache";
+            mkdir(cacheDirectory.c_str(), 0700);
+            directory = cacheDirectory + "/k4a_lut_cache";
+        }
+        else
+        {
+            directory = "/tmp/k4a_lut_cache_" + std::to_string((unsigned long)getuid());
+        }
+
+        // Someone else may have created the directory first to plant tables, only a private directory is used
+        mkdir(directory.c_str(), 0700);
+        struct stat directoryStatus;
+        if (lstat(directory.c_str(), &directoryStatus) != 0 ||
+            !S_ISDIR(directoryStatus.st_mode) ||
+            directoryStatus.st_uid != getuid() ||
+            (directoryStatus.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+        {
+            return std::string();
+        }
+        return directory + "/";
+    }
+
+    bool Map(const std::string& path, uint64_t key, size_t size)
+    {
+        m_fd = open(path.c_str(), O_RDONLY);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStatus;
+        if (fstat(m_fd, &fileStatus) != 0 || (uint64_t)fileStatus.st_size != sizeof(FileHeader) + size)
+        {
+            Close();
+            return false;
+        }
+
+        m_viewSize = sizeof(FileHeader) + size;
+        void* view = mmap(nullptr, m_viewSize, PROT_READ, MAP_SHARED, m_fd, 0);
+        m_view = view != MAP_FAILED ? view : nullptr;
+        return ValidateView(key, size);
+    }
+
+    static bool StoreFile(const std::string& path, uint64_t key, const uint8_t* data, size_t size)
+    {
+        // Written next to the final file and renamed, so a concurrent launch never maps a partial table
+        const std::string tempPath = path + "." + std::to_string((long)getpid()) + ".tmp";
+        if (!WriteTableFile(tempPath, key, data, size) || rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    int m_fd = -1;
+    void* m_view = nullptr;
+    size_t m_viewSize = 0;
+#endif
+
+    bool ValidateView(uint64_t key, size_t size)
+    {
+        if (m_view == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        FileHeader expected;
+        InitializeHeader(expected, key, size);
+        if (memcmp(m_view, &expected, sizeof(expected)) != 0)
+        {
+            Close();
+            return false;
+        }
+
+        m_data = static_cast<const uint8_t*>(m_view) + sizeof(FileHeader);
+        m_size = size;
+        return true;
+    }
+
+    static bool WriteTableFile(const std::string& path, uint64_t key, const uint8_t* data, size_t size)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        FileHeader header;
+        InitializeHeader(header, key, size);
+        const bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, 1, size, file) == size;
+        return fclose(file) == 0 && written;
+    }
+
+    std::vector<uint8_t> m_buffer;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_isFromCache = false;
+};
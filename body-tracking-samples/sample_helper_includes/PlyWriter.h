@@ -0,0 +1,230 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Property types of a PLY vertex. Int16/UInt8 allow storing quantized data (e.g. k4a point clouds in millimeters,
+// 8 bit colors) without conversion.
+enum class PlyPropertyType
+{
+    Int16,
+    UInt8,
+    Float32
+};
+
+inline const char* GetPlyPropertyTypeName(PlyPropertyType type)
+{
+    switch (type)
+    {
+    case PlyPropertyType::Int16: return "short";
+    case PlyPropertyType::UInt8: return "uchar";
+    default: return "float";
+    }
+}
+
+inline size_t GetPlyPropertySize(PlyPropertyType type)
+{
+    switch (type)
+    {
+    case PlyPropertyType::Int16: return sizeof(int16_t);
+    case PlyPropertyType::UInt8: return sizeof(uint8_t);
+    default: return sizeof(float);
+    }
+}
+
+// Streaming binary_little_endian PLY writer for point clouds.
+// The vertex layout is declared with AddProperty() before Open(). Vertices are appended in a single pass straight
+// into a large output buffer with BeginVertex(), which is flushed with one fwrite whenever it is full. The number
+// of vertices does not have to be known up front: Close() patches the vertex count into the header.
+// The vertex data is copied in host byte order, all platforms supported by the Azure Kinect SDK are little endian.
+//
+//    PlyWriter writer;
+//    writer.AddProperty("x", PlyPropertyType::Int16);
+//    ...
+//    writer.Open("cloud.ply");
+//    uint8_t* vertex = writer.BeginVertex();
+//    memcpy(vertex, ..., writer.GetVertexSize());
+//    writer.Close();
+class PlyWriter
+{
+public:
+    explicit PlyWriter(size_t bufferSize = 4 * 1024 * 1024)
+        : m_buffer(bufferSize)
+    {
+    }
+
+    ~PlyWriter()
+    {
+        Close();
+    }
+
+    PlyWriter(const PlyWriter&) = delete;
+    PlyWriter& operator=(const PlyWriter&) = delete;
+
+    void AddProperty(const char* name, PlyPropertyType type)
+    {
+        m_properties.push_back({ name, type });
+        m_vertexSize += GetPlyPropertySize(type);
+    }
+
+    size_t GetVertexSize() const { return m_vertexSize; }
+
+    uint64_t GetVertexCount() const { return m_vertexCount; }
+
+    bool Open(const char* fileName)
+    {
+        if (m_file != nullptr || m_properties.empty() || m_vertexSize > m_buffer.size())
+        {
+            return false;
+        }
+
+        m_file = fopen(fileName, "wb");
+        if (m_file == nullptr)
+        {
+            printf("Failed to open %s for writing\n", fileName);
+            return false;
+        }
+
+        // All output goes through m_buffer, the stdio buffer would only add another copy
+        setvbuf(m_file, nullptr, _IONBF, 0);
+
+        m_vertexCount = 0;
+        m_used = 0;
+        m_failed = false;
+
+        std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex ";
+        m_vertexCountOffset = header.size();
+        header += std::string(VertexCountDigits, '0');
+        header += "\n";
+        for (const Property& property : m_properties)
+        {
+            header += "property ";
+            header += GetPlyPropertyTypeName(property.Type);
+            header += " ";
+            header += property.Name;
+            header += "\n";
+        }
+        header += "end_header\n";
+
+        Append(header.data(), header.size());
+        return true;
+    }
+
+    // Returns storage for one vertex of GetVertexSize() bytes, laid out in the order of the properties.
+    // Returns nullptr when the writer is not open or a write failed, the caller stops writing and Close() fails.
+    uint8_t* BeginVertex()
+    {
+        if (m_file == nullptr || m_failed)
+        {
+            return nullptr;
+        }
+
+        if (m_used + m_vertexSize > m_buffer.size() && !Flush())
+        {
+            return nullptr;
+        }
+
+        uint8_t* vertex = m_buffer.data() + m_used;
+        m_used += m_vertexSize;
+        m_vertexCount++;
+        return vertex;
+    }
+
+    // Discard the vertex returned by the last BeginVertex(), for callers that filter while writing
+    void CancelVertex()
+    {
+        m_used -= m_vertexSize;
+        m_vertexCount--;
+    }
+
+    // Flush the remaining data and write the final vertex count into the header
+    bool Close()
+    {
+        if (m_file == nullptr)
+        {
+            return false;
+        }
+
+        Flush();
+
+        char digits[VertexCountDigits + 1];
+        snprintf(digits, sizeof(digits), "%0*llu", (int)VertexCountDigits, (unsigned long long)m_vertexCount);
+        if (fseek(m_file, (long)m_vertexCountOffset, SEEK_SET) != 0 ||
+            fwrite(digits, 1, VertexCountDigits, m_file) != VertexCountDigits)
+        {
+            m_failed = true;
+        }
+
+        if (fclose(m_file) != 0)
+        {
+            m_failed = true;
+        }
+        m_file = nullptr;
+
+        if (m_failed)
+        {
+            printf("Failed to write ply file\n");
+        }
+        return !m_failed;
+    }
+
+private:
+    struct Property
+    {
+        std::string Name;
+        PlyPropertyType Type;
+    };
+
+    // Zero padded so the header size does not depend on the final count
+    static const size_t VertexCountDigits = 10;
+
+    void Append(const void* data, size_t size)
+    {
+        if (m_used + size > m_buffer.size())
+        {
+            Flush();
+        }
+        if (size > m_buffer.size())
+        {
+            if (fwrite(data, 1, size, m_file) != size)
+            {
+                m_failed = true;
+            }
+            return;
+        }
+        memcpy(m_buffer.data() + m_used, data, size);
+        m_used += size;
+    }
+
+    bool Flush()
+    {
+        if (m_file == nullptr)
+        {
+            return false;
+        }
+
+        if (m_used > 0 && fwrite(m_buffer.data(), 1, m_used, m_file) != m_used)
+        {
+            m_failed = true;
+        }
+        m_used = 0;
+        return !m_failed;
+    }
+
+    std::vector<Property> m_properties;
+    size_t m_vertexSize = 0;
+
+    std::vector<uint8_t> m_buffer;
+    size_t m_used = 0;
+
+    FILE* m_file = nullptr;
+    size_t m_vertexCountOffset = 0;
+    uint64_t m_vertexCount = 0;
+    bool m_failed = false;
+};
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "GlShaderDefs.h"
+#include "MultiViewShaders.h"
 
 // ************** Color Object Vertex Shader **************
 static const char* const glslColorObjectVertexShader = GLSL_STRING(
@@ -12,13 +13,11 @@ static const char* const glslColorObjectVertexShader = GLSL_STRING(
     layout(location = 1) in vec3 vertexNormal;
     layout(location = 2) in vec4 vertexColor;
 
-    varying vec4 fragmentColor;
-    varying vec3 fragmentPosition;
-    varying vec3 fragmentNormal;
+    out vec4 fragmentColor;
+    out vec3 fragmentPosition;
+    out vec3 fragmentNormal;
 
     uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
 
     void main()
     {
@@ -26,7 +25,33 @@ static const char* const glslColorObjectVertexShader = GLSL_STRING(
         fragmentPosition = vec3(model * vec4(vertexPosition, 1.0));
         fragmentNormal = mat3(transpose(inverse(model))) * vertexNormal;
 
-        gl_Position = projection * view * model * vec4(vertexPosition, 1);
+        gl_Position = ProjectVertex(model * vec4(vertexPosition, 1));
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Color Object Instanced Vertex Shader **************
+// Model comes from the instance attributes instead of a uniform
+static const char* const glslColorObjectInstancedVertexShader = GLSL_STRING(
+
+    layout(location = 0) in vec3 vertexPosition;
+    layout(location = 1) in vec3 vertexNormal;
+    layout(location = 2) in vec4 vertexColor;
+    layout(location = 3) in mat4 instanceModel;
+
+    out vec4 fragmentColor;
+    out vec3 fragmentPosition;
+    out vec3 fragmentNormal;
+
+
+    void main()
+    {
+        fragmentColor = vertexColor;
+        fragmentPosition = vec3(instanceModel * vec4(vertexPosition, 1.0));
+        fragmentNormal = mat3(transpose(inverse(instanceModel))) * vertexNormal;
+
+        gl_Position = ProjectVertex(instanceModel * vec4(vertexPosition, 1));
     }
 
 );  // GLSL_STRING
@@ -35,9 +60,11 @@ static const char* const glslColorObjectVertexShader = GLSL_STRING(
 // ************** Color Object Fragment Shader **************
 static const char* const glslColorObjectFragmentShader = GLSL_STRING(
 
-    varying vec4 fragmentColor;
-    varying vec3 fragmentPosition;
-    varying vec3 fragmentNormal;
+    in vec4 fragmentColor;
+    in vec3 fragmentPosition;
+    in vec3 fragmentNormal;
+
+    out vec4 outputColor;
 
     void main()
     {
@@ -48,7 +75,7 @@ static const char* const glslColorObjectFragmentShader = GLSL_STRING(
         vec3 lightDir = normalize(lightPosition - fragmentPosition);
         float diffuse = abs(dot(norm, lightDir));
 
-        gl_FragColor = vec4(fragmentColor.rgb * diffuse, fragmentColor.a);
+        outputColor = vec4(fragmentColor.rgb * diffuse, fragmentColor.a);
     }
 
 );  // GLSL_STRING
@@ -4,6 +4,7 @@
 #include "CoordinateAxes.h"
 
 #include <cmath>
+#include <string>
 
 #include "Cylinder.h"
 #include "Helpers.h"
@@ -63,65 +64,26 @@ void CoordinateAxes::Create(GLFWwindow * window)
     m_initialized = true;
 
     m_window = window;
-    glfwMakeContextCurrent(window);
-
-    // Context Settings
-    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar* vertexShaderSources[] = { glslShaderVersion, glslColorObjectVertexShader };
-    int numVertexShaderSources = sizeof(vertexShaderSources) / sizeof(*vertexShaderSources);
-    glShaderSource(m_vertexShader, numVertexShaderSources, vertexShaderSources, NULL);
-    glCompileShader(m_vertexShader);
-    ValidateShader(m_vertexShader);
-
-    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar* fragmentShaderSources[] = { glslShaderVersion, glslColorObjectFragmentShader };
-    int numFragmentShaderSources = sizeof(fragmentShaderSources) / sizeof(*fragmentShaderSources);
-    glShaderSource(m_fragmentShader, numFragmentShaderSources, fragmentShaderSources, NULL);
-    glCompileShader(m_fragmentShader);
-    ValidateShader(m_fragmentShader);
-
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, m_vertexShader);
-    glAttachShader(m_shaderProgram, m_fragmentShader);
-    glLinkProgram(m_shaderProgram);
-    ValidateProgram(m_shaderProgram);
+    MakeContextCurrent(window);
+
+    // Programs and geometry are shared with the renderers of the other contexts of the share group
+    m_resources = &GlResourceManager::GetCurrent();
+    m_shaderProgram = m_resources->GetProgram("ColorObject",
+        { glslShaderVersion, glslSingleViewVertexShaderCommon, glslColorObjectVertexShader },
+        { glslShaderVersion, glslColorObjectFragmentShader });
 
     // Get shader index
     m_modelIndex = glGetUniformLocation(m_shaderProgram, "model");
     m_viewIndex = glGetUniformLocation(m_shaderProgram, "view");
     m_projectionIndex = glGetUniformLocation(m_shaderProgram, "projection");
 
-    // **************** Generate Sphere VAO ****************
+    // **************** Generate CoordinateAxes VAO ****************
     glGenVertexArrays(1, &m_vertexArrayObject);
-    glBindVertexArray(m_vertexArrayObject);
-
-    // Create buffers and bind the geometry
-    glGenBuffers(1, &m_vertexBufferObject);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(ColorVertex), m_vertices.data(), GL_STATIC_DRAW);
-
-    // Set the vertex attribute pointers
-    // Vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)0);
 
-    // Vertex Normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)offsetof(ColorVertex, Normal));
+    // Per instance attributes and instanced programs, the VAO points into the instance buffer in UpdateVAO
+    m_instances.Create(*m_resources, "ColorObject", glslColorObjectInstancedVertexShader, glslColorObjectFragmentShader);
 
-    // Vertex Colors
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)offsetof(ColorVertex, Color));
-
-    // Create buffers and bind the indices
-    glGenBuffers(1, &m_elementBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
-
-    // **************** Unbind VAO ****************
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    UpdateVAO();
 }
 
 void CoordinateAxes::Delete()
@@ -132,12 +94,11 @@ void CoordinateAxes::Delete()
     }
 
     m_initialized = false;
-    glDeleteBuffers(1, &m_vertexBufferObject);
-    glDeleteBuffers(1, &m_elementBufferObject);
+    glDeleteVertexArrays(1, &m_vertexArrayObject);
+    m_instances.Delete();
 
-    glDeleteShader(m_vertexShader);
-    glDeleteShader(m_fragmentShader);
-    glDeleteProgram(m_shaderProgram);
+    m_resources->ReleaseGeometry(m_geometry);
+    m_geometry = SharedGeometry();
 }
 
 void CoordinateAxes::Render()
@@ -171,8 +132,30 @@ void CoordinateAxes::Render(const linmath::vec3 p, const linmath::quaternion q)
     Render(model);
 }
 
+
+void CoordinateAxes::UpdateInstances(const ObjectInstance* instances, size_t instanceCount)
+{
+    m_instances.Update(instances, instanceCount);
+}
+
+void CoordinateAxes::RenderInstances()
+{
+    const GLsizei instanceCount = m_instances.UseProgram(m_multiView, m_view, m_projection);
+    if (instanceCount == 0)
+    {
+        return;
+    }
+
+    glBindVertexArray(m_vertexArrayObject);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)m_indices.size(), GL_UNSIGNED_INT, NULL, instanceCount);
+}
+
 void CoordinateAxes::BuildVertices()
 {
+    // clear memory of prev arrays
+    m_vertices.clear();
+    m_indices.clear();
+
     // Cylinder is created along z axis and centered at origin.
     Cylinder axisZCylinder(m_axisThickness, m_axisLength);
     std::vector<MonoVertex> axisZCylinderVertices = axisZCylinder.GetVecticesVector();
@@ -246,12 +229,40 @@ void CoordinateAxes::BuildVertices()
 
 void CoordinateAxes::UpdateVAO()
 {
+    // Axes of another size are another shared geometry, the previous one may still be used by other windows
+    const std::string geometryName = "CoordinateAxes " + std::to_string(m_axisThickness) + " " + std::to_string(m_axisLength);
+    SharedGeometry previousGeometry = m_geometry;
+    m_geometry = m_resources->AcquireGeometry(geometryName,
+        m_vertices.data(), m_vertices.size() * sizeof(ColorVertex),
+        m_indices.data(), m_indices.size());
+
     glBindVertexArray(m_vertexArrayObject);
-    // Create buffers and bind the geometry
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(ColorVertex), m_vertices.data(), GL_STATIC_DRAW);
 
-    // Create buffers and bind the indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+    // Set the vertex attribute pointers
+    glBindBuffer(GL_ARRAY_BUFFER, m_geometry.VertexBuffer);
+    // Vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)0);
+
+    // Vertex Normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)offsetof(ColorVertex, Normal));
+
+    // Vertex Colors
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)offsetof(ColorVertex, Color));
+
+    // Bind the indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_geometry.ElementBuffer);
+
+    m_instances.SetAttributes();
+
+    // **************** Unbind VAO ****************
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (previousGeometry.VertexBuffer != 0)
+    {
+        m_resources->ReleaseGeometry(previousGeometry);
+    }
 }
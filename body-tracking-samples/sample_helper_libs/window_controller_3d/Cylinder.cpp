@@ -4,6 +4,7 @@
 #include "Cylinder.h"
 
 #include <cmath>
+#include <string>
 
 #include "Helpers.h"
 
@@ -82,28 +83,13 @@ void Cylinder::Create(GLFWwindow * window)
     m_initialized = true;
 
     m_window = window;
-    glfwMakeContextCurrent(window);
-
-    // Context Settings
-    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar* vertexShaderSources[] = { glslShaderVersion, glslMonoObjectVertexShader };
-    int numVertexShaderSources = sizeof(vertexShaderSources) / sizeof(*vertexShaderSources);
-    glShaderSource(m_vertexShader, numVertexShaderSources, vertexShaderSources, NULL);
-    glCompileShader(m_vertexShader);
-    ValidateShader(m_vertexShader);
-
-    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar* fragmentShaderSources[] = { glslShaderVersion, glslMonoObjectFragmentShader };
-    int numFragmentShaderSources = sizeof(fragmentShaderSources) / sizeof(*fragmentShaderSources);
-    glShaderSource(m_fragmentShader, numFragmentShaderSources, fragmentShaderSources, NULL);
-    glCompileShader(m_fragmentShader);
-    ValidateShader(m_fragmentShader);
-
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, m_vertexShader);
-    glAttachShader(m_shaderProgram, m_fragmentShader);
-    glLinkProgram(m_shaderProgram);
-    ValidateProgram(m_shaderProgram);
+    MakeContextCurrent(window);
+
+    // Programs and geometry are shared with the renderers of the other contexts of the share group
+    m_resources = &GlResourceManager::GetCurrent();
+    m_shaderProgram = m_resources->GetProgram("MonoObject",
+        { glslShaderVersion, glslSingleViewVertexShaderCommon, glslMonoObjectVertexShader },
+        { glslShaderVersion, glslMonoObjectFragmentShader });
 
     // Get shader index
     m_modelIndex = glGetUniformLocation(m_shaderProgram, "model");
@@ -111,33 +97,13 @@ void Cylinder::Create(GLFWwindow * window)
     m_projectionIndex = glGetUniformLocation(m_shaderProgram, "projection");
     m_colorIndex = glGetUniformLocation(m_shaderProgram, "color");
 
-    // **************** Generate Sphere VAO ****************
+    // **************** Generate Cylinder VAO ****************
     glGenVertexArrays(1, &m_vertexArrayObject);
-    glBindVertexArray(m_vertexArrayObject);
 
-    // Create buffers and bind the geometry
-    glGenBuffers(1, &m_vertexBufferObject);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
-
-    // Set the vertex attribute pointers
-    // Vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
+    // Per instance attributes and instanced programs, the VAO points into the instance buffer in UpdateVAO
+    m_instances.Create(*m_resources, "MonoObject", glslMonoObjectInstancedVertexShader, glslMonoObjectFragmentShader);
 
-    // Vertex Normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
-
-    // Create buffers and bind the indices
-    glGenBuffers(1, &m_elementBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
-
-    // **************** Unbind VAO ****************
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    UpdateVAO();
 }
 
 void Cylinder::Delete()
@@ -148,12 +114,11 @@ void Cylinder::Delete()
     }
 
     m_initialized = false;
-    glDeleteBuffers(1, &m_vertexBufferObject);
-    glDeleteBuffers(1, &m_elementBufferObject);
+    glDeleteVertexArrays(1, &m_vertexArrayObject);
+    m_instances.Delete();
 
-    glDeleteShader(m_vertexShader);
-    glDeleteShader(m_fragmentShader);
-    glDeleteProgram(m_shaderProgram);
+    m_resources->ReleaseGeometry(m_geometry);
+    m_geometry = SharedGeometry();
 }
 
 void Cylinder::Render()
@@ -181,6 +146,14 @@ void Cylinder::Render(const mat4x4 model, const linmath::vec4 color)
 }
 
 void Cylinder::Render(const linmath::vec3 start, const linmath::vec3 end, const linmath::vec4 color)
+{
+    // Scaled by the model like the instances, SetHeight would replace the geometry that is shared with other windows
+    mat4x4 model;
+    GetInstanceModel(model, start, end);
+    Render(model, color);
+}
+
+void Cylinder::GetInstanceModel(mat4x4 model, const vec3 start, const vec3 end)
 {
     vec3 centralAxis;
     vec3_sub(centralAxis, start, end);
@@ -190,17 +163,17 @@ void Cylinder::Render(const linmath::vec3 start, const linmath::vec3 end, const
     vec3_add(centerPosition, start, end);
     vec3_scale(centerPosition, centerPosition, 0.5f);
 
-    mat4x4 model, translation, rotation;
+    mat4x4 translation, rotation, translationRotation;
     mat4x4_translate(translation, centerPosition[0], centerPosition[1], centerPosition[2]);
 
     vec3 zAxis;
     vec3_set(zAxis, 0.f, 0.f, 1.f);
 
     ComputeRotationBetweenVectors(rotation, zAxis, centralAxis);
-    mat4x4_mul(model, translation, rotation);
+    mat4x4_mul(translationRotation, translation, rotation);
 
-    SetHeight(length);
-    Render(model, color);
+    // Stretch the shared vertices along the z axis instead of rebuilding them with SetHeight
+    mat4x4_scale_aniso(model, translationRotation, 1.f, 1.f, length / m_height);
 }
 
 void Cylinder::ComputeRotationBetweenVectors(mat4x4 rotation, const vec3 v0, const vec3 v1)
@@ -243,6 +216,24 @@ void Cylinder::ComputeRotationBetweenVectors(mat4x4 rotation, const vec3 v0, con
     rotation[3][3] = 1.f;
 }
 
+
+void Cylinder::UpdateInstances(const ObjectInstance* instances, size_t instanceCount)
+{
+    m_instances.Update(instances, instanceCount);
+}
+
+void Cylinder::RenderInstances()
+{
+    const GLsizei instanceCount = m_instances.UseProgram(m_multiView, m_view, m_projection);
+    if (instanceCount == 0)
+    {
+        return;
+    }
+
+    glBindVertexArray(m_vertexArrayObject);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)m_indices.size(), GL_UNSIGNED_INT, NULL, instanceCount);
+}
+
 // build vertices of Cylinder with smooth shading using parametric equation
 // x = r * cos(v)
 // y = r * sin(v)
@@ -304,14 +295,38 @@ void Cylinder::BuildVertices()
 
 void Cylinder::UpdateVAO()
 {
+    // A cylinder of another radius or height is another shared geometry, the previous one may still be used by other windows
+    const std::string geometryName = "Cylinder " + std::to_string(m_baseRadius) + " " + std::to_string(m_height) + " " + std::to_string(m_sectorCount);
+    SharedGeometry previousGeometry = m_geometry;
+    m_geometry = m_resources->AcquireGeometry(geometryName,
+        m_vertices.data(), m_vertices.size() * sizeof(MonoVertex),
+        m_indices.data(), m_indices.size());
+
     glBindVertexArray(m_vertexArrayObject);
-    // Create buffers and bind the geometry
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
 
-    // Create buffers and bind the indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+    // Set the vertex attribute pointers
+    glBindBuffer(GL_ARRAY_BUFFER, m_geometry.VertexBuffer);
+    // Vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
+
+    // Vertex Normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
+
+    // Bind the indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_geometry.ElementBuffer);
+
+    m_instances.SetAttributes();
+
+    // **************** Unbind VAO ****************
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (previousGeometry.VertexBuffer != 0)
+    {
+        m_resources->ReleaseGeometry(previousGeometry);
+    }
 }
 
 void Cylinder::AddIndices(uint32_t i1, uint32_t i2, uint32_t i3)
@@ -4,6 +4,7 @@
 #include "FloorRenderer.h"
 
 #include <cmath>
+#include <string>
 
 #include "Helpers.h"
 
@@ -38,28 +39,22 @@ void FloorRenderer::Create(GLFWwindow * window)
     m_initialized = true;
 
     m_window = window;
-    glfwMakeContextCurrent(window);
-
-    // Context Settings
-    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar* vertexShaderSources[] = { glslShaderVersion, glslMonoObjectVertexShader };
-    int numVertexShaderSources = sizeof(vertexShaderSources) / sizeof(*vertexShaderSources);
-    glShaderSource(m_vertexShader, numVertexShaderSources, vertexShaderSources, NULL);
-    glCompileShader(m_vertexShader);
-    ValidateShader(m_vertexShader);
-
-    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar* fragmentShaderSources[] = { glslShaderVersion, glslMonoObjectFragmentShader };
-    int numFragmentShaderSources = sizeof(fragmentShaderSources) / sizeof(*fragmentShaderSources);
-    glShaderSource(m_fragmentShader, numFragmentShaderSources, fragmentShaderSources, NULL);
-    glCompileShader(m_fragmentShader);
-    ValidateShader(m_fragmentShader);
-
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, m_vertexShader);
-    glAttachShader(m_shaderProgram, m_fragmentShader);
-    glLinkProgram(m_shaderProgram);
-    ValidateProgram(m_shaderProgram);
+    MakeContextCurrent(window);
+
+    // Programs and geometry are shared with the renderers of the other contexts of the share group
+    m_resources = &GlResourceManager::GetCurrent();
+    m_shaderProgram = m_resources->GetProgram("MonoObject",
+        { glslShaderVersion, glslSingleViewVertexShaderCommon, glslMonoObjectVertexShader },
+        { glslShaderVersion, glslMonoObjectFragmentShader });
+    if (IsMultiViewSupported())
+    {
+        m_multiViewShaderProgram = m_resources->GetProgram("MonoObjectMultiView",
+            { glslShaderVersion, glslMultiViewVertexShaderCommon, glslMonoObjectVertexShader },
+            { glslShaderVersion, glslMultiViewTriangleGeometryShader },
+            { glslShaderVersion, glslMonoObjectFragmentShader });
+        m_multiViewModelIndex = glGetUniformLocation(m_multiViewShaderProgram, "model");
+        m_multiViewColorIndex = glGetUniformLocation(m_multiViewShaderProgram, "color");
+    }
 
     // Get shader index
     m_modelIndex = glGetUniformLocation(m_shaderProgram, "model");
@@ -69,31 +64,8 @@ void FloorRenderer::Create(GLFWwindow * window)
 
     // **************** Generate FloorRenderer VAO ****************
     glGenVertexArrays(1, &m_vertexArrayObject);
-    glBindVertexArray(m_vertexArrayObject);
-
-    // Create buffers and bind the geometry
-    glGenBuffers(1, &m_vertexBufferObject);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
-
-    // Set the vertex attribute pointers
-    // Vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
 
-    // Vertex Normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
-
-    // Create buffers and bind the indices
-    glGenBuffers(1, &m_elementBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
-
-    // **************** Unbind VAO ****************
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    UpdateVAO();
 }
 
 void FloorRenderer::Delete()
@@ -104,12 +76,10 @@ void FloorRenderer::Delete()
     }
 
     m_initialized = false;
-    glDeleteBuffers(1, &m_vertexBufferObject);
-    glDeleteBuffers(1, &m_elementBufferObject);
+    glDeleteVertexArrays(1, &m_vertexArrayObject);
 
-    glDeleteShader(m_vertexShader);
-    glDeleteShader(m_fragmentShader);
-    glDeleteProgram(m_shaderProgram);
+    m_resources->ReleaseGeometry(m_geometry);
+    m_geometry = SharedGeometry();
 }
 
 void FloorRenderer::Render()
@@ -117,13 +87,24 @@ void FloorRenderer::Render()
     vec4 color;
     vec4_set(color, 1.f, 1.f, 1.f, 1.f);
 
-    glUseProgram(m_shaderProgram);
+    if (m_multiView)
+    {
+        // The view projections come from the MultiView uniform block
+        CheckAssert(m_multiViewShaderProgram != 0, "Multi view rendering is not supported");
+        glUseProgram(m_multiViewShaderProgram);
+        glUniformMatrix4fv(m_multiViewModelIndex, 1, GL_FALSE, (const GLfloat*)m_model);
+        glUniform4f(m_multiViewColorIndex, color[0], color[1], color[2], color[3]);
+    }
+    else
+    {
+        glUseProgram(m_shaderProgram);
 
-    // Update model/view/projective matrices in shader
-    glUniformMatrix4fv(m_viewIndex, 1, GL_FALSE, (const GLfloat*)m_view);
-    glUniformMatrix4fv(m_projectionIndex, 1, GL_FALSE, (const GLfloat*)m_projection);
-    glUniformMatrix4fv(m_modelIndex, 1, GL_FALSE, (const GLfloat*)m_model);
-    glUniform4f(m_colorIndex, color[0], color[1], color[2], color[3]);
+        // Update model/view/projective matrices in shader
+        glUniformMatrix4fv(m_viewIndex, 1, GL_FALSE, (const GLfloat*)m_view);
+        glUniformMatrix4fv(m_projectionIndex, 1, GL_FALSE, (const GLfloat*)m_projection);
+        glUniformMatrix4fv(m_modelIndex, 1, GL_FALSE, (const GLfloat*)m_model);
+        glUniform4f(m_colorIndex, color[0], color[1], color[2], color[3]);
+    }
 
     glBindVertexArray(m_vertexArrayObject); // Bind FloorRenderer VAO
     glDrawElements(GL_TRIANGLES, (GLsizei)m_indices.size(), GL_UNSIGNED_INT, NULL);
@@ -146,14 +127,35 @@ void FloorRenderer::BuildVertices()
 
 void FloorRenderer::UpdateVAO()
 {
+    const std::string geometryName = "Floor " + std::to_string(m_length) + " " + std::to_string(m_width);
+    SharedGeometry previousGeometry = m_geometry;
+    m_geometry = m_resources->AcquireGeometry(geometryName,
+        m_vertices.data(), m_vertices.size() * sizeof(MonoVertex),
+        m_indices.data(), m_indices.size());
+
     glBindVertexArray(m_vertexArrayObject);
-    // Create buffers and bind the geometry
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
 
-    // Create buffers and bind the indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+    // Set the vertex attribute pointers
+    glBindBuffer(GL_ARRAY_BUFFER, m_geometry.VertexBuffer);
+    // Vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
+
+    // Vertex Normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
+
+    // Bind the indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_geometry.ElementBuffer);
+
+    // **************** Unbind VAO ****************
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (previousGeometry.VertexBuffer != 0)
+    {
+        m_resources->ReleaseGeometry(previousGeometry);
+    }
 }
 
 void FloorRenderer::AddIndices(uint32_t i1, uint32_t i2, uint32_t i3)
@@ -42,15 +42,19 @@ namespace Visualization
         std::vector<MonoVertex> m_vertices;
         std::vector<uint32_t> m_indices;
 
-        // OpenGL objects
-        GLuint m_vertexArrayObject;
-        GLuint m_vertexBufferObject;
-        GLuint m_elementBufferObject;
+        // OpenGL objects, the geometry buffers are shared with the renderers of the other windows
+        GLuint m_vertexArrayObject = 0;
+        SharedGeometry m_geometry;
 
         GLuint m_modelIndex;
         GLuint m_viewIndex;
         GLuint m_projectionIndex;
 
         GLuint m_colorIndex;
+
+        // Rendering into all viewports, only created where multi view rendering is supported
+        GLuint m_multiViewShaderProgram = 0;
+        GLuint m_multiViewModelIndex = 0;
+        GLuint m_multiViewColorIndex = 0;
     };
 }
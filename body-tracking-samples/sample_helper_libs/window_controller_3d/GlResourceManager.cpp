@@ -0,0 +1,182 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "GlResourceManager.h"
+
+#include <vector>
+
+#include "Helpers.h"
+
+using namespace Visualization;
+
+static thread_local GlResourceManager* g_currentResources = nullptr;
+
+GlResourceManager& GlResourceManager::GetWindowResources()
+{
+    // The window contexts are destroyed with GLFW, which frees the objects as well
+    static GlResourceManager windowResources;
+    return windowResources;
+}
+
+GlResourceManager& GlResourceManager::GetCurrent()
+{
+    CheckAssert(g_currentResources != nullptr, "No GL resources are current on this thread");
+    return *g_currentResources;
+}
+
+void GlResourceManager::MakeCurrent(GlResourceManager* resources)
+{
+    g_currentResources = resources;
+}
+
+static GLuint CompileShader(GLenum type, std::initializer_list<const GLchar*> sources)
+{
+    std::vector<const GLchar*> sourceList(sources);
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, (GLsizei)sourceList.size(), sourceList.data(), NULL);
+    glCompileShader(shader);
+    ValidateShader(shader);
+    return shader;
+}
+
+GLuint GlResourceManager::GetProgram(
+    const std::string& name,
+    std::initializer_list<const GLchar*> vertexShaderSources,
+    std::initializer_list<const GLchar*> fragmentShaderSources)
+{
+    return GetProgram(name, vertexShaderSources, {}, fragmentShaderSources);
+}
+
+GLuint GlResourceManager::GetProgram(
+    const std::string& name,
+    std::initializer_list<const GLchar*> vertexShaderSources,
+    std::initializer_list<const GLchar*> geometryShaderSources,
+    std::initializer_list<const GLchar*> fragmentShaderSources)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto program = m_programs.find(name);
+    if (program != m_programs.end())
+    {
+        return program->second;
+    }
+
+    std::vector<GLuint> shaders;
+    shaders.push_back(CompileShader(GL_VERTEX_SHADER, vertexShaderSources));
+    if (geometryShaderSources.size() > 0)
+    {
+        shaders.push_back(CompileShader(GL_GEOMETRY_SHADER, geometryShaderSources));
+    }
+    shaders.push_back(CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSources));
+
+    GLuint shaderProgram = glCreateProgram();
+    for (GLuint shader : shaders)
+    {
+        glAttachShader(shaderProgram, shader);
+    }
+    glLinkProgram(shaderProgram);
+    ValidateProgram(shaderProgram);
+
+    // The linked program does not need the shaders anymore
+    for (GLuint shader : shaders)
+    {
+        glDetachShader(shaderProgram, shader);
+        glDeleteShader(shader);
+    }
+
+    m_programs[name] = shaderProgram;
+    return shaderProgram;
+}
+
+GLuint GlResourceManager::GetComputeProgram(
+    const std::string& name,
+    std::initializer_list<const GLchar*> computeShaderSources)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto program = m_programs.find(name);
+    if (program != m_programs.end())
+    {
+        return program->second;
+    }
+
+    GLuint computeShader = CompileShader(GL_COMPUTE_SHADER, computeShaderSources);
+
+    GLuint shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, computeShader);
+    glLinkProgram(shaderProgram);
+    ValidateProgram(shaderProgram);
+
+    glDetachShader(shaderProgram, computeShader);
+    glDeleteShader(computeShader);
+
+    m_programs[name] = shaderProgram;
+    return shaderProgram;
+}
+
+SharedGeometry GlResourceManager::AcquireGeometry(
+    const std::string& name,
+    const void* vertices, size_t verticesSize,
+    const uint32_t* indices, size_t indicesCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    GeometryEntry& entry = m_geometries[name];
+    if (entry.ReferenceCount++ > 0)
+    {
+        return entry.Geometry;
+    }
+
+    glGenBuffers(1, &entry.Geometry.VertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, entry.Geometry.VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Bound to the copy target, the element array binding belongs to the vertex array object of the caller
+    glGenBuffers(1, &entry.Geometry.ElementBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, entry.Geometry.ElementBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, indicesCount * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return entry.Geometry;
+}
+
+void GlResourceManager::ReleaseGeometry(const SharedGeometry& geometry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto entry = m_geometries.begin(); entry != m_geometries.end(); ++entry)
+    {
+        if (entry->second.Geometry.VertexBuffer != geometry.VertexBuffer)
+        {
+            continue;
+        }
+
+        if (--entry->second.ReferenceCount == 0)
+        {
+            glDeleteBuffers(1, &entry->second.Geometry.VertexBuffer);
+            glDeleteBuffers(1, &entry->second.Geometry.ElementBuffer);
+            m_geometries.erase(entry);
+        }
+        return;
+    }
+}
+
+void GlResourceManager::Delete()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& program : m_programs)
+    {
+        glDeleteProgram(program.second);
+    }
+    m_programs.clear();
+
+    for (auto& geometry : m_geometries)
+    {
+        glDeleteBuffers(1, &geometry.second.Geometry.VertexBuffer);
+        glDeleteBuffers(1, &geometry.second.Geometry.ElementBuffer);
+    }
+    m_geometries.clear();
+}
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "glad/glad.h"
+
+namespace Visualization
+{
+    // Static vertex and index buffer of a shape, shared by the renderers of all contexts of a share group
+    struct SharedGeometry
+    {
+        GLuint VertexBuffer = 0;
+        GLuint ElementBuffer = 0;
+    };
+
+    // Shader programs and static geometry of the contexts of one share group. Renderers get them in Create instead of
+    // compiling and uploading their own, so a program is compiled once per share group and not once per renderer and
+    // window.
+    //
+    // Programs are identified by name and stay until the group is deleted, there is only a handful of them. Geometry is
+    // identified by a name that includes its parameters and is deleted with its last reference. Vertex array objects
+    // can not be shared between contexts, every renderer keeps its own. Uniforms are program state, so renderers of a
+    // share group have to set all of them before drawing and must not render on different threads at the same time.
+    class GlResourceManager
+    {
+    public:
+        // Resources of all windows, their contexts share with a hidden window that lives as long as GLFW
+        static GlResourceManager& GetWindowResources();
+
+        // Resources of the context that is current on the calling thread, set along with the context
+        static GlResourceManager& GetCurrent();
+        static void MakeCurrent(GlResourceManager* resources);
+
+        // Compiles and links the program on the first call for the name, later calls return the same program
+        GLuint GetProgram(
+            const std::string& name,
+            std::initializer_list<const GLchar*> vertexShaderSources,
+            std::initializer_list<const GLchar*> fragmentShaderSources);
+
+        // Same with a geometry shader between the vertex and the fragment shader
+        GLuint GetProgram(
+            const std::string& name,
+            std::initializer_list<const GLchar*> vertexShaderSources,
+            std::initializer_list<const GLchar*> geometryShaderSources,
+            std::initializer_list<const GLchar*> fragmentShaderSources);
+
+        // Same for a compute program, needs GL 4.3 or ARB_compute_shader
+        GLuint GetComputeProgram(
+            const std::string& name,
+            std::initializer_list<const GLchar*> computeShaderSources);
+
+        // Uploads the geometry on the first call for the name, every call has to be paired with a ReleaseGeometry
+        SharedGeometry AcquireGeometry(
+            const std::string& name,
+            const void* vertices, size_t verticesSize,
+            const uint32_t* indices, size_t indicesCount);
+        void ReleaseGeometry(const SharedGeometry& geometry);
+
+        // Deletes all programs and geometry, with a context of the group current. Only needed for a group that ends
+        // before its last context is destroyed.
+        void Delete();
+
+    private:
+        struct GeometryEntry
+        {
+            SharedGeometry Geometry;
+            int ReferenceCount = 0;
+        };
+
+        std::map<std::string, GLuint> m_programs;
+        std::map<std::string, GeometryEntry> m_geometries;
+
+        std::mutex m_mutex;
+    };
+}
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "GLFW/glfw3.h"
 
@@ -79,3 +80,40 @@ void ValidateProgram(GLuint programIndex)
         Fail("Shader Error: %s", infoLog);
     }
 }
+
+// Context functions
+static GLADloadproc g_glProcAddressLoader = nullptr;
+
+void MakeContextCurrent(GLFWwindow* window)
+{
+    if (window != nullptr)
+    {
+        glfwMakeContextCurrent(window);
+    }
+}
+
+void SetGlProcAddressLoader(GLADloadproc loader)
+{
+    g_glProcAddressLoader = loader;
+}
+
+void* GetGlProcAddress(const char* name)
+{
+    CheckAssert(g_glProcAddressLoader != nullptr, "No GL loader set to load %s", name);
+    return g_glProcAddressLoader(name);
+}
+
+bool IsGlExtensionSupported(const char* extension)
+{
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++)
+    {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (name != nullptr && strcmp(name, extension) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -5,6 +5,8 @@
 
 #include "glad/glad.h"
 
+struct GLFWwindow;
+
 void FailedValidation(const char* message);
 
 void Fail(const char* message, ...);
@@ -18,6 +20,18 @@ void ValidateShader(GLuint shaderIndex);
 
 void ValidateProgram(GLuint programIndex);
 
+// Context functions
+// Renderers of an offscreen context get no window, their context is already current
+void MakeContextCurrent(GLFWwindow* window);
+
+// Loader of the context, glfwGetProcAddress or eglGetProcAddress. Set before gladLoadGLLoader.
+void SetGlProcAddressLoader(GLADloadproc loader);
+
+// Also loads functions newer than the GL 4.3 loader, nullptr when they are not available
+void* GetGlProcAddress(const char* name);
+
+bool IsGlExtensionSupported(const char* extension);
+
 #define RETURN_IF_GL_ERRORS  { bool glErr = false; while (glGetError() != GL_NO_ERROR) { glErr = true; } if (glErr) { return GPU_ERROR_FROM_API; } }
 
 #define UNINIT_IF_GL_ERRORS  { bool glErr = false; while (glGetError() != GL_NO_ERROR) { glErr = true; } if (glErr) { UnInitialize(); return GPU_ERROR_FROM_API; } }
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "InstanceBuffer.h"
+
+#include <cstddef>
+
+#include "Helpers.h"
+#include "MultiViewShaders.h"
+#include "RendererBase.h"
+
+using namespace linmath;
+using namespace Visualization;
+
+void InstanceBuffer::Create(GlResourceManager& resources,
+    const std::string& name,
+    const GLchar* instancedVertexShader,
+    const GLchar* fragmentShader)
+{
+    m_shaderProgram = resources.GetProgram(name + "Instanced",
+        { glslShaderVersion, glslSingleViewVertexShaderCommon, instancedVertexShader },
+        { glslShaderVersion, fragmentShader });
+    if (RendererBase::IsMultiViewSupported())
+    {
+        m_multiViewShaderProgram = resources.GetProgram(name + "InstancedMultiView",
+            { glslShaderVersion, glslMultiViewVertexShaderCommon, instancedVertexShader },
+            { glslShaderVersion, glslMultiViewTriangleGeometryShader },
+            { glslShaderVersion, fragmentShader });
+    }
+
+    m_viewIndex = glGetUniformLocation(m_shaderProgram, "view");
+    m_projectionIndex = glGetUniformLocation(m_shaderProgram, "projection");
+
+    // Only read by the instanced programs
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ObjectInstance), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Delete()
+{
+    // The programs belong to the resources
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+    m_instanceCount = 0;
+    m_shaderProgram = 0;
+    m_multiViewShaderProgram = 0;
+}
+
+void InstanceBuffer::SetAttributes()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+    // A mat4 attribute takes one location per column
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectInstance),
+            (void*)(offsetof(ObjectInstance, Model) + column * sizeof(vec4)));
+        glVertexAttribDivisor(3 + column, 1);
+    }
+
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectInstance), (void*)offsetof(ObjectInstance, Color));
+    glVertexAttribDivisor(7, 1);
+}
+
+void InstanceBuffer::Update(const ObjectInstance* instances, size_t instanceCount)
+{
+    m_instanceCount = (GLsizei)instanceCount;
+    if (instanceCount == 0)
+    {
+        // Keep the last buffer, the attributes of the program without instancing still point into it
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(ObjectInstance), instances, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLsizei InstanceBuffer::UseProgram(bool multiView, const mat4x4 view, const mat4x4 projection)
+{
+    if (m_instanceCount == 0)
+    {
+        return 0;
+    }
+
+    if (multiView)
+    {
+        CheckAssert(m_multiViewShaderProgram != 0, "Multi view rendering is not supported");
+        glUseProgram(m_multiViewShaderProgram);
+    }
+    else
+    {
+        glUseProgram(m_shaderProgram);
+
+        // The models are instance attributes
+        glUniformMatrix4fv(m_viewIndex, 1, GL_FALSE, (const GLfloat*)view);
+        glUniformMatrix4fv(m_projectionIndex, 1, GL_FALSE, (const GLfloat*)projection);
+    }
+    return m_instanceCount;
+}
@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <string>
+
+#include "glad/glad.h"
+
+#include "GlResourceManager.h"
+#include "linmath.h"
+#include "WindowController3dTypes.h"
+
+namespace Visualization
+{
+    // Per instance ObjectInstance attributes and the instanced programs of a shape renderer. The renderer keeps its
+    // geometry and vertex array object, calls SetAttributes while its vertex array object is bound and draws
+    // UseProgram() instances with glDrawElementsInstanced.
+    //
+    // The instanced vertex shader reads the model at locations 3-6 and the color at 7, see MonoObjectShaders.h.
+    class InstanceBuffer
+    {
+    public:
+        // With the context of the renderer current. Gets "<name>Instanced" and, where multi view rendering is
+        // supported, "<name>InstancedMultiView" from the resources.
+        void Create(GlResourceManager& resources,
+            const std::string& name,
+            const GLchar* instancedVertexShader,
+            const GLchar* fragmentShader);
+        void Delete();
+
+        // Points the instance attributes of the bound vertex array object into the buffer
+        void SetAttributes();
+
+        void Update(const ObjectInstance* instances, size_t instanceCount);
+
+        // Uses the program for the view mode and returns the number of instances to draw, 0 when there are none.
+        // In multi view mode the view projections come from the MultiView uniform block instead of view and projection.
+        GLsizei UseProgram(bool multiView, const linmath::mat4x4 view, const linmath::mat4x4 projection);
+
+    private:
+        GLuint m_buffer = 0;
+        GLsizei m_instanceCount = 0;
+
+        GLuint m_shaderProgram = 0;
+        GLuint m_viewIndex = 0;
+        GLuint m_projectionIndex = 0;
+
+        // Only created where multi view rendering is supported
+        GLuint m_multiViewShaderProgram = 0;
+    };
+}
@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "GlShaderDefs.h"
+
+// Number of viewports a multi view geometry shader renders into, the size of the MultiView uniform block
+static const int glslMaxViewCount = 4;
+
+// ************** Single View Vertex Shader Code **************
+// Transform of the vertex shaders that render into one viewport, has to precede the vertex shader in the sources
+static const char* const glslSingleViewVertexShaderCommon = GLSL_STRING(
+
+    uniform mat4 view;
+    uniform mat4 projection;
+
+    vec4 ProjectVertex(vec4 worldPosition)
+    {
+        return projection * view * worldPosition;
+    }
+
+    // Outside of the clip volume, the point is not rasterized
+    vec4 DiscardedVertex()
+    {
+        return vec4(2, 2, 2, 1);
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Multi View Vertex Shader Code **************
+// Replaces glslSingleViewVertexShaderCommon for the multi view programs. The vertex shader outputs the world position
+// and one of the geometry shaders below projects it into every viewport. The outputs of the vertex shader are renamed,
+// the geometry shader passes them on to the fragment shader under their original names. GLSL_STRING code has no line
+// breaks, the defines have to start on a line of their own after the common code of the programs.
+static const char* const glslMultiViewVertexShaderCommon =
+    "\n"
+    "#define fragmentColor multiViewFragmentColor\n"
+    "#define fragmentPosition multiViewFragmentPosition\n"
+    "#define fragmentNormal multiViewFragmentNormal\n"
+    GLSL_STRING(
+
+    vec4 ProjectVertex(vec4 worldPosition)
+    {
+        return worldPosition;
+    }
+
+    // World positions always have w = 1, the geometry shader drops vertices with w = 0
+    vec4 DiscardedVertex()
+    {
+        return vec4(0, 0, 0, 0);
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Multi View Point Geometry Shader **************
+// One invocation per viewport of the viewport array
+static const char* const glslMultiViewPointGeometryShader = GLSL_STRING(
+
+    layout(points, invocations = 4) in;
+    layout(points, max_vertices = 1) out;
+
+    layout(std140, binding = 0) uniform MultiView
+    {
+        mat4 viewProjection[4];
+    };
+
+    in vec4 multiViewFragmentColor[];
+
+    out vec4 fragmentColor;
+
+    void main()
+    {
+        if (gl_in[0].gl_Position.w == 0)
+        {
+            return;
+        }
+
+        gl_ViewportIndex = gl_InvocationID;
+        gl_Position = viewProjection[gl_InvocationID] * gl_in[0].gl_Position;
+        fragmentColor = multiViewFragmentColor[0];
+        EmitVertex();
+        EndPrimitive();
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Multi View Triangle Geometry Shader **************
+// One invocation per viewport of the viewport array, for the vertex shaders of the mono and color objects
+static const char* const glslMultiViewTriangleGeometryShader = GLSL_STRING(
+
+    layout(triangles, invocations = 4) in;
+    layout(triangle_strip, max_vertices = 3) out;
+
+    layout(std140, binding = 0) uniform MultiView
+    {
+        mat4 viewProjection[4];
+    };
+
+    in vec4 multiViewFragmentColor[];
+    in vec3 multiViewFragmentPosition[];
+    in vec3 multiViewFragmentNormal[];
+
+    out vec4 fragmentColor;
+    out vec3 fragmentPosition;
+    out vec3 fragmentNormal;
+
+    void main()
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            gl_ViewportIndex = gl_InvocationID;
+            gl_Position = viewProjection[gl_InvocationID] * gl_in[i].gl_Position;
+            fragmentColor = multiViewFragmentColor[i];
+            fragmentPosition = multiViewFragmentPosition[i];
+            fragmentNormal = multiViewFragmentNormal[i];
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+
+);  // GLSL_STRING
@@ -0,0 +1,205 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "OffscreenContext.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glad/glad.h"
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "Helpers.h"
+
+using namespace Visualization;
+
+#ifndef _WIN32
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// The display is shared by all offscreen contexts of the process and never terminated, terminating it would
+// destroy the contexts of the other users as well
+static EGLDisplay GetOffscreenDisplay()
+{
+    static EGLDisplay display = []() {
+        EGLDisplay surfacelessDisplay = EGL_NO_DISPLAY;
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (clientExtensions != nullptr && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != nullptr &&
+            getPlatformDisplay != nullptr)
+        {
+            surfacelessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (surfacelessDisplay != EGL_NO_DISPLAY && !eglInitialize(surfacelessDisplay, nullptr, nullptr))
+            {
+                surfacelessDisplay = EGL_NO_DISPLAY;
+            }
+        }
+        if (surfacelessDisplay != EGL_NO_DISPLAY)
+        {
+            return surfacelessDisplay;
+        }
+
+        EGLDisplay defaultDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (defaultDisplay != EGL_NO_DISPLAY && !eglInitialize(defaultDisplay, nullptr, nullptr))
+        {
+            defaultDisplay = EGL_NO_DISPLAY;
+        }
+        return defaultDisplay;
+    }();
+    return display;
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    Delete();
+}
+
+bool OffscreenContext::Create()
+{
+    CheckAssert(!IsCreated());
+
+    EGLDisplay display = GetOffscreenDisplay();
+    if (display == EGL_NO_DISPLAY)
+    {
+        printf("No EGL display for offscreen rendering\n");
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("EGL does not support desktop OpenGL\n");
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        printf("No EGL config for offscreen rendering\n");
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        printf("Failed to create an OpenGL 4.3 EGL context\n");
+        return false;
+    }
+
+    // Surfaceless contexts need EGL_KHR_surfaceless_context, otherwise a dummy pbuffer is current
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+        {
+            printf("Failed to make the EGL context current\n");
+            if (surface != EGL_NO_SURFACE)
+            {
+                eglDestroySurface(display, surface);
+            }
+            eglDestroyContext(display, context);
+            return false;
+        }
+    }
+
+    m_display = display;
+    m_context = context;
+    m_surface = surface;
+
+    SetGlProcAddressLoader((GLADloadproc)eglGetProcAddress);
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        printf("Failed to load the OpenGL functions of the EGL context\n");
+        Delete();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenContext::Delete()
+{
+    if (!IsCreated())
+    {
+        return;
+    }
+
+    if (eglGetCurrentContext() == m_context)
+    {
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    if (m_surface != nullptr)
+    {
+        eglDestroySurface(m_display, m_surface);
+    }
+    eglDestroyContext(m_display, m_context);
+
+    m_context = nullptr;
+    m_surface = nullptr;
+}
+
+void OffscreenContext::MakeCurrent()
+{
+    CheckAssert(IsCreated(), "The offscreen context is not created");
+
+    if (eglGetCurrentContext() != m_context)
+    {
+        eglMakeCurrent(m_display, m_surface, m_surface, m_context);
+    }
+}
+
+void OffscreenContext::ReleaseCurrent()
+{
+    if (IsCreated() && eglGetCurrentContext() == m_context)
+    {
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+}
+
+#else
+
+OffscreenContext::~OffscreenContext()
+{
+}
+
+bool OffscreenContext::Create()
+{
+    return false;
+}
+
+void OffscreenContext::Delete()
+{
+}
+
+void OffscreenContext::MakeCurrent()
+{
+    Fail("Offscreen contexts are not supported on Windows");
+}
+
+void OffscreenContext::ReleaseCurrent()
+{
+}
+
+#endif
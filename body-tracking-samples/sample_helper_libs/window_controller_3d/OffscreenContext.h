@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+namespace Visualization
+{
+    // OpenGL 4.3 core context without any window or display server, for rendering on headless machines.
+    // Uses EGL with the surfaceless platform when available (Mesa, including the llvmpipe software rasterizer),
+    // otherwise the default EGL display with a small pbuffer. The context has no default framebuffer to render to,
+    // the user renders into a framebuffer object.
+    //
+    // EGL is not used on Windows, Create returns false there and a hidden window has to provide the context instead.
+    // The repository only has Visual Studio projects, so the EGL implementation is not built by any of them, see the
+    // README of simple_3d_viewer.
+    class OffscreenContext
+    {
+    public:
+        ~OffscreenContext();
+
+        // Creates the context, makes it current on the calling thread and loads the GL functions
+        bool Create();
+        void Delete();
+
+        bool IsCreated() const { return m_context != nullptr; }
+
+        void MakeCurrent();
+
+        // Only a context that is not current on any other thread can be made current
+        void ReleaseCurrent();
+
+    private:
+        // EGLDisplay, EGLContext and EGLSurface, the EGL headers are only needed by the implementation
+        void* m_display = nullptr;
+        void* m_context = nullptr;
+        void* m_surface = nullptr;
+    };
+}
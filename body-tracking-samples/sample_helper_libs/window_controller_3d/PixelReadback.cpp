@@ -0,0 +1,126 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "PixelReadback.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "Helpers.h"
+
+using namespace Visualization;
+
+PixelReadback::~PixelReadback()
+{
+    Delete();
+}
+
+void PixelReadback::Create(int slotCount)
+{
+    CheckAssert(!IsCreated());
+    CheckAssert(slotCount > 0 && slotCount <= MaxSlotCount, "Invalid pixel readback slot count %d", slotCount);
+
+    m_slots.resize(slotCount);
+    for (Slot& slot : m_slots)
+    {
+        glGenBuffers(1, &slot.Buffer);
+    }
+    m_firstQueued = 0;
+    m_queuedCount = 0;
+    m_droppedCount = 0;
+}
+
+void PixelReadback::Delete()
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.Fence != nullptr)
+        {
+            glDeleteSync(slot.Fence);
+        }
+        glDeleteBuffers(1, &slot.Buffer);
+    }
+    m_slots.clear();
+    m_firstQueued = 0;
+    m_queuedCount = 0;
+}
+
+void PixelReadback::Queue(int width, int height, uint64_t frameIndex)
+{
+    CheckAssert(IsCreated() && !IsFull(), "No free pixel readback slot");
+
+    Slot& slot = m_slots[(m_firstQueued + m_queuedCount) % m_slots.size()];
+    slot.Width = width;
+    slot.Height = height;
+    slot.FrameIndex = frameIndex;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+    const GLsizeiptr size = (GLsizeiptr)width * height * 3;
+    if (size != slot.Size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.Size = size;
+    }
+
+    // Tightly packed rows, the copy out is a single memcpy. With a pack buffer bound the pointer is an offset.
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_queuedCount++;
+}
+
+bool PixelReadback::Pop(RenderedFrame& frame, bool wait)
+{
+    if (IsEmpty())
+    {
+        return false;
+    }
+
+    Slot& slot = m_slots[m_firstQueued];
+    if (slot.Fence != nullptr)
+    {
+        // The flush makes sure the fence is eventually signaled, also when only polling
+        const GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum waitResult = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        while (wait && waitResult == GL_TIMEOUT_EXPIRED)
+        {
+            waitResult = glClientWaitSync(slot.Fence, 0, timeout);
+        }
+        if (waitResult == GL_TIMEOUT_EXPIRED)
+        {
+            return false;
+        }
+        CheckAssert(waitResult != GL_WAIT_FAILED, "Waiting for the pixel readback failed");
+
+        glDeleteSync(slot.Fence);
+        slot.Fence = nullptr;
+    }
+
+    frame.Width = slot.Width;
+    frame.Height = slot.Height;
+    frame.FrameIndex = slot.FrameIndex;
+    frame.PixelsBgr.resize((size_t)slot.Size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.Size, GL_MAP_READ_BIT);
+    if (pixels != nullptr)
+    {
+        memcpy(frame.PixelsBgr.data(), pixels, (size_t)slot.Size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+    {
+        // Keeping the slot would not help, a buffer that can not be mapped once fails again (out of memory or a lost
+        // context) and the ring would stay full
+        printf("Mapping the pixel readback of frame %llu failed, the frame is dropped\n", (unsigned long long)slot.FrameIndex);
+        m_droppedCount++;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_firstQueued = (m_firstQueued + 1) % (int)m_slots.size();
+    m_queuedCount--;
+    return pixels != nullptr;
+}
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "WindowController3dTypes.h"
+
+namespace Visualization
+{
+    // Ring of pixel pack buffers to read rendered frames back without stalling the render thread.
+    // Queue only starts the copy into the next buffer and fences it, the pixels are copied out by Pop once the fence
+    // is signaled, usually a few frames later. A ring of N buffers allows N frames in flight.
+    //
+    // Usage per frame, with the context of the readback current:
+    //     if (readback.IsFull()) readback.Pop(frame, true);  // or Pop(frame, false) to only take finished frames
+    //     readback.Queue(width, height, frameIndex);        // reads from the current read framebuffer
+    class PixelReadback
+    {
+    public:
+        static const int MaxSlotCount = 8;
+
+        ~PixelReadback();
+
+        void Create(int slotCount = 3);
+        void Delete();
+
+        bool IsCreated() const { return !m_slots.empty(); }
+        bool IsEmpty() const { return m_queuedCount == 0; }
+        bool IsFull() const { return m_queuedCount == (int)m_slots.size(); }
+
+        // Starts reading the lower-left width x height pixels as BGR, the ring must not be full
+        void Queue(int width, int height, uint64_t frameIndex);
+
+        // Copies out the oldest queued frame. Without wait it returns false when that frame is not finished yet.
+        // Also returns false when its buffer can not be mapped, the frame is then dropped and counted.
+        bool Pop(RenderedFrame& frame, bool wait);
+
+        // Frames dropped by Pop since Create
+        uint64_t GetDroppedCount() const { return m_droppedCount; }
+
+    private:
+        struct Slot
+        {
+            GLuint Buffer = 0;
+            GLsizeiptr Size = 0;
+            GLsync Fence = nullptr;
+            int Width = 0;
+            int Height = 0;
+            uint64_t FrameIndex = 0;
+        };
+
+        std::vector<Slot> m_slots;
+        int m_firstQueued = 0;
+        int m_queuedCount = 0;
+        uint64_t m_droppedCount = 0;
+    };
+}
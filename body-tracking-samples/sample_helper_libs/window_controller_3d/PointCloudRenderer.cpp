@@ -8,6 +8,7 @@
 #include <stdarg.h>
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <thread>
 
 #include "PointCloudShaders.h"
@@ -34,6 +35,11 @@ PointCloudRenderer::PointCloudRenderer()
 {
     mat4x4_identity(m_view);
     mat4x4_identity(m_projection);
+
+    for (DepthSource& depthSource : m_depthSources)
+    {
+        mat4x4_identity(depthSource.DepthToWorld);
+    }
 }
 
 PointCloudRenderer::~PointCloudRenderer()
@@ -47,39 +53,48 @@ void PointCloudRenderer::Create(GLFWwindow* window)
     m_initialized = true;
 
     m_window = window;
-    glfwMakeContextCurrent(window);
+    MakeContextCurrent(window);
 
     // Context Settings
     glEnable(GL_PROGRAM_POINT_SIZE);
 
-    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar* vertexShaderSources[] = { glslShaderVersion, glslPointCloudVertexShader };
-    int numVertexShaderSources = sizeof(vertexShaderSources) / sizeof(*vertexShaderSources);
-    glShaderSource(m_vertexShader, numVertexShaderSources, vertexShaderSources, NULL);
-    glCompileShader(m_vertexShader);
-    ValidateShader(m_vertexShader);
-
-    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar* fragmentShaderSources[] = { glslShaderVersion, glslPointCloudFragmentShader};
-    int numFragmentShaderSources = sizeof(fragmentShaderSources) / sizeof(*fragmentShaderSources);
-    glShaderSource(m_fragmentShader, numFragmentShaderSources, fragmentShaderSources, NULL);
-    glCompileShader(m_fragmentShader);
-    ValidateShader(m_fragmentShader);
-
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, m_vertexShader);
-    glAttachShader(m_shaderProgram, m_fragmentShader);
-    glLinkProgram(m_shaderProgram);
-    ValidateProgram(m_shaderProgram);
+    // Programs are shared with the renderers of the other contexts of the share group
+    m_resources = &GlResourceManager::GetCurrent();
+    m_pointProgram = GetPointCloudProgram(m_resources->GetProgram("PointCloud",
+        { glslShaderVersion, glslPointCloudShaderCommon, glslSingleViewVertexShaderCommon,
+          glslPointCloudVertexShaderCommon, glslPointCloudVertexShader },
+        { glslShaderVersion, glslPointCloudFragmentShader }));
+    m_depthPointProgram = GetPointCloudProgram(m_resources->GetProgram("PointCloudDepth",
+        { glslShaderVersion, glslPointCloudShaderCommon, glslSingleViewVertexShaderCommon,
+          glslPointCloudVertexShaderCommon, glslPointCloudDepthVertexShader },
+        { glslShaderVersion, glslPointCloudFragmentShader }));
+    m_shaderProgram = m_pointProgram.Program;
+
+    if (IsMultiViewSupported())
+    {
+        m_multiViewPointProgram = GetPointCloudProgram(m_resources->GetProgram("PointCloudMultiView",
+            { glslShaderVersion, glslPointCloudShaderCommon, glslMultiViewVertexShaderCommon,
+              glslPointCloudVertexShaderCommon, glslPointCloudVertexShader },
+            { glslShaderVersion, glslMultiViewPointGeometryShader },
+            { glslShaderVersion, glslPointCloudFragmentShader }));
+        m_multiViewDepthPointProgram = GetPointCloudProgram(m_resources->GetProgram("PointCloudDepthMultiView",
+            { glslShaderVersion, glslPointCloudShaderCommon, glslMultiViewVertexShaderCommon,
+              glslPointCloudVertexShaderCommon, glslPointCloudDepthVertexShader },
+            { glslShaderVersion, glslMultiViewPointGeometryShader },
+            { glslShaderVersion, glslPointCloudFragmentShader }));
+    }
 
     glGenVertexArrays(1, &m_vertexArrayObject);
-    glBindVertexArray(m_vertexArrayObject);
-    glGenBuffers(1, &m_vertexBufferObject);
-    m_viewIndex = glGetUniformLocation(m_shaderProgram, "view");
-    m_projectionIndex = glGetUniformLocation(m_shaderProgram, "projection");
-    m_enableShadingIndex = glGetUniformLocation(m_shaderProgram, "enableShading");
-    m_xyTableSamplerIndex = glGetUniformLocation(m_shaderProgram, "xyTable");
-    m_depthSamplerIndex = glGetUniformLocation(m_shaderProgram, "depth");
+    glGenVertexArrays(1, &m_emptyVertexArrayObject);
+
+    // Without compute shaders the vertex shaders compute the normals themselves, once per vertex and viewport
+    m_normalShaderProgram = 0;
+    if (GLAD_GL_VERSION_4_3 || IsGlExtensionSupported("GL_ARB_compute_shader"))
+    {
+        m_normalShaderProgram = m_resources->GetComputeProgram("PointCloudNormal",
+            { glslShaderVersion, glslPointCloudShaderCommon, glslPointCloudNormalComputeShader });
+        m_normalSourceSizeIndex = glGetUniformLocation(m_normalShaderProgram, "sourceSize");
+    }
 }
 
 void PointCloudRenderer::Delete()
@@ -90,26 +105,138 @@ void PointCloudRenderer::Delete()
     }
 
     m_initialized = false;
-    glDeleteBuffers(1, &m_vertexBufferObject);
+    m_vertexUploadBuffer.Delete();
+
+    glDeleteVertexArrays(1, &m_vertexArrayObject);
+    glDeleteVertexArrays(1, &m_emptyVertexArrayObject);
+    m_vertexArrayObject = 0;
+    m_emptyVertexArrayObject = 0;
+
+    glDeleteTextures(1, &m_xyTableTextureObject);
+    glDeleteTextures(1, &m_depthTextureObject);
+    glDeleteTextures(1, &m_bodyIndexTextureObject);
+    glDeleteTextures(1, &m_normalTextureObject);
+    m_xyTableTextureObject = 0;
+    m_depthTextureObject = 0;
+    m_bodyIndexTextureObject = 0;
+    m_normalTextureObject = 0;
+    m_normalsUpToDate = false;
+    m_drawArraySize = 0;
+
+    for (uint32_t source = 0; source < m_depthSourceCount; source++)
+    {
+        m_depthSources[source].DepthUploadBuffer.Delete();
+        m_depthSources[source].HasBodyIndexMap = false;
+    }
+    m_depthSourceCount = 0;
+    m_width = 0;
+    m_height = 0;
+    m_layerCount = 0;
+}
+
+void PointCloudRenderer::InitializeDepthXYTable(const float* xyTableInterleaved, uint32_t width, uint32_t height, uint32_t source)
+{
+    if (source > m_depthSourceCount || source >= MaxDepthSources)
+    {
+        Fail("Depth source %u can not be initialized, %u sources are initialized and at most %u are supported!", source, m_depthSourceCount, MaxDepthSources);
+    }
+
+    DepthSource& depthSource = m_depthSources[source];
+    depthSource.Width = width;
+    depthSource.Height = height;
+    depthSource.HasBodyIndexMap = false;
+    depthSource.XyTable.assign(xyTableInterleaved, xyTableInterleaved + width * height * 2);
 
-    glDeleteShader(m_vertexShader);
-    glDeleteShader(m_fragmentShader);
-    glDeleteProgram(m_shaderProgram);
+    depthSource.DepthUploadBuffer.Delete();
+    depthSource.DepthUploadBuffer.Create(GL_PIXEL_UNPACK_BUFFER, width * height * sizeof(uint16_t));
+
+    m_depthSourceCount = std::max(m_depthSourceCount, source + 1);
+    m_normalsUpToDate = false;
+
+    // Replaces the layer of a previous table, e.g. of another sensor, unless the textures grow anyway
+    if (m_depthSourceCount > m_layerCount || width > m_width || height > m_height)
+    {
+        CreateSourceTextures();
+    }
+    else
+    {
+        ResetSourceLayer(source);
+    }
 }
 
-void PointCloudRenderer::InitializeDepthXYTable(const float* xyTableInterleaved, uint32_t width, uint32_t height)
+void PointCloudRenderer::SetDepthSourceTransform(uint32_t source, const linmath::mat4x4 depthToWorld)
 {
-    m_width = width;
-    m_height = height;
+    if (source >= MaxDepthSources)
+    {
+        Fail("Depth source %u is out of range, at most %u are supported!", source, MaxDepthSources);
+    }
 
+    std::memcpy(m_depthSources[source].DepthToWorld, depthToWorld, sizeof(linmath::mat4x4));
+}
+
+void PointCloudRenderer::CreateSourceTextures()
+{
+    glDeleteTextures(1, &m_xyTableTextureObject);
+    glDeleteTextures(1, &m_depthTextureObject);
+    glDeleteTextures(1, &m_bodyIndexTextureObject);
+    glDeleteTextures(1, &m_normalTextureObject);
+
+    m_width = 0;
+    m_height = 0;
+    for (uint32_t source = 0; source < m_depthSourceCount; source++)
+    {
+        m_width = std::max(m_width, m_depthSources[source].Width);
+        m_height = std::max(m_height, m_depthSources[source].Height);
+    }
+    m_layerCount = m_depthSourceCount;
+
+    // The textures are only allocated once per set of sources, frames are uploaded into the existing storage
     glGenTextures(1, &m_xyTableTextureObject);
-    glBindTexture(GL_TEXTURE_2D, m_xyTableTextureObject);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32F, m_width, m_height);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RG, GL_FLOAT, xyTableInterleaved);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_xyTableTextureObject);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RG32F, m_width, m_height, m_layerCount);
 
     glGenTextures(1, &m_depthTextureObject);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTextureObject);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16UI, m_width, m_height, m_layerCount);
+
+    glGenTextures(1, &m_bodyIndexTextureObject);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_bodyIndexTextureObject);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8UI, m_width, m_height, m_layerCount);
+
+    glGenTextures(1, &m_normalTextureObject);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_normalTextureObject);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA16F, m_width, m_height, m_layerCount);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // The depth frames of the previous textures are lost, the sources show up again with their next frame
+    for (uint32_t source = 0; source < m_depthSourceCount; source++)
+    {
+        ResetSourceLayer(source);
+    }
+}
+
+void PointCloudRenderer::ResetSourceLayer(uint32_t source)
+{
+    const DepthSource& depthSource = m_depthSources[source];
+
+    // Pixels outside of a smaller source stay 0, so neighbor lookups at its border find no points there
+    const std::vector<float> zeros(m_width * m_height * 2, 0.f);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_xyTableTextureObject);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, m_width, m_height, 1, GL_RG, GL_FLOAT, zeros.data());
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, depthSource.Width, depthSource.Height, 1, GL_RG, GL_FLOAT,
+        depthSource.XyTable.data());
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTextureObject);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, m_width, m_height, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, zeros.data());
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_bodyIndexTextureObject);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, m_width, m_height, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE, zeros.data());
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 void PointCloudRenderer::UpdatePointClouds(
@@ -119,52 +246,174 @@ void PointCloudRenderer::UpdatePointClouds(
     const uint16_t* depthFrame,
     uint32_t width, uint32_t height,
     bool useTestPointClouds)
+{
+    uint16_t* mappedDepthFrame = MapDepthFrame(window, width, height);
+    if (mappedDepthFrame != nullptr)
+    {
+        std::copy(depthFrame, depthFrame + width * height, mappedDepthFrame);
+        UnmapDepthFrame(false);
+    }
+
+    if (useTestPointClouds)
+    {
+        point3ds = testVertices;
+        numPoints = sizeof(testVertices) / sizeof(*testVertices);
+    }
+
+    PointCloudVertex* mappedPoint3ds = MapPointClouds(window, numPoints);
+    if (mappedPoint3ds != nullptr)
+    {
+        std::copy(point3ds, point3ds + numPoints, mappedPoint3ds);
+        UnmapPointClouds(numPoints);
+    }
+}
+
+void PointCloudRenderer::UpdateDepthFrame(
+    GLFWwindow* window,
+    const uint16_t* depthFrame,
+    uint32_t width, uint32_t height,
+    uint32_t source)
+{
+    uint16_t* mappedDepthFrame = MapDepthFrame(window, width, height, source);
+    if (mappedDepthFrame != nullptr)
+    {
+        std::copy(depthFrame, depthFrame + width * height, mappedDepthFrame);
+        UnmapDepthFrame(true, source);
+    }
+}
+
+uint16_t* PointCloudRenderer::MapDepthFrame(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t source)
 {
     if (window != m_window)
     {
         Create(window);
     }
 
-    if (m_width != width && m_height != height)
+    if (source >= m_depthSourceCount)
     {
-        Fail("Width and Height (%u, %u) does not match the DepthXYTable settings: (%u, %u) are expected!", width, height, m_width, m_height);
+        Fail("Depth source %u has no DepthXYTable, %u sources are initialized!", source, m_depthSourceCount);
     }
 
-    glBindImageTexture(0, m_xyTableTextureObject, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    DepthSource& depthSource = m_depthSources[source];
+    if (depthSource.Width != width || depthSource.Height != height)
+    {
+        Fail("Width and Height (%u, %u) does not match the DepthXYTable settings: (%u, %u) are expected!", width, height, depthSource.Width, depthSource.Height);
+    }
 
-    glBindTexture(GL_TEXTURE_2D, m_depthTextureObject);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, m_width, m_height);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, depthFrame);
-    glBindImageTexture(1, m_depthTextureObject, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16UI);
+    return static_cast<uint16_t*>(depthSource.DepthUploadBuffer.MapNextSegment());
+}
 
-    glBindVertexArray(m_vertexArrayObject);
-    // Create buffers and bind the geometry
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
+void PointCloudRenderer::UnmapDepthFrame(bool generatePointsFromDepth, uint32_t source)
+{
+    DepthSource& depthSource = m_depthSources[source];
+    depthSource.DepthUploadBuffer.UnmapSegment();
+
+    // Copy from the pixel unpack buffer into the layer of the source, the offset replaces the pixel pointer
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, depthSource.DepthUploadBuffer.GetBuffer());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTextureObject);
+    // Rows are tightly packed in the segment, the default alignment of 4 would read past it for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, depthSource.Width, depthSource.Height, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+        reinterpret_cast<const void*>(depthSource.DepthUploadBuffer.GetCurrentOffset()));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    depthSource.DepthUploadBuffer.FenceCurrentSegment();
+    m_normalsUpToDate = false;
+
+    glBindImageTexture(0, m_xyTableTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, m_depthTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16UI);
+
+    // The other sources never have CPU generated vertices
+    if (generatePointsFromDepth && source == 0)
+    {
+        m_generatePointsFromDepth = true;
+    }
+}
 
-    if (!useTestPointClouds)
+PointCloudVertex* PointCloudRenderer::MapPointClouds(GLFWwindow* window, uint32_t maxNumPoints)
+{
+    if (window != m_window)
     {
-        glBufferData(GL_ARRAY_BUFFER, numPoints * sizeof(PointCloudVertex), point3ds, GL_STREAM_DRAW);
+        Create(window);
     }
-    else
+
+    // Sized for a full depth frame of source 0, so it is only recreated for unusually large point clouds
+    const GLsizeiptr requiredSize = std::max<GLsizeiptr>(maxNumPoints, m_depthSources[0].Width * m_depthSources[0].Height) * sizeof(PointCloudVertex);
+    if (m_vertexUploadBuffer.GetSegmentSize() < requiredSize)
     {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(testVertices), testVertices, GL_STREAM_DRAW);
+        m_vertexUploadBuffer.Delete();
+        m_vertexUploadBuffer.Create(GL_ARRAY_BUFFER, requiredSize);
     }
 
-    // Set the vertex attribute pointers
+    return static_cast<PointCloudVertex*>(m_vertexUploadBuffer.MapNextSegment());
+}
+
+void PointCloudRenderer::UnmapPointClouds(uint32_t numPoints)
+{
+    m_vertexUploadBuffer.UnmapSegment();
+
+    const GLintptr offset = m_vertexUploadBuffer.GetCurrentOffset();
+
+    glBindVertexArray(m_vertexArrayObject);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexUploadBuffer.GetBuffer());
+
+    // Set the vertex attribute pointers into the segment that was just written
     // Vertex Positions
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PointCloudVertex), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PointCloudVertex), (void*)(offset + offsetof(PointCloudVertex, Position)));
     // Vertex Colors
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointCloudVertex), (void*)offsetof(PointCloudVertex, Color));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointCloudVertex), (void*)(offset + offsetof(PointCloudVertex, Color)));
     // Vertex Pixel Location
     // Notice: For GL_INT type, we need to use glVertexAttribIPointer instead of glVertexAttribPointer
     glEnableVertexAttribArray(2);
-    glVertexAttribIPointer(2, 2, GL_INT, sizeof(PointCloudVertex), (void*)offsetof(PointCloudVertex, PixelLocation));
+    glVertexAttribIPointer(2, 2, GL_INT, sizeof(PointCloudVertex), (void*)(offset + offsetof(PointCloudVertex, PixelLocation)));
 
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    m_drawArraySize = useTestPointClouds ? 8 : GLsizei(numPoints);
+    m_drawArraySize = GLsizei(numPoints);
+    m_generatePointsFromDepth = false;
+}
+
+void PointCloudRenderer::UpdateBodyIndexMap(
+    const uint8_t* bodyIndexMap,
+    uint32_t width, uint32_t height,
+    const linmath::vec4* bodyPalette,
+    uint32_t bodyPaletteSize,
+    uint32_t source)
+{
+    if (source >= m_depthSourceCount)
+    {
+        Fail("Depth source %u has no DepthXYTable, %u sources are initialized!", source, m_depthSourceCount);
+    }
+
+    DepthSource& depthSource = m_depthSources[source];
+    if (bodyIndexMap == nullptr)
+    {
+        depthSource.HasBodyIndexMap = false;
+        return;
+    }
+
+    if (depthSource.Width != width || depthSource.Height != height)
+    {
+        Fail("Body index map size (%u, %u) does not match the DepthXYTable settings: (%u, %u) are expected!", width, height, depthSource.Width, depthSource.Height);
+    }
+
+    // A frame of one byte per pixel, uploaded directly without a pixel unpack buffer
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_bodyIndexTextureObject);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, source, width, height, 1, GL_RED_INTEGER, GL_UNSIGNED_BYTE, bodyIndexMap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    m_bodyPaletteSize = std::min(bodyPaletteSize, MaxBodyPaletteSize);
+    for (uint32_t i = 0; i < m_bodyPaletteSize; i++)
+    {
+        vec4_copy(m_bodyPalette[i], bodyPalette[i]);
+    }
+    depthSource.HasBodyIndexMap = true;
 }
 
 void PointCloudRenderer::SetShading(bool enableShading)
@@ -180,8 +429,34 @@ void PointCloudRenderer::Render()
     Render(data[2], data[3]);
 }
 
+void PointCloudRenderer::UpdateNormals()
+{
+    if (!m_enableShading || m_normalsUpToDate || m_normalShaderProgram == 0 || m_normalTextureObject == 0)
+    {
+        return;
+    }
+
+    const std::array<GLint, 2 * MaxDepthSources> sourceSizes = GetSourceSizes();
+
+    glUseProgram(m_normalShaderProgram);
+    glUniform2iv(m_normalSourceSizeIndex, (GLsizei)MaxDepthSources, sourceSizes.data());
+    glBindImageTexture(0, m_xyTableTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, m_depthTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16UI);
+    glBindImageTexture(3, m_normalTextureObject, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    // 8x8 pixels per work group, as in the compute shader, and one layer of work groups per source
+    glDispatchCompute((m_width + 7) / 8, (m_height + 7) / 8, m_depthSourceCount);
+
+    // The vertex shaders read the normals with imageLoad
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    m_normalsUpToDate = true;
+}
+
 void PointCloudRenderer::Render(int width, int height)
 {
+    UpdateNormals();
+    const bool useNormalTexture = m_enableShading && m_normalsUpToDate;
+
     glEnable(GL_DEPTH_TEST);
     // Enable blending
     glEnable(GL_BLEND);
@@ -199,19 +474,109 @@ void PointCloudRenderer::Render(int width, int height)
     }
     glPointSize(pointSize);
 
-    glUseProgram(m_shaderProgram);
+    // The depth points of all sources are generated in one draw call, one instance per source. Source 0 is drawn from
+    // the vertex buffer instead when its points come from the CPU.
+    GLint firstDepthSource = 0;
+    if (!m_generatePointsFromDepth)
+    {
+        UsePointCloudProgram(m_multiView ? m_multiViewPointProgram : m_pointProgram, useNormalTexture);
 
-    // Update model/view/projective matrices in shader
-    glUniformMatrix4fv(m_viewIndex, 1, GL_FALSE, (const GLfloat*)m_view);
-    glUniformMatrix4fv(m_projectionIndex, 1, GL_FALSE, (const GLfloat*)m_projection);
+        // Render point cloud
+        glBindVertexArray(m_vertexArrayObject);
+        glDrawArrays(GL_POINTS, 0, m_drawArraySize);
+        glBindVertexArray(0);
 
-    // Update render settings in shader
-    glUniform1i(m_enableShadingIndex, (GLint)m_enableShading);
+        // The vertex segment can only be rewritten once this draw is done
+        if (m_vertexUploadBuffer.IsCreated())
+        {
+            m_vertexUploadBuffer.FenceCurrentSegment();
+        }
 
-    // Render point cloud
-    glBindVertexArray(m_vertexArrayObject);
-    glDrawArrays(GL_POINTS, 0, m_drawArraySize);
-    glBindVertexArray(0);
+        firstDepthSource = 1;
+    }
+
+    const GLint depthSourceCount = (GLint)m_depthSourceCount - firstDepthSource;
+    if (depthSourceCount > 0)
+    {
+        const PointCloudProgram& program = m_multiView ? m_multiViewDepthPointProgram : m_depthPointProgram;
+        UsePointCloudProgram(program, useNormalTexture);
+        glUniform1i(program.FirstSourceIndex, firstDepthSource);
+
+        // One point per depth pixel, positions come from gl_VertexID
+        glBindVertexArray(m_emptyVertexArrayObject);
+        glDrawArraysInstanced(GL_POINTS, 0, GLsizei(m_width * m_height), depthSourceCount);
+        glBindVertexArray(0);
+    }
+}
+
+std::array<GLint, 2 * PointCloudRenderer::MaxDepthSources> PointCloudRenderer::GetSourceSizes() const
+{
+    std::array<GLint, 2 * MaxDepthSources> sourceSizes{};
+    for (uint32_t source = 0; source < m_depthSourceCount; source++)
+    {
+        sourceSizes[2 * source] = (GLint)m_depthSources[source].Width;
+        sourceSizes[2 * source + 1] = (GLint)m_depthSources[source].Height;
+    }
+    return sourceSizes;
+}
+
+PointCloudRenderer::PointCloudProgram PointCloudRenderer::GetPointCloudProgram(GLuint program)
+{
+    PointCloudProgram pointCloudProgram;
+    pointCloudProgram.Program = program;
+    pointCloudProgram.ViewIndex = glGetUniformLocation(program, "view");
+    pointCloudProgram.ProjectionIndex = glGetUniformLocation(program, "projection");
+    pointCloudProgram.EnableShadingIndex = glGetUniformLocation(program, "enableShading");
+    pointCloudProgram.PointColorIndex = glGetUniformLocation(program, "pointColor");
+    pointCloudProgram.FirstSourceIndex = glGetUniformLocation(program, "firstSource");
+    pointCloudProgram.SourceSizeIndex = glGetUniformLocation(program, "sourceSize");
+    pointCloudProgram.SourceModelIndex = glGetUniformLocation(program, "sourceModel");
+    pointCloudProgram.BodyIndexMapSourcesIndex = glGetUniformLocation(program, "bodyIndexMapSources");
+    pointCloudProgram.BodyPaletteSizeIndex = glGetUniformLocation(program, "bodyPaletteSize");
+    pointCloudProgram.BodyPaletteIndex = glGetUniformLocation(program, "bodyPalette");
+    pointCloudProgram.UseNormalTextureIndex = glGetUniformLocation(program, "useNormalTexture");
+    return pointCloudProgram;
+}
+
+void PointCloudRenderer::UsePointCloudProgram(const PointCloudProgram& program, bool useNormalTexture)
+{
+    CheckAssert(program.Program != 0, "Multi view rendering is not supported");
+    glUseProgram(program.Program);
+
+    // Update view/projective matrices in shader, the multi view programs have them in the MultiView uniform block
+    // instead. Locations of -1 are ignored.
+    glUniformMatrix4fv(program.ViewIndex, 1, GL_FALSE, (const GLfloat*)m_view);
+    glUniformMatrix4fv(program.ProjectionIndex, 1, GL_FALSE, (const GLfloat*)m_projection);
+
+    // Update render settings in shader, only the depth programs have a point color
+    glUniform1i(program.EnableShadingIndex, (GLint)m_enableShading);
+    glUniform4f(program.PointColorIndex, 1.f, 1.f, 1.f, 0.8f);
+    glUniform1ui(program.BodyPaletteSizeIndex, m_bodyPaletteSize);
+    glUniform4fv(program.BodyPaletteIndex, (GLsizei)MaxBodyPaletteSize, (const GLfloat*)m_bodyPalette.data());
+    glUniform1i(program.UseNormalTextureIndex, (GLint)useNormalTexture);
+
+    // Per source settings, the sources without a table keep size 0 and never produce a point
+    std::array<linmath::mat4x4, MaxDepthSources> sourceModels;
+    GLuint bodyIndexMapSources = 0;
+    for (uint32_t source = 0; source < MaxDepthSources; source++)
+    {
+        mat4x4_dup(sourceModels[source], m_depthSources[source].DepthToWorld);
+        if (source < m_depthSourceCount && m_depthSources[source].HasBodyIndexMap)
+        {
+            bodyIndexMapSources |= 1u << source;
+        }
+    }
+
+    const std::array<GLint, 2 * MaxDepthSources> sourceSizes = GetSourceSizes();
+    glUniform2iv(program.SourceSizeIndex, (GLsizei)MaxDepthSources, sourceSizes.data());
+    glUniformMatrix4fv(program.SourceModelIndex, (GLsizei)MaxDepthSources, GL_FALSE, (const GLfloat*)sourceModels.data());
+    glUniform1ui(program.BodyIndexMapSourcesIndex, bodyIndexMapSources);
+
+    // Image units are shared by all renderers of the context, bind ours again. All layers of the arrays are bound.
+    glBindImageTexture(0, m_xyTableTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, m_depthTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16UI);
+    glBindImageTexture(2, m_bodyIndexTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R8UI);
+    glBindImageTexture(3, m_normalTextureObject, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
 }
 
 void PointCloudRenderer::ChangePointCloudSize(std::optional<float> pointCloudSize)
@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include <array>
 #include <mutex>
+#include <vector>
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -11,6 +13,7 @@
 #include "linmath.h"
 #include "WindowController3dTypes.h"
 #include "RendererBase.h"
+#include "StreamingBuffer.h"
 #include <optional>
 
 namespace Visualization
@@ -18,13 +21,27 @@ namespace Visualization
     class PointCloudRenderer : public RendererBase
     {
     public:
+        // Size of the bodyPalette uniform array of the point cloud shaders
+        static const uint32_t MaxBodyPaletteSize = 32;
+
+        // Size of the per source uniform arrays of the point cloud shaders
+        static const uint32_t MaxDepthSources = 8;
 
         PointCloudRenderer();
         ~PointCloudRenderer();
         void Create(GLFWwindow* window)  override;
         void Delete() override;
 
-        void InitializeDepthXYTable(const float* xyTableInterleaved, uint32_t width, uint32_t height);
+        // A depth source is the depth camera of one sensor. All sources are layers of the same textures and are
+        // rendered with one draw call, each with its own DepthXYTable, resolution and transform into the world.
+        // Sources are initialized in order, a table of an existing source replaces it, e.g. for another sensor.
+        // Only source 0 has the CPU generated vertices of UpdatePointClouds and MapPointClouds.
+        void InitializeDepthXYTable(const float* xyTableInterleaved, uint32_t width, uint32_t height, uint32_t source = 0);
+
+        // Rigid transform from the depth camera of the source into the world in meters, identity by default
+        void SetDepthSourceTransform(uint32_t source, const linmath::mat4x4 depthToWorld);
+
+        uint32_t GetDepthSourceCount() const { return m_depthSourceCount; }
 
         void UpdatePointClouds(
             GLFWwindow* window,
@@ -34,11 +51,42 @@ namespace Visualization
             uint32_t width, uint32_t height,
             bool useTestPointClouds = false);
 
+        // Points are generated on the GPU from the depth frame and the DepthXYTable, one point per depth pixel
+        void UpdateDepthFrame(
+            GLFWwindow* window,
+            const uint16_t* depthFrame,
+            uint32_t width, uint32_t height,
+            uint32_t source = 0);
+
+        // Zero copy variants of the updates above: the producer writes directly into a mapped upload buffer.
+        // Map returns nullptr when the GPU still reads all upload buffers, the previous frame is rendered again then.
+        // generatePointsFromDepth renders the points from the depth frame instead of the last point cloud vertices.
+        uint16_t* MapDepthFrame(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t source = 0);
+        void UnmapDepthFrame(bool generatePointsFromDepth, uint32_t source = 0);
+
+        Visualization::PointCloudVertex* MapPointClouds(GLFWwindow* window, uint32_t maxNumPoints);
+        void UnmapPointClouds(uint32_t numPoints);
+
+        // Colors the points of bodies in the shader. bodyIndexMap has the tracker body index of every depth pixel,
+        // 255 for the background, body i gets bodyPalette[i % bodyPaletteSize]. Replaces the CPU blending of colored
+        // vertices with one 8 bit texture upload. nullptr disables the coloring of the source. The palette is shared
+        // by all sources.
+        void UpdateBodyIndexMap(
+            const uint8_t* bodyIndexMap,
+            uint32_t width, uint32_t height,
+            const linmath::vec4* bodyPalette,
+            uint32_t bodyPaletteSize,
+            uint32_t source = 0);
+
         void SetShading(bool enableShading);
 
         void Render() override;
         void Render(int width, int height);
 
+        // Computes the normals of the current depth frames for shading if they are not up to date. Render calls it,
+        // the first viewport of a frame pays for all of them.
+        void UpdateNormals();
+
         void ChangePointCloudSize(std::optional<float> pointCloudSize);
 
     private:
@@ -46,25 +94,98 @@ namespace Visualization
         std::optional<GLfloat> m_pointCloudSize;
         bool m_enableShading = false;
 
-        // Point Array Size
+        // Number of CPU generated vertices
         GLsizei m_drawArraySize = 0;
 
-        // Depth Frame Information
+        // Points come from the depth textures instead of the vertex buffer
+        bool m_generatePointsFromDepth = false;
+
+        // Normals of the depth frames, written by a compute shader where available
+        bool m_normalsUpToDate = false;
+
+        // Body segmentation colors
+        std::array<linmath::vec4, MaxBodyPaletteSize> m_bodyPalette{};
+        uint32_t m_bodyPaletteSize = 0;
+
+        struct DepthSource
+        {
+            uint32_t Width = 0;
+            uint32_t Height = 0;
+            linmath::mat4x4 DepthToWorld;
+            bool HasBodyIndexMap = false;
+
+            // Kept to fill the layer again when the textures grow for another source
+            std::vector<float> XyTable;
+
+            // Depth frames of the source go through a pixel unpack buffer ring
+            StreamingBuffer DepthUploadBuffer;
+        };
+
+        // (Re)creates the texture arrays with one layer per source and the size of the largest one
+        void CreateSourceTextures();
+
+        // Zeroes the layer of the source and uploads its DepthXYTable
+        void ResetSourceLayer(uint32_t source);
+
+        // Depth sources, the first m_depthSourceCount are initialized
+        std::array<DepthSource, MaxDepthSources> m_depthSources;
+        uint32_t m_depthSourceCount = 0;
+
+        // Size of the layers of the texture arrays, the largest source
         uint32_t m_width = 0;
         uint32_t m_height = 0;
+        uint32_t m_layerCount = 0;
 
         // OpenGL resources
         GLuint m_vertexArrayObject = 0;
-        GLuint m_vertexBufferObject = 0;
 
+        // Vertices go through a vertex buffer ring
+        StreamingBuffer m_vertexUploadBuffer;
+
+        // 2D texture arrays, one layer per depth source
         GLuint m_xyTableTextureObject = 0;
         GLuint m_depthTextureObject = 0;
-
-        GLuint m_viewIndex = 0;
-        GLuint m_projectionIndex = 0;
-        GLuint m_enableShadingIndex = 0;
-        GLuint m_xyTableSamplerIndex = 0;
-        GLuint m_depthSamplerIndex = 0;
+        GLuint m_bodyIndexTextureObject = 0;
+        GLuint m_normalTextureObject = 0;
+
+        // Uniform locations of one of the point cloud programs, all of them share the uniforms of the common code
+        struct PointCloudProgram
+        {
+            GLuint Program = 0;
+            GLint ViewIndex = -1;
+            GLint ProjectionIndex = -1;
+            GLint EnableShadingIndex = -1;
+            GLint PointColorIndex = -1;
+            GLint FirstSourceIndex = -1;
+            GLint SourceSizeIndex = -1;
+            GLint SourceModelIndex = -1;
+            GLint BodyIndexMapSourcesIndex = -1;
+            GLint BodyPaletteSizeIndex = -1;
+            GLint BodyPaletteIndex = -1;
+            GLint UseNormalTextureIndex = -1;
+        };
+
+        static PointCloudProgram GetPointCloudProgram(GLuint program);
+
+        // Sets the uniforms and binds the image units of the program for a draw call
+        void UsePointCloudProgram(const PointCloudProgram& program, bool useNormalTexture);
+
+        // Width and height of every source for the sourceSize uniform arrays
+        std::array<GLint, 2 * MaxDepthSources> GetSourceSizes() const;
+
+        // Points of the vertex buffer and points generated from the depth frames, the multi view programs are only
+        // created where multi view rendering is supported
+        PointCloudProgram m_pointProgram;
+        PointCloudProgram m_depthPointProgram;
+        PointCloudProgram m_multiViewPointProgram;
+        PointCloudProgram m_multiViewDepthPointProgram;
+
+        // Core profile needs a bound vertex array for the depth points even when no attribute is used
+        GLuint m_emptyVertexArrayObject = 0;
+
+        // Normal precompute pass, 0 without compute shaders
+        GLuint m_normalShaderProgram = 0;
+        GLint m_normalSourceSizeIndex = -1;
 
         // Lock
         std::mutex m_mutex;
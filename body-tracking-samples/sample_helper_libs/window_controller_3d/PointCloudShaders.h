@@ -4,24 +4,23 @@
 #pragma once
 
 #include "GlShaderDefs.h"
+#include "MultiViewShaders.h"
 
-// ************** Point Cloud Vertex Shader **************
-static const char* const glslPointCloudVertexShader = GLSL_STRING(
-
-    layout(location = 0) in vec3 vertexPosition;
-    layout(location = 1) in vec4 vertexColor;
-    layout(location = 2) in ivec2 pixelLocation;
+// ************** Point Cloud Common Shader Code **************
+// Shared by the vertex and compute shaders below, has to follow glslShaderVersion in the shader sources.
+// Every depth source is one layer of the images, pixelId.z selects it. The images have the size of the largest
+// source, the pixels outside of a smaller source are 0.
+static const char* const glslPointCloudShaderCommon = GLSL_STRING(
 
-    out vec4 fragmentColor;
+    layout(rg32f, binding = 0) restrict readonly uniform image2DArray xyTable;
+    layout(r16ui, binding = 1) restrict readonly uniform uimage2DArray depth;
 
-    uniform mat4 view;
-    uniform mat4 projection;
-    uniform bool enableShading;
+    // Resolution of every depth source, sourceSize has MaxDepthSources entries
+    uniform ivec2 sourceSize[8];
 
-    layout(rg32f, binding = 0) restrict readonly uniform image2D xyTable;
-    layout(r16ui, binding = 1) restrict readonly uniform uimage2D depth;
-
-    vec3 ComputePoint3d(ivec2 pixelId)
+    // Point of a depth pixel in meters, in the coordinate system of the depth camera of its source like the CPU
+    // generated vertices
+    vec3 ComputePoint3d(ivec3 pixelId)
     {
         float depthInMeter = float(imageLoad(depth, pixelId).x) /  1000.f;
 
@@ -36,16 +35,15 @@ static const char* const glslPointCloudVertexShader = GLSL_STRING(
             return vec3(0, 0, 0);
         }
 
-        // Y, Z direction for OpenGL camera coordinate is opposite to the Kinect camera coordinate
-        return vec3(point3d.x, -point3d.y, -point3d.z);
+        return point3d;
     }
 
-    vec3 ComputeNormal(ivec2 pixelId)
+    vec3 ComputeNormal(ivec3 pixelId, vec3 vertexPosition)
     {
-        vec3 pointLeft = ComputePoint3d(ivec2(pixelId.x - 1, pixelId.y));
-        vec3 pointRight = ComputePoint3d(ivec2(pixelId.x + 1, pixelId.y));
-        vec3 pointUp = ComputePoint3d(ivec2(pixelId.x, pixelId.y - 1));
-        vec3 pointDown = ComputePoint3d(ivec2(pixelId.x, pixelId.y + 1));
+        vec3 pointLeft = ComputePoint3d(pixelId + ivec3(-1, 0, 0));
+        vec3 pointRight = ComputePoint3d(pixelId + ivec3(1, 0, 0));
+        vec3 pointUp = ComputePoint3d(pixelId + ivec3(0, -1, 0));
+        vec3 pointDown = ComputePoint3d(pixelId + ivec3(0, 1, 0));
 
         pointLeft = pointLeft.z == 0 ? vertexPosition : pointLeft;
         pointRight = pointRight.z == 0 ? vertexPosition : pointRight;
@@ -60,34 +58,157 @@ static const char* const glslPointCloudVertexShader = GLSL_STRING(
         return normal;
     }
 
+);  // GLSL_STRING
+
+
+// ************** Point Cloud Common Vertex Shader Code **************
+// Shared by the vertex shaders below, has to follow glslPointCloudShaderCommon and one of the view codes of
+// MultiViewShaders.h in the shader sources
+static const char* const glslPointCloudVertexShaderCommon = GLSL_STRING(
+
+    out vec4 fragmentColor;
+
+    uniform bool enableShading;
+
+    // Rigid transform from the depth camera of every source into the world, MaxDepthSources entries
+    uniform mat4 sourceModel[8];
+
+    // Normals of the depth frames written by the normal compute shader, computed per vertex otherwise
+    uniform bool useNormalTexture;
+    layout(rgba16f, binding = 3) restrict readonly uniform image2DArray normals;
+
+    // Segmentation colors, bit i of bodyIndexMapSources is set when source i has a body index map. bodyPalette has
+    // MaxBodyPaletteSize entries of which bodyPaletteSize are set.
+    uniform uint bodyIndexMapSources;
+    uniform uint bodyPaletteSize;
+    uniform vec4 bodyPalette[32];
+
+    layout(r8ui, binding = 2) restrict readonly uniform uimage2DArray bodyIndexMap;
+
+    // Blends the color of the body the depth pixel belongs to into the point color, like the CPU BlendBodyColor
+    vec4 ColorBodyPoint(ivec3 pixelId, vec4 vertexColor)
+    {
+        if ((bodyIndexMapSources & (1u << uint(pixelId.z))) == 0u || bodyPaletteSize == 0u)
+        {
+            return vertexColor;
+        }
+
+        // 255 is K4ABT_BODY_INDEX_MAP_BACKGROUND
+        uint bodyIndex = imageLoad(bodyIndexMap, pixelId).x;
+        if (bodyIndex == 255u)
+        {
+            return vertexColor;
+        }
+
+        const float darkenRatio = 0.8f;
+        const float instanceAlpha = 0.8f;
+        vec3 bodyColor = bodyPalette[bodyIndex % bodyPaletteSize].rgb;
+        return vec4(bodyColor * instanceAlpha + vertexColor.rgb * darkenRatio, vertexColor.a);
+    }
+
+    // Lit from the depth camera of the source, vertexPosition is in its coordinate system
+    vec4 ShadePoint(ivec3 pixelId, vec3 vertexPosition, vec4 vertexColor)
+    {
+        if (!enableShading)
+        {
+            return vertexColor;
+        }
+
+        const vec3 lightPosition = vec3(0, 0, 0);
+        vec3 vertexNormal = useNormalTexture ? imageLoad(normals, pixelId).xyz : ComputeNormal(pixelId, vertexPosition);
+        float diffuse = 0.f;
+        if (dot(vertexNormal, vertexNormal) != 0.f)
+        {
+            vec3 lightDirection = normalize(lightPosition - vertexPosition);
+            // Use mix function to reduce the strength of the diffuse effect
+            float defuseRatio = 0.5f;
+            diffuse = mix(1.0f, abs(dot(normalize(vertexNormal), lightDirection)), defuseRatio);
+        }
+
+        float distance = length(lightPosition - vertexPosition);
+        // Attenuation term for light source that covers distance up to 50 meters
+        // http://wiki.ogre3d.org/tiki-index.php?page=-Point+Light+Attenuation
+        float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
+
+        return vec4(attenuation * diffuse * vertexColor.rgb, vertexColor.a);
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Point Cloud Vertex Shader **************
+// Points come from a vertex buffer that was filled on the CPU, they belong to depth source 0
+static const char* const glslPointCloudVertexShader = GLSL_STRING(
+
+    layout(location = 0) in vec3 vertexPosition;
+    layout(location = 1) in vec4 vertexColor;
+    layout(location = 2) in ivec2 pixelLocation;
+
     void main()
     {
-        gl_Position = projection * view * vec4(vertexPosition, 1);
+        ivec3 pixelId = ivec3(pixelLocation, 0);
+        gl_Position = ProjectVertex(sourceModel[0] * vec4(vertexPosition, 1));
+        fragmentColor = ShadePoint(pixelId, vertexPosition, ColorBodyPoint(pixelId, vertexColor));
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Point Cloud Depth Vertex Shader **************
+// Points are generated from the depth images, one vertex per depth pixel without any vertex buffer and one instance
+// per depth source, starting at firstSource
+static const char* const glslPointCloudDepthVertexShader = GLSL_STRING(
+
+    uniform vec4 pointColor;
+    uniform int firstSource;
 
-        if (enableShading)
+    void main()
+    {
+        int source = firstSource + gl_InstanceID;
+        ivec2 depthSize = imageSize(depth).xy;
+        ivec3 pixelId = ivec3(gl_VertexID % depthSize.x, gl_VertexID / depthSize.x, source);
+        vec3 vertexPosition = ComputePoint3d(pixelId);
+
+        // Pixels without a valid depth and outside of the source are not rasterized
+        if (vertexPosition.z == 0 || any(greaterThanEqual(pixelId.xy, sourceSize[source])))
+        {
+            gl_Position = DiscardedVertex();
+            fragmentColor = vec4(0, 0, 0, 0);
+            return;
+        }
+
+        gl_Position = ProjectVertex(sourceModel[source] * vec4(vertexPosition, 1));
+        fragmentColor = ShadePoint(pixelId, vertexPosition, ColorBodyPoint(pixelId, pointColor));
+    }
+
+);  // GLSL_STRING
+
+
+// ************** Point Cloud Normal Compute Shader **************
+// Writes the normal of every depth pixel once per depth frame, so shading does not repeat the neighbor lookups for
+// every vertex of every viewport. Invalid normals are written as 0 like ComputeNormal returns them. The z work group
+// is the depth source.
+static const char* const glslPointCloudNormalComputeShader = GLSL_STRING(
+
+    layout(local_size_x = 8, local_size_y = 8) in;
+
+    layout(rgba16f, binding = 3) restrict writeonly uniform image2DArray normals;
+
+    void main()
+    {
+        ivec3 pixelId = ivec3(gl_GlobalInvocationID);
+        if (any(greaterThanEqual(pixelId.xy, sourceSize[pixelId.z])))
         {
-            const vec3 lightPosition = vec3(0, 0, 0);
-            vec3 vertexNormal = ComputeNormal(pixelLocation);
-            float diffuse = 0.f;
-            if (dot(vertexNormal, vertexNormal) != 0.f)
-            {
-                vec3 lightDirection = normalize(lightPosition - vertexPosition);
-                // Use mix function to reduce the strength of the diffuse effect
-                float defuseRatio = 0.5f;
-                diffuse = mix(1.0f, abs(dot(normalize(vertexNormal), lightDirection)), defuseRatio);
-            }
-
-            float distance = length(lightPosition - vertexPosition);
-            // Attenuation term for light source that covers distance up to 50 meters
-            // http://wiki.ogre3d.org/tiki-index.php?page=-Point+Light+Attenuation
-            float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
-
-            fragmentColor = vec4(attenuation * diffuse * vertexColor.rgb, vertexColor.a);
+            return;
         }
-        else
+
+        // Normalized here, the tiny cross products of neighboring points would not fit into half floats
+        vec3 normal = ComputeNormal(pixelId, ComputePoint3d(pixelId));
+        if (dot(normal, normal) != 0.f)
         {
-            fragmentColor = vertexColor;
+            normal = normalize(normal);
         }
+        imageStore(normals, pixelId, vec4(normal, 0));
     }
 
 );  // GLSL_STRING
@@ -98,9 +219,11 @@ static const char* const glslPointCloudFragmentShader = GLSL_STRING(
 
     in vec4 fragmentColor;
 
+    out vec4 outputColor;
+
     void main()
     {
-        gl_FragColor = fragmentColor;
+        outputColor = fragmentColor;
     }
 
 );  // GLSL_STRING
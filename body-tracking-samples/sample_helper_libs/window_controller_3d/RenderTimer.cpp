@@ -0,0 +1,290 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "RenderTimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "Helpers.h"
+
+using namespace Visualization;
+
+const char* Visualization::GetRenderSectionName(RenderSection section)
+{
+    switch (section)
+    {
+    case RenderSection::PointCloudUpload:
+        return "point_cloud_upload";
+    case RenderSection::PointCloudDraw:
+        return "point_cloud_draw";
+    case RenderSection::SkeletonDraw:
+        return "skeleton_draw";
+    case RenderSection::FloorDraw:
+        return "floor_draw";
+    case RenderSection::Present:
+        return "present";
+    default:
+        return "unknown";
+    }
+}
+
+RenderTimer::~RenderTimer()
+{
+    Delete();
+}
+
+void RenderTimer::Create()
+{
+    CheckAssert(!m_created);
+    m_created = true;
+
+    // Timer queries are core since GL 3.3
+    m_gpuTimerAvailable = GLAD_GL_VERSION_3_3 || IsGlExtensionSupported("GL_ARB_timer_query");
+
+    m_currentFrame = 0;
+    m_frameIndex = 0;
+    m_queryActive = false;
+    m_sectionActive.fill(false);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_history.clear();
+}
+
+void RenderTimer::Delete()
+{
+    if (!m_created)
+    {
+        return;
+    }
+
+    m_created = false;
+    for (PendingFrame& frame : m_frames)
+    {
+        if (!frame.Queries.empty())
+        {
+            glDeleteQueries((GLsizei)frame.Queries.size(), frame.Queries.data());
+        }
+        frame = PendingFrame();
+    }
+}
+
+void RenderTimer::Begin(RenderSection section)
+{
+    if (!m_created)
+    {
+        return;
+    }
+
+    if (m_gpuTimerAvailable)
+    {
+        CheckAssert(!m_queryActive, "Render section %s overlaps another section", GetRenderSectionName(section));
+
+        PendingFrame& frame = m_frames[m_currentFrame];
+        if (frame.UsedQueryCount == frame.Queries.size())
+        {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.Queries.push_back(query);
+            frame.QuerySections.push_back(section);
+        }
+        frame.QuerySections[frame.UsedQueryCount] = section;
+        glBeginQuery(GL_TIME_ELAPSED, frame.Queries[frame.UsedQueryCount++]);
+        m_queryActive = true;
+    }
+
+    m_sectionActive[(size_t)section] = true;
+    m_cpuBegin[(size_t)section] = std::chrono::steady_clock::now();
+}
+
+void RenderTimer::End(RenderSection section)
+{
+    // Also skips sections that began before Create
+    if (!m_created || !m_sectionActive[(size_t)section])
+    {
+        return;
+    }
+    m_sectionActive[(size_t)section] = false;
+
+    const std::chrono::duration<float, std::milli> cpuTime = std::chrono::steady_clock::now() - m_cpuBegin[(size_t)section];
+    m_frames[m_currentFrame].Sample.CpuTime[(size_t)section] += cpuTime.count();
+
+    if (m_gpuTimerAvailable)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_queryActive = false;
+    }
+}
+
+void RenderTimer::EndFrame(float frameTime)
+{
+    if (!m_created)
+    {
+        return;
+    }
+
+    PendingFrame& frame = m_frames[m_currentFrame];
+    frame.Sample.FrameIndex = m_frameIndex++;
+    frame.Sample.FrameTime = frameTime * 1000.f;
+    frame.Pending = true;
+    m_currentFrame = (m_currentFrame + 1) % MaxPendingFrames;
+
+    // Oldest frame first, so the history stays in order. Only the frame whose queries are reused next is waited for.
+    for (int i = 0; i < MaxPendingFrames; i++)
+    {
+        PendingFrame& pendingFrame = m_frames[(m_currentFrame + i) % MaxPendingFrames];
+        if (pendingFrame.Pending && !CollectFrame(pendingFrame, i == 0))
+        {
+            break;
+        }
+    }
+}
+
+bool RenderTimer::CollectFrame(PendingFrame& frame, bool wait)
+{
+    if (frame.UsedQueryCount > 0)
+    {
+        // Queries finish in order, the last one of the frame tells about all of them
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(frame.Queries[frame.UsedQueryCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < frame.UsedQueryCount; i++)
+        {
+            GLuint64 elapsedNanoseconds = 0;
+            glGetQueryObjectui64v(frame.Queries[i], GL_QUERY_RESULT, &elapsedNanoseconds);
+            frame.Sample.GpuTime[(size_t)frame.QuerySections[i]] += elapsedNanoseconds / 1e6f;
+        }
+    }
+
+    AddToHistory(frame.Sample);
+
+    frame.Sample = FrameSample();
+    frame.UsedQueryCount = 0;
+    frame.Pending = false;
+    return true;
+}
+
+void RenderTimer::AddToHistory(const FrameSample& sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_history.size() == HistorySize)
+    {
+        m_history.pop_front();
+    }
+    m_history.push_back(sample);
+}
+
+static TimingStatistics ComputeTimingStatistics(std::vector<float>& values)
+{
+    TimingStatistics statistics;
+    if (values.empty())
+    {
+        return statistics;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    // Nearest rank percentiles
+    auto percentile = [&values](float p) {
+        const size_t rank = (size_t)std::ceil(p * values.size());
+        return values[std::max<size_t>(rank, 1) - 1];
+    };
+
+    double sum = 0.;
+    for (float value : values)
+    {
+        sum += value;
+    }
+
+    statistics.Mean = (float)(sum / values.size());
+    statistics.P50 = percentile(0.5f);
+    statistics.P90 = percentile(0.9f);
+    statistics.P99 = percentile(0.99f);
+    statistics.Max = values.back();
+    return statistics;
+}
+
+RenderStatistics RenderTimer::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    RenderStatistics statistics;
+    statistics.FrameCount = (uint32_t)m_history.size();
+    statistics.GpuTimerAvailable = m_gpuTimerAvailable;
+
+    std::vector<float> values;
+    values.reserve(m_history.size());
+
+    for (const FrameSample& sample : m_history)
+    {
+        values.push_back(sample.FrameTime);
+    }
+    statistics.FrameTime = ComputeTimingStatistics(values);
+
+    for (size_t section = 0; section < SectionCount; section++)
+    {
+        values.clear();
+        for (const FrameSample& sample : m_history)
+        {
+            values.push_back(sample.CpuTime[section]);
+        }
+        statistics.CpuTime[section] = ComputeTimingStatistics(values);
+
+        values.clear();
+        for (const FrameSample& sample : m_history)
+        {
+            values.push_back(sample.GpuTime[section]);
+        }
+        statistics.GpuTime[section] = ComputeTimingStatistics(values);
+    }
+
+    return statistics;
+}
+
+bool RenderTimer::WriteCsv(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    file << "frame,frame_ms";
+    for (size_t section = 0; section < SectionCount; section++)
+    {
+        file << "," << GetRenderSectionName((RenderSection)section) << "_cpu_ms";
+    }
+    for (size_t section = 0; section < SectionCount; section++)
+    {
+        file << "," << GetRenderSectionName((RenderSection)section) << "_gpu_ms";
+    }
+    file << "\n";
+
+    for (const FrameSample& sample : m_history)
+    {
+        file << sample.FrameIndex << "," << sample.FrameTime;
+        for (float cpuTime : sample.CpuTime)
+        {
+            file << "," << cpuTime;
+        }
+        for (float gpuTime : sample.GpuTime)
+        {
+            file << ",";
+            if (m_gpuTimerAvailable)
+            {
+                file << gpuTime;
+            }
+        }
+        file << "\n";
+    }
+
+    return (bool)file;
+}
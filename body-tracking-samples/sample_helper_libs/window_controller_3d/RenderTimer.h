@@ -0,0 +1,113 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "WindowController3dTypes.h"
+
+namespace Visualization
+{
+    const char* GetRenderSectionName(RenderSection section);
+
+    // Times the sections of the rendered frames on the CPU and, with GL_TIME_ELAPSED queries, on the GPU, and keeps
+    // the last HistorySize frames for rolling statistics. Query results are read back MaxPendingFrames frames later,
+    // so timing never waits for the GPU unless it is that far behind.
+    //
+    // Usage per frame, with the context of the timer current:
+    //     timer.Begin(RenderSection::PointCloudDraw);  // or RenderTimer::Scope
+    //     ... GL commands ...
+    //     timer.End(RenderSection::PointCloudDraw);
+    //     timer.EndFrame(frameTime);
+    //
+    // Sections must not overlap, a GL_TIME_ELAPSED query can not be nested in another one. A section may be timed
+    // several times per frame, e.g. once per viewport, the times are summed up. Begin and End do nothing before Create.
+    class RenderTimer
+    {
+    public:
+        static const int MaxPendingFrames = 4;
+        static const size_t HistorySize = 300;
+
+        class Scope
+        {
+        public:
+            Scope(RenderTimer& timer, RenderSection section) : m_timer(timer), m_section(section) { m_timer.Begin(m_section); }
+            ~Scope() { m_timer.End(m_section); }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            RenderTimer& m_timer;
+            RenderSection m_section;
+        };
+
+        ~RenderTimer();
+
+        void Create();
+        void Delete();
+
+        bool IsCreated() const { return m_created; }
+        bool IsGpuTimerAvailable() const { return m_gpuTimerAvailable; }
+
+        void Begin(RenderSection section);
+        void End(RenderSection section);
+
+        // Closes the timed frame, frameTime is the CPU time since the previous frame in seconds
+        void EndFrame(float frameTime);
+
+        // Can be called from any thread
+        RenderStatistics GetStatistics() const;
+
+        // One row per frame of the history with the frame time and the CPU and GPU time of every section in ms
+        bool WriteCsv(const std::string& path) const;
+
+    private:
+        static const size_t SectionCount = (size_t)RenderSection::Count;
+
+        struct FrameSample
+        {
+            uint64_t FrameIndex = 0;
+            float FrameTime = 0.f;
+            std::array<float, SectionCount> CpuTime{};
+            std::array<float, SectionCount> GpuTime{};
+        };
+
+        // Queries of one frame, the pool only grows when a frame times more sections than before
+        struct PendingFrame
+        {
+            FrameSample Sample;
+            std::vector<GLuint> Queries;
+            std::vector<RenderSection> QuerySections;
+            size_t UsedQueryCount = 0;
+            bool Pending = false;
+        };
+
+        // Reads the query results of the frame into its sample. Without wait it returns false when they are not
+        // available yet.
+        bool CollectFrame(PendingFrame& frame, bool wait);
+        void AddToHistory(const FrameSample& sample);
+
+        bool m_created = false;
+        bool m_gpuTimerAvailable = false;
+
+        std::array<PendingFrame, MaxPendingFrames> m_frames;
+        int m_currentFrame = 0;
+        uint64_t m_frameIndex = 0;
+
+        std::array<std::chrono::steady_clock::time_point, SectionCount> m_cpuBegin{};
+        std::array<bool, SectionCount> m_sectionActive{};
+        bool m_queryActive = false;
+
+        std::deque<FrameSample> m_history;
+        mutable std::mutex m_mutex;
+    };
+}
@@ -3,6 +3,8 @@
 
 #include "RendererBase.h"
 
+#include "Helpers.h"
+
 using namespace linmath;
 using namespace Visualization;
 
@@ -11,3 +13,9 @@ void RendererBase::UpdateViewProjection(mat4x4 view, mat4x4 projection)
     mat4x4_dup(m_view, view);
     mat4x4_dup(m_projection, projection);
 }
+
+bool RendererBase::IsMultiViewSupported()
+{
+    return GLAD_GL_VERSION_4_1 ||
+        (IsGlExtensionSupported("GL_ARB_viewport_array") && IsGlExtensionSupported("GL_ARB_gpu_shader5"));
+}
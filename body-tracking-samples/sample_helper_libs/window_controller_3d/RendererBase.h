@@ -5,6 +5,8 @@
 
 #include "GLFW/glfw3.h"
 #include "linmath.h"
+#include "GlResourceManager.h"
+#include "WindowController3dTypes.h"
 
 namespace Visualization
 {
@@ -21,16 +23,23 @@ namespace Visualization
 
         virtual void Render() = 0;
 
+        // Renders into all viewports of the viewport array at once, with the view projections of the MultiView uniform
+        // block at binding 0 instead of UpdateViewProjection, see MultiViewShaders.h. Needs IsMultiViewSupported.
+        virtual void SetMultiView(bool multiView) { m_multiView = multiView; }
+
+        // Viewport arrays and geometry shader instancing, core since GL 4.1 and 4.0, with the current context
+        static bool IsMultiViewSupported();
+
     protected:
         bool m_initialized = false;
+        bool m_multiView = false;
 
         linmath::mat4x4 m_view;
         linmath::mat4x4 m_projection;
 
-        // Basic OpenGL resources
+        // Basic OpenGL resources, the program belongs to m_resources
         GLFWwindow* m_window;
+        GlResourceManager* m_resources = nullptr;
         GLuint m_shaderProgram;
-        GLuint m_vertexShader;
-        GLuint m_fragmentShader;
     };
 }
@@ -60,16 +60,73 @@ void SkeletonRenderer::CleanJointsAndBones()
 {
     m_joints.clear();
     m_bones.clear();
+
+    m_jointInstances.clear();
+    m_boneInstances.clear();
+    m_coordinateAxesInstances.clear();
+    m_instancesUploaded = false;
 }
 
 void SkeletonRenderer::AddJoint(const Visualization::Joint& joint)
 {
     m_joints.push_back(joint);
+    AppendJointInstances(joint);
 }
 
 void SkeletonRenderer::AddBone(const Visualization::Bone& bone)
 {
     m_bones.push_back(bone);
+    AppendBoneInstance(bone);
+}
+
+void SkeletonRenderer::AddJoints(const Visualization::Joint* joints, size_t jointCount)
+{
+    m_joints.insert(m_joints.end(), joints, joints + jointCount);
+
+    m_jointInstances.reserve(m_jointInstances.size() + jointCount);
+    m_coordinateAxesInstances.reserve(m_coordinateAxesInstances.size() + jointCount);
+    for (size_t i = 0; i < jointCount; i++)
+    {
+        AppendJointInstances(joints[i]);
+    }
+}
+
+void SkeletonRenderer::AddBones(const Visualization::Bone* bones, size_t boneCount)
+{
+    m_bones.insert(m_bones.end(), bones, bones + boneCount);
+
+    m_boneInstances.reserve(m_boneInstances.size() + boneCount);
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        AppendBoneInstance(bones[i]);
+    }
+}
+
+void SkeletonRenderer::AppendJointInstances(const Visualization::Joint& joint)
+{
+    ObjectInstance jointInstance;
+    mat4x4_translate(jointInstance.Model, joint.Position[0], joint.Position[1], joint.Position[2]);
+    vec4_copy(jointInstance.Color, joint.Color);
+    m_jointInstances.push_back(jointInstance);
+
+    ObjectInstance coordinateAxesInstance;
+    mat4x4 rotation;
+    quaternion_to_mat4x4(rotation, joint.Orientation);
+    mat4x4_mul(coordinateAxesInstance.Model, jointInstance.Model, rotation);
+    vec4_copy(coordinateAxesInstance.Color, joint.Color);
+    m_coordinateAxesInstances.push_back(coordinateAxesInstance);
+
+    m_instancesUploaded = false;
+}
+
+void SkeletonRenderer::AppendBoneInstance(const Visualization::Bone& bone)
+{
+    ObjectInstance boneInstance;
+    m_cylinder.GetInstanceModel(boneInstance.Model, bone.Joint1Position, bone.Joint2Position);
+    vec4_copy(boneInstance.Color, bone.Color);
+    m_boneInstances.push_back(boneInstance);
+
+    m_instancesUploaded = false;
 }
 
 void SkeletonRenderer::UpdateViewProjection(linmath::mat4x4 view, linmath::mat4x4 projection)
@@ -80,6 +137,14 @@ void SkeletonRenderer::UpdateViewProjection(linmath::mat4x4 view, linmath::mat4x
     m_coordinateAxes.UpdateViewProjection(view, projection);
 }
 
+void SkeletonRenderer::SetMultiView(bool multiView)
+{
+    RendererBase::SetMultiView(multiView);
+    m_sphere.SetMultiView(multiView);
+    m_cylinder.SetMultiView(multiView);
+    m_coordinateAxes.SetMultiView(multiView);
+}
+
 void SkeletonRenderer::Render()
 {
     glDisable(GL_DEPTH_TEST);
@@ -87,31 +152,26 @@ void SkeletonRenderer::Render()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // Every viewport of the frame renders the same instances
+    if (!m_instancesUploaded)
+    {
+        m_cylinder.UpdateInstances(m_boneInstances.data(), m_boneInstances.size());
+        m_sphere.UpdateInstances(m_jointInstances.data(), m_jointInstances.size());
+        m_coordinateAxes.UpdateInstances(m_coordinateAxesInstances.data(), m_coordinateAxesInstances.size());
+        m_instancesUploaded = true;
+    }
+
     if (m_renderSkeletons)
     {
-        // Render Bones
-        for (size_t i = 0; i < m_bones.size(); i++)
-        {
-            m_cylinder.Render(
-                m_bones[i].Joint1Position,
-                m_bones[i].Joint2Position,
-                m_bones[i].Color);
-        }
-
-        // Render Joints
-        for (size_t i = 0; i < m_joints.size(); i++)
-        {
-            RenderJoint(m_joints[i].Position, m_joints[i].Color);
-        }
+        // Render Bones, then Joints on top
+        m_cylinder.RenderInstances();
+        m_sphere.RenderInstances();
     }
 
     if (m_renderCoordinateAxes)
     {
         // Render Joint Coordinate
-        for (size_t i = 0; i < m_joints.size(); i++)
-        {
-            RenderCoordinateAxes(m_joints[i].Position, m_joints[i].Orientation);
-        }
+        m_coordinateAxes.RenderInstances();
     }
     glBindVertexArray(0);
 }
@@ -30,10 +30,17 @@ namespace Visualization
         void AddJoint(const Visualization::Joint& joint);
         void AddBone(const Visualization::Bone& bone);
 
+        // Bulk variants, e.g. all joints and bones of one body
+        void AddJoints(const Visualization::Joint* joints, size_t jointCount);
+        void AddBones(const Visualization::Bone* bones, size_t boneCount);
+
         void UpdateViewProjection(
             linmath::mat4x4 view,
             linmath::mat4x4 projection) override;
 
+        // Joints, bones and coordinate axes, RenderJoint and RenderCoordinateAxes stay single view
+        void SetMultiView(bool multiView) override;
+
         void Render() override;
         void RenderJoint(const linmath::vec3 p, const linmath::vec4 color);
         void RenderCoordinateAxes(const linmath::vec3 p, const linmath::quaternion q);
@@ -44,6 +51,9 @@ namespace Visualization
         const std::vector<Joint>& GetJoints() { return m_joints; }
 
     private:
+        void AppendJointInstances(const Visualization::Joint& joint);
+        void AppendBoneInstance(const Visualization::Bone& bone);
+
         // Render settings
         bool m_renderSkeletons = true;
         bool m_renderCoordinateAxes = false;
@@ -62,5 +72,11 @@ namespace Visualization
         // Skeleton information
         std::vector<Joint> m_joints;
         std::vector<Bone> m_bones;
+
+        // Instance attributes built when joints and bones are added, uploaded once per frame on the first Render
+        std::vector<ObjectInstance> m_jointInstances;
+        std::vector<ObjectInstance> m_boneInstances;
+        std::vector<ObjectInstance> m_coordinateAxesInstances;
+        bool m_instancesUploaded = false;
     };
 }
\ No newline at end of file
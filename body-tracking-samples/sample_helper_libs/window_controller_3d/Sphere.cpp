@@ -4,6 +4,7 @@
 #include "Sphere.h"
 
 #include <cmath>
+#include <string>
 
 #include "Helpers.h"
 
@@ -67,28 +68,13 @@ void Sphere::Create(GLFWwindow * window)
     m_initialized = true;
 
     m_window = window;
-    glfwMakeContextCurrent(window);
-
-    // Context Settings
-    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar* vertexShaderSources[] = { glslShaderVersion, glslMonoObjectVertexShader };
-    int numVertexShaderSources = sizeof(vertexShaderSources) / sizeof(*vertexShaderSources);
-    glShaderSource(m_vertexShader, numVertexShaderSources, vertexShaderSources, NULL);
-    glCompileShader(m_vertexShader);
-    ValidateShader(m_vertexShader);
-
-    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar* fragmentShaderSources[] = { glslShaderVersion, glslMonoObjectFragmentShader };
-    int numFragmentShaderSources = sizeof(fragmentShaderSources) / sizeof(*fragmentShaderSources);
-    glShaderSource(m_fragmentShader, numFragmentShaderSources, fragmentShaderSources, NULL);
-    glCompileShader(m_fragmentShader);
-    ValidateShader(m_fragmentShader);
-
-    m_shaderProgram = glCreateProgram();
-    glAttachShader(m_shaderProgram, m_vertexShader);
-    glAttachShader(m_shaderProgram, m_fragmentShader);
-    glLinkProgram(m_shaderProgram);
-    ValidateProgram(m_shaderProgram);
+    MakeContextCurrent(window);
+
+    // Programs and geometry are shared with the renderers of the other contexts of the share group
+    m_resources = &GlResourceManager::GetCurrent();
+    m_shaderProgram = m_resources->GetProgram("MonoObject",
+        { glslShaderVersion, glslSingleViewVertexShaderCommon, glslMonoObjectVertexShader },
+        { glslShaderVersion, glslMonoObjectFragmentShader });
 
     // Get shader index
     m_modelIndex = glGetUniformLocation(m_shaderProgram, "model");
@@ -98,31 +84,11 @@ void Sphere::Create(GLFWwindow * window)
 
     // **************** Generate Sphere VAO ****************
     glGenVertexArrays(1, &m_vertexArrayObject);
-    glBindVertexArray(m_vertexArrayObject);
-
-    // Create buffers and bind the geometry
-    glGenBuffers(1, &m_vertexBufferObject);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
-
-    // Set the vertex attribute pointers
-    // Vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
-
-    // Vertex Normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
 
-    // Create buffers and bind the indices
-    glGenBuffers(1, &m_elementBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+    // Per instance attributes and instanced programs, the VAO points into the instance buffer in UpdateVAO
+    m_instances.Create(*m_resources, "MonoObject", glslMonoObjectInstancedVertexShader, glslMonoObjectFragmentShader);
 
-    // **************** Unbind VAO ****************
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    UpdateVAO();
 }
 
 void Sphere::Delete()
@@ -133,12 +99,11 @@ void Sphere::Delete()
     }
 
     m_initialized = false;
-    glDeleteBuffers(1, &m_vertexBufferObject);
-    glDeleteBuffers(1, &m_elementBufferObject);
+    glDeleteVertexArrays(1, &m_vertexArrayObject);
+    m_instances.Delete();
 
-    glDeleteShader(m_vertexShader);
-    glDeleteShader(m_fragmentShader);
-    glDeleteProgram(m_shaderProgram);
+    m_resources->ReleaseGeometry(m_geometry);
+    m_geometry = SharedGeometry();
 }
 
 void Sphere::Render()
@@ -172,6 +137,24 @@ void Sphere::Render(const linmath::vec3 p, const linmath::vec4 color)
     Render(model, color);
 }
 
+
+void Sphere::UpdateInstances(const ObjectInstance* instances, size_t instanceCount)
+{
+    m_instances.Update(instances, instanceCount);
+}
+
+void Sphere::RenderInstances()
+{
+    const GLsizei instanceCount = m_instances.UseProgram(m_multiView, m_view, m_projection);
+    if (instanceCount == 0)
+    {
+        return;
+    }
+
+    glBindVertexArray(m_vertexArrayObject);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)m_indices.size(), GL_UNSIGNED_INT, NULL, instanceCount);
+}
+
 // build vertices of sphere with smooth shading using parametric equation
 // x = r * cos(u) * cos(v)
 // y = r * cos(u) * sin(v)
@@ -248,14 +231,38 @@ void Sphere::BuildVertices()
 
 void Sphere::UpdateVAO()
 {
+    // A sphere of another radius is another shared geometry, the previous one may still be used by other windows
+    const std::string geometryName = "Sphere " + std::to_string(m_radius) + " " + std::to_string(m_sectorCount) + " " + std::to_string(m_stackCount);
+    SharedGeometry previousGeometry = m_geometry;
+    m_geometry = m_resources->AcquireGeometry(geometryName,
+        m_vertices.data(), m_vertices.size() * sizeof(MonoVertex),
+        m_indices.data(), m_indices.size());
+
     glBindVertexArray(m_vertexArrayObject);
-    // Create buffers and bind the geometry
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObject);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MonoVertex), m_vertices.data(), GL_STATIC_DRAW);
 
-    // Create buffers and bind the indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_elementBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+    // Set the vertex attribute pointers
+    glBindBuffer(GL_ARRAY_BUFFER, m_geometry.VertexBuffer);
+    // Vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)0);
+
+    // Vertex Normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MonoVertex), (void*)offsetof(MonoVertex, Normal));
+
+    // Bind the indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_geometry.ElementBuffer);
+
+    m_instances.SetAttributes();
+
+    // **************** Unbind VAO ****************
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (previousGeometry.VertexBuffer != 0)
+    {
+        m_resources->ReleaseGeometry(previousGeometry);
+    }
 }
 
 void Sphere::AddIndices(uint32_t i1, uint32_t i2, uint32_t i3)
@@ -8,6 +8,7 @@
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
+#include "InstanceBuffer.h"
 #include "RendererBase.h"
 #include "WindowController3dTypes.h"
 
@@ -34,6 +35,11 @@ namespace Visualization
         void Render(const linmath::mat4x4 model, const linmath::vec4 color);
         void Render(const linmath::vec3 p, const linmath::vec4 color);
 
+        // Instanced rendering, UpdateInstances once per frame and RenderInstances draws all of them with one draw call
+        // RenderInstances follows SetMultiView, the single object Render functions always render into one viewport
+        void UpdateInstances(const ObjectInstance* instances, size_t instanceCount);
+        void RenderInstances();
+
     private:
         void BuildVertices();
 
@@ -50,15 +56,17 @@ namespace Visualization
         std::vector<MonoVertex> m_vertices;
         std::vector<uint32_t> m_indices;
 
-        // OpenGL objects
-        GLuint m_vertexArrayObject;
-        GLuint m_vertexBufferObject;
-        GLuint m_elementBufferObject;
+        // OpenGL objects, the geometry buffers are shared with the renderers of the other windows
+        GLuint m_vertexArrayObject = 0;
+        SharedGeometry m_geometry;
 
         GLuint m_modelIndex;
         GLuint m_viewIndex;
         GLuint m_projectionIndex;
 
+        // Instanced rendering
+        InstanceBuffer m_instances;
+
         GLuint m_colorIndex;
     };
 }
\ No newline at end of file
@@ -0,0 +1,172 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "StreamingBuffer.h"
+
+#include "Helpers.h"
+
+using namespace Visualization;
+
+// GL 4.4 / ARB_buffer_storage, not part of the GL 4.3 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static PFNGLBUFFERSTORAGEPROC GetBufferStorageFunction()
+{
+    GLint majorVersion = 0;
+    GLint minorVersion = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+    const bool isSupported = majorVersion > 4 || (majorVersion == 4 && minorVersion >= 4) ||
+        IsGlExtensionSupported("GL_ARB_buffer_storage");
+    if (!isSupported)
+    {
+        return nullptr;
+    }
+    return (PFNGLBUFFERSTORAGEPROC)GetGlProcAddress("glBufferStorage");
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    Delete();
+}
+
+void StreamingBuffer::Create(GLenum target, GLsizeiptr segmentSize, int segmentCount)
+{
+    CheckAssert(!IsCreated());
+    CheckAssert(segmentCount > 1 && segmentCount <= MaxSegmentCount, "Invalid streaming buffer segment count %d", segmentCount);
+
+    m_target = target;
+    m_segmentSize = segmentSize;
+    m_segmentCount = segmentCount;
+    // The first write goes to segment 0
+    m_currentSegment = segmentCount - 1;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(m_target, m_buffer);
+
+    const GLsizeiptr bufferSize = m_segmentSize * m_segmentCount;
+    PFNGLBUFFERSTORAGEPROC bufferStorage = GetBufferStorageFunction();
+    if (bufferStorage != nullptr)
+    {
+        // Coherent writes are visible to the GPU without flushing, the fences take care of the ordering
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(m_target, bufferSize, nullptr, flags);
+        m_persistentData = (uint8_t*)glMapBufferRange(m_target, 0, bufferSize, flags);
+    }
+
+    if (m_persistentData == nullptr)
+    {
+        if (bufferStorage != nullptr)
+        {
+            // Immutable storage that could not be mapped can not be reallocated either
+            glDeleteBuffers(1, &m_buffer);
+            glGenBuffers(1, &m_buffer);
+            glBindBuffer(m_target, m_buffer);
+        }
+        glBufferData(m_target, bufferSize, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(m_target, 0);
+}
+
+void StreamingBuffer::Delete()
+{
+    if (!IsCreated())
+    {
+        return;
+    }
+
+    for (GLsync& fence : m_fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (m_persistentData != nullptr || m_mappedSegment >= 0)
+    {
+        glBindBuffer(m_target, m_buffer);
+        glUnmapBuffer(m_target);
+        glBindBuffer(m_target, 0);
+    }
+    m_persistentData = nullptr;
+    m_mappedSegment = -1;
+
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+}
+
+void* StreamingBuffer::MapNextSegment()
+{
+    CheckAssert(m_mappedSegment < 0, "Streaming buffer segment %d is still mapped", m_mappedSegment);
+    if (!IsCreated())
+    {
+        return nullptr;
+    }
+
+    const int segment = (m_currentSegment + 1) % m_segmentCount;
+    GLsync& fence = m_fences[segment];
+    if (fence != nullptr)
+    {
+        // Only poll, the flush makes sure the fence is eventually signaled
+        const GLenum waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (waitResult == GL_TIMEOUT_EXPIRED)
+        {
+            return nullptr;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    m_mappedSegment = segment;
+    const GLintptr offset = segment * m_segmentSize;
+    if (m_persistentData != nullptr)
+    {
+        return m_persistentData + offset;
+    }
+
+    // The fence already guarantees the GPU is done with the range
+    glBindBuffer(m_target, m_buffer);
+    void* data = glMapBufferRange(m_target, offset, m_segmentSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(m_target, 0);
+    if (data == nullptr)
+    {
+        m_mappedSegment = -1;
+    }
+    return data;
+}
+
+void StreamingBuffer::UnmapSegment()
+{
+    CheckAssert(m_mappedSegment >= 0, "No streaming buffer segment is mapped");
+
+    if (m_persistentData == nullptr)
+    {
+        glBindBuffer(m_target, m_buffer);
+        glUnmapBuffer(m_target);
+        glBindBuffer(m_target, 0);
+    }
+
+    m_currentSegment = m_mappedSegment;
+    m_mappedSegment = -1;
+}
+
+void StreamingBuffer::FenceCurrentSegment()
+{
+    GLsync& fence = m_fences[m_currentSegment];
+    if (fence != nullptr)
+    {
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "glad/glad.h"
+
+namespace Visualization
+{
+    // Ring of equally sized segments in one buffer object to stream data to the GPU without stalls.
+    // The buffer is mapped persistently when GL 4.4 / ARB_buffer_storage is available, otherwise every segment is
+    // mapped unsynchronized on write. A fence per segment tells when the GPU is done reading it, so a segment is
+    // only reused once the GPU no longer needs it and the driver never has to orphan or synchronize the buffer.
+    //
+    // Usage per frame, with the context of the buffer current:
+    //     void* data = buffer.MapNextSegment();  // nullptr when the GPU still reads every segment
+    //     ... write up to GetSegmentSize() bytes ...
+    //     buffer.UnmapSegment();
+    //     ... issue GL commands that read from GetBuffer() at GetCurrentOffset() ...
+    //     buffer.FenceCurrentSegment();
+    class StreamingBuffer
+    {
+    public:
+        static const int MaxSegmentCount = 4;
+
+        ~StreamingBuffer();
+
+        void Create(GLenum target, GLsizeiptr segmentSize, int segmentCount = 3);
+        void Delete();
+
+        bool IsCreated() const { return m_buffer != 0; }
+        bool IsPersistent() const { return m_persistentData != nullptr; }
+
+        GLuint GetBuffer() const { return m_buffer; }
+        GLenum GetTarget() const { return m_target; }
+        GLsizeiptr GetSegmentSize() const { return m_segmentSize; }
+
+        // Offset of the segment that was written last
+        GLintptr GetCurrentOffset() const { return m_currentSegment * m_segmentSize; }
+
+        // Returns nullptr instead of waiting when the GPU has not finished reading the next segment yet.
+        // The caller drops the upload and keeps rendering the previous data.
+        void* MapNextSegment();
+        void UnmapSegment();
+
+        // Has to follow the last GL command that reads the current segment
+        void FenceCurrentSegment();
+
+    private:
+        GLenum m_target = GL_ARRAY_BUFFER;
+        GLuint m_buffer = 0;
+        GLsizeiptr m_segmentSize = 0;
+        int m_segmentCount = 0;
+        int m_currentSegment = 0;
+        int m_mappedSegment = -1;
+
+        uint8_t* m_persistentData = nullptr;
+        std::array<GLsync, MaxSegmentCount> m_fences{};
+    };
+}
@@ -3,10 +3,13 @@
 
 #include "Window3dWrapper.h"
 
+#include <algorithm>
 #include <array>
 #include <k4a/k4a.h>
 #include <k4abt.h>
 
+#include "BrownConradyCamera.h"
+#include "CalibrationLutCache.h"
 #include "Utilities.h"
 
 const float MillimeterToMeter = 0.001f;
@@ -18,6 +21,21 @@ void ConvertMillimeterToMeter(k4a_float3_t positionInMM, linmath::vec3 outPositi
     outPositionInMeter[2] = positionInMM.v[2] * MillimeterToMeter;
 }
 
+// k4a extrinsics have a row major rotation and a translation in millimeters, linmath matrices are column major
+static void ConvertExtrinsics(const k4a_calibration_extrinsics_t& extrinsics, linmath::mat4x4 outTransformInMeter)
+{
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 3; column++)
+        {
+            outTransformInMeter[column][row] = extrinsics.rotation[row * 3 + column];
+        }
+        outTransformInMeter[row][3] = 0.f;
+        outTransformInMeter[3][row] = extrinsics.translation[row] * MillimeterToMeter;
+    }
+    outTransformInMeter[3][3] = 1.f;
+}
+
 Window3dWrapper::~Window3dWrapper()
 {
     Delete();
@@ -28,6 +46,65 @@ void Window3dWrapper::Create(
     k4a_depth_mode_t depthMode)
 {
     m_window3d.Create(name);
+    SetDefaultView(depthMode);
+}
+
+void Window3dWrapper::Create(
+    const char* name,
+    const k4a_calibration_t& sensorCalibration)
+{
+    Create(name, sensorCalibration.depth_mode);
+    InitializeCalibration(sensorCalibration);
+}
+
+void Window3dWrapper::CreateOffscreen(
+    const k4a_calibration_t& sensorCalibration,
+    int width,
+    int height)
+{
+    m_window3d.CreateOffscreen(width, height);
+    SetDefaultView(sensorCalibration.depth_mode);
+    InitializeCalibration(sensorCalibration);
+}
+
+void Window3dWrapper::SetCalibration(const k4a_calibration_t& sensorCalibration)
+{
+    SetDefaultView(sensorCalibration.depth_mode);
+    InitializeCalibration(sensorCalibration);
+}
+
+uint32_t Window3dWrapper::AddDepthSource(const k4a_calibration_t& sensorCalibration, const k4a_calibration_extrinsics_t& depthToWorld)
+{
+    std::vector<XY> xyDepthTable;
+    EXIT_IF(!CreateXYDepthTable(sensorCalibration, xyDepthTable), "Create XY Depth Table failed!");
+
+    linmath::mat4x4 transform;
+    ConvertExtrinsics(depthToWorld, transform);
+
+    const uint32_t source = m_depthSourceCount++;
+    m_window3d.InitializeDepthSource(
+        source,
+        reinterpret_cast<float*>(xyDepthTable.data()),
+        sensorCalibration.depth_camera_calibration.resolution_width,
+        sensorCalibration.depth_camera_calibration.resolution_height,
+        transform);
+    return source;
+}
+
+void Window3dWrapper::SetDepthSourceTransform(uint32_t source, const k4a_calibration_extrinsics_t& depthToWorld)
+{
+    linmath::mat4x4 transform;
+    ConvertExtrinsics(depthToWorld, transform);
+    m_window3d.SetDepthSourceTransform(source, transform);
+}
+
+void Window3dWrapper::UpdateDepthSource(uint32_t source, k4a_image_t depthImage)
+{
+    UpdateDepthBuffer(depthImage, true, source);
+}
+
+void Window3dWrapper::SetDefaultView(k4a_depth_mode_t depthMode)
+{
     m_window3d.SetMirrorMode(true);
 
     switch (depthMode)
@@ -44,14 +121,6 @@ void Window3dWrapper::Create(
     }
 }
 
-void Window3dWrapper::Create(
-    const char* name,
-    const k4a_calibration_t& sensorCalibration)
-{
-    Create(name, sensorCalibration.depth_mode);
-    InitializeCalibration(sensorCalibration);
-}
-
 void Window3dWrapper::SetCloseCallback(
     Visualization::CloseCallbackType closeCallback,
     void* closeCallbackContext)
@@ -83,9 +152,73 @@ void Window3dWrapper::Delete()
     }
 }
 
-void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, std::vector<Color> pointCloudColors)
+void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, const std::vector<Color>& pointCloudColors)
+{
+    // No segmentation colors from the GPU, the colors come with the vertices if at all
+    m_window3d.UpdateBodyIndexMap(nullptr, 0, 0, nullptr, 0);
+    UpdatePoints(depthImage, pointCloudColors);
+}
+
+void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, k4a_image_t bodyIndexMap, const std::vector<uint32_t>& bodyIds)
+{
+    std::array<linmath::vec4, Visualization::PointCloudRenderer::MaxBodyPaletteSize> bodyPalette;
+    const size_t bodyPaletteSize = bodyIds.empty() ? bodyPalette.size() : std::min(bodyIds.size(), bodyPalette.size());
+    for (size_t i = 0; i < bodyPaletteSize; i++)
+    {
+        const Color& color = g_bodyColors[(bodyIds.empty() ? i : bodyIds[i]) % g_bodyColors.size()];
+        bodyPalette[i][0] = color.r;
+        bodyPalette[i][1] = color.g;
+        bodyPalette[i][2] = color.b;
+        bodyPalette[i][3] = color.a;
+    }
+
+    m_window3d.UpdateBodyIndexMap(
+        k4a_image_get_buffer(bodyIndexMap),
+        static_cast<uint32_t>(k4a_image_get_width_pixels(bodyIndexMap)),
+        static_cast<uint32_t>(k4a_image_get_height_pixels(bodyIndexMap)),
+        bodyPalette.data(),
+        static_cast<uint32_t>(bodyPaletteSize));
+
+    // Uncolored points, the point cloud shader colors them with the body index map
+    UpdatePoints(depthImage, std::vector<Color>());
+}
+
+void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, k4abt_frame_t bodyFrame)
 {
-    m_pointCloudUpdated = true;
+    std::vector<uint32_t> bodyIds(k4abt_frame_get_num_bodies(bodyFrame));
+    for (uint32_t i = 0; i < static_cast<uint32_t>(bodyIds.size()); i++)
+    {
+        bodyIds[i] = k4abt_frame_get_body_id(bodyFrame, i);
+    }
+
+    k4a_image_t bodyIndexMap = k4abt_frame_get_body_index_map(bodyFrame);
+    if (bodyIndexMap == nullptr)
+    {
+        UpdatePointClouds(depthImage);
+        return;
+    }
+
+    UpdatePointClouds(depthImage, bodyIndexMap, bodyIds);
+    k4a_image_release(bodyIndexMap);
+}
+
+void Window3dWrapper::UpdatePoints(k4a_image_t depthImage, const std::vector<Color>& pointCloudColors)
+{
+    // Without colors every point looks the same, the vertex shader computes the points from the depth texture
+    const bool generatePointsFromDepth = m_enableGpuPointCloudGeneration && pointCloudColors.empty() && !m_xyDepthTable.empty();
+    if (generatePointsFromDepth)
+    {
+        UpdateDepthBuffer(depthImage, true);
+        return;
+    }
+
+    // The GPU is still busy with the previous point clouds, drop this one instead of waiting
+    Visualization::PointCloudVertex* pointClouds = m_window3d.MapPointClouds(m_depthWidth * m_depthHeight);
+    if (pointClouds == nullptr)
+    {
+        return;
+    }
+
     VERIFY(k4a_transformation_depth_image_to_point_cloud(m_transformationHandle,
         depthImage,
         K4A_CALIBRATION_TYPE_DEPTH,
@@ -96,6 +229,7 @@ void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, std::vector<Colo
 
     int16_t* pointCloudImageBuffer = (int16_t*)k4a_image_get_buffer(m_pointCloudImage);
 
+    uint32_t numPoints = 0;
     for (int h = 0; h < height; h++)
     {
         for (int w = 0; w < width; w++)
@@ -122,17 +256,19 @@ void Window3dWrapper::UpdatePointClouds(k4a_image_t depthImage, std::vector<Colo
 
             linmath::vec3 positionInMeter;
             ConvertMillimeterToMeter(position, positionInMeter);
-            Visualization::PointCloudVertex pointCloud;
+
+            // Written straight into the mapped vertex buffer
+            Visualization::PointCloudVertex& pointCloud = pointClouds[numPoints++];
             linmath::vec3_copy(pointCloud.Position, positionInMeter);
             linmath::vec4_copy(pointCloud.Color, color);
             pointCloud.PixelLocation[0] = pixelLocation[0];
             pointCloud.PixelLocation[1] = pixelLocation[1];
-
-            m_pointClouds.push_back(pointCloud);
         }
     }
 
-    UpdateDepthBuffer(depthImage);
+    // The depth frame is still needed for the shading
+    UpdateDepthBuffer(depthImage, false);
+    m_window3d.UnmapPointClouds(numPoints);
 }
 
 void Window3dWrapper::CleanJointsAndBones()
@@ -140,43 +276,50 @@ void Window3dWrapper::CleanJointsAndBones()
     m_window3d.CleanJointsAndBones();
 }
 
-void Window3dWrapper::AddJoint(k4a_float3_t position, k4a_quaternion_t orientation, Color color)
+static Visualization::Joint ConvertJoint(k4a_float3_t position, k4a_quaternion_t orientation, Color color)
 {
     linmath::vec3 jointPositionInMeter;
     ConvertMillimeterToMeter(position, jointPositionInMeter);
-    m_window3d.AddJoint({
+    return {
         {jointPositionInMeter[0], jointPositionInMeter[1], jointPositionInMeter[2]},
         {orientation.v[0], orientation.v[1], orientation.v[2], orientation.v[3]},
-        {color.r, color.g, color.b, color.a} });
+        {color.r, color.g, color.b, color.a} };
 }
 
-void Window3dWrapper::AddBone(k4a_float3_t joint1Position, k4a_float3_t joint2Position, Color color)
+static Visualization::Bone ConvertBone(k4a_float3_t joint1Position, k4a_float3_t joint2Position, Color color)
 {
-    linmath::vec3 joint1PositionInMeter;
-    ConvertMillimeterToMeter(joint1Position, joint1PositionInMeter);
-    linmath::vec3 joint2PositionInMeter;
-    ConvertMillimeterToMeter(joint2Position, joint2PositionInMeter);
     Visualization::Bone bone;
-    linmath::vec4_copy(bone.Joint1Position, joint1PositionInMeter);
-    linmath::vec4_copy(bone.Joint2Position, joint2PositionInMeter);
+    ConvertMillimeterToMeter(joint1Position, bone.Joint1Position);
+    ConvertMillimeterToMeter(joint2Position, bone.Joint2Position);
     bone.Color[0] = color.r;
     bone.Color[1] = color.g;
     bone.Color[2] = color.b;
     bone.Color[3] = color.a;
+    return bone;
+}
 
-    m_window3d.AddBone(bone);
+void Window3dWrapper::AddJoint(k4a_float3_t position, k4a_quaternion_t orientation, Color color)
+{
+    m_window3d.AddJoint(ConvertJoint(position, orientation, color));
+}
+
+void Window3dWrapper::AddBone(k4a_float3_t joint1Position, k4a_float3_t joint2Position, Color color)
+{
+    m_window3d.AddBone(ConvertBone(joint1Position, joint2Position, color));
 }
 
 void Window3dWrapper::AddBody(const k4abt_body_t& body, Color color)
 {
+    std::array<Visualization::Joint, K4ABT_JOINT_COUNT> joints;
     for (int joint = 0; joint < static_cast<int>(K4ABT_JOINT_COUNT); joint++)
     {
         const k4a_float3_t& jointPosition = body.skeleton.joints[joint].position;
         const k4a_quaternion_t& jointOrientation = body.skeleton.joints[joint].orientation;
 
-        AddJoint(jointPosition, jointOrientation, color);
+        joints[joint] = ConvertJoint(jointPosition, jointOrientation, color);
     }
 
+    std::array<Visualization::Bone, g_boneList.size()> bones;
     for (size_t boneIdx = 0; boneIdx < g_boneList.size(); boneIdx++)
     {
         k4abt_joint_id_t joint1 = g_boneList[boneIdx].first;
@@ -185,22 +328,44 @@ void Window3dWrapper::AddBody(const k4abt_body_t& body, Color color)
         const k4a_float3_t& joint1Position = body.skeleton.joints[joint1].position;
         const k4a_float3_t& joint2Position = body.skeleton.joints[joint2].position;
 
-        AddBone(joint1Position, joint2Position, color);
+        bones[boneIdx] = ConvertBone(joint1Position, joint2Position, color);
     }
+
+    // One bulk call per body, the skeleton renderer builds the instance attributes from it
+    m_window3d.AddJoints(joints.data(), joints.size());
+    m_window3d.AddBones(bones.data(), bones.size());
 }
 
 void Window3dWrapper::Render()
 {
-    if (m_pointCloudUpdated || m_pointClouds.size() != 0)
-    {
-        m_window3d.UpdatePointClouds(m_pointClouds.data(), (uint32_t)m_pointClouds.size(), m_depthBuffer.data(), m_depthWidth, m_depthHeight);
-        m_pointClouds.clear();
-        m_pointCloudUpdated = false;
-    }
-
     m_window3d.Render();
 }
 
+bool Window3dWrapper::RenderAsync(Visualization::RenderedFrame& frame)
+{
+    return m_window3d.RenderAsync(frame);
+}
+
+bool Window3dWrapper::FlushAsyncRender(Visualization::RenderedFrame& frame)
+{
+    return m_window3d.FlushAsyncReadback(frame);
+}
+
+uint64_t Window3dWrapper::GetDroppedReadbackCount()
+{
+    return m_window3d.GetDroppedReadbackCount();
+}
+
+void Window3dWrapper::SetAsyncReadbackDepth(int readbackDepth)
+{
+    m_window3d.SetAsyncReadbackDepth(readbackDepth);
+}
+
+void Window3dWrapper::ReleaseContext()
+{
+    m_window3d.ReleaseContext();
+}
+
 void Window3dWrapper::SetWindowPosition(int xPos, int yPos)
 {
     m_window3d.SetWindowPosition(xPos, yPos);
@@ -220,6 +385,31 @@ void Window3dWrapper::SetJointFrameVisualization(bool enableJointFrameVisualizat
     m_window3d.SetSkeletonRenderMode(skeletonRenderMode);
 }
 
+void Window3dWrapper::SetGpuPointCloudGeneration(bool enableGpuPointCloudGeneration)
+{
+    m_enableGpuPointCloudGeneration = enableGpuPointCloudGeneration;
+}
+
+void Window3dWrapper::EnableRenderStatistics(bool enableRenderStatistics)
+{
+    m_window3d.EnableRenderStatistics(enableRenderStatistics);
+}
+
+Visualization::RenderStatistics Window3dWrapper::GetRenderStatistics() const
+{
+    return m_window3d.GetRenderStatistics();
+}
+
+bool Window3dWrapper::WriteRenderStatisticsCsv(const std::string& path) const
+{
+    return m_window3d.WriteRenderStatisticsCsv(path);
+}
+
+void Window3dWrapper::SetRenderStatisticsOverlay(bool enableOverlay)
+{
+    m_window3d.SetRenderStatisticsOverlay(enableOverlay);
+}
+
 void Window3dWrapper::SetFloorRendering(bool enableFloorRendering, float floorPositionX, float floorPositionY, float floorPositionZ)
 {
     linmath::vec3 position = { floorPositionX, floorPositionY, floorPositionZ };
@@ -233,27 +423,29 @@ void Window3dWrapper::InitializeCalibration(const k4a_calibration_t& sensorCalib
     m_depthHeight = static_cast<uint32_t>(sensorCalibration.depth_camera_calibration.resolution_height);
 
     // Cache the 2D to 3D unprojection table
-    EXIT_IF(!CreateXYDepthTable(sensorCalibration), "Create XY Depth Table failed!");
+    EXIT_IF(!CreateXYDepthTable(sensorCalibration, m_xyDepthTable), "Create XY Depth Table failed!");
     m_window3d.InitializePointCloudRenderer(
         true,   // Enable point cloud shading for better visualization effect
         reinterpret_cast<float*>(m_xyDepthTable.data()),
         m_depthWidth,
         m_depthHeight);
 
-    // Create transformation handle
-    if (m_transformationHandle == nullptr)
+    // Create transformation handle, replacing the one of a previous calibration
+    if (m_transformationHandle != nullptr)
     {
-        m_transformationHandle = k4a_transformation_create(&sensorCalibration);
+        k4a_transformation_destroy(m_transformationHandle);
+    }
+    m_transformationHandle = k4a_transformation_create(&sensorCalibration);
 
-        if (m_pointCloudImage == nullptr)
-        {
-            VERIFY(k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-                m_depthWidth,
-                m_depthHeight,
-                m_depthWidth * 3 * (int)sizeof(int16_t),
-                &m_pointCloudImage), "Create Point Cloud Image failed!");
-        }
+    if (m_pointCloudImage != nullptr)
+    {
+        k4a_image_release(m_pointCloudImage);
     }
+    VERIFY(k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
+        m_depthWidth,
+        m_depthHeight,
+        m_depthWidth * 3 * (int)sizeof(int16_t),
+        &m_pointCloudImage), "Create Point Cloud Image failed!");
 }
 
 void Window3dWrapper::BlendBodyColor(linmath::vec4 color, Color bodyColor)
@@ -266,58 +458,105 @@ void Window3dWrapper::BlendBodyColor(linmath::vec4 color, Color bodyColor)
     color[2] = bodyColor.b * instanceAlpha + color[2] * darkenRatio;
 }
 
-void Window3dWrapper::UpdateDepthBuffer(k4a_image_t depthFrame)
+void Window3dWrapper::UpdateDepthBuffer(k4a_image_t depthFrame, bool generatePointsFromDepth, uint32_t source)
 {
     int width = k4a_image_get_width_pixels(depthFrame);
     int height = k4a_image_get_height_pixels(depthFrame);
-    uint16_t* depthFrameBuffer = (uint16_t*)k4a_image_get_buffer(depthFrame);
-    m_depthBuffer.assign(depthFrameBuffer, depthFrameBuffer + width * height);
+
+    // Single copy from the k4a image into the mapped upload buffer
+    uint16_t* mappedDepthFrame = m_window3d.MapDepthFrame(width, height, source);
+    if (mappedDepthFrame == nullptr)
+    {
+        return;
+    }
+
+    const uint16_t* depthFrameBuffer = (const uint16_t*)k4a_image_get_buffer(depthFrame);
+    std::copy(depthFrameBuffer, depthFrameBuffer + width * height, mappedDepthFrame);
+    m_window3d.UnmapDepthFrame(generatePointsFromDepth, source);
 }
 
-bool Window3dWrapper::CreateXYDepthTable(const k4a_calibration_t & sensorCalibration)
+bool Window3dWrapper::CreateXYDepthTable(const k4a_calibration_t & sensorCalibration, std::vector<XY>& xyDepthTable)
 {
     int width = sensorCalibration.depth_camera_calibration.resolution_width;
     int height = sensorCalibration.depth_camera_calibration.resolution_height;
 
-    m_xyDepthTable.resize(width * height);
+    // Rows are unprojected a few pixels at a time by the batch camera model, the SDK is the fallback for other
+    // lens models
+    BrownConradyCamera camera;
+    const bool useBatchCamera = camera.Initialize(sensorCalibration.depth_camera_calibration);
 
-    auto xyTablePtr = m_xyDepthTable.begin();
+    // Computed in parallel on the first launch with this calibration, mapped from the cache afterwards
+    CalibrationLut lut;
+    const bool created = lut.LoadOrCreate(sensorCalibration, "xy_depth_table", 2, nullptr, 0, width * height * sizeof(XY), height,
+        [&](uint8_t* data, int rowBegin, int rowEnd) {
+            XY* xyTablePtr = reinterpret_cast<XY*>(data) + rowBegin * width;
 
-    k4a_float3_t pt3;
-    for (int h = 0; h < height; h++)
-    {
-        for (int w = 0; w < width; w++)
-        {
-            k4a_float2_t pt = { static_cast<float>(w), static_cast<float>(h) };
-            int valid = 0;
-            k4a_result_t result = k4a_calibration_2d_to_3d(&sensorCalibration,
-                &pt,
-                1.f,
-                K4A_CALIBRATION_TYPE_DEPTH,
-                K4A_CALIBRATION_TYPE_DEPTH,
-                &pt3,
-                &valid);
-            if (result != K4A_RESULT_SUCCEEDED)
+            if (useBatchCamera)
             {
-                return false;
+                std::vector<float> u(width), v(width), x(width), y(width);
+                std::vector<int> valid(width);
+                for (int w = 0; w < width; w++)
+                {
+                    u[w] = static_cast<float>(w);
+                }
+
+                for (int h = rowBegin; h < rowEnd; h++)
+                {
+                    std::fill(v.begin(), v.end(), static_cast<float>(h));
+                    // Invalid pixels are (0, 0) like below
+                    camera.Undistort(u.data(), v.data(), x.data(), y.data(), valid.data(), width);
+                    for (int w = 0; w < width; w++)
+                    {
+                        xyTablePtr->x = x[w];
+                        xyTablePtr->y = y[w];
+                        ++xyTablePtr;
+                    }
+                }
+                return true;
             }
 
-            if (valid == 0)
-            {
-                // Set the invalid xy table to be (0, 0)
-                xyTablePtr->x = 0.f;
-                xyTablePtr->y = 0.f;
-            }
-            else
+            k4a_float3_t pt3;
+            for (int h = rowBegin; h < rowEnd; h++)
             {
-                xyTablePtr->x = pt3.xyz.x;
-                xyTablePtr->y = pt3.xyz.y;
+                for (int w = 0; w < width; w++)
+                {
+                    k4a_float2_t pt = { static_cast<float>(w), static_cast<float>(h) };
+                    int valid = 0;
+                    k4a_result_t result = k4a_calibration_2d_to_3d(&sensorCalibration,
+                        &pt,
+                        1.f,
+                        K4A_CALIBRATION_TYPE_DEPTH,
+                        K4A_CALIBRATION_TYPE_DEPTH,
+                        &pt3,
+                        &valid);
+                    if (result != K4A_RESULT_SUCCEEDED)
+                    {
+                        return false;
+                    }
+
+                    if (valid == 0)
+                    {
+                        // Set the invalid xy table to be (0, 0)
+                        xyTablePtr->x = 0.f;
+                        xyTablePtr->y = 0.f;
+                    }
+                    else
+                    {
+                        xyTablePtr->x = pt3.xyz.x;
+                        xyTablePtr->y = pt3.xyz.y;
+                    }
+
+                    ++xyTablePtr;
+                }
             }
-
-            ++xyTablePtr;
-        }
+            return true;
+        });
+    if (!created)
+    {
+        return false;
     }
 
+    const XY* xyTable = reinterpret_cast<const XY*>(lut.GetData());
+    xyDepthTable.assign(xyTable, xyTable + width * height);
     return true;
 }
-
@@ -25,6 +25,26 @@ public:
         const char* name,
         const k4a_calibration_t& sensorCalibration);
 
+    // Create Window3d wrapper with point cloud shading that renders without a window, see
+    // WindowController3d::CreateOffscreen. Use RenderAsync to get the rendered frames.
+    void CreateOffscreen(
+        const k4a_calibration_t& sensorCalibration,
+        int width,
+        int height);
+
+    // Switch to the depth camera of another sensor, e.g. before rendering the next recording
+    void SetCalibration(const k4a_calibration_t& sensorCalibration);
+
+    // Depth cameras of further sensors of a rig, rendered in the same pass as the one of Create (source 0).
+    // depthToWorld is the extrinsics from the depth camera of the sensor into the world (rotation row major,
+    // translation in millimeters). Returns the source index for UpdateDepthSource.
+    uint32_t AddDepthSource(const k4a_calibration_t& sensorCalibration, const k4a_calibration_extrinsics_t& depthToWorld);
+
+    void SetDepthSourceTransform(uint32_t source, const k4a_calibration_extrinsics_t& depthToWorld);
+
+    // Uncolored points of the source generated on the GPU, source 0 is the same as UpdatePointClouds without colors
+    void UpdateDepthSource(uint32_t source, k4a_image_t depthImage);
+
     void SetCloseCallback(
         Visualization::CloseCallbackType closeCallback,
         void* closeCallbackContext = nullptr);
@@ -35,7 +55,15 @@ public:
 
     void Delete();
 
-    void UpdatePointClouds(k4a_image_t depthImage, std::vector<Color> pointCloudColors = std::vector<Color>());
+    void UpdatePointClouds(k4a_image_t depthImage, const std::vector<Color>& pointCloudColors = std::vector<Color>());
+
+    // Colors the body pixels on the GPU from the body index map of the tracker instead of blending per pixel colors on
+    // the CPU. Body i of the frame gets g_bodyColors[bodyIds[i] % g_bodyColors.size()], like AddBody with the colors
+    // of the samples, or g_bodyColors[i % g_bodyColors.size()] without ids.
+    void UpdatePointClouds(k4a_image_t depthImage, k4a_image_t bodyIndexMap, const std::vector<uint32_t>& bodyIds = std::vector<uint32_t>());
+
+    // Same with the body index map and the body ids of the body frame
+    void UpdatePointClouds(k4a_image_t depthImage, k4abt_frame_t bodyFrame);
 
     void CleanJointsAndBones();
 
@@ -48,6 +76,18 @@ public:
 
     void Render();
 
+    // Render with asynchronous readback, see WindowController3d::RenderAsync and FlushAsyncReadback
+    bool RenderAsync(Visualization::RenderedFrame& frame);
+
+    bool FlushAsyncRender(Visualization::RenderedFrame& frame);
+
+    uint64_t GetDroppedReadbackCount();
+
+    void SetAsyncReadbackDepth(int readbackDepth);
+
+    // The context is current on the thread that created the wrapper. Release it there before rendering on another thread.
+    void ReleaseContext();
+
     // Window Configuration Functions
     void SetFloorRendering(bool enableFloorRendering, float floorPositionX, float floorPositionY, float floorPositionZ);
 
@@ -57,28 +97,42 @@ public:
     void SetLayout3d(Visualization::Layout3d layout3d);
     void SetJointFrameVisualization(bool enableJointFrameVisualization);
 
+    // Generate uncolored point clouds on the GPU from the depth image (default). Needs the calibration Create.
+    // Colored point clouds are always generated on the CPU.
+    void SetGpuPointCloudGeneration(bool enableGpuPointCloudGeneration);
+
+    // Render statistics, see WindowController3d::EnableRenderStatistics
+    void EnableRenderStatistics(bool enableRenderStatistics);
+    Visualization::RenderStatistics GetRenderStatistics() const;
+    bool WriteRenderStatisticsCsv(const std::string& path) const;
+    void SetRenderStatisticsOverlay(bool enableOverlay);
+
 private:
+    void SetDefaultView(k4a_depth_mode_t depthMode);
+
     void InitializeCalibration(const k4a_calibration_t& sensorCalibration);
 
     void BlendBodyColor(linmath::vec4 color, Color bodyColor);
 
-    void UpdateDepthBuffer(k4a_image_t depthImage);
-
-    bool CreateXYDepthTable(const k4a_calibration_t& sensorCalibration);
-
-private:
-    Visualization::WindowController3d m_window3d;
+    void UpdatePoints(k4a_image_t depthImage, const std::vector<Color>& pointCloudColors);
 
-    bool m_pointCloudUpdated = false;
-    std::vector<uint16_t> m_depthBuffer;
-    std::vector<Visualization::PointCloudVertex> m_pointClouds;
+    void UpdateDepthBuffer(k4a_image_t depthImage, bool generatePointsFromDepth, uint32_t source = 0);
 
     struct XY
     {
         float x;
         float y;
     };
+
+    static bool CreateXYDepthTable(const k4a_calibration_t& sensorCalibration, std::vector<XY>& xyDepthTable);
+
+private:
+    Visualization::WindowController3d m_window3d;
+
+    bool m_enableGpuPointCloudGeneration = true;
+
     std::vector<XY> m_xyDepthTable;
+    uint32_t m_depthSourceCount = 1;
     uint32_t m_depthWidth = 0;
     uint32_t m_depthHeight = 0;
     k4a_transformation_t m_transformationHandle = nullptr;
@@ -8,6 +8,8 @@
 #include <stdarg.h>
 #include <thread>
 #include <limits>
+#include <chrono>
+#include <cmath>
 
 #include "ViewControl.h"
 #include "Helpers.h"
@@ -50,6 +52,25 @@ class GLFWEnvironmentSingleton
     {
         Fail("GLFW Error %d: %s\n", error, description);
     }
+
+    // Hidden window whose context shares its objects with every window, so that shaders and geometry of the
+    // GlResourceManager::GetWindowResources survive the windows that created them. Needs the context hints of the
+    // windows to be set already.
+    static GLFWwindow* GetShareWindow()
+    {
+        static GLFWwindow* shareWindow = nullptr;
+        if (shareWindow == nullptr)
+        {
+            glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+            shareWindow = glfwCreateWindow(1, 1, "Share", nullptr, nullptr);
+            if (!shareWindow)
+            {
+                glfwTerminate();
+                exit(EXIT_FAILURE);
+            }
+        }
+        return shareWindow;
+    }
 };
 
 WindowController3d::WindowController3d()
@@ -69,12 +90,19 @@ void WindowController3d::Create(const char* name, bool showWindow, int width, in
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    if (!showWindow)
+
+    // Windows share programs and geometry, a window of an offscreen controller may render on another thread and
+    // keeps its own
+    GLFWwindow* shareWindow = nullptr;
+    if (m_resources == nullptr)
     {
-        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        shareWindow = GLFWEnvironmentSingleton::GetShareWindow();
+        m_resources = &GlResourceManager::GetWindowResources();
     }
+    glfwWindowHint(GLFW_VISIBLE, showWindow ? GL_TRUE : GL_FALSE);
     m_windowWidth = width;
     m_windowHeight = height;
+    m_windowName = name;
 
     // Get monitor for full screen
     GLFWmonitor* monitor = nullptr;
@@ -99,7 +127,7 @@ void WindowController3d::Create(const char* name, bool showWindow, int width, in
     }
 
     // Create window
-    m_window = glfwCreateWindow(m_windowWidth, m_windowHeight, name, monitor, nullptr);
+    m_window = glfwCreateWindow(m_windowWidth, m_windowHeight, name, monitor, shareWindow);
     if (!m_window)
     {
         glfwTerminate();
@@ -148,7 +176,9 @@ void WindowController3d::Create(const char* name, bool showWindow, int width, in
 
 
     glfwMakeContextCurrent(m_window);
+    GlResourceManager::MakeCurrent(m_resources);
 
+    SetGlProcAddressLoader((GLADloadproc)glfwGetProcAddress);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
         glfwTerminate();
@@ -163,13 +193,99 @@ void WindowController3d::Create(const char* name, bool showWindow, int width, in
     glClearColor(0.f, 0.f, 0.f, 0.f);
     glClearDepth(1.0f);
 
+    m_multiViewSupported = RendererBase::IsMultiViewSupported();
+
     m_pointCloudRenderer.Create(m_window);
     m_skeletonRenderer.Create(m_window);
 }
 
+void WindowController3d::CreateOffscreen(int width, int height)
+{
+    CheckAssert(!m_initialized);
+
+    // Offscreen controllers are rendered on worker threads, so they do not share their programs with other contexts
+    m_resources = &m_privateResources;
+
+    if (!m_offscreenContext.Create())
+    {
+        // Keeps the framebuffer object, pixels of a hidden window are not guaranteed to be rendered
+        Create("Offscreen", false, width, height);
+        CreateFramebuffer();
+        return;
+    }
+
+    m_initialized = true;
+    m_windowWidth = width;
+    m_windowHeight = height;
+    GlResourceManager::MakeCurrent(m_resources);
+    CreateFramebuffer();
+
+    // Context Settings
+    glDisable(GL_BLEND);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClearDepth(1.0f);
+
+    m_multiViewSupported = RendererBase::IsMultiViewSupported();
+
+    // Renderers get no window, the offscreen context is already current
+    m_pointCloudRenderer.Create(nullptr);
+    m_skeletonRenderer.Create(nullptr);
+}
+
+void WindowController3d::CreateFramebuffer()
+{
+    glGenRenderbuffers(1, &m_colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_windowWidth, m_windowHeight);
+
+    glGenRenderbuffers(1, &m_depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_windowWidth, m_windowHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // Stays bound for drawing and reading, the context renders nowhere else
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
+
+    CheckAssert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "Offscreen framebuffer is incomplete");
+}
+
+void WindowController3d::MakeContextCurrent()
+{
+    if (m_offscreenContext.IsCreated())
+    {
+        m_offscreenContext.MakeCurrent();
+    }
+    else
+    {
+        glfwMakeContextCurrent(m_window);
+    }
+    GlResourceManager::MakeCurrent(m_resources);
+}
+
+void WindowController3d::ReleaseContext()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_offscreenContext.IsCreated())
+    {
+        m_offscreenContext.ReleaseCurrent();
+    }
+    else
+    {
+        glfwMakeContextCurrent(nullptr);
+    }
+    GlResourceManager::MakeCurrent(nullptr);
+}
+
 void WindowController3d::Delete()
 {
     m_initialized = false;
+    MakeContextCurrent();
+    m_pixelReadback.Delete();
+    m_renderTimer.Delete();
     m_pointCloudRenderer.Delete();
     m_skeletonRenderer.Delete();
 
@@ -179,8 +295,34 @@ void WindowController3d::Delete()
         m_enableFloorRendering = false;
     }
 
-    glfwDestroyWindow(m_window);
-    m_window = nullptr;
+    glDeleteBuffers(1, &m_multiViewUniformBuffer);
+    m_multiViewUniformBuffer = 0;
+
+    if (m_framebuffer != 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_colorRenderbuffer);
+        glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+        m_framebuffer = 0;
+        m_colorRenderbuffer = 0;
+        m_depthRenderbuffer = 0;
+    }
+
+    // Shared resources stay for the next windows, private ones end with this context
+    if (m_resources == &m_privateResources)
+    {
+        m_privateResources.Delete();
+    }
+    GlResourceManager::MakeCurrent(nullptr);
+    m_resources = nullptr;
+
+    if (m_window != nullptr)
+    {
+        glfwDestroyWindow(m_window);
+        m_window = nullptr;
+    }
+    m_offscreenContext.Delete();
 }
 
 void WindowController3d::SetWindowPosition(int xPos, int yPos)
@@ -204,12 +346,29 @@ bool WindowController3d::InitializePointCloudRenderer(
             return false;
         }
 
+        MakeContextCurrent();
         m_pointCloudRenderer.InitializeDepthXYTable(depthXyTableInterleaved, width, height);
     }
 
     return true;
 }
 
+void WindowController3d::InitializeDepthSource(
+    uint32_t source,
+    const float* depthXyTableInterleaved,
+    int width, int height,
+    const linmath::mat4x4 depthToWorld)
+{
+    MakeContextCurrent();
+    m_pointCloudRenderer.InitializeDepthXYTable(depthXyTableInterleaved, width, height, source);
+    m_pointCloudRenderer.SetDepthSourceTransform(source, depthToWorld);
+}
+
+void WindowController3d::SetDepthSourceTransform(uint32_t source, const linmath::mat4x4 depthToWorld)
+{
+    m_pointCloudRenderer.SetDepthSourceTransform(source, depthToWorld);
+}
+
 void WindowController3d::UpdatePointClouds(
     const PointCloudVertex* point3d,
     uint32_t numPoints,
@@ -217,9 +376,57 @@ void WindowController3d::UpdatePointClouds(
     uint32_t width, uint32_t height,
     bool useTestPointClouds)
 {
+    MakeContextCurrent();
+    RenderTimer::Scope timerScope(m_renderTimer, RenderSection::PointCloudUpload);
     m_pointCloudRenderer.UpdatePointClouds(m_window, point3d, numPoints, depthFrame, width, height, useTestPointClouds);
 }
 
+void WindowController3d::UpdatePointCloudsFromDepth(
+    const uint16_t* depthFrame,
+    uint32_t width, uint32_t height,
+    uint32_t source)
+{
+    MakeContextCurrent();
+    RenderTimer::Scope timerScope(m_renderTimer, RenderSection::PointCloudUpload);
+    m_pointCloudRenderer.UpdateDepthFrame(m_window, depthFrame, width, height, source);
+}
+
+uint16_t* WindowController3d::MapDepthFrame(uint32_t width, uint32_t height, uint32_t source)
+{
+    MakeContextCurrent();
+    return m_pointCloudRenderer.MapDepthFrame(m_window, width, height, source);
+}
+
+void WindowController3d::UnmapDepthFrame(bool generatePointsFromDepth, uint32_t source)
+{
+    RenderTimer::Scope timerScope(m_renderTimer, RenderSection::PointCloudUpload);
+    m_pointCloudRenderer.UnmapDepthFrame(generatePointsFromDepth, source);
+}
+
+PointCloudVertex* WindowController3d::MapPointClouds(uint32_t maxNumPoints)
+{
+    MakeContextCurrent();
+    return m_pointCloudRenderer.MapPointClouds(m_window, maxNumPoints);
+}
+
+void WindowController3d::UnmapPointClouds(uint32_t numPoints)
+{
+    RenderTimer::Scope timerScope(m_renderTimer, RenderSection::PointCloudUpload);
+    m_pointCloudRenderer.UnmapPointClouds(numPoints);
+}
+
+void WindowController3d::UpdateBodyIndexMap(
+    const uint8_t* bodyIndexMap,
+    uint32_t width, uint32_t height,
+    const linmath::vec4* bodyPalette,
+    uint32_t bodyPaletteSize,
+    uint32_t source)
+{
+    MakeContextCurrent();
+    RenderTimer::Scope timerScope(m_renderTimer, RenderSection::PointCloudUpload);
+    m_pointCloudRenderer.UpdateBodyIndexMap(bodyIndexMap, width, height, bodyPalette, bodyPaletteSize, source);
+}
+
 void WindowController3d::CleanJointsAndBones()
 {
     m_skeletonRenderer.CleanJointsAndBones();
@@ -235,6 +442,16 @@ void WindowController3d::AddBone(const Visualization::Bone& bone)
     m_skeletonRenderer.AddBone(bone);
 }
 
+void WindowController3d::AddJoints(const Visualization::Joint* joints, size_t jointCount)
+{
+    m_skeletonRenderer.AddJoints(joints, jointCount);
+}
+
+void WindowController3d::AddBones(const Visualization::Bone* bones, size_t boneCount)
+{
+    m_skeletonRenderer.AddBones(bones, boneCount);
+}
+
 void WindowController3d::RenderScene(ViewControl& viewControl, Viewport viewport)
 {
     // Assign viewport to viewControl.
@@ -252,8 +469,60 @@ void WindowController3d::RenderScene(ViewControl& viewControl, Viewport viewport
 
     UpdateRenderersViewProjection(view, projection);
 
+    RenderObjects(viewport.width, viewport.height);
+    RenderCameraPivotPoint();
+}
+
+void WindowController3d::RenderMultiViewScene(
+    const std::array<ViewControl*, 4>& viewControls,
+    const std::array<Viewport, 4>& viewports)
+{
+    // Laid out as the MultiView uniform block of MultiViewShaders.h, std140 mat4 arrays have no padding
+    std::array<linmath::mat4x4, 4> views;
+    std::array<linmath::mat4x4, 4> projections;
+    std::array<linmath::mat4x4, 4> viewProjections;
+
+    for (size_t i = 0; i < viewControls.size(); i++)
+    {
+        const Viewport& viewport = viewports[i];
+        viewControls[i]->SetViewport(viewport);
+        glViewportIndexedf((GLuint)i, (GLfloat)viewport.x, (GLfloat)viewport.y, (GLfloat)viewport.width, (GLfloat)viewport.height);
+
+        viewControls[i]->GetPerspectiveMatrix(projections[i]);
+        viewControls[i]->GetViewMatrix(views[i]);
+        mat4x4_mul(viewProjections[i], projections[i], views[i]);
+    }
+
+    if (m_multiViewUniformBuffer == 0)
+    {
+        glGenBuffers(1, &m_multiViewUniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_multiViewUniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(viewProjections), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_multiViewUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(viewProjections), viewProjections.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_multiViewUniformBuffer);
+
+    // The views have the same size, the point size follows it
+    SetRenderersMultiView(true);
+    RenderObjects(viewports[0].width, viewports[0].height);
+    SetRenderersMultiView(false);
+
+    // The pivot point is one sphere, it is not worth a multi view program. glViewport resets all viewports.
+    for (size_t i = 0; i < viewControls.size(); i++)
+    {
+        glViewport(viewports[i].x, viewports[i].y, viewports[i].width, viewports[i].height);
+        m_skeletonRenderer.UpdateViewProjection(views[i], projections[i]);
+        RenderCameraPivotPoint();
+    }
+}
+
+void WindowController3d::RenderObjects(int viewportWidth, int viewportHeight)
+{
     if (m_enableFloorRendering)
     {
+        RenderTimer::Scope timerScope(m_renderTimer, RenderSection::FloorDraw);
         m_floorRenderer.Render();
     }
 
@@ -271,20 +540,32 @@ void WindowController3d::RenderScene(ViewControl& viewControl, Viewport viewport
     if (m_skeletonRenderMode == SkeletonRenderMode::SkeletonOverlay ||
         m_skeletonRenderMode == SkeletonRenderMode::SkeletonOverlayWithJointFrame)
     {
-        m_pointCloudRenderer.Render(viewport.width, viewport.height);
+        m_renderTimer.Begin(RenderSection::PointCloudDraw);
+        m_pointCloudRenderer.Render(viewportWidth, viewportHeight);
+        m_renderTimer.End(RenderSection::PointCloudDraw);
 
         glClear(GL_DEPTH_BUFFER_BIT);
+        m_renderTimer.Begin(RenderSection::SkeletonDraw);
         m_skeletonRenderer.Render();
+        m_renderTimer.End(RenderSection::SkeletonDraw);
     }
     else
     {
+        m_renderTimer.Begin(RenderSection::SkeletonDraw);
         m_skeletonRenderer.Render();
-        m_pointCloudRenderer.Render(viewport.width, viewport.height);
+        m_renderTimer.End(RenderSection::SkeletonDraw);
+
+        m_renderTimer.Begin(RenderSection::PointCloudDraw);
+        m_pointCloudRenderer.Render(viewportWidth, viewportHeight);
+        m_renderTimer.End(RenderSection::PointCloudDraw);
     }
+}
 
+void WindowController3d::RenderCameraPivotPoint()
+{
     // Render Camera Pivot Point when interacting with the view control.
 
-    const bool ctrl = glfwGetKey(m_window, GLFW_KEY_LEFT_CONTROL);
+    const bool ctrl = m_window != nullptr && glfwGetKey(m_window, GLFW_KEY_LEFT_CONTROL);
     if (m_cameraPivotPointRenderCount > 0 || m_mouseButtonLeftPressed || m_mouseButtonRightPressed || ctrl)
     {
         m_cameraPivotPointRenderCount = std::max(0, m_cameraPivotPointRenderCount - 1);
@@ -293,6 +574,7 @@ void WindowController3d::RenderScene(ViewControl& viewControl, Viewport viewport
         m_viewControl.GetTargetPosition(targetPos);
         // Render Camera Pivot Point the shape of a joint, but red.
         vec4 red = { 1.0f, 0.0f, 0.0f, 1.0f };
+        RenderTimer::Scope timerScope(m_renderTimer, RenderSection::SkeletonDraw);
         m_skeletonRenderer.RenderJoint(targetPos, red);
     }
 }
@@ -303,15 +585,11 @@ void WindowController3d::TriggerCameraPivotPointRendering()
     m_cameraPivotPointRenderCount = 5;
 }
 
-void WindowController3d::Render(std::vector<uint8_t>* renderedPixelsBgr, int* pixelsWidth, int* pixelsHeight)
+void WindowController3d::RenderFrame()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    glfwMakeContextCurrent(m_window);
-
-    // Per-frame time logic
-    double currentFrame = glfwGetTime();
-    m_deltaTime = (float)(currentFrame - m_lastFrame);
+    // Per-frame time logic, also without GLFW
+    double currentFrame = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_deltaTime = m_lastFrame == 0. ? 0.f : (float)(currentFrame - m_lastFrame);
     m_lastFrame = currentFrame;
 
     // General Render clean up
@@ -329,18 +607,160 @@ void WindowController3d::Render(std::vector<uint8_t>* renderedPixelsBgr, int* pi
         RenderScene(m_viewControl, Viewport{0, 0, windowWidth, windowHeight});
         break;
     case Layout3d::FourViews:
-        RenderScene(m_leftViewControl, Viewport{0, 0, windowWidth / 2, windowHeight / 2});
-        RenderScene(m_rightViewControl, Viewport{windowWidth / 2, 0, windowWidth / 2, windowHeight / 2});
-        RenderScene(m_viewControl, Viewport{0, m_windowHeight / 2, windowWidth / 2, windowHeight / 2});
-        RenderScene(m_topViewControl, Viewport{windowWidth / 2, windowHeight / 2, windowWidth / 2, windowHeight / 2});
+    {
+        const std::array<ViewControl*, 4> viewControls = { &m_leftViewControl, &m_rightViewControl, &m_viewControl, &m_topViewControl };
+        const std::array<Viewport, 4> viewports = {
+            Viewport{0, 0, windowWidth / 2, windowHeight / 2},
+            Viewport{windowWidth / 2, 0, windowWidth / 2, windowHeight / 2},
+            Viewport{0, m_windowHeight / 2, windowWidth / 2, windowHeight / 2},
+            Viewport{windowWidth / 2, windowHeight / 2, windowWidth / 2, windowHeight / 2} };
+
+        if (m_enableMultiViewRendering && m_multiViewSupported)
+        {
+            RenderMultiViewScene(viewControls, viewports);
+        }
+        else
+        {
+            for (size_t i = 0; i < viewControls.size(); i++)
+            {
+                RenderScene(*viewControls[i], viewports[i]);
+            }
+        }
         break;
     }
+    }
+
+    if (m_renderStatisticsOverlay)
+    {
+        RenderStatisticsOverlay();
+    }
+}
+
+void WindowController3d::RenderStatisticsOverlay()
+{
+    // Colors of the sections in RenderSection order
+    static const std::array<std::array<float, 3>, (size_t)RenderSection::Count> sectionColors = { {
+        { 0.2f, 0.6f, 1.0f },   // PointCloudUpload
+        { 0.1f, 0.9f, 0.3f },   // PointCloudDraw
+        { 1.0f, 0.8f, 0.1f },   // SkeletonDraw
+        { 0.7f, 0.4f, 1.0f },   // FloorDraw
+        { 1.0f, 0.3f, 0.3f },   // Present
+    } };
+
+    const RenderStatistics statistics = m_renderTimer.GetStatistics();
+
+    // Rectangles are scissored clears, the overlay needs neither a program nor geometry.
+    // Half of the window width stands for two frames at 60 Hz.
+    const float frameBudgetMs = 1000.f / 60.f;
+    const float pixelsPerMs = (m_windowWidth / 2) / (2.f * frameBudgetMs);
+    const int barHeight = 8;
+    const int margin = 8;
+
+    auto fillRect = [](int x, int y, int width, int height, const std::array<float, 3>& color) {
+        if (width <= 0)
+        {
+            return;
+        }
+        glScissor(x, y, width, height);
+        glClearColor(color[0], color[1], color[2], 1.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    };
+
+    glViewport(0, 0, m_windowWidth, m_windowHeight);
+    glEnable(GL_SCISSOR_TEST);
+
+    // Rows from the top: frame time, CPU sections, GPU sections
+    int y = m_windowHeight - margin - barHeight;
+    fillRect(margin, y, (int)(statistics.FrameTime.P50 * pixelsPerMs), barHeight, { 0.6f, 0.6f, 0.6f });
+
+    for (int row = 0; row < 2; row++)
+    {
+        const auto& times = row == 0 ? statistics.CpuTime : statistics.GpuTime;
+        if (row == 1 && !statistics.GpuTimerAvailable)
+        {
+            break;
+        }
+
+        y -= barHeight + 2;
+        float x = (float)margin;
+        for (size_t section = 0; section < times.size(); section++)
+        {
+            const float width = times[section].P50 * pixelsPerMs;
+            fillRect((int)x, y, (int)std::ceil(width), barHeight, sectionColors[section]);
+            x += width;
+        }
+    }
+
+    // Marker of the frame budget across all rows
+    fillRect(margin + (int)(frameBudgetMs * pixelsPerMs), y, 1, m_windowHeight - margin - y, { 1.f, 1.f, 1.f });
+
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+}
+
+void WindowController3d::UpdateStatisticsTitle()
+{
+    if (m_window == nullptr || m_framebuffer != 0 || m_lastFrame - m_lastTitleUpdate < 0.5)
+    {
+        return;
+    }
+    m_lastTitleUpdate = m_lastFrame;
+
+    if (!m_renderStatisticsOverlay)
+    {
+        glfwSetWindowTitle(m_window, m_windowName.c_str());
+        return;
+    }
+
+    const RenderStatistics statistics = m_renderTimer.GetStatistics();
+    float cpuTime = 0.f;
+    float gpuTime = 0.f;
+    for (size_t section = 0; section < (size_t)RenderSection::Count; section++)
+    {
+        cpuTime += statistics.CpuTime[section].P50;
+        gpuTime += statistics.GpuTime[section].P50;
+    }
+
+    char title[256];
+    snprintf(title, sizeof(title), "%s | frame %.1f ms (p99 %.1f) | cpu %.1f ms | gpu %.1f ms",
+        m_windowName.c_str(), statistics.FrameTime.P50, statistics.FrameTime.P99, cpuTime, gpuTime);
+    glfwSetWindowTitle(m_window, title);
+}
+
+void WindowController3d::PresentFrame()
+{
+    // Offscreen frames stay in the framebuffer object. A hidden offscreen window has no events to poll, so offscreen
+    // controllers can render on any thread.
+    if (m_window != nullptr && m_framebuffer == 0)
+    {
+        RenderTimer::Scope timerScope(m_renderTimer, RenderSection::Present);
+        glfwSwapBuffers(m_window);
+        glfwPollEvents();
+    }
+
+    m_renderTimer.EndFrame(m_deltaTime);
+    UpdateStatisticsTitle();
+}
+
+void WindowController3d::Render(std::vector<uint8_t>* renderedPixelsBgr, int* pixelsWidth, int* pixelsHeight)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MakeContextCurrent();
+    RenderFrame();
+    m_frameIndex++;
+
+    const int windowWidth = m_windowWidth;
+    const int windowHeight = m_windowHeight;
 
     // Copy rendered pixels if needed
     if (renderedPixelsBgr != nullptr)
     {
         renderedPixelsBgr->resize(windowWidth * windowHeight * 3);
+        // Tightly packed rows, the default alignment of 4 would overrun the buffer for widths not divisible by 4
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
         glReadPixels(0, 0, windowWidth, windowHeight, GL_BGR, GL_UNSIGNED_BYTE, renderedPixelsBgr->data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
     }
     if (pixelsWidth != nullptr)
     {
@@ -351,8 +771,59 @@ void WindowController3d::Render(std::vector<uint8_t>* renderedPixelsBgr, int* pi
         *pixelsHeight = windowHeight;
     }
 
-    glfwSwapBuffers(m_window);
-    glfwPollEvents();
+    PresentFrame();
+}
+
+bool WindowController3d::RenderAsync(RenderedFrame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MakeContextCurrent();
+    if (!m_pixelReadback.IsCreated())
+    {
+        m_pixelReadback.Create(m_asyncReadbackDepth);
+    }
+
+    RenderFrame();
+
+    // Take the oldest frame first to free its slot, waiting only when every slot is in flight
+    const bool hasFrame = m_pixelReadback.Pop(frame, m_pixelReadback.IsFull());
+    m_pixelReadback.Queue(m_windowWidth, m_windowHeight, m_frameIndex++);
+
+    PresentFrame();
+    return hasFrame;
+}
+
+bool WindowController3d::FlushAsyncReadback(RenderedFrame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MakeContextCurrent();
+
+    // A dropped frame is skipped, the frames after it are still in flight
+    while (!m_pixelReadback.IsEmpty())
+    {
+        if (m_pixelReadback.Pop(frame, true))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t WindowController3d::GetDroppedReadbackCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_pixelReadback.GetDroppedCount();
+}
+
+void WindowController3d::SetAsyncReadbackDepth(int readbackDepth)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    CheckAssert(!m_pixelReadback.IsCreated(), "The async readback depth has to be set before the first RenderAsync");
+    m_asyncReadbackDepth = readbackDepth;
 }
 
 void WindowController3d::SetPointCloudShading(bool enableShading)
@@ -392,6 +863,11 @@ void WindowController3d::SetLayout3d(Layout3d layout3d)
     m_layout3d = layout3d;
 }
 
+void WindowController3d::SetMultiViewRendering(bool enableMultiViewRendering)
+{
+    m_enableMultiViewRendering = enableMultiViewRendering;
+}
+
 void WindowController3d::ChangePointCloudSize(std::optional<float> pointCloudSize)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -403,6 +879,7 @@ void WindowController3d::SetFloorRendering(bool enableFloorRendering, linmath::v
 {
     if (!m_enableFloorRendering && enableFloorRendering)
     {
+        MakeContextCurrent();
         m_floorRenderer.Create(m_window);
     }
     else if (m_enableFloorRendering && !enableFloorRendering)
@@ -417,6 +894,46 @@ void WindowController3d::SetFloorRendering(bool enableFloorRendering, linmath::v
     }
 }
 
+void WindowController3d::EnableRenderStatistics(bool enableRenderStatistics)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (enableRenderStatistics == m_renderTimer.IsCreated())
+    {
+        return;
+    }
+
+    MakeContextCurrent();
+    if (enableRenderStatistics)
+    {
+        m_renderTimer.Create();
+    }
+    else
+    {
+        m_renderTimer.Delete();
+        m_renderStatisticsOverlay = false;
+    }
+}
+
+RenderStatistics WindowController3d::GetRenderStatistics() const
+{
+    return m_renderTimer.GetStatistics();
+}
+
+bool WindowController3d::WriteRenderStatisticsCsv(const std::string& path) const
+{
+    return m_renderTimer.WriteCsv(path);
+}
+
+void WindowController3d::SetRenderStatisticsOverlay(bool enableOverlay)
+{
+    if (enableOverlay)
+    {
+        EnableRenderStatistics(true);
+    }
+    m_renderStatisticsOverlay = enableOverlay;
+}
+
 void WindowController3d::SetCloseCallback(CloseCallbackType callback, void* context)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -472,6 +989,17 @@ void WindowController3d::UpdateRenderersViewProjection(linmath::mat4x4 view, lin
     }
 }
 
+void WindowController3d::SetRenderersMultiView(bool multiView)
+{
+    m_pointCloudRenderer.SetMultiView(multiView);
+    m_skeletonRenderer.SetMultiView(multiView);
+
+    if (m_enableFloorRendering)
+    {
+        m_floorRenderer.SetMultiView(multiView);
+    }
+}
+
 void WindowController3d::MouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/)
 {
     // Keep track of mouse movement for camera rotation/translation when left button is pressed.
@@ -592,6 +1120,14 @@ void WindowController3d::KeyPressCallback(GLFWwindow* /*window*/, int key, int /
     case GLFW_KEY_F5:
         m_viewControl.SetViewPoint(ViewPoint::TopView);
         break;
+    case GLFW_KEY_F6:
+        // Called from glfwPollEvents within Render, which already holds the lock of EnableRenderStatistics
+        if (!m_renderTimer.IsCreated())
+        {
+            m_renderTimer.Create();
+        }
+        m_renderStatisticsOverlay = !m_renderStatisticsOverlay;
+        break;
     default:
         // If not handled, then pass along to external callback.
         if (m_keyCallback)
@@ -5,6 +5,7 @@
 
 #include <array>
 #include <mutex>
+#include <string>
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -15,6 +16,10 @@
 #include "PointCloudRenderer.h"
 #include "SkeletonRenderer.h"
 #include "FloorRenderer.h"
+#include "GlResourceManager.h"
+#include "OffscreenContext.h"
+#include "PixelReadback.h"
+#include "RenderTimer.h"
 
 namespace Visualization
 {
@@ -48,6 +53,10 @@ namespace Visualization
             int height = 576,
             bool fullscreen = false);
 
+        // Headless alternative to Create: renders into a framebuffer object of a context without any window, so it also
+        // works on machines without a display server. Falls back to a hidden window where EGL is not available.
+        void CreateOffscreen(int width = 640, int height = 576);
+
         void Delete();
 
         void SetWindowPosition(int xPos, int yPos);
@@ -59,6 +68,17 @@ namespace Visualization
             const float* depthXyTableInterleaved,
             int width, int height);
 
+        // Depth cameras of further sensors, rendered together with the one of InitializePointCloudRenderer (source 0)
+        // in one pass, see PointCloudRenderer::InitializeDepthXYTable. Sources are added in order up to
+        // PointCloudRenderer::MaxDepthSources. depthToWorld moves the points of the source into the world in meters.
+        void InitializeDepthSource(
+            uint32_t source,
+            const float* depthXyTableInterleaved,
+            int width, int height,
+            const linmath::mat4x4 depthToWorld);
+
+        void SetDepthSourceTransform(uint32_t source, const linmath::mat4x4 depthToWorld);
+
         void UpdatePointClouds(
             const Visualization::PointCloudVertex* point3d,
             uint32_t numPoints,
@@ -66,17 +86,62 @@ namespace Visualization
             uint32_t width, uint32_t height,
             bool useTestPointClouds = false);
 
+        // Generate the point cloud on the GPU from the depth frame, needs the DepthXY table of InitializePointCloudRenderer
+        void UpdatePointCloudsFromDepth(
+            const uint16_t* depthFrame,
+            uint32_t width, uint32_t height,
+            uint32_t source = 0);
+
+        // Zero copy updates, write the frame or the vertices directly into GPU visible memory between Map and Unmap.
+        // Map returns nullptr when the GPU is behind; skip the update, the previous point cloud stays visible.
+        uint16_t* MapDepthFrame(uint32_t width, uint32_t height, uint32_t source = 0);
+        void UnmapDepthFrame(bool generatePointsFromDepth, uint32_t source = 0);
+
+        Visualization::PointCloudVertex* MapPointClouds(uint32_t maxNumPoints);
+        void UnmapPointClouds(uint32_t numPoints);
+
+        // Colors the points of bodies on the GPU, see PointCloudRenderer::UpdateBodyIndexMap. nullptr disables it.
+        void UpdateBodyIndexMap(
+            const uint8_t* bodyIndexMap,
+            uint32_t width, uint32_t height,
+            const linmath::vec4* bodyPalette,
+            uint32_t bodyPaletteSize,
+            uint32_t source = 0);
+
         void CleanJointsAndBones();
 
         void AddJoint(const Visualization::Joint& joint);
 
         void AddBone(const Visualization::Bone& bone);
 
+        // Bulk variants, one call per body instead of one per joint and bone
+        void AddJoints(const Visualization::Joint* joints, size_t jointCount);
+
+        void AddBones(const Visualization::Bone* bones, size_t boneCount);
+
         void Render(
             std::vector<uint8_t>* renderedPixelsBgr = nullptr,
             int* pixelsWidth = nullptr,
             int* pixelsHeight = nullptr);
 
+        // Render with asynchronous readback: the pixels of the frame are copied into a pixel pack buffer and returned
+        // by a later call, so rendering never waits for the readback. Returns true with the oldest finished frame,
+        // which is at most the async readback depth - 1 frames old. Only waits when all of them are still in flight.
+        bool RenderAsync(RenderedFrame& frame);
+
+        // Returns the frames still in flight after the last RenderAsync one per call, false when none is left
+        bool FlushAsyncReadback(RenderedFrame& frame);
+
+        // Frames of RenderAsync that were dropped because their pixels could not be read back. Neither RenderAsync
+        // nor FlushAsyncReadback return them, the caller compares the count before and after rendering.
+        uint64_t GetDroppedReadbackCount();
+
+        // Number of frames in flight of RenderAsync, set before its first call
+        void SetAsyncReadbackDepth(int readbackDepth);
+
+        // Makes the context not current on the calling thread, so that another thread can render with it
+        void ReleaseContext();
+
         void SetPointCloudShading(bool enableShading);
 
         void SetDefaultVerticalFOV(float degrees);
@@ -87,10 +152,29 @@ namespace Visualization
 
         void SetLayout3d(Layout3d layout3d);
 
+        // Renders the four views of Layout3d::FourViews in one pass: every object is drawn once and a geometry shader
+        // sends it to all viewports of a viewport array. On by default, ignored where the GL has no viewport arrays,
+        // the views are rendered one after another then.
+        void SetMultiViewRendering(bool enableMultiViewRendering);
+
         void ChangePointCloudSize(std::optional<float> pointCloudSize);
 
         void SetFloorRendering(bool enableFloorRendering, linmath::vec3 floorPosition, linmath::quaternion floorOrientation);
 
+        // CPU and GPU time of the uploads, draws and presentation of the last frames, see RenderTimer. Disabled
+        // statistics cost nothing, enabling creates the timer queries in the context.
+        void EnableRenderStatistics(bool enableRenderStatistics);
+
+        // Can be called from any thread
+        RenderStatistics GetRenderStatistics() const;
+
+        // Frame times of the statistics history, one row per frame
+        bool WriteRenderStatisticsCsv(const std::string& path) const;
+
+        // Bars of the median section times in the upper-left corner, also shown in the window title. Enables the
+        // statistics, F6 toggles the overlay as well.
+        void SetRenderStatisticsOverlay(bool enableOverlay);
+
         // Methods to set external callback functions
         void SetCloseCallback(CloseCallbackType callback, void* context);
 
@@ -105,12 +189,22 @@ namespace Visualization
         void WindowCloseCallback(GLFWwindow* window);
 
     private:
+        void MakeContextCurrent();
+        void CreateFramebuffer();
+        void RenderFrame();
+        void PresentFrame();
         void RenderScene(ViewControl& viewControl, Viewport viewport);
+        void RenderMultiViewScene(const std::array<ViewControl*, 4>& viewControls, const std::array<Viewport, 4>& viewports);
+        void RenderObjects(int viewportWidth, int viewportHeight);
+        void RenderCameraPivotPoint();
+        void RenderStatisticsOverlay();
+        void UpdateStatisticsTitle();
         void TriggerCameraPivotPointRendering();
         void ChangeCameraPivotPoint(ViewControl& viewControl, linmath::vec2 screenPos);
         void GetCursorPosInScreenCoordinates(GLFWwindow* window, linmath::vec2 outScreenPos);
         void GetCursorPosInScreenCoordinates(double cursorPosX, double cursorPosY, linmath::vec2 outScreenPos);
         void UpdateRenderersViewProjection(linmath::mat4x4 view, linmath::mat4x4 projection);
+        void SetRenderersMultiView(bool multiView);
 
         bool m_initialized = false;
 
@@ -118,6 +212,7 @@ namespace Visualization
         Layout3d m_layout3d = Layout3d::OnlyMainView;
         SkeletonRenderMode m_skeletonRenderMode = SkeletonRenderMode::DefaultRender;
         bool m_enableFloorRendering = false;
+        bool m_enableMultiViewRendering = true;
 
         // View Controls
         ViewControl m_viewControl;
@@ -135,12 +230,37 @@ namespace Visualization
         double m_lastFrame = 0.;
         float m_deltaTime = 0.f;
 
+        // Render statistics
+        RenderTimer m_renderTimer;
+        bool m_renderStatisticsOverlay = false;
+        double m_lastTitleUpdate = 0.;
+
         // Window information
         int m_windowWidth = 640;
         int m_windowHeight = 576;
 
         // OpenGL resources
         GLFWwindow* m_window = nullptr;
+        std::string m_windowName;
+
+        // Programs and geometry of the renderers, shared by all windows or private to an offscreen controller
+        GlResourceManager* m_resources = nullptr;
+        GlResourceManager m_privateResources;
+
+        // Offscreen rendering, m_offscreenContext is only created when there is no window
+        OffscreenContext m_offscreenContext;
+        GLuint m_framebuffer = 0;
+        GLuint m_colorRenderbuffer = 0;
+        GLuint m_depthRenderbuffer = 0;
+
+        // Multi view rendering, the view projections of the viewports are in a uniform buffer at binding 0
+        bool m_multiViewSupported = false;
+        GLuint m_multiViewUniformBuffer = 0;
+
+        // Asynchronous readback
+        PixelReadback m_pixelReadback;
+        int m_asyncReadbackDepth = 3;
+        uint64_t m_frameIndex = 0;
 
         // Input status
         bool m_mouseButtonLeftPressed = false;
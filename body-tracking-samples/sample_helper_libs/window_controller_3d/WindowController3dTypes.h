@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 #include "linmath.h"
 
 namespace Visualization
@@ -27,6 +31,13 @@ namespace Visualization
         linmath::vec4 Color;
     };
 
+    // Per instance attributes of an instanced shape
+    struct ObjectInstance
+    {
+        linmath::mat4x4 Model;
+        linmath::vec4 Color;            // Ignored by shapes with per vertex colors
+    };
+
     struct Joint
     {
         linmath::vec3 Position;          // The position of the joint specified in meters
@@ -40,4 +51,44 @@ namespace Visualization
         linmath::vec3 Joint2Position;
         linmath::vec4 Color;
     };
+
+    // Rendered pixels returned by the asynchronous readback, bottom-up rows like glReadPixels
+    struct RenderedFrame
+    {
+        std::vector<uint8_t> PixelsBgr;
+        int Width = 0;
+        int Height = 0;
+        uint64_t FrameIndex = 0;        // Counts the rendered frames, tells which frame the pixels belong to
+    };
+
+    // Parts of a frame that are timed by the render statistics
+    enum class RenderSection
+    {
+        PointCloudUpload = 0,   // Depth frame and vertex uploads since the previous frame
+        PointCloudDraw,
+        SkeletonDraw,
+        FloorDraw,
+        Present,                // Swap and event polling, includes waiting for vsync
+        Count
+    };
+
+    // Rolling statistics of one timed series in milliseconds
+    struct TimingStatistics
+    {
+        float Mean = 0.f;
+        float P50 = 0.f;
+        float P90 = 0.f;
+        float P99 = 0.f;
+        float Max = 0.f;
+    };
+
+    // Statistics over the last frames of the render statistics window, GPU times are only valid with GpuTimerAvailable
+    struct RenderStatistics
+    {
+        uint32_t FrameCount = 0;        // Frames the statistics are computed from
+        bool GpuTimerAvailable = false;
+        TimingStatistics FrameTime;     // CPU time from one rendered frame to the next
+        std::array<TimingStatistics, (size_t)RenderSection::Count> CpuTime;
+        std::array<TimingStatistics, (size_t)RenderSection::Count> GpuTime;
+    };
 }
@@ -0,0 +1,583 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "CaptureContainer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char ContainerMagic[8] = { 'K', '4', 'A', 'C', 'A', 'P', 0, 0 };
+
+static std::string GetChunkPath(const std::string& path, size_t chunk)
+{
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".chunk%03zu", chunk);
+    return path + suffix;
+}
+
+/**************************************** Chunk file ****************************************/
+
+// Preallocated file that supports positional writes from several threads
+class CaptureContainerWriter::ChunkFile
+{
+public:
+    ~ChunkFile()
+    {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool Create(const std::string& path, uint64_t size)
+    {
+        m_handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_handle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        return Truncate(size);
+    }
+
+    bool WriteAt(uint64_t offset, const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD toWrite = (DWORD)std::min<size_t>(size, 1u << 30);
+            DWORD written = 0;
+            if (!WriteFile(m_handle, data, toWrite, &written, &overlapped) || written == 0)
+            {
+                return false;
+            }
+            offset += written;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool Truncate(uint64_t size)
+    {
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)size;
+        return SetFilePointerEx(m_handle, position, nullptr, FILE_BEGIN) && SetEndOfFile(m_handle);
+    }
+
+    void Close()
+    {
+        if (m_handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_handle);
+            m_handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+private:
+    HANDLE m_handle = INVALID_HANDLE_VALUE;
+#else
+    bool Create(const std::string& path, uint64_t size)
+    {
+        m_fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+#ifdef __linux__
+        // Reserve the blocks up front so the chunk is not fragmented while it fills up
+        if (posix_fallocate(m_fd, 0, (off_t)size) == 0)
+        {
+            return true;
+        }
+#endif
+        return Truncate(size);
+    }
+
+    bool WriteAt(uint64_t offset, const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t written = pwrite(m_fd, data, size, (off_t)offset);
+            if (written <= 0)
+            {
+                return false;
+            }
+            offset += (uint64_t)written;
+            data += written;
+            size -= (size_t)written;
+        }
+        return true;
+    }
+
+    bool Truncate(uint64_t size)
+    {
+        return ftruncate(m_fd, (off_t)size) == 0;
+    }
+
+    void Close()
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+private:
+    int m_fd = -1;
+#endif
+};
+
+/**************************************** Mapped file ****************************************/
+
+// Read-only memory mapping of a whole file
+class CaptureContainerReader::MappedFile
+{
+public:
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    const uint8_t* GetData() const { return m_data; }
+    uint64_t GetSize() const { return m_size; }
+
+#ifdef _WIN32
+    bool Open(const std::string& path)
+    {
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+        {
+            return false;
+        }
+        m_size = (uint64_t)size.QuadPart;
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr)
+        {
+            return false;
+        }
+        m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        return m_data != nullptr;
+    }
+
+    void Close()
+    {
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+        m_size = 0;
+    }
+
+private:
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    bool Open(const std::string& path)
+    {
+        m_fd = open(path.c_str(), O_RDONLY);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStatus;
+        if (fstat(m_fd, &fileStatus) != 0)
+        {
+            return false;
+        }
+        m_size = (uint64_t)fileStatus.st_size;
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        void* data = mmap(nullptr, (size_t)m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+        m_data = (const uint8_t*)data;
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_data != nullptr)
+        {
+            munmap((void*)m_data, (size_t)m_size);
+            m_data = nullptr;
+        }
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+        m_size = 0;
+    }
+
+private:
+    int m_fd = -1;
+#endif
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+};
+
+/**************************************** Writer ****************************************/
+
+CaptureContainerWriter::CaptureContainerWriter() = default;
+
+CaptureContainerWriter::~CaptureContainerWriter()
+{
+    Close();
+}
+
+bool CaptureContainerWriter::Open(const std::string& path, const std::vector<k4a_calibration_t>& calibrations, uint64_t chunkSize)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_indexFile != nullptr || calibrations.empty() || chunkSize == 0)
+    {
+        return false;
+    }
+
+    m_path = path;
+    m_chunkSize = chunkSize;
+    m_chunkUsed = 0;
+    m_bytesWritten = 0;
+    m_failed = false;
+
+    m_indexFile = fopen((path + ".index").c_str(), "wb");
+    if (m_indexFile == nullptr)
+    {
+        std::cout << "Cannot create container index " << path << ".index" << std::endl;
+        return false;
+    }
+
+    ContainerIndexHeader header = {};
+    memcpy(header.Magic, ContainerMagic, sizeof(header.Magic));
+    header.Version = ContainerVersion;
+    header.DeviceCount = (uint32_t)calibrations.size();
+    header.ChunkSize = chunkSize;
+    header.EntrySize = sizeof(ContainerIndexEntry);
+    header.CalibrationSize = sizeof(k4a_calibration_t);
+    if (fwrite(&header, sizeof(header), 1, m_indexFile) != 1 ||
+        fwrite(calibrations.data(), sizeof(k4a_calibration_t), calibrations.size(), m_indexFile) != calibrations.size() ||
+        fflush(m_indexFile) != 0)
+    {
+        std::cout << "Cannot write the header of container index " << path << ".index" << std::endl;
+        fclose(m_indexFile);
+        m_indexFile = nullptr;
+        return false;
+    }
+
+    auto chunk = std::make_unique<ChunkFile>();
+    if (!chunk->Create(GetChunkPath(path, 0), chunkSize))
+    {
+        std::cout << "Cannot create container chunk " << GetChunkPath(path, 0) << std::endl;
+        fclose(m_indexFile);
+        m_indexFile = nullptr;
+        return false;
+    }
+    m_chunks.push_back(std::move(chunk));
+    return true;
+}
+
+bool CaptureContainerWriter::AppendImage(uint64_t groupId, size_t deviceSlot, const k4a_image_t image)
+{
+    ContainerPayloadType type;
+    switch (k4a_image_get_format(image))
+    {
+    case K4A_IMAGE_FORMAT_DEPTH16: type = ContainerPayloadType::Depth16; break;
+    case K4A_IMAGE_FORMAT_COLOR_BGRA32: type = ContainerPayloadType::Bgra32; break;
+    case K4A_IMAGE_FORMAT_COLOR_MJPG: type = ContainerPayloadType::Mjpg; break;
+    default: return false;
+    }
+
+    return Append(groupId,
+        deviceSlot,
+        k4a_image_get_device_timestamp_usec(image),
+        type,
+        k4a_image_get_width_pixels(image),
+        k4a_image_get_height_pixels(image),
+        k4a_image_get_stride_bytes(image),
+        k4a_image_get_buffer(image),
+        k4a_image_get_size(image));
+}
+
+bool CaptureContainerWriter::Append(uint64_t groupId,
+    size_t deviceSlot,
+    uint64_t deviceTimestampUsec,
+    ContainerPayloadType type,
+    int width,
+    int height,
+    int strideBytes,
+    const uint8_t* data,
+    size_t size)
+{
+    if (size > m_chunkSize || size > std::numeric_limits<uint32_t>::max())
+    {
+        return false;
+    }
+
+    ContainerIndexEntry entry = {};
+    entry.GroupId = groupId;
+    entry.DeviceTimestampUsec = deviceTimestampUsec;
+    entry.Size = (uint32_t)size;
+    entry.StrideBytes = (uint32_t)strideBytes;
+    entry.Width = (uint16_t)width;
+    entry.Height = (uint16_t)height;
+    entry.DeviceSlot = (uint8_t)deviceSlot;
+    entry.PayloadType = (uint8_t)type;
+
+    // Reserve the space, the payload itself is written without holding the lock
+    ChunkFile* chunk = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_indexFile == nullptr)
+        {
+            return false;
+        }
+
+        if (m_chunkUsed + size > m_chunkSize)
+        {
+            // Earlier chunks stay open until Close() because other threads may still be writing into them
+            auto nextChunk = std::make_unique<ChunkFile>();
+            if (!nextChunk->Create(GetChunkPath(m_path, m_chunks.size()), m_chunkSize))
+            {
+                std::cout << "Cannot create container chunk " << GetChunkPath(m_path, m_chunks.size()) << std::endl;
+                m_failed = true;
+                return false;
+            }
+            m_chunks.back()->Truncate(m_chunkUsed);
+            m_chunks.push_back(std::move(nextChunk));
+            m_chunkUsed = 0;
+        }
+
+        chunk = m_chunks.back().get();
+        entry.Chunk = (uint16_t)(m_chunks.size() - 1);
+        entry.Offset = m_chunkUsed;
+        m_chunkUsed += size;
+        m_bytesWritten += size;
+    }
+
+    bool succeeded = chunk->WriteAt(entry.Offset, data, size);
+
+    // The entry is only published once its payload is on disk
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!succeeded || fwrite(&entry, sizeof(entry), 1, m_indexFile) != 1)
+    {
+        m_failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool CaptureContainerWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_indexFile == nullptr)
+    {
+        return false;
+    }
+
+    if (!m_chunks.empty() && !m_chunks.back()->Truncate(m_chunkUsed))
+    {
+        m_failed = true;
+    }
+    m_chunks.clear();
+
+    if (fclose(m_indexFile) != 0)
+    {
+        m_failed = true;
+    }
+    m_indexFile = nullptr;
+
+    if (m_failed)
+    {
+        std::cout << "Writing the container " << m_path << " failed" << std::endl;
+    }
+    return !m_failed;
+}
+
+uint64_t CaptureContainerWriter::GetBytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytesWritten;
+}
+
+/**************************************** Reader ****************************************/
+
+CaptureContainerReader::CaptureContainerReader() = default;
+
+CaptureContainerReader::~CaptureContainerReader()
+{
+    Close();
+}
+
+bool CaptureContainerReader::Open(const std::string& path)
+{
+    Close();
+
+    m_index = std::make_unique<MappedFile>();
+    if (!m_index->Open(path + ".index") || m_index->GetSize() < sizeof(ContainerIndexHeader))
+    {
+        std::cout << "Cannot open container index " << path << ".index" << std::endl;
+        Close();
+        return false;
+    }
+
+    ContainerIndexHeader header;
+    memcpy(&header, m_index->GetData(), sizeof(header));
+    const uint64_t entriesOffset = sizeof(header) + (uint64_t)header.DeviceCount * header.CalibrationSize;
+    if (memcmp(header.Magic, ContainerMagic, sizeof(header.Magic)) != 0 ||
+        header.Version != ContainerVersion ||
+        header.EntrySize != sizeof(ContainerIndexEntry) ||
+        header.CalibrationSize != sizeof(k4a_calibration_t) ||
+        entriesOffset > m_index->GetSize())
+    {
+        std::cout << "Unsupported container index " << path << ".index" << std::endl;
+        Close();
+        return false;
+    }
+
+    m_calibrations.resize(header.DeviceCount);
+    memcpy(m_calibrations.data(), m_index->GetData() + sizeof(header), header.DeviceCount * sizeof(k4a_calibration_t));
+
+    // A writer that did not finish may leave a partial entry at the end, it is ignored
+    m_entries = (const ContainerIndexEntry*)(m_index->GetData() + entriesOffset);
+    m_entryCount = (size_t)((m_index->GetSize() - entriesOffset) / sizeof(ContainerIndexEntry));
+
+    uint16_t chunkCount = 0;
+    m_firstGroupId = m_entryCount > 0 ? std::numeric_limits<uint64_t>::max() : 0;
+    m_endGroupId = 0;
+    for (size_t i = 0; i < m_entryCount; i++)
+    {
+        const ContainerIndexEntry& entry = m_entries[i];
+        if (entry.DeviceSlot >= header.DeviceCount || entry.PayloadType >= (uint8_t)ContainerPayloadType::Count)
+        {
+            std::cout << "Corrupted entry " << i << " in container index " << path << ".index" << std::endl;
+            Close();
+            return false;
+        }
+        chunkCount = entry.Chunk + 1 > chunkCount ? (uint16_t)(entry.Chunk + 1) : chunkCount;
+        m_firstGroupId = entry.GroupId < m_firstGroupId ? entry.GroupId : m_firstGroupId;
+        m_endGroupId = entry.GroupId + 1 > m_endGroupId ? entry.GroupId + 1 : m_endGroupId;
+    }
+
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        m_chunks.push_back(std::make_unique<MappedFile>());
+        if (!m_chunks.back()->Open(GetChunkPath(path, chunk)))
+        {
+            std::cout << "Cannot open container chunk " << GetChunkPath(path, chunk) << std::endl;
+            Close();
+            return false;
+        }
+    }
+
+    // Sorted (group, device, payload type) -> entry index, entries are written in completion order. Triggered sessions
+    // have long gaps between their group ids, the table only has a row per entry.
+    m_lookup.resize(m_entryCount);
+    for (size_t i = 0; i < m_entryCount; i++)
+    {
+        const ContainerIndexEntry& entry = m_entries[i];
+        if (entry.Offset + entry.Size > m_chunks[entry.Chunk]->GetSize())
+        {
+            std::cout << "Entry " << i << " points outside of its chunk in container " << path << std::endl;
+            Close();
+            return false;
+        }
+
+        m_lookup[i].GroupId = entry.GroupId;
+        m_lookup[i].Slot = GetLookupSlot(entry.DeviceSlot, (ContainerPayloadType)entry.PayloadType);
+        m_lookup[i].Index = (uint32_t)i;
+    }
+
+    // A payload that was written twice resolves to the last entry, like it did while the entries were appended
+    std::sort(m_lookup.begin(), m_lookup.end(), [](const LookupEntry& a, const LookupEntry& b) {
+        return a.GroupId != b.GroupId ? a.GroupId < b.GroupId : a.Slot != b.Slot ? a.Slot < b.Slot : a.Index < b.Index;
+    });
+    return true;
+}
+
+void CaptureContainerReader::Close()
+{
+    m_lookup.clear();
+    m_chunks.clear();
+    m_calibrations.clear();
+    m_entries = nullptr;
+    m_entryCount = 0;
+    m_firstGroupId = 0;
+    m_endGroupId = 0;
+    m_index.reset();
+}
+
+const ContainerIndexEntry* CaptureContainerReader::FindEntry(uint64_t groupId, size_t deviceSlot, ContainerPayloadType type) const
+{
+    if (groupId < m_firstGroupId || groupId >= m_endGroupId || deviceSlot >= m_calibrations.size())
+    {
+        return nullptr;
+    }
+
+    // Last lookup entry of the (group, slot) range
+    const uint32_t slot = GetLookupSlot(deviceSlot, type);
+    auto next = std::upper_bound(m_lookup.begin(), m_lookup.end(), std::make_pair(groupId, slot),
+        [](const std::pair<uint64_t, uint32_t>& key, const LookupEntry& entry) {
+            return key.first != entry.GroupId ? key.first < entry.GroupId : key.second < entry.Slot;
+        });
+    if (next == m_lookup.begin())
+    {
+        return nullptr;
+    }
+
+    const LookupEntry& found = *(next - 1);
+    return found.GroupId == groupId && found.Slot == slot ? &m_entries[found.Index] : nullptr;
+}
+
+uint32_t CaptureContainerReader::GetLookupSlot(size_t deviceSlot, ContainerPayloadType type)
+{
+    return (uint32_t)(deviceSlot * (size_t)ContainerPayloadType::Count + (size_t)type);
+}
+
+const uint8_t* CaptureContainerReader::GetPayload(const ContainerIndexEntry& entry) const
+{
+    return m_chunks[entry.Chunk]->GetData() + entry.Offset;
+}
@@ -0,0 +1,150 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+// Session container: the image payloads of all devices are appended to large preallocated chunk files
+// (<path>.chunk000, <path>.chunk001, ...) and every payload gets a fixed size entry in <path>.index. The index
+// starts with a ContainerIndexHeader followed by the raw k4a_calibration_t of every device, the entries follow
+// until the end of the file. Payloads are stored back to back without per-record headers, so a reader can map the
+// chunks and hand out pointers into them.
+
+enum class ContainerPayloadType : uint16_t
+{
+    Depth16 = 0,        // Raw K4A_IMAGE_FORMAT_DEPTH16 rows
+    Bgra32,             // Raw K4A_IMAGE_FORMAT_COLOR_BGRA32 rows
+    Mjpg,               // K4A_IMAGE_FORMAT_COLOR_MJPG as delivered by the device
+    Depth16Codec,       // DEPTH16 compressed with DepthCodec, the header's ReferenceId is the group id of the reference
+    Count
+};
+
+#pragma pack(push, 1)
+struct ContainerIndexHeader
+{
+    char Magic[8];              // "K4ACAP\0\0"
+    uint32_t Version;
+    uint32_t DeviceCount;
+    uint64_t ChunkSize;
+    uint32_t EntrySize;
+    uint32_t CalibrationSize;   // sizeof(k4a_calibration_t) of the writer
+};
+
+struct ContainerIndexEntry
+{
+    uint64_t GroupId;
+    uint64_t DeviceTimestampUsec;
+    uint64_t Offset;            // Byte offset of the payload in its chunk
+    uint32_t Size;              // Payload size in bytes
+    uint32_t StrideBytes;
+    uint16_t Width;
+    uint16_t Height;
+    uint16_t Chunk;
+    uint8_t DeviceSlot;
+    uint8_t PayloadType;        // ContainerPayloadType
+};
+#pragma pack(pop)
+
+const uint32_t ContainerVersion = 1;
+
+// Thread-safe writer. Space is reserved under a lock and the payload is then written with a positional write
+// outside of it, so several encoder threads can append at the same time.
+class CaptureContainerWriter
+{
+public:
+    CaptureContainerWriter();
+    ~CaptureContainerWriter();
+
+    bool Open(const std::string& path, const std::vector<k4a_calibration_t>& calibrations, uint64_t chunkSize);
+
+    // Append the buffer of a k4a image. Images of a format without a container payload type are rejected.
+    bool AppendImage(uint64_t groupId, size_t deviceSlot, const k4a_image_t image);
+
+    bool Append(uint64_t groupId,
+        size_t deviceSlot,
+        uint64_t deviceTimestampUsec,
+        ContainerPayloadType type,
+        int width,
+        int height,
+        int strideBytes,
+        const uint8_t* data,
+        size_t size);
+
+    // Flush the index and trim the last chunk to the used size
+    bool Close();
+
+    uint64_t GetBytesWritten() const;
+
+private:
+    class ChunkFile;
+
+    std::string m_path;
+    uint64_t m_chunkSize = 0;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<ChunkFile>> m_chunks;
+    uint64_t m_chunkUsed = 0;
+    uint64_t m_bytesWritten = 0;
+    FILE* m_indexFile = nullptr;
+    bool m_failed = false;
+};
+
+// Read-only view of a container. The index and the chunks are memory mapped, payload pointers stay valid until
+// Close(). FindEntry() is a binary search in a sorted table built when the container is opened.
+class CaptureContainerReader
+{
+public:
+    CaptureContainerReader();
+    ~CaptureContainerReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    size_t GetDeviceCount() const { return m_calibrations.size(); }
+
+    const k4a_calibration_t& GetCalibration(size_t deviceSlot) const { return m_calibrations[deviceSlot]; }
+
+    size_t GetEntryCount() const { return m_entryCount; }
+
+    const ContainerIndexEntry& GetEntry(size_t index) const { return m_entries[index]; }
+
+    uint64_t GetFirstGroupId() const { return m_firstGroupId; }
+
+    // One past the largest group id in the container, groups in between may be missing
+    uint64_t GetEndGroupId() const { return m_endGroupId; }
+
+    // Returns nullptr when the group has no payload of this type for the device
+    const ContainerIndexEntry* FindEntry(uint64_t groupId, size_t deviceSlot, ContainerPayloadType type) const;
+
+    const uint8_t* GetPayload(const ContainerIndexEntry& entry) const;
+
+private:
+    class MappedFile;
+
+    std::unique_ptr<MappedFile> m_index;
+    std::vector<std::unique_ptr<MappedFile>> m_chunks;
+    std::vector<k4a_calibration_t> m_calibrations;
+
+    const ContainerIndexEntry* m_entries = nullptr;
+    size_t m_entryCount = 0;
+
+    struct LookupEntry
+    {
+        uint64_t GroupId;
+        uint32_t Slot;      // Device slot and payload type, see GetLookupSlot
+        uint32_t Index;     // Index of the entry in m_entries
+    };
+
+    static uint32_t GetLookupSlot(size_t deviceSlot, ContainerPayloadType type);
+
+    uint64_t m_firstGroupId = 0;
+    uint64_t m_endGroupId = 0;
+    std::vector<LookupEntry> m_lookup;
+};
@@ -0,0 +1,370 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "CaptureExport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <opencv2/opencv.hpp>
+
+#include "CaptureContainer.h"
+#include "DepthCodec.h"
+
+namespace
+{
+    // Delta frames reference a keyframe, which is never a delta frame itself, the limit only guards against
+    // corrupted files referencing each other
+    const int MaxReferenceDepth = 8;
+
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(path.string().c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool succeeded = fseek(file, 0, SEEK_END) == 0;
+        const long size = succeeded ? ftell(file) : -1;
+        succeeded = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+        if (succeeded)
+        {
+            data.resize((size_t)size);
+            succeeded = fread(data.data(), 1, data.size(), file) == data.size();
+        }
+        fclose(file);
+        return succeeded;
+    }
+
+    bool WriteFile(const std::string& path, const uint8_t* data, size_t size)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        const bool succeeded = fwrite(data, 1, size, file) == size;
+        return fclose(file) == 0 && succeeded;
+    }
+
+    // d<slot>_<time>_<usec>_g<group id>.k4dz as written by the FrameWriter
+    bool ParseDepthFileName(const std::filesystem::path& path, size_t& deviceSlot, uint64_t& groupId)
+    {
+        const std::string stem = path.stem().string();
+        const size_t slotEnd = stem.find('_');
+        const size_t groupStart = stem.rfind("_g");
+        if (path.extension() != ".k4dz" || stem.empty() || stem[0] != 'd' ||
+            slotEnd == std::string::npos || groupStart == std::string::npos || groupStart + 2 >= stem.size())
+        {
+            return false;
+        }
+
+        char* end = nullptr;
+        deviceSlot = (size_t)strtoull(stem.c_str() + 1, &end, 10);
+        if (end != stem.c_str() + slotEnd)
+        {
+            return false;
+        }
+        groupId = strtoull(stem.c_str() + groupStart + 2, &end, 10);
+        return end == stem.c_str() + stem.size();
+    }
+
+    class DepthFileDecoder
+    {
+    public:
+        // Decodes the tiles of a frame on all cores, offline there are no other encoder threads to share them with
+        DepthFileDecoder()
+            : m_codec(std::max(1u, std::thread::hardware_concurrency()))
+        {
+        }
+
+        bool Decode(const std::filesystem::path& path, std::vector<uint16_t>& depth, DepthCodecHeader& header, size_t& encodedSize)
+        {
+            return Decode(path, depth, header, encodedSize, 0);
+        }
+
+    private:
+        bool Decode(const std::filesystem::path& path,
+            std::vector<uint16_t>& depth,
+            DepthCodecHeader& header,
+            size_t& encodedSize,
+            int referenceDepth)
+        {
+            std::vector<uint8_t> data;
+            if (!ReadFile(path, data) || !DepthCodec::ReadHeader(data.data(), data.size(), header))
+            {
+                std::cout << "Cannot read the depth codec file " << path.string() << std::endl;
+                return false;
+            }
+            encodedSize = data.size();
+
+            const uint16_t* previous = nullptr;
+            if ((header.Flags & DepthCodecFlagTemporal) != 0)
+            {
+                previous = GetReference(path, header, referenceDepth);
+                if (previous == nullptr)
+                {
+                    std::cout << "Cannot decode the keyframe (group " << header.ReferenceId << ") of " << path.string() << std::endl;
+                    return false;
+                }
+            }
+
+            depth.resize((size_t)header.Width * header.Height);
+            if (!m_codec.Decode(data.data(), data.size(), previous, depth.data(), header.Width * (int)sizeof(uint16_t)))
+            {
+                std::cout << "Corrupted depth codec file " << path.string() << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // The deltas of a keyframe follow each other, the last decoded keyframe is kept
+        const uint16_t* GetReference(const std::filesystem::path& path, const DepthCodecHeader& header, int referenceDepth)
+        {
+            size_t deviceSlot = 0;
+            uint64_t groupId = 0;
+            if (referenceDepth >= MaxReferenceDepth || !ParseDepthFileName(path, deviceSlot, groupId))
+            {
+                return nullptr;
+            }
+
+            const std::filesystem::path* referencePath = FindFile(path.parent_path(), deviceSlot, header.ReferenceId);
+            if (referencePath == nullptr)
+            {
+                return nullptr;
+            }
+            if (m_referencePath == *referencePath)
+            {
+                return m_reference.data();
+            }
+
+            std::vector<uint16_t> reference;
+            DepthCodecHeader referenceHeader;
+            size_t encodedSize = 0;
+            if (!Decode(*referencePath, reference, referenceHeader, encodedSize, referenceDepth + 1) ||
+                referenceHeader.Width != header.Width ||
+                referenceHeader.Height != header.Height)
+            {
+                return nullptr;
+            }
+            m_reference = std::move(reference);
+            m_referencePath = *referencePath;
+            return m_reference.data();
+        }
+
+        // The files of a directory are listed once, by device slot and group id
+        const std::filesystem::path* FindFile(const std::filesystem::path& directory, size_t deviceSlot, uint64_t groupId)
+        {
+            const std::string key = directory.string();
+            auto files = m_directories.find(key);
+            if (files == m_directories.end())
+            {
+                files = m_directories.emplace(key, std::map<std::pair<size_t, uint64_t>, std::filesystem::path>()).first;
+                std::error_code error;
+                for (const auto& entry : std::filesystem::directory_iterator(directory.empty() ? "." : directory, error))
+                {
+                    size_t fileSlot = 0;
+                    uint64_t fileGroupId = 0;
+                    if (ParseDepthFileName(entry.path(), fileSlot, fileGroupId))
+                    {
+                        files->second[std::make_pair(fileSlot, fileGroupId)] = entry.path();
+                    }
+                }
+            }
+
+            auto file = files->second.find(std::make_pair(deviceSlot, groupId));
+            return file != files->second.end() ? &file->second : nullptr;
+        }
+
+        DepthCodec m_codec;
+        std::map<std::string, std::map<std::pair<size_t, uint64_t>, std::filesystem::path>> m_directories;
+        std::filesystem::path m_referencePath;
+        std::vector<uint16_t> m_reference;
+    };
+
+    class ContainerExporter
+    {
+    public:
+        ContainerExporter(const CaptureContainerReader& reader, const std::string& outputDirectory)
+            : m_reader(reader)
+            , m_outputDirectory(outputDirectory)
+            , m_codec(std::max(1u, std::thread::hardware_concurrency()))
+        {
+        }
+
+        bool Export(const ContainerIndexEntry& entry, CaptureExportStatistics& statistics)
+        {
+            const uint8_t* payload = m_reader.GetPayload(entry);
+            if (payload == nullptr)
+            {
+                return false;
+            }
+
+            switch ((ContainerPayloadType)entry.PayloadType)
+            {
+            case ContainerPayloadType::Depth16:
+                if (!cv::imwrite(GetOutputPath('d', entry, ".png"),
+                    cv::Mat(entry.Height, entry.Width, CV_16UC1, (void*)payload, entry.StrideBytes)))
+                {
+                    return false;
+                }
+                statistics.DepthFrames++;
+                statistics.DecodedBytes += entry.Size;
+                return true;
+            case ContainerPayloadType::Depth16Codec:
+            {
+                std::vector<uint16_t> depth;
+                if (!Decode(entry, depth, 0) ||
+                    !cv::imwrite(GetOutputPath('d', entry, ".png"), cv::Mat(entry.Height, entry.Width, CV_16UC1, depth.data())))
+                {
+                    return false;
+                }
+                statistics.DepthFrames++;
+                statistics.EncodedBytes += entry.Size;
+                statistics.DecodedBytes += depth.size() * sizeof(uint16_t);
+                return true;
+            }
+            case ContainerPayloadType::Bgra32:
+            case ContainerPayloadType::Mjpg:
+            {
+                // MJPG payloads are JPEG files already
+                const std::string outputPath = GetOutputPath('c', entry, ".jpg");
+                if ((ContainerPayloadType)entry.PayloadType == ContainerPayloadType::Mjpg ?
+                    !WriteFile(outputPath, payload, entry.Size) :
+                    !cv::imwrite(outputPath, cv::Mat(entry.Height, entry.Width, CV_8UC4, (void*)payload, entry.StrideBytes)))
+                {
+                    return false;
+                }
+                statistics.ColorFrames++;
+                return true;
+            }
+            default:
+                std::cout << "Unknown payload type " << (int)entry.PayloadType << " in group " << entry.GroupId << std::endl;
+                return false;
+            }
+        }
+
+    private:
+        std::string GetOutputPath(char prefix, const ContainerIndexEntry& entry, const char* extension) const
+        {
+            std::stringstream fileName;
+            fileName << prefix << (int)entry.DeviceSlot << "_" << entry.DeviceTimestampUsec << "_g" << entry.GroupId << extension;
+            return (std::filesystem::path(m_outputDirectory) / fileName.str()).string();
+        }
+
+        bool Decode(const ContainerIndexEntry& entry, std::vector<uint16_t>& depth, int referenceDepth)
+        {
+            const uint8_t* payload = m_reader.GetPayload(entry);
+            DepthCodecHeader header;
+            if (payload == nullptr || !DepthCodec::ReadHeader(payload, entry.Size, header))
+            {
+                return false;
+            }
+
+            const uint16_t* previous = nullptr;
+            if ((header.Flags & DepthCodecFlagTemporal) != 0)
+            {
+                previous = GetReference(entry, header, referenceDepth);
+                if (previous == nullptr)
+                {
+                    std::cout << "Cannot decode the keyframe (group " << header.ReferenceId << ") of group " << entry.GroupId
+                        << ", device " << (int)entry.DeviceSlot << std::endl;
+                    return false;
+                }
+            }
+
+            depth.resize((size_t)header.Width * header.Height);
+            return m_codec.Decode(payload, entry.Size, previous, depth.data(), header.Width * (int)sizeof(uint16_t));
+        }
+
+        // The keyframe is looked up in the index, the last decoded one is kept for the deltas that follow it
+        const uint16_t* GetReference(const ContainerIndexEntry& entry, const DepthCodecHeader& header, int referenceDepth)
+        {
+            const ContainerIndexEntry* reference = m_reader.FindEntry(header.ReferenceId, entry.DeviceSlot, ContainerPayloadType::Depth16Codec);
+            if (reference == nullptr || referenceDepth >= MaxReferenceDepth ||
+                reference->Width != entry.Width || reference->Height != entry.Height)
+            {
+                return nullptr;
+            }
+            if (reference == m_referenceEntry)
+            {
+                return m_reference.data();
+            }
+
+            if (!Decode(*reference, m_reference, referenceDepth + 1))
+            {
+                m_referenceEntry = nullptr;
+                return nullptr;
+            }
+            m_referenceEntry = reference;
+            return m_reference.data();
+        }
+
+        const CaptureContainerReader& m_reader;
+        std::string m_outputDirectory;
+        DepthCodec m_codec;
+        const ContainerIndexEntry* m_referenceEntry = nullptr;
+        std::vector<uint16_t> m_reference;
+    };
+}
+
+bool DecodeDepthFiles(const std::vector<std::string>& paths, CaptureExportStatistics& statistics)
+{
+    DepthFileDecoder decoder;
+    std::vector<uint16_t> depth;
+    for (const std::string& path : paths)
+    {
+        DepthCodecHeader header;
+        size_t encodedSize = 0;
+        std::filesystem::path outputPath(path);
+        outputPath.replace_extension(".png");
+        if (!decoder.Decode(path, depth, header, encodedSize) ||
+            !cv::imwrite(outputPath.string(), cv::Mat(header.Height, header.Width, CV_16UC1, depth.data())))
+        {
+            statistics.Failures++;
+            continue;
+        }
+
+        statistics.DepthFrames++;
+        statistics.EncodedBytes += encodedSize;
+        statistics.DecodedBytes += depth.size() * sizeof(uint16_t);
+    }
+    return statistics.Failures == 0;
+}
+
+bool ExportContainer(const std::string& containerPath, const std::string& outputDirectory, CaptureExportStatistics& statistics)
+{
+    CaptureContainerReader reader;
+    if (!reader.Open(containerPath))
+    {
+        std::cout << "Cannot open the container " << containerPath << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(outputDirectory, error);
+    if (error)
+    {
+        std::cout << "Cannot create the output directory " << outputDirectory << std::endl;
+        return false;
+    }
+
+    ContainerExporter exporter(reader, outputDirectory);
+    for (size_t i = 0; i < reader.GetEntryCount(); i++)
+    {
+        if (!exporter.Export(reader.GetEntry(i), statistics))
+        {
+            statistics.Failures++;
+        }
+    }
+    return statistics.Failures == 0;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CaptureExportStatistics
+{
+    uint64_t DepthFrames = 0;
+    uint64_t ColorFrames = 0;
+    uint64_t Failures = 0;
+    uint64_t EncodedBytes = 0;      // DepthCodec input of the decoded frames
+    uint64_t DecodedBytes = 0;
+};
+
+// Decodes the .k4dz files written by the FrameWriter into 16 bit PNG files next to them. A delta frame is decoded
+// with its keyframe, which is found in the same directory by the group id in its file name.
+bool DecodeDepthFiles(const std::vector<std::string>& paths, CaptureExportStatistics& statistics);
+
+// Writes the payloads of a session container as the loose files of the writing mode: depth as 16 bit PNG
+// (d<slot>_<usec>_g<group id>.png, compressed depth is decoded) and color as JPEG (c<slot>_<usec>_g<group id>.jpg).
+bool ExportContainer(const std::string& containerPath, const std::string& outputDirectory, CaptureExportStatistics& statistics);
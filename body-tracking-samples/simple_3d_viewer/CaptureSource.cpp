@@ -0,0 +1,637 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "CaptureSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std::chrono;
+
+CaptureSource::CaptureSource(const CaptureSourceConfig& config, const k4a_device_configuration_t& deviceConfig)
+    : m_config(config)
+    , m_deviceConfig(deviceConfig)
+{
+    m_deviceConfig.wired_sync_mode = config.SyncMode;
+    m_deviceConfig.subordinate_delay_off_master_usec =
+        config.SyncMode == K4A_WIRED_SYNC_MODE_SUBORDINATE ? config.SubordinateDelayOffMasterUsec : 0;
+}
+
+void GetDepthModeResolution(k4a_depth_mode_t depthMode, int& width, int& height)
+{
+    switch (depthMode)
+    {
+    case K4A_DEPTH_MODE_NFOV_2X2BINNED:
+        width = 320;
+        height = 288;
+        break;
+    case K4A_DEPTH_MODE_NFOV_UNBINNED:
+        width = 640;
+        height = 576;
+        break;
+    case K4A_DEPTH_MODE_WFOV_2X2BINNED:
+        width = 512;
+        height = 512;
+        break;
+    case K4A_DEPTH_MODE_WFOV_UNBINNED:
+    case K4A_DEPTH_MODE_PASSIVE_IR:
+        width = 1024;
+        height = 1024;
+        break;
+    default:
+        width = 0;
+        height = 0;
+        break;
+    }
+}
+
+void GetColorResolution(k4a_color_resolution_t colorResolution, int& width, int& height)
+{
+    switch (colorResolution)
+    {
+    case K4A_COLOR_RESOLUTION_720P:
+        width = 1280;
+        height = 720;
+        break;
+    case K4A_COLOR_RESOLUTION_1080P:
+        width = 1920;
+        height = 1080;
+        break;
+    case K4A_COLOR_RESOLUTION_1440P:
+        width = 2560;
+        height = 1440;
+        break;
+    case K4A_COLOR_RESOLUTION_1536P:
+        width = 2048;
+        height = 1536;
+        break;
+    case K4A_COLOR_RESOLUTION_2160P:
+        width = 3840;
+        height = 2160;
+        break;
+    case K4A_COLOR_RESOLUTION_3072P:
+        width = 4096;
+        height = 3072;
+        break;
+    default:
+        width = 0;
+        height = 0;
+        break;
+    }
+}
+
+microseconds GetFramePeriod(k4a_fps_t fps)
+{
+    switch (fps)
+    {
+    case K4A_FRAMES_PER_SECOND_5:
+        return microseconds(200000);
+    case K4A_FRAMES_PER_SECOND_15:
+        return microseconds(66667);
+    case K4A_FRAMES_PER_SECOND_30:
+    default:
+        return microseconds(33333);
+    }
+}
+
+/******************************************************************************************************/
+/************************************** Live device capture source ************************************/
+/******************************************************************************************************/
+
+class DeviceCaptureSource : public CaptureSource
+{
+public:
+    DeviceCaptureSource(const CaptureSourceConfig& config, const k4a_device_configuration_t& deviceConfig)
+        : CaptureSource(config, deviceConfig)
+    {
+        std::stringstream ss;
+        ss << "device" << config.DeviceIndex;
+        m_name = ss.str();
+    }
+
+    ~DeviceCaptureSource()
+    {
+        Close();
+    }
+
+    bool Open() override
+    {
+        if (K4A_RESULT_SUCCEEDED != k4a_device_open(m_config.DeviceIndex, &m_device))
+        {
+            std::cout << "Failed to open " << m_name << std::endl;
+            return false;
+        }
+
+        if (K4A_RESULT_SUCCEEDED != k4a_device_get_calibration(m_device, m_deviceConfig.depth_mode, m_deviceConfig.color_resolution, &m_calibration))
+        {
+            std::cout << "Failed to get calibration of " << m_name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Start() override
+    {
+        if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(m_device, &m_deviceConfig))
+        {
+            std::cout << "Failed to start cameras of " << m_name << std::endl;
+            return false;
+        }
+        m_started = true;
+        return true;
+    }
+
+    void Stop() override
+    {
+        if (m_started)
+        {
+            k4a_device_stop_cameras(m_device);
+            m_started = false;
+        }
+    }
+
+    void Close() override
+    {
+        Stop();
+        if (m_device != nullptr)
+        {
+            k4a_device_close(m_device);
+            m_device = nullptr;
+        }
+    }
+
+    k4a_wait_result_t GetCapture(k4a_capture_t* capture, int32_t timeoutInMs) override
+    {
+        return k4a_device_get_capture(m_device, capture, timeoutInMs);
+    }
+
+private:
+    k4a_device_t m_device = nullptr;
+    bool m_started = false;
+};
+
+/******************************************************************************************************/
+/**************************************** Recording capture source ************************************/
+/******************************************************************************************************/
+
+class PlaybackCaptureSource : public CaptureSource
+{
+public:
+    PlaybackCaptureSource(const CaptureSourceConfig& config, const k4a_device_configuration_t& deviceConfig)
+        : CaptureSource(config, deviceConfig)
+    {
+        m_name = config.Path;
+    }
+
+    ~PlaybackCaptureSource()
+    {
+        Close();
+    }
+
+    bool Open() override
+    {
+        if (K4A_RESULT_SUCCEEDED != k4a_playback_open(m_config.Path.c_str(), &m_playback))
+        {
+            std::cout << "Failed to open recording " << m_name << std::endl;
+            return false;
+        }
+
+        if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(m_playback, &m_calibration))
+        {
+            std::cout << "Failed to get calibration of recording " << m_name << std::endl;
+            return false;
+        }
+
+        // The recording knows which role the device had when it was captured and how the cameras were configured
+        k4a_record_configuration_t recordConfig;
+        bool colorTrackEnabled = true;
+        if (K4A_RESULT_SUCCEEDED == k4a_playback_get_record_configuration(m_playback, &recordConfig))
+        {
+            m_config.SyncMode = recordConfig.wired_sync_mode;
+            m_config.SubordinateDelayOffMasterUsec = recordConfig.subordinate_delay_off_master_usec;
+            m_deviceConfig.depth_mode = recordConfig.depth_mode;
+            m_deviceConfig.color_resolution = recordConfig.color_resolution;
+            m_deviceConfig.camera_fps = recordConfig.camera_fps;
+            m_startTimestampOffsetUsec = recordConfig.start_timestamp_offset_usec;
+            colorTrackEnabled = recordConfig.color_track_enabled;
+        }
+
+        // The viewer and the writers expect BGRA color as delivered by the devices, recordings usually store MJPG
+        if (colorTrackEnabled &&
+            K4A_RESULT_SUCCEEDED != k4a_playback_set_color_conversion(m_playback, K4A_IMAGE_FORMAT_COLOR_BGRA32))
+        {
+            std::cout << "Failed to convert the color images of recording " << m_name << " to BGRA" << std::endl;
+            return false;
+        }
+        m_deviceConfig.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32;
+        return true;
+    }
+
+    bool Start() override
+    {
+        m_firstTimestamp = microseconds::zero();
+        m_loopOffsetUsec = 0;
+        m_lastTimestampUsec = 0;
+        return SeekToStart();
+    }
+
+    void Stop() override
+    {
+    }
+
+    void Close() override
+    {
+        if (m_playback != nullptr)
+        {
+            k4a_playback_close(m_playback);
+            m_playback = nullptr;
+        }
+    }
+
+    k4a_wait_result_t GetCapture(k4a_capture_t* capture, int32_t timeoutInMs) override
+    {
+        k4a_stream_result_t result = k4a_playback_get_next_capture(m_playback, capture);
+        if (result == K4A_STREAM_RESULT_SUCCEEDED && IsPastEndOffset(*capture))
+        {
+            k4a_capture_release(*capture);
+            *capture = nullptr;
+            result = K4A_STREAM_RESULT_EOF;
+        }
+        if (result == K4A_STREAM_RESULT_EOF && m_config.Loop)
+        {
+            SeekToStart();
+            result = k4a_playback_get_next_capture(m_playback, capture);
+
+            // Continue the timestamps one frame period after the last capture, so they keep increasing across
+            // loops. Synchronized recordings of the same slice get the same offset, which keeps the devices in sync.
+            uint64_t firstTimestampUsec = 0;
+            if (result == K4A_STREAM_RESULT_SUCCEEDED && GetFirstTimestampUsec(*capture, firstTimestampUsec))
+            {
+                const uint64_t framePeriodUsec = static_cast<uint64_t>(GetFramePeriod(m_deviceConfig.camera_fps).count());
+                m_loopOffsetUsec = m_lastTimestampUsec + framePeriodUsec - std::min(firstTimestampUsec, m_lastTimestampUsec);
+            }
+        }
+
+        if (result == K4A_STREAM_RESULT_EOF)
+        {
+            m_endOfStream = true;
+            return K4A_WAIT_RESULT_FAILED;
+        }
+        if (result != K4A_STREAM_RESULT_SUCCEEDED)
+        {
+            return K4A_WAIT_RESULT_FAILED;
+        }
+
+        OffsetTimestamps(*capture);
+        if (m_config.RealTime)
+        {
+            PaceCapture(*capture, timeoutInMs);
+        }
+        return K4A_WAIT_RESULT_SUCCEEDED;
+    }
+
+    bool IsEndOfStream() const override { return m_endOfStream; }
+
+    uint64_t GetDurationUsec() const override
+    {
+        return m_playback != nullptr ? k4a_playback_get_recording_length_usec(m_playback) : 0;
+    }
+
+private:
+    bool SeekToStart()
+    {
+        if (K4A_RESULT_SUCCEEDED != k4a_playback_seek_timestamp(m_playback, (int64_t)m_config.StartOffsetUsec, K4A_PLAYBACK_SEEK_BEGIN))
+        {
+            std::cout << "Failed to seek to " << m_config.StartOffsetUsec << " usec in recording " << m_name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Device timestamps of a recording start at the start timestamp offset, the slice is relative to it
+    bool IsPastEndOffset(k4a_capture_t capture) const
+    {
+        if (m_config.EndOffsetUsec == 0)
+        {
+            return false;
+        }
+
+        k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+        if (depthImage == nullptr)
+        {
+            return false;
+        }
+        const uint64_t timestampUsec = k4a_image_get_device_timestamp_usec(depthImage);
+        k4a_image_release(depthImage);
+
+        return timestampUsec >= m_startTimestampOffsetUsec + m_config.EndOffsetUsec;
+    }
+
+    // Earliest device timestamp of the images of a capture
+    static bool GetFirstTimestampUsec(k4a_capture_t capture, uint64_t& timestampUsec)
+    {
+        bool found = false;
+        for (k4a_image_t image : { k4a_capture_get_color_image(capture),
+                                   k4a_capture_get_depth_image(capture),
+                                   k4a_capture_get_ir_image(capture) })
+        {
+            if (image != nullptr)
+            {
+                const uint64_t imageTimestampUsec = k4a_image_get_device_timestamp_usec(image);
+                timestampUsec = found ? std::min(timestampUsec, imageTimestampUsec) : imageTimestampUsec;
+                found = true;
+                k4a_image_release(image);
+            }
+        }
+        return found;
+    }
+
+    // Add the offset of the current loop to the device timestamps of the images
+    void OffsetTimestamps(k4a_capture_t capture)
+    {
+        for (k4a_image_t image : { k4a_capture_get_color_image(capture),
+                                   k4a_capture_get_depth_image(capture),
+                                   k4a_capture_get_ir_image(capture) })
+        {
+            if (image != nullptr)
+            {
+                const uint64_t timestampUsec = k4a_image_get_device_timestamp_usec(image) + m_loopOffsetUsec;
+                if (m_loopOffsetUsec != 0)
+                {
+                    k4a_image_set_device_timestamp_usec(image, timestampUsec);
+                }
+                m_lastTimestampUsec = std::max(m_lastTimestampUsec, timestampUsec);
+                k4a_image_release(image);
+            }
+        }
+    }
+
+    // Sleep until the capture is due relative to the first capture of the recording
+    void PaceCapture(k4a_capture_t capture, int32_t timeoutInMs)
+    {
+        k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+        if (depthImage == nullptr)
+        {
+            return;
+        }
+        microseconds timestamp(k4a_image_get_device_timestamp_usec(depthImage));
+        k4a_image_release(depthImage);
+
+        if (m_firstTimestamp == microseconds::zero())
+        {
+            m_firstTimestamp = timestamp;
+            m_startTime = steady_clock::now();
+            return;
+        }
+
+        auto dueTime = m_startTime + (timestamp - m_firstTimestamp);
+        auto latestTime = steady_clock::now() + milliseconds(timeoutInMs);
+        std::this_thread::sleep_until(timeoutInMs < 0 ? dueTime : std::min(dueTime, latestTime));
+    }
+
+    k4a_playback_t m_playback = nullptr;
+    bool m_endOfStream = false;
+    uint64_t m_startTimestampOffsetUsec = 0;
+    uint64_t m_loopOffsetUsec = 0;          // Added to the device timestamps of the current loop
+    uint64_t m_lastTimestampUsec = 0;       // Latest device timestamp delivered, with the loop offset
+    microseconds m_firstTimestamp = microseconds::zero();
+    steady_clock::time_point m_startTime;
+};
+
+/******************************************************************************************************/
+/**************************************** Synthetic capture source ************************************/
+/******************************************************************************************************/
+
+class SyntheticCaptureSource : public CaptureSource
+{
+public:
+    SyntheticCaptureSource(const CaptureSourceConfig& config, const k4a_device_configuration_t& deviceConfig)
+        : CaptureSource(config, deviceConfig)
+    {
+        std::stringstream ss;
+        ss << "synthetic" << config.DeviceIndex;
+        m_name = ss.str();
+    }
+
+    bool Open() override
+    {
+        GetDepthModeResolution(m_deviceConfig.depth_mode, m_depthWidth, m_depthHeight);
+        GetColorResolution(m_deviceConfig.color_resolution, m_colorWidth, m_colorHeight);
+        if (m_depthWidth == 0)
+        {
+            std::cout << "Synthetic source " << m_name << " requires the depth camera to be enabled" << std::endl;
+            return false;
+        }
+
+        BuildCalibration();
+        return true;
+    }
+
+    bool Start() override
+    {
+        m_frameIndex = 0;
+        m_startTime = steady_clock::now();
+        return true;
+    }
+
+    void Stop() override
+    {
+    }
+
+    void Close() override
+    {
+    }
+
+    k4a_wait_result_t GetCapture(k4a_capture_t* capture, int32_t timeoutInMs) override
+    {
+        const microseconds framePeriod = GetFramePeriod(m_deviceConfig.camera_fps);
+        if (m_config.RealTime)
+        {
+            auto dueTime = m_startTime + framePeriod * (m_frameIndex + 1);
+            if (timeoutInMs >= 0 && dueTime > steady_clock::now() + milliseconds(timeoutInMs))
+            {
+                std::this_thread::sleep_for(milliseconds(timeoutInMs));
+                return K4A_WAIT_RESULT_TIMEOUT;
+            }
+            std::this_thread::sleep_until(dueTime);
+        }
+
+        // Subordinates expose their images subordinate_delay_off_master_usec after the master
+        uint64_t deviceTimestampUsec = static_cast<uint64_t>(framePeriod.count()) * m_frameIndex +
+            m_deviceConfig.subordinate_delay_off_master_usec + SyntheticStartTimestampUsec;
+        uint64_t systemTimestampNsec = static_cast<uint64_t>(
+            duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+
+        if (K4A_RESULT_SUCCEEDED != k4a_capture_create(capture))
+        {
+            return K4A_WAIT_RESULT_FAILED;
+        }
+
+        k4a_image_t depthImage = CreateDepthImage(deviceTimestampUsec, systemTimestampNsec);
+        if (depthImage == nullptr)
+        {
+            k4a_capture_release(*capture);
+            *capture = nullptr;
+            return K4A_WAIT_RESULT_FAILED;
+        }
+        k4a_capture_set_depth_image(*capture, depthImage);
+        k4a_image_release(depthImage);
+
+        if (m_colorWidth > 0)
+        {
+            int64_t colorTimestampUsec = static_cast<int64_t>(deviceTimestampUsec) - m_deviceConfig.depth_delay_off_color_usec;
+            k4a_image_t colorImage = CreateColorImage(static_cast<uint64_t>(colorTimestampUsec), systemTimestampNsec);
+            if (colorImage != nullptr)
+            {
+                k4a_capture_set_color_image(*capture, colorImage);
+                k4a_image_release(colorImage);
+            }
+        }
+
+        m_frameIndex++;
+        return K4A_WAIT_RESULT_SUCCEEDED;
+    }
+
+private:
+    // Build an undistorted calibration close enough to the real sensor for the transformation engine
+    void BuildCalibration()
+    {
+        const float Pi = 3.14159265f;
+        const bool wideFov = m_deviceConfig.depth_mode == K4A_DEPTH_MODE_WFOV_2X2BINNED ||
+                             m_deviceConfig.depth_mode == K4A_DEPTH_MODE_WFOV_UNBINNED;
+        const float depthHorizontalFov = wideFov ? 120.f : 75.f;
+        const float colorHorizontalFov = 90.f;
+
+        memset(&m_calibration, 0, sizeof(m_calibration));
+        m_calibration.depth_mode = m_deviceConfig.depth_mode;
+        m_calibration.color_resolution = m_deviceConfig.color_resolution;
+
+        FillCamera(m_calibration.depth_camera_calibration, m_depthWidth, m_depthHeight,
+            (m_depthWidth / 2.f) / tanf(depthHorizontalFov * Pi / 360.f));
+        FillCamera(m_calibration.color_camera_calibration, m_colorWidth, m_colorHeight,
+            (m_colorWidth / 2.f) / tanf(colorHorizontalFov * Pi / 360.f));
+
+        // The color camera sits 32mm next to the depth camera
+        for (int source = 0; source < K4A_CALIBRATION_TYPE_NUM; source++)
+        {
+            for (int target = 0; target < K4A_CALIBRATION_TYPE_NUM; target++)
+            {
+                k4a_calibration_extrinsics_t& extrinsics = m_calibration.extrinsics[source][target];
+                memset(&extrinsics, 0, sizeof(extrinsics));
+                extrinsics.rotation[0] = extrinsics.rotation[4] = extrinsics.rotation[8] = 1.f;
+            }
+        }
+        m_calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR].translation[0] = -32.f;
+        m_calibration.extrinsics[K4A_CALIBRATION_TYPE_COLOR][K4A_CALIBRATION_TYPE_DEPTH].translation[0] = 32.f;
+        m_calibration.depth_camera_calibration.extrinsics = m_calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_DEPTH];
+        m_calibration.color_camera_calibration.extrinsics = m_calibration.extrinsics[K4A_CALIBRATION_TYPE_COLOR][K4A_CALIBRATION_TYPE_DEPTH];
+    }
+
+    static void FillCamera(k4a_calibration_camera_t& camera, int width, int height, float focalLength)
+    {
+        camera.resolution_width = width;
+        camera.resolution_height = height;
+        camera.metric_radius = 1.7f;
+        camera.intrinsics.type = K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT;
+        camera.intrinsics.parameter_count = 14;
+        camera.intrinsics.parameters.param.cx = width / 2.f;
+        camera.intrinsics.parameters.param.cy = height / 2.f;
+        camera.intrinsics.parameters.param.fx = focalLength;
+        camera.intrinsics.parameters.param.fy = focalLength;
+        camera.intrinsics.parameters.param.metric_radius = 1.7f;
+    }
+
+    // A wall at 3m with a box at 1.5m that sweeps from left to right
+    k4a_image_t CreateDepthImage(uint64_t deviceTimestampUsec, uint64_t systemTimestampNsec)
+    {
+        k4a_image_t image = nullptr;
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16,
+            m_depthWidth,
+            m_depthHeight,
+            m_depthWidth * (int)sizeof(uint16_t),
+            &image))
+        {
+            return nullptr;
+        }
+
+        uint16_t* buffer = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(image));
+        int boxSize = m_depthWidth / 4;
+        int boxLeft = static_cast<int>((m_frameIndex * 4) % static_cast<uint64_t>(m_depthWidth + boxSize)) - boxSize;
+        int boxTop = (m_depthHeight - boxSize) / 2;
+
+        for (int h = 0; h < m_depthHeight; h++)
+        {
+            uint16_t* row = buffer + h * m_depthWidth;
+            for (int w = 0; w < m_depthWidth; w++)
+            {
+                bool insideBox = w >= boxLeft && w < boxLeft + boxSize && h >= boxTop && h < boxTop + boxSize;
+                row[w] = insideBox ? static_cast<uint16_t>(1500 + (w - boxLeft)) : static_cast<uint16_t>(3000 + h / 4);
+            }
+        }
+
+        k4a_image_set_device_timestamp_usec(image, deviceTimestampUsec);
+        k4a_image_set_system_timestamp_nsec(image, systemTimestampNsec);
+        return image;
+    }
+
+    k4a_image_t CreateColorImage(uint64_t deviceTimestampUsec, uint64_t systemTimestampNsec)
+    {
+        k4a_image_t image = nullptr;
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+            m_colorWidth,
+            m_colorHeight,
+            m_colorWidth * 4 * (int)sizeof(uint8_t),
+            &image))
+        {
+            return nullptr;
+        }
+
+        uint8_t* buffer = k4a_image_get_buffer(image);
+        uint8_t shade = static_cast<uint8_t>(m_frameIndex * 2);
+        for (int h = 0; h < m_colorHeight; h++)
+        {
+            uint8_t* row = buffer + h * m_colorWidth * 4;
+            for (int w = 0; w < m_colorWidth; w++)
+            {
+                row[4 * w + 0] = static_cast<uint8_t>(w * 255 / m_colorWidth);
+                row[4 * w + 1] = static_cast<uint8_t>(h * 255 / m_colorHeight);
+                row[4 * w + 2] = shade;
+                row[4 * w + 3] = 255;
+            }
+        }
+
+        k4a_image_set_device_timestamp_usec(image, deviceTimestampUsec);
+        k4a_image_set_system_timestamp_nsec(image, systemTimestampNsec);
+        return image;
+    }
+
+    // Start at a non-zero device time like a real sensor does
+    static const uint64_t SyntheticStartTimestampUsec = 1000000;
+
+    int m_depthWidth = 0;
+    int m_depthHeight = 0;
+    int m_colorWidth = 0;
+    int m_colorHeight = 0;
+    uint64_t m_frameIndex = 0;
+    steady_clock::time_point m_startTime;
+};
+
+std::unique_ptr<CaptureSource> CreateCaptureSource(
+    const CaptureSourceConfig& config,
+    const k4a_device_configuration_t& deviceConfig)
+{
+    switch (config.Type)
+    {
+    case CaptureSourceType::Playback:
+        return std::make_unique<PlaybackCaptureSource>(config, deviceConfig);
+    case CaptureSourceType::Synthetic:
+        return std::make_unique<SyntheticCaptureSource>(config, deviceConfig);
+    case CaptureSourceType::Device:
+    default:
+        return std::make_unique<DeviceCaptureSource>(config, deviceConfig);
+    }
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <k4a/k4a.h>
+#include <k4arecord/playback.h>
+
+enum class CaptureSourceType
+{
+    Device = 0,     // Live Azure Kinect device opened with k4a_device_open
+    Playback,       // Recording (.mkv) opened with k4a_playback_open
+    Synthetic       // Generated depth/color frames, no hardware required
+};
+
+struct CaptureSourceConfig
+{
+    CaptureSourceType Type = CaptureSourceType::Device;
+
+    // Device: index passed to k4a_device_open
+    uint32_t DeviceIndex = 0;
+
+    // Playback: path of the recording
+    std::string Path;
+
+    k4a_wired_sync_mode_t SyncMode = K4A_WIRED_SYNC_MODE_STANDALONE;
+    uint32_t SubordinateDelayOffMasterUsec = 0;
+
+    // Playback/Synthetic: deliver frames at the recorded/configured frame rate instead of as fast as possible
+    bool RealTime = true;
+
+    // Playback: restart from the beginning when the end of the recording is reached. The device timestamps keep
+    // increasing, every loop continues one frame period after the last capture of the previous one.
+    bool Loop = false;
+
+    // Playback: only deliver the captures of this time slice, relative to the start of the recording.
+    // An end of 0 plays until the end of the recording.
+    uint64_t StartOffsetUsec = 0;
+    uint64_t EndOffsetUsec = 0;
+
+    // Pose of the depth camera in the rig, places the point cloud of the device in the 3d window. Rotation is row
+    // major, translation in millimeters like the k4a extrinsics. Identity when the rig is not calibrated.
+    k4a_calibration_extrinsics_t DepthToRig = { { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f }, { 0.f, 0.f, 0.f } };
+};
+
+// Common interface of everything that produces k4a captures for the capture engine.
+// Open() must make the calibration available, Start() begins streaming.
+class CaptureSource
+{
+public:
+    virtual ~CaptureSource() = default;
+
+    virtual bool Open() = 0;
+    virtual bool Start() = 0;
+    virtual void Stop() = 0;
+    virtual void Close() = 0;
+
+    // Same contract as k4a_device_get_capture. On success the caller owns the returned capture.
+    virtual k4a_wait_result_t GetCapture(k4a_capture_t* capture, int32_t timeoutInMs) = 0;
+
+    // Finite sources (recordings) report true once no more captures will be produced.
+    virtual bool IsEndOfStream() const { return false; }
+
+    // Length of finite sources, 0 for live and generated sources
+    virtual uint64_t GetDurationUsec() const { return 0; }
+
+    const k4a_calibration_t& GetCalibration() const { return m_calibration; }
+    const CaptureSourceConfig& GetConfig() const { return m_config; }
+    const k4a_device_configuration_t& GetDeviceConfig() const { return m_deviceConfig; }
+    const std::string& GetName() const { return m_name; }
+
+protected:
+    CaptureSource(const CaptureSourceConfig& config, const k4a_device_configuration_t& deviceConfig);
+
+    CaptureSourceConfig m_config;
+    k4a_device_configuration_t m_deviceConfig;
+    k4a_calibration_t m_calibration = {};
+    std::string m_name;
+};
+
+std::unique_ptr<CaptureSource> CreateCaptureSource(
+    const CaptureSourceConfig& config,
+    const k4a_device_configuration_t& deviceConfig);
+
+// Helper functions shared by the capture sources
+void GetDepthModeResolution(k4a_depth_mode_t depthMode, int& width, int& height);
+
+void GetColorResolution(k4a_color_resolution_t colorResolution, int& width, int& height);
+
+std::chrono::microseconds GetFramePeriod(k4a_fps_t fps);
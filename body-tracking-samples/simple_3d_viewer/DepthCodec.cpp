@@ -0,0 +1,603 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "DepthCodec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DEPTH_CODEC_SSE2
+#endif
+
+static const char DepthCodecMagic[4] = { 'K', '4', 'D', 'Z' };
+static const int BlockSize = 16;
+
+enum TileMode : uint8_t
+{
+    TileModeSpatial = 0,
+    TileModeTemporal = 1
+};
+
+/**************************************** Worker pool ****************************************/
+
+// Runs the tiles of one image on persistent threads, the calling thread takes part as well
+class DepthCodec::WorkerPool
+{
+public:
+    explicit WorkerPool(size_t threadCount)
+    {
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_threads.emplace_back(&WorkerPool::WorkerThread, this);
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isRunning = false;
+        }
+        m_wakeUp.notify_all();
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    void Run(size_t count, const std::function<void(size_t)>& function)
+    {
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_function = &function;
+            m_count = count;
+            m_next = 0;
+            m_pending = count;
+            generation = ++m_generation;
+        }
+        m_wakeUp.notify_all();
+
+        RunItems(generation, count, function);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_pending == 0; });
+        m_function = nullptr;
+    }
+
+private:
+    // Items are claimed under the lock and only while the generation is still current. A worker that wakes up late
+    // can not take items of the next Run() with the function of the previous one, and Run() does not return before
+    // every claimed item is done.
+    void RunItems(uint64_t generation, size_t count, const std::function<void(size_t)>& function)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_generation == generation && m_next < count)
+        {
+            const size_t index = m_next++;
+            lock.unlock();
+            function(index);
+            lock.lock();
+
+            if (--m_pending == 0)
+            {
+                m_done.notify_all();
+            }
+        }
+    }
+
+    void WorkerThread()
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            size_t count = 0;
+            const std::function<void(size_t)>* function = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [&]() { return m_generation != generation || !m_isRunning; });
+                if (!m_isRunning)
+                {
+                    return;
+                }
+                generation = m_generation;
+                count = m_count;
+                function = m_function;
+            }
+            if (function != nullptr)
+            {
+                RunItems(generation, count, *function);
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_done;
+    const std::function<void(size_t)>* m_function = nullptr;
+    size_t m_next = 0;
+    size_t m_count = 0;
+    size_t m_pending = 0;
+    uint64_t m_generation = 0;
+    bool m_isRunning = true;
+};
+
+/**************************************** Prediction ****************************************/
+
+static inline uint16_t ZigZag(uint16_t value, uint16_t prediction)
+{
+    int16_t residual = (int16_t)(uint16_t)(value - prediction);
+    return (uint16_t)(((uint16_t)residual << 1) ^ (uint16_t)(residual >> 15));
+}
+
+static inline uint16_t UnZigZag(uint16_t code, uint16_t prediction)
+{
+    uint16_t residual = (uint16_t)((code >> 1) ^ (uint16_t)(0 - (code & 1)));
+    return (uint16_t)(prediction + residual);
+}
+
+// Median edge detector: a = left, b = up, c = up-left
+static inline uint16_t PredictMed(uint16_t a, uint16_t b, uint16_t c)
+{
+    uint16_t minimum = std::min(a, b);
+    uint16_t maximum = std::max(a, b);
+    if (c >= maximum)
+    {
+        return minimum;
+    }
+    if (c <= minimum)
+    {
+        return maximum;
+    }
+    return (uint16_t)(a + b - c);
+}
+
+// Zigzag residuals of one row with spatial prediction. up is nullptr for the first row of a tile.
+static void SpatialResidualRow(const uint16_t* row, const uint16_t* up, int width, uint16_t* residuals)
+{
+    if (up == nullptr)
+    {
+        uint16_t left = 0;
+        for (int x = 0; x < width; x++)
+        {
+            residuals[x] = ZigZag(row[x], left);
+            left = row[x];
+        }
+        return;
+    }
+
+    residuals[0] = ZigZag(row[0], up[0]);
+    int x = 1;
+
+#ifdef DEPTH_CODEC_SSE2
+    // SSE2 only has signed 16 bit min/max/compare, flipping the sign bit maps unsigned order onto signed order
+    const __m128i signBit = _mm_set1_epi16((short)0x8000);
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i value = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i a = _mm_loadu_si128((const __m128i*)(row + x - 1));
+        __m128i b = _mm_loadu_si128((const __m128i*)(up + x));
+        __m128i c = _mm_loadu_si128((const __m128i*)(up + x - 1));
+
+        __m128i as = _mm_xor_si128(a, signBit);
+        __m128i bs = _mm_xor_si128(b, signBit);
+        __m128i cs = _mm_xor_si128(c, signBit);
+        __m128i minimum = _mm_min_epi16(as, bs);
+        __m128i maximum = _mm_max_epi16(as, bs);
+        __m128i gradient = _mm_sub_epi16(_mm_add_epi16(a, b), c);
+
+        __m128i cAboveMax = _mm_or_si128(_mm_cmpgt_epi16(cs, maximum), _mm_cmpeq_epi16(cs, maximum));
+        __m128i cBelowMin = _mm_or_si128(_mm_cmplt_epi16(cs, minimum), _mm_cmpeq_epi16(cs, minimum));
+        minimum = _mm_xor_si128(minimum, signBit);
+        maximum = _mm_xor_si128(maximum, signBit);
+
+        // c >= max ? min : (c <= min ? max : a + b - c)
+        __m128i prediction = _mm_or_si128(_mm_and_si128(cBelowMin, maximum), _mm_andnot_si128(cBelowMin, gradient));
+        prediction = _mm_or_si128(_mm_and_si128(cAboveMax, minimum), _mm_andnot_si128(cAboveMax, prediction));
+
+        __m128i residual = _mm_sub_epi16(value, prediction);
+        __m128i code = _mm_xor_si128(_mm_slli_epi16(residual, 1), _mm_srai_epi16(residual, 15));
+        _mm_storeu_si128((__m128i*)(residuals + x), code);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        residuals[x] = ZigZag(row[x], PredictMed(row[x - 1], up[x], up[x - 1]));
+    }
+}
+
+static void TemporalResidualRow(const uint16_t* row, const uint16_t* previous, int width, uint16_t* residuals)
+{
+    int x = 0;
+#ifdef DEPTH_CODEC_SSE2
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i value = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i prediction = _mm_loadu_si128((const __m128i*)(previous + x));
+        __m128i residual = _mm_sub_epi16(value, prediction);
+        __m128i code = _mm_xor_si128(_mm_slli_epi16(residual, 1), _mm_srai_epi16(residual, 15));
+        _mm_storeu_si128((__m128i*)(residuals + x), code);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        residuals[x] = ZigZag(row[x], previous[x]);
+    }
+}
+
+/**************************************** Bit packing ****************************************/
+
+static inline int GetBitWidth(uint16_t value)
+{
+    int width = 0;
+    while (value != 0)
+    {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+static inline int GetBlockWidth(const uint16_t* block)
+{
+#ifdef DEPTH_CODEC_SSE2
+    __m128i bits = _mm_or_si128(_mm_loadu_si128((const __m128i*)block), _mm_loadu_si128((const __m128i*)(block + 8)));
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 8));
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 4));
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 2));
+    return GetBitWidth((uint16_t)_mm_cvtsi128_si32(bits));
+#else
+    uint16_t bits = 0;
+    for (int i = 0; i < BlockSize; i++)
+    {
+        bits |= block[i];
+    }
+    return GetBitWidth(bits);
+#endif
+}
+
+// Size in bytes of the packed residuals of a tile, including the mode byte
+static size_t GetPackedSize(const uint16_t* residuals, size_t blockCount)
+{
+    size_t size = 1;
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        size += 1 + 2 * (size_t)GetBlockWidth(residuals + block * BlockSize);
+    }
+    return size;
+}
+
+static size_t PackTile(const uint16_t* residuals, size_t blockCount, uint8_t mode, uint8_t* output)
+{
+    uint8_t* out = output;
+    *out++ = mode;
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        const uint16_t* values = residuals + block * BlockSize;
+        const int width = GetBlockWidth(values);
+        *out++ = (uint8_t)width;
+        if (width == 0)
+        {
+            continue;
+        }
+
+        // 16 values of width bits are exactly 2 * width bytes
+        uint64_t accumulator = 0;
+        int bits = 0;
+        for (int i = 0; i < BlockSize; i++)
+        {
+            accumulator |= (uint64_t)values[i] << bits;
+            bits += width;
+            if (bits >= 32)
+            {
+                uint32_t word = (uint32_t)accumulator;
+                memcpy(out, &word, sizeof(word));
+                out += sizeof(word);
+                accumulator >>= 32;
+                bits -= 32;
+            }
+        }
+        while (bits > 0)
+        {
+            *out++ = (uint8_t)accumulator;
+            accumulator >>= 8;
+            bits -= 8;
+        }
+    }
+    return (size_t)(out - output);
+}
+
+static bool UnpackTile(const uint8_t* input, size_t size, size_t blockCount, uint8_t& mode, uint16_t* residuals)
+{
+    const uint8_t* in = input;
+    const uint8_t* end = input + size;
+    if (in >= end)
+    {
+        return false;
+    }
+    mode = *in++;
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        uint16_t* values = residuals + block * BlockSize;
+        if (in >= end)
+        {
+            return false;
+        }
+        const int width = *in++;
+        if (width == 0)
+        {
+            memset(values, 0, BlockSize * sizeof(uint16_t));
+            continue;
+        }
+        if (width > 16 || in + 2 * width > end)
+        {
+            return false;
+        }
+
+        const uint64_t mask = (1ull << width) - 1;
+        uint64_t accumulator = 0;
+        int bits = 0;
+        for (int i = 0; i < BlockSize; i++)
+        {
+            while (bits < width)
+            {
+                accumulator |= (uint64_t)(*in++) << bits;
+                bits += 8;
+            }
+            values[i] = (uint16_t)(accumulator & mask);
+            accumulator >>= width;
+            bits -= width;
+        }
+    }
+    return in == end;
+}
+
+/**************************************** Codec ****************************************/
+
+DepthCodec::DepthCodec(size_t threadCount, int tileRows)
+    : m_tileRows(std::max(tileRows, 1))
+{
+    if (threadCount > 1)
+    {
+        m_workerPool = std::make_unique<WorkerPool>(threadCount - 1);
+    }
+}
+
+DepthCodec::~DepthCodec() = default;
+
+void DepthCodec::ParallelFor(size_t count, const std::function<void(size_t)>& function)
+{
+    if (m_workerPool == nullptr || count <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            function(i);
+        }
+        return;
+    }
+    m_workerPool->Run(count, function);
+}
+
+size_t DepthCodec::GetMaxEncodedSize(int width, int height, int tileRows)
+{
+    const size_t tileCount = (size_t)((height + tileRows - 1) / tileRows);
+    const size_t blockCount = ((size_t)width * tileRows + BlockSize - 1) / BlockSize;
+    return sizeof(DepthCodecHeader) + tileCount * (sizeof(uint32_t) + 1 + blockCount * (1 + 2 * BlockSize));
+}
+
+bool DepthCodec::Encode(const uint16_t* depth,
+    int width,
+    int height,
+    int strideBytes,
+    const uint16_t* previous,
+    uint64_t referenceId,
+    std::vector<uint8_t>& output)
+{
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+    {
+        return false;
+    }
+
+    const size_t tileCount = (size_t)((height + m_tileRows - 1) / m_tileRows);
+    m_spatialResiduals.resize(std::max(m_spatialResiduals.size(), tileCount));
+    m_temporalResiduals.resize(std::max(m_temporalResiduals.size(), tileCount));
+    m_tileOutputs.resize(std::max(m_tileOutputs.size(), tileCount));
+
+    const uint8_t* depthBytes = (const uint8_t*)depth;
+    const uint8_t* previousBytes = (const uint8_t*)previous;
+    std::vector<uint8_t> tileModes(tileCount, TileModeSpatial);
+    std::vector<size_t> tileSizes(tileCount, 0);
+
+    ParallelFor(tileCount, [&](size_t tile) {
+        const int y0 = (int)tile * m_tileRows;
+        const int y1 = std::min(y0 + m_tileRows, height);
+        const size_t pixelCount = (size_t)width * (y1 - y0);
+        const size_t blockCount = (pixelCount + BlockSize - 1) / BlockSize;
+
+        // Padding the residuals to whole blocks with zeros keeps the packing loop branch free
+        std::vector<uint16_t>& spatial = m_spatialResiduals[tile];
+        spatial.assign(blockCount * BlockSize, 0);
+        for (int y = y0; y < y1; y++)
+        {
+            const uint16_t* row = (const uint16_t*)(depthBytes + (size_t)y * strideBytes);
+            const uint16_t* up = y > y0 ? (const uint16_t*)(depthBytes + (size_t)(y - 1) * strideBytes) : nullptr;
+            SpatialResidualRow(row, up, width, spatial.data() + (size_t)(y - y0) * width);
+        }
+
+        const uint16_t* residuals = spatial.data();
+        uint8_t mode = TileModeSpatial;
+        if (previous != nullptr)
+        {
+            std::vector<uint16_t>& temporal = m_temporalResiduals[tile];
+            temporal.assign(blockCount * BlockSize, 0);
+            for (int y = y0; y < y1; y++)
+            {
+                const uint16_t* row = (const uint16_t*)(depthBytes + (size_t)y * strideBytes);
+                const uint16_t* previousRow = (const uint16_t*)(previousBytes + (size_t)y * strideBytes);
+                TemporalResidualRow(row, previousRow, width, temporal.data() + (size_t)(y - y0) * width);
+            }
+
+            if (GetPackedSize(temporal.data(), blockCount) < GetPackedSize(spatial.data(), blockCount))
+            {
+                residuals = temporal.data();
+                mode = TileModeTemporal;
+            }
+        }
+
+        std::vector<uint8_t>& tileOutput = m_tileOutputs[tile];
+        tileOutput.resize(1 + blockCount * (1 + 2 * BlockSize));
+        tileSizes[tile] = PackTile(residuals, blockCount, mode, tileOutput.data());
+        tileModes[tile] = mode;
+    });
+
+    DepthCodecHeader header = {};
+    memcpy(header.Magic, DepthCodecMagic, sizeof(header.Magic));
+    header.Version = DepthCodecVersion;
+    header.Width = (uint16_t)width;
+    header.Height = (uint16_t)height;
+    header.TileRows = (uint16_t)m_tileRows;
+    header.TileCount = (uint16_t)tileCount;
+    header.ReferenceId = referenceId;
+
+    size_t totalSize = sizeof(header) + tileCount * sizeof(uint32_t);
+    for (size_t tile = 0; tile < tileCount; tile++)
+    {
+        totalSize += tileSizes[tile];
+        if (tileModes[tile] == TileModeTemporal)
+        {
+            header.Flags |= DepthCodecFlagTemporal;
+        }
+    }
+
+    // Reserving the worst case once keeps a reused output buffer from growing again on a noisier frame
+    output.reserve(GetMaxEncodedSize(width, height, m_tileRows));
+    output.resize(totalSize);
+    uint8_t* out = output.data();
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (size_t tile = 0; tile < tileCount; tile++)
+    {
+        uint32_t tileSize = (uint32_t)tileSizes[tile];
+        memcpy(out, &tileSize, sizeof(tileSize));
+        out += sizeof(tileSize);
+    }
+    for (size_t tile = 0; tile < tileCount; tile++)
+    {
+        memcpy(out, m_tileOutputs[tile].data(), tileSizes[tile]);
+        out += tileSizes[tile];
+    }
+    return true;
+}
+
+bool DepthCodec::ReadHeader(const uint8_t* data, size_t size, DepthCodecHeader& header)
+{
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    return memcmp(header.Magic, DepthCodecMagic, sizeof(header.Magic)) == 0 &&
+        header.Version == DepthCodecVersion &&
+        header.TileRows > 0 &&
+        header.TileCount == (header.Height + header.TileRows - 1) / header.TileRows;
+}
+
+bool DepthCodec::Decode(const uint8_t* data, size_t size, const uint16_t* previous, uint16_t* depth, int strideBytes)
+{
+    DepthCodecHeader header;
+    if (!ReadHeader(data, size, header) || size < sizeof(header) + header.TileCount * sizeof(uint32_t))
+    {
+        return false;
+    }
+    if ((header.Flags & DepthCodecFlagTemporal) != 0 && previous == nullptr)
+    {
+        return false;
+    }
+
+    const size_t tileCount = header.TileCount;
+    const int width = header.Width;
+    const int height = header.Height;
+    const int tileRows = header.TileRows;
+
+    // Tile offsets from the size table
+    std::vector<size_t> tileOffsets(tileCount + 1);
+    tileOffsets[0] = sizeof(header) + tileCount * sizeof(uint32_t);
+    for (size_t tile = 0; tile < tileCount; tile++)
+    {
+        uint32_t tileSize;
+        memcpy(&tileSize, data + sizeof(header) + tile * sizeof(uint32_t), sizeof(tileSize));
+        tileOffsets[tile + 1] = tileOffsets[tile] + tileSize;
+    }
+    if (tileOffsets[tileCount] != size)
+    {
+        return false;
+    }
+
+    m_spatialResiduals.resize(std::max(m_spatialResiduals.size(), tileCount));
+
+    uint8_t* depthBytes = (uint8_t*)depth;
+    const uint8_t* previousBytes = (const uint8_t*)previous;
+    std::atomic<bool> succeeded{ true };
+
+    ParallelFor(tileCount, [&](size_t tile) {
+        const int y0 = (int)tile * tileRows;
+        const int y1 = std::min(y0 + tileRows, height);
+        const size_t pixelCount = (size_t)width * (y1 - y0);
+        const size_t blockCount = (pixelCount + BlockSize - 1) / BlockSize;
+
+        std::vector<uint16_t>& residuals = m_spatialResiduals[tile];
+        residuals.resize(blockCount * BlockSize);
+        uint8_t mode = TileModeSpatial;
+        if (!UnpackTile(data + tileOffsets[tile], tileOffsets[tile + 1] - tileOffsets[tile], blockCount, mode, residuals.data()) ||
+            (mode == TileModeTemporal && previous == nullptr) ||
+            mode > TileModeTemporal)
+        {
+            succeeded = false;
+            return;
+        }
+
+        for (int y = y0; y < y1; y++)
+        {
+            uint16_t* row = (uint16_t*)(depthBytes + (size_t)y * strideBytes);
+            const uint16_t* codes = residuals.data() + (size_t)(y - y0) * width;
+            if (mode == TileModeTemporal)
+            {
+                const uint16_t* previousRow = (const uint16_t*)(previousBytes + (size_t)y * strideBytes);
+                for (int x = 0; x < width; x++)
+                {
+                    row[x] = UnZigZag(codes[x], previousRow[x]);
+                }
+            }
+            else if (y == y0)
+            {
+                uint16_t left = 0;
+                for (int x = 0; x < width; x++)
+                {
+                    row[x] = UnZigZag(codes[x], left);
+                    left = row[x];
+                }
+            }
+            else
+            {
+                // The left neighbor makes this loop serial, tiles provide the parallelism
+                const uint16_t* up = (const uint16_t*)(depthBytes + (size_t)(y - 1) * strideBytes);
+                row[0] = UnZigZag(codes[0], up[0]);
+                for (int x = 1; x < width; x++)
+                {
+                    row[x] = UnZigZag(codes[x], PredictMed(row[x - 1], up[x], up[x - 1]));
+                }
+            }
+        }
+    });
+
+    return succeeded;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Lossless codec for K4A_IMAGE_FORMAT_DEPTH16 images.
+//
+// The image is split into bands of TileRows rows that are coded independently, so encoding and decoding run in
+// parallel across tiles. Every tile predicts each pixel either spatially with the median edge detector of
+// LOCO-I (left, up and up-left neighbors) or temporally from the same pixel of a previous frame, whichever gives
+// the smaller output. The zigzag mapped residuals are bit packed in blocks of 16 with a bit width per block, which
+// turns the flat and invalid (zero) regions that dominate depth images into almost nothing. There is no entropy
+// coder, the packing only drops the leading zero bits of each block.
+//
+// Stream layout: DepthCodecHeader, uint32_t encoded size of every tile, tile payloads. A tile payload is a mode byte
+// followed by, per block of 16 residuals, a width byte and 2 * width bytes of packed residuals.
+
+#pragma pack(push, 1)
+struct DepthCodecHeader
+{
+    char Magic[4];          // "K4DZ"
+    uint16_t Version;
+    uint16_t Flags;         // DepthCodecFlagTemporal when at least one tile needs the reference frame
+    uint16_t Width;
+    uint16_t Height;
+    uint16_t TileRows;
+    uint16_t TileCount;
+    uint64_t ReferenceId;   // Caller defined id of the reference frame, e.g. a group id
+};
+#pragma pack(pop)
+
+const uint16_t DepthCodecVersion = 1;
+const uint16_t DepthCodecFlagTemporal = 1;
+
+class DepthCodec
+{
+public:
+    // threadCount > 1 codes the tiles of one image on a pool of worker threads owned by the codec
+    explicit DepthCodec(size_t threadCount = 1, int tileRows = 32);
+    ~DepthCodec();
+
+    DepthCodec(const DepthCodec&) = delete;
+    DepthCodec& operator=(const DepthCodec&) = delete;
+
+    // Upper bound of the output of Encode(), with every block packed at 16 bits
+    static size_t GetMaxEncodedSize(int width, int height, int tileRows);
+
+    // Encode into output, which is resized to the encoded size. previous (same size and stride, may be nullptr)
+    // enables temporal prediction; its referenceId is stored in the header for the decoder.
+    bool Encode(const uint16_t* depth,
+        int width,
+        int height,
+        int strideBytes,
+        const uint16_t* previous,
+        uint64_t referenceId,
+        std::vector<uint8_t>& output);
+
+    static bool ReadHeader(const uint8_t* data, size_t size, DepthCodecHeader& header);
+
+    // previous must be the decoded reference frame when the header has DepthCodecFlagTemporal set
+    bool Decode(const uint8_t* data, size_t size, const uint16_t* previous, uint16_t* depth, int strideBytes);
+
+private:
+    class WorkerPool;
+
+    void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+
+    int m_tileRows;
+    std::unique_ptr<WorkerPool> m_workerPool;
+
+    // Per tile scratch space, reused from frame to frame
+    std::vector<std::vector<uint16_t>> m_spatialResiduals;
+    std::vector<std::vector<uint16_t>> m_temporalResiduals;
+    std::vector<std::vector<uint8_t>> m_tileOutputs;
+};
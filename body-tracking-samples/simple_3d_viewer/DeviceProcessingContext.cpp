@@ -0,0 +1,165 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "DeviceProcessingContext.h"
+
+#include <cstdio>
+#include <iostream>
+
+#include "transformation_helpers.h"
+
+DeviceProcessingContext::~DeviceProcessingContext()
+{
+    if (m_transformation != nullptr)
+    {
+        k4a_transformation_destroy(m_transformation);
+        m_transformation = nullptr;
+    }
+}
+
+bool DeviceProcessingContext::Initialize(const k4a_calibration_t& calibration, size_t poolSize)
+{
+    m_calibration = calibration;
+    m_transformation = k4a_transformation_create(&m_calibration);
+    if (m_transformation == nullptr)
+    {
+        std::cout << "Failed to create transformation" << std::endl;
+        return false;
+    }
+
+    const int depthWidth = calibration.depth_camera_calibration.resolution_width;
+    const int depthHeight = calibration.depth_camera_calibration.resolution_height;
+    const int colorWidth = calibration.color_camera_calibration.resolution_width;
+    const int colorHeight = calibration.color_camera_calibration.resolution_height;
+
+    bool succeeded = m_colorInDepthPool.Initialize(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+        depthWidth, depthHeight, depthWidth * 4 * (int)sizeof(uint8_t), poolSize);
+    succeeded = succeeded && m_depthPointCloudPool.Initialize(K4A_IMAGE_FORMAT_CUSTOM,
+        depthWidth, depthHeight, depthWidth * 3 * (int)sizeof(int16_t), poolSize);
+
+    // Color geometry outputs only exist when the color camera is running
+    if (colorWidth > 0 && colorHeight > 0)
+    {
+        succeeded = succeeded && m_depthInColorPool.Initialize(K4A_IMAGE_FORMAT_DEPTH16,
+            colorWidth, colorHeight, colorWidth * (int)sizeof(uint16_t), poolSize);
+        succeeded = succeeded && m_colorPointCloudPool.Initialize(K4A_IMAGE_FORMAT_CUSTOM,
+            colorWidth, colorHeight, colorWidth * 3 * (int)sizeof(int16_t), poolSize);
+    }
+
+    if (!succeeded)
+    {
+        std::cout << "Failed to initialize the image pools" << std::endl;
+    }
+    return succeeded;
+}
+
+k4a_image_t DeviceProcessingContext::ColorToDepthCamera(const k4a_image_t depthImage, const k4a_image_t colorImage)
+{
+    k4a_image_t transformedColorImage = m_colorInDepthPool.Acquire();
+    if (transformedColorImage == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_transformationMutex);
+    if (K4A_RESULT_SUCCEEDED != k4a_transformation_color_image_to_depth_camera(m_transformation,
+        depthImage,
+        colorImage,
+        transformedColorImage))
+    {
+        printf("Failed to compute transformed color image\n");
+        k4a_image_release(transformedColorImage);
+        return nullptr;
+    }
+    return transformedColorImage;
+}
+
+k4a_image_t DeviceProcessingContext::DepthToColorCamera(const k4a_image_t depthImage)
+{
+    k4a_image_t transformedDepthImage = m_depthInColorPool.Acquire();
+    if (transformedDepthImage == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_transformationMutex);
+    if (K4A_RESULT_SUCCEEDED !=
+        k4a_transformation_depth_image_to_color_camera(m_transformation, depthImage, transformedDepthImage))
+    {
+        printf("Failed to compute transformed depth image\n");
+        k4a_image_release(transformedDepthImage);
+        return nullptr;
+    }
+    return transformedDepthImage;
+}
+
+k4a_image_t DeviceProcessingContext::DepthToPointCloud(const k4a_image_t depthImage, k4a_calibration_type_t calibrationType)
+{
+    ImagePool& pool = calibrationType == K4A_CALIBRATION_TYPE_COLOR ? m_colorPointCloudPool : m_depthPointCloudPool;
+    k4a_image_t pointCloudImage = pool.Acquire();
+    if (pointCloudImage == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_transformationMutex);
+    if (K4A_RESULT_SUCCEEDED != k4a_transformation_depth_image_to_point_cloud(m_transformation,
+        depthImage,
+        calibrationType,
+        pointCloudImage))
+    {
+        printf("Failed to compute point cloud\n");
+        k4a_image_release(pointCloudImage);
+        return nullptr;
+    }
+    return pointCloudImage;
+}
+
+bool DeviceProcessingContext::WritePointCloudDepthToColor(const k4a_image_t depthImage, const k4a_image_t colorImage, const char* fileName)
+{
+    k4a_image_t transformedDepthImage = DepthToColorCamera(depthImage);
+    if (transformedDepthImage == nullptr)
+    {
+        return false;
+    }
+
+    k4a_image_t pointCloudImage = DepthToPointCloud(transformedDepthImage, K4A_CALIBRATION_TYPE_COLOR);
+    k4a_image_release(transformedDepthImage);
+    if (pointCloudImage == nullptr)
+    {
+        return false;
+    }
+
+    bool succeeded = tranformation_helpers_write_point_cloud(pointCloudImage, colorImage, fileName);
+    k4a_image_release(pointCloudImage);
+    return succeeded;
+}
+
+bool DeviceProcessingContext::WritePointCloudColorToDepth(const k4a_image_t depthImage, const k4a_image_t colorImage, const char* fileName)
+{
+    k4a_image_t transformedColorImage = ColorToDepthCamera(depthImage, colorImage);
+    if (transformedColorImage == nullptr)
+    {
+        return false;
+    }
+
+    k4a_image_t pointCloudImage = DepthToPointCloud(depthImage, K4A_CALIBRATION_TYPE_DEPTH);
+    if (pointCloudImage == nullptr)
+    {
+        k4a_image_release(transformedColorImage);
+        return false;
+    }
+
+    bool succeeded = tranformation_helpers_write_point_cloud(pointCloudImage, transformedColorImage, fileName);
+    k4a_image_release(transformedColorImage);
+    k4a_image_release(pointCloudImage);
+    return succeeded;
+}
+
+size_t DeviceProcessingContext::GetPoolGrowCount() const
+{
+    return m_colorInDepthPool.GetGrowCount() +
+        m_depthInColorPool.GetGrowCount() +
+        m_depthPointCloudPool.GetGrowCount() +
+        m_colorPointCloudPool.GetGrowCount();
+}
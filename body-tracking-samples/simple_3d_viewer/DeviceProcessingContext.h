@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <mutex>
+
+#include <k4a/k4a.h>
+
+#include "ImagePool.h"
+
+// Per-device state for registering depth and color. The transformation is built once from the device calibration
+// and all output images come from recycling pools sized for the device, so a frame in steady state does not
+// allocate pixel memory. Every returned image is owned by the caller and goes back to its pool on k4a_image_release.
+// The methods can be called from several threads; calls that use the transformation are serialized per device.
+class DeviceProcessingContext
+{
+public:
+    DeviceProcessingContext() = default;
+    ~DeviceProcessingContext();
+
+    DeviceProcessingContext(const DeviceProcessingContext&) = delete;
+    DeviceProcessingContext& operator=(const DeviceProcessingContext&) = delete;
+
+    // poolSize is the number of images of each kind that can be in flight before a pool has to grow
+    bool Initialize(const k4a_calibration_t& calibration, size_t poolSize);
+
+    const k4a_calibration_t& GetCalibration() const { return m_calibration; }
+
+    // Color image resampled into the depth camera geometry (BGRA32, depth resolution)
+    k4a_image_t ColorToDepthCamera(const k4a_image_t depthImage, const k4a_image_t colorImage);
+
+    // Depth image resampled into the color camera geometry (DEPTH16, color resolution)
+    k4a_image_t DepthToColorCamera(const k4a_image_t depthImage);
+
+    // Point cloud (int16 xyz in millimeters) of a depth image in the geometry of calibrationType.
+    // For K4A_CALIBRATION_TYPE_COLOR the depth image must already be in the color camera geometry.
+    k4a_image_t DepthToPointCloud(const k4a_image_t depthImage, k4a_calibration_type_t calibrationType);
+
+    // Colored point cloud in the color camera geometry written as PLY
+    bool WritePointCloudDepthToColor(const k4a_image_t depthImage, const k4a_image_t colorImage, const char* fileName);
+
+    // Colored point cloud in the depth camera geometry written as PLY
+    bool WritePointCloudColorToDepth(const k4a_image_t depthImage, const k4a_image_t colorImage, const char* fileName);
+
+    // Number of buffers all pools had to allocate after initialization
+    size_t GetPoolGrowCount() const;
+
+private:
+    k4a_calibration_t m_calibration = {};
+    k4a_transformation_t m_transformation = nullptr;
+    std::mutex m_transformationMutex;
+
+    ImagePool m_colorInDepthPool;       // BGRA32, depth geometry
+    ImagePool m_depthInColorPool;       // DEPTH16, color geometry
+    ImagePool m_depthPointCloudPool;    // xyz int16, depth geometry
+    ImagePool m_colorPointCloudPool;    // xyz int16, color geometry
+};
@@ -0,0 +1,442 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "FrameWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#include <opencv2/opencv.hpp>
+
+const char* GetWriteStageName(WriteStage stage)
+{
+    switch (stage)
+    {
+    case WriteStage::Register: return "register";
+    case WriteStage::DepthPng: return "depth png";
+    case WriteStage::DepthCodec: return "depth codec";
+    case WriteStage::ColorJpeg: return "color jpeg";
+    case WriteStage::PointCloud: return "point cloud";
+    case WriteStage::ContainerAppend: return "container append";
+    default: return "unknown";
+    }
+}
+
+FrameWriter::~FrameWriter()
+{
+    Stop();
+}
+
+bool FrameWriter::Start(const FrameWriterConfig& config, const std::vector<DeviceProcessingContext*>& processingContexts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_isRunning || config.QueueDepth == 0 || config.ThreadCount == 0)
+    {
+        return false;
+    }
+
+    m_config = config;
+    m_processingContexts = processingContexts;
+
+    if (config.Output == FrameWriterOutput::Container)
+    {
+        if (m_config.ContainerPath.empty())
+        {
+            m_config.ContainerPath = "session_" + std::to_string(std::time(nullptr));
+        }
+
+        std::vector<k4a_calibration_t> calibrations;
+        for (const DeviceProcessingContext* processingContext : processingContexts)
+        {
+            calibrations.push_back(processingContext->GetCalibration());
+        }
+        if (!m_container.Open(m_config.ContainerPath, calibrations, m_config.ContainerChunkSize))
+        {
+            return false;
+        }
+        std::cout << "Writing captures into container " << m_config.ContainerPath << std::endl;
+    }
+
+    m_jobs.assign(config.QueueDepth, WriteJob());
+    m_keyframes.assign(processingContexts.size(), DepthKeyframe());
+    m_head = 0;
+    m_count = 0;
+    m_isRunning = true;
+
+    for (size_t i = 0; i < config.ThreadCount; i++)
+    {
+        m_threads.emplace_back(&FrameWriter::EncoderThread, this);
+    }
+    return true;
+}
+
+void FrameWriter::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+    ReleaseKeyframes();
+
+    // No-op unless a container is open
+    m_container.Close();
+}
+
+bool FrameWriter::Enqueue(size_t deviceSlot,
+    k4a_capture_t capture,
+    uint64_t groupId,
+    std::time_t timestamp,
+    uint64_t timestampUsec,
+    bool writePointCloud)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_count == m_jobs.size() && m_isRunning)
+    {
+        if (m_config.Policy == FrameWriterQueuePolicy::Drop)
+        {
+            m_dropped++;
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        m_notFull.wait(lock, [this]() { return m_count < m_jobs.size() || !m_isRunning; });
+        m_blockedUsec += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (!m_isRunning)
+    {
+        return false;
+    }
+
+    k4a_capture_reference(capture);
+
+    WriteJob& job = m_jobs[(m_head + m_count) % m_jobs.size()];
+    job.DeviceSlot = deviceSlot;
+    job.Capture = capture;
+    job.GroupId = groupId;
+    job.Timestamp = timestamp;
+    job.TimestampUsec = timestampUsec;
+    job.WritePointCloud = writePointCloud;
+    job.Reference = nullptr;
+    job.ReferenceGroupId = 0;
+
+    // Keyframes are chosen here rather than on the encoder threads, which may run frames of a device out of order.
+    // Only captures with a depth image take part, every keyframe is written and its deltas can be decoded.
+    if (m_config.DepthEncoding == FrameWriterDepthEncoding::Codec && m_config.DepthKeyframeInterval > 1 &&
+        HasDepthImage(capture))
+    {
+        DepthKeyframe& keyframe = m_keyframes[deviceSlot];
+        if (keyframe.Capture == nullptr || keyframe.FramesSinceKeyframe + 1 >= m_config.DepthKeyframeInterval)
+        {
+            if (keyframe.Capture != nullptr)
+            {
+                k4a_capture_release(keyframe.Capture);
+            }
+            k4a_capture_reference(capture);
+            keyframe.Capture = capture;
+            keyframe.GroupId = groupId;
+            keyframe.FramesSinceKeyframe = 0;
+        }
+        else
+        {
+            k4a_capture_reference(keyframe.Capture);
+            job.Reference = keyframe.Capture;
+            job.ReferenceGroupId = keyframe.GroupId;
+            keyframe.FramesSinceKeyframe++;
+        }
+    }
+
+    m_count++;
+    m_maxCount = std::max(m_maxCount, m_count);
+    m_enqueued++;
+
+    lock.unlock();
+    m_notEmpty.notify_one();
+    return true;
+}
+
+bool FrameWriter::HasDepthImage(k4a_capture_t capture)
+{
+    k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+    if (depthImage == nullptr)
+    {
+        return false;
+    }
+    k4a_image_release(depthImage);
+    return true;
+}
+
+size_t FrameWriter::GetQueueDepth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+bool FrameWriter::HasCapacity(size_t jobCount) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_isRunning && m_count + jobCount <= m_jobs.size();
+}
+
+FrameWriterStatistics FrameWriter::GetStatistics() const
+{
+    FrameWriterStatistics statistics;
+    statistics.Enqueued = m_enqueued.load();
+    statistics.Dropped = m_dropped.load();
+    statistics.BlockedUsec = m_blockedUsec.load();
+    statistics.Completed = m_completed.load();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        statistics.MaxQueueDepth = m_maxCount;
+    }
+    for (size_t stage = 0; stage < m_stages.size(); stage++)
+    {
+        statistics.Stages[stage].Count = m_stages[stage].Count.load();
+        statistics.Stages[stage].Failures = m_stages[stage].Failures.load();
+        statistics.Stages[stage].TotalUsec = m_stages[stage].TotalUsec.load();
+    }
+    return statistics;
+}
+
+void FrameWriter::EncoderThread()
+{
+    for (;;)
+    {
+        WriteJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this]() { return m_count > 0 || !m_isRunning; });
+
+            // Queued jobs are still written after Stop() so no captured frame is lost on exit
+            if (m_count == 0)
+            {
+                return;
+            }
+
+            job = m_jobs[m_head];
+            m_jobs[m_head].Capture = nullptr;
+            m_jobs[m_head].Reference = nullptr;
+            m_head = (m_head + 1) % m_jobs.size();
+            m_count--;
+        }
+        m_notFull.notify_one();
+
+        if (m_config.Output == FrameWriterOutput::Container)
+        {
+            AppendToContainer(job);
+        }
+        else
+        {
+            ProcessJob(job);
+        }
+        k4a_capture_release(job.Capture);
+        if (job.Reference != nullptr)
+        {
+            k4a_capture_release(job.Reference);
+        }
+        m_completed++;
+    }
+}
+
+void FrameWriter::ReleaseKeyframes()
+{
+    for (DepthKeyframe& keyframe : m_keyframes)
+    {
+        if (keyframe.Capture != nullptr)
+        {
+            k4a_capture_release(keyframe.Capture);
+        }
+    }
+    m_keyframes.clear();
+}
+
+bool FrameWriter::EncodeDepth(const WriteJob& job, const k4a_image_t depthImage, std::vector<uint8_t>& output)
+{
+    // The encoder threads already run in parallel, so every thread codes its frames on its own. A tile pool per
+    // thread would only oversubscribe the cores, it is used by the offline decoding (CaptureExport) instead.
+    thread_local DepthCodec codec;
+
+    const int width = k4a_image_get_width_pixels(depthImage);
+    const int height = k4a_image_get_height_pixels(depthImage);
+    const int strideBytes = k4a_image_get_stride_bytes(depthImage);
+
+    k4a_image_t referenceImage = job.Reference != nullptr ? k4a_capture_get_depth_image(job.Reference) : nullptr;
+    const uint16_t* previous = nullptr;
+    if (referenceImage != nullptr &&
+        k4a_image_get_width_pixels(referenceImage) == width &&
+        k4a_image_get_height_pixels(referenceImage) == height &&
+        k4a_image_get_stride_bytes(referenceImage) == strideBytes)
+    {
+        previous = (const uint16_t*)k4a_image_get_buffer(referenceImage);
+    }
+
+    bool succeeded = codec.Encode((const uint16_t*)k4a_image_get_buffer(depthImage),
+        width,
+        height,
+        strideBytes,
+        previous,
+        previous != nullptr ? job.ReferenceGroupId : job.GroupId,
+        output);
+
+    if (referenceImage != nullptr)
+    {
+        k4a_image_release(referenceImage);
+    }
+    return succeeded;
+}
+
+void FrameWriter::RecordStage(WriteStage stage, bool succeeded, std::chrono::steady_clock::time_point start)
+{
+    StageCounters& counters = m_stages[(size_t)stage];
+    counters.TotalUsec += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    counters.Count++;
+    if (!succeeded)
+    {
+        counters.Failures++;
+    }
+}
+
+void FrameWriter::ProcessJob(const WriteJob& job)
+{
+    // Each encoder thread converts into its own buffers, which keep their allocation from frame to frame
+    thread_local cv::Mat colorScratch;
+    thread_local std::vector<uint8_t> depthScratch;
+
+    DeviceProcessingContext& processingContext = *m_processingContexts[job.DeviceSlot];
+    const k4a_calibration_t& sensorCalibration = processingContext.GetCalibration();
+    int depthWidth = sensorCalibration.depth_camera_calibration.resolution_width;
+    int depthHeight = sensorCalibration.depth_camera_calibration.resolution_height;
+
+    // Depth is written whether or not the color image can be registered, a codec keyframe may be the reference of
+    // the next frames of the device
+    k4a_image_t depthImage = k4a_capture_get_depth_image(job.Capture);
+    if (depthImage == nullptr)
+    {
+        std::cout << "Capture of device " << job.DeviceSlot << " is missing the depth image" << std::endl;
+        return;
+    }
+
+    const bool useCodec = m_config.DepthEncoding == FrameWriterDepthEncoding::Codec;
+    std::stringstream ssd;
+    ssd << "d" << job.DeviceSlot << "_" << job.Timestamp << "_" << job.TimestampUsec;
+    if (useCodec)
+    {
+        // The header of a delta frame references the group id of its keyframe, the decoder finds it by file name
+        ssd << "_g" << job.GroupId << ".k4dz";
+    }
+    else
+    {
+        ssd << ".png";
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (useCodec)
+    {
+        bool succeeded = EncodeDepth(job, depthImage, depthScratch);
+        if (succeeded)
+        {
+            FILE* file = fopen(ssd.str().c_str(), "wb");
+            succeeded = file != nullptr && fwrite(depthScratch.data(), 1, depthScratch.size(), file) == depthScratch.size();
+            succeeded = file != nullptr && fclose(file) == 0 && succeeded;
+        }
+        RecordStage(WriteStage::DepthCodec, succeeded, start);
+    }
+    else
+    {
+        const cv::Mat depthImg(depthHeight, depthWidth, CV_16UC1, k4a_image_get_buffer(depthImage));
+        RecordStage(WriteStage::DepthPng, cv::imwrite(ssd.str(), depthImg), start);
+    }
+
+    k4a_image_t colorImage = k4a_capture_get_color_image(job.Capture);
+    if (colorImage == nullptr)
+    {
+        std::cout << "Capture of device " << job.DeviceSlot << " is missing the color image" << std::endl;
+        k4a_image_release(depthImage);
+        return;
+    }
+
+    start = std::chrono::steady_clock::now();
+    k4a_image_t transformedColorImage = processingContext.ColorToDepthCamera(depthImage, colorImage);
+    RecordStage(WriteStage::Register, transformedColorImage != nullptr, start);
+
+    if (transformedColorImage != nullptr)
+    {
+        std::stringstream ssc;
+        ssc << "c" << job.DeviceSlot << "_" << job.Timestamp << "_" << job.TimestampUsec << ".jpg";
+
+        start = std::chrono::steady_clock::now();
+        const cv::Mat colorImg(depthHeight, depthWidth, CV_8UC4, k4a_image_get_buffer(transformedColorImage));
+        cv::cvtColor(colorImg, colorScratch, cv::COLOR_BGRA2BGR);
+        RecordStage(WriteStage::ColorJpeg, cv::imwrite(ssc.str(), colorScratch), start);
+
+        k4a_image_release(transformedColorImage);
+    }
+
+    if (job.WritePointCloud)
+    {
+        std::stringstream ssp;
+        ssp << "pc_" << job.TimestampUsec << ".ply";
+
+        start = std::chrono::steady_clock::now();
+        bool succeeded = processingContext.WritePointCloudDepthToColor(depthImage, colorImage, ssp.str().c_str());
+        RecordStage(WriteStage::PointCloud, succeeded, start);
+    }
+
+    k4a_image_release(colorImage);
+    k4a_image_release(depthImage);
+}
+
+void FrameWriter::AppendToContainer(const WriteJob& job)
+{
+    thread_local std::vector<uint8_t> depthScratch;
+
+    // Raw images only, registration can be done offline with the calibrations stored in the container
+    auto start = std::chrono::steady_clock::now();
+    bool succeeded = true;
+
+    k4a_image_t depthImage = k4a_capture_get_depth_image(job.Capture);
+    if (depthImage != nullptr && m_config.DepthEncoding == FrameWriterDepthEncoding::Codec)
+    {
+        auto encodeStart = std::chrono::steady_clock::now();
+        bool encoded = EncodeDepth(job, depthImage, depthScratch);
+        RecordStage(WriteStage::DepthCodec, encoded, encodeStart);
+
+        succeeded = encoded && m_container.Append(job.GroupId,
+            job.DeviceSlot,
+            k4a_image_get_device_timestamp_usec(depthImage),
+            ContainerPayloadType::Depth16Codec,
+            k4a_image_get_width_pixels(depthImage),
+            k4a_image_get_height_pixels(depthImage),
+            k4a_image_get_stride_bytes(depthImage),
+            depthScratch.data(),
+            depthScratch.size());
+        k4a_image_release(depthImage);
+    }
+    else if (depthImage != nullptr)
+    {
+        succeeded = m_container.AppendImage(job.GroupId, job.DeviceSlot, depthImage) && succeeded;
+        k4a_image_release(depthImage);
+    }
+
+    k4a_image_t colorImage = k4a_capture_get_color_image(job.Capture);
+    if (colorImage != nullptr)
+    {
+        succeeded = m_container.AppendImage(job.GroupId, job.DeviceSlot, colorImage) && succeeded;
+        k4a_image_release(colorImage);
+    }
+
+    RecordStage(WriteStage::ContainerAppend, succeeded, start);
+}
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#include "CaptureContainer.h"
+#include "DepthCodec.h"
+#include "DeviceProcessingContext.h"
+#include "RigConfiguration.h"
+
+enum class WriteStage
+{
+    Register = 0,   // Color image resampled into the depth geometry
+    DepthPng,
+    DepthCodec,     // Lossless depth compression, file write included for file output
+    ColorJpeg,
+    PointCloud,
+    ContainerAppend,    // Raw depth and color appended to the session container
+    Count
+};
+
+const char* GetWriteStageName(WriteStage stage);
+
+struct WriteStageStatistics
+{
+    uint64_t Count = 0;
+    uint64_t Failures = 0;
+    uint64_t TotalUsec = 0;
+};
+
+struct FrameWriterStatistics
+{
+    uint64_t Enqueued = 0;
+    uint64_t Dropped = 0;           // Rejected by the drop policy because the queue was full
+    uint64_t BlockedUsec = 0;       // Time the producer spent waiting for space with the block policy
+    uint64_t Completed = 0;
+    size_t MaxQueueDepth = 0;
+    std::array<WriteStageStatistics, (size_t)WriteStage::Count> Stages;
+};
+
+// Background writer for the outputs of a capture: depth PNG (or DepthCodec), color JPEG and PLY files, or the raw
+// images appended to a session container. Enqueue() only takes a reference on the capture and returns; a pool of
+// encoder threads does the registration, encoding and writing, so the capture loop never waits for the disk or the
+// encoders unless the block policy is selected and the queue is full.
+class FrameWriter
+{
+public:
+    ~FrameWriter();
+
+    // One processing context per device slot. The contexts must outlive the writer.
+    bool Start(const FrameWriterConfig& config, const std::vector<DeviceProcessingContext*>& processingContexts);
+
+    // Write everything that is still queued and join the encoder threads
+    void Stop();
+
+    // The writer adds its own reference to the capture, the caller keeps its reference.
+    // Returns false when the job was dropped or the writer is not running.
+    bool Enqueue(size_t deviceSlot,
+        k4a_capture_t capture,
+        uint64_t groupId,
+        std::time_t timestamp,
+        uint64_t timestampUsec,
+        bool writePointCloud);
+
+    size_t GetQueueDepth() const;
+
+    // True when jobCount more jobs fit into the queue without blocking or dropping
+    bool HasCapacity(size_t jobCount) const;
+
+    FrameWriterStatistics GetStatistics() const;
+
+private:
+    struct WriteJob
+    {
+        size_t DeviceSlot = 0;
+        k4a_capture_t Capture = nullptr;
+        uint64_t GroupId = 0;
+        std::time_t Timestamp = 0;
+        uint64_t TimestampUsec = 0;
+        bool WritePointCloud = false;
+
+        // Depth codec: capture holding the reference depth frame, nullptr for keyframes
+        k4a_capture_t Reference = nullptr;
+        uint64_t ReferenceGroupId = 0;
+    };
+
+    // Depth codec keyframe of a device, referenced by the jobs that predict from it
+    struct DepthKeyframe
+    {
+        k4a_capture_t Capture = nullptr;
+        uint64_t GroupId = 0;
+        size_t FramesSinceKeyframe = 0;
+    };
+
+    struct StageCounters
+    {
+        std::atomic<uint64_t> Count{ 0 };
+        std::atomic<uint64_t> Failures{ 0 };
+        std::atomic<uint64_t> TotalUsec{ 0 };
+    };
+
+    static bool HasDepthImage(k4a_capture_t capture);
+
+    void EncoderThread();
+
+    void ProcessJob(const WriteJob& job);
+
+    void AppendToContainer(const WriteJob& job);
+
+    // Compress the depth image of a job, predicting from the job's reference frame when there is one
+    bool EncodeDepth(const WriteJob& job, const k4a_image_t depthImage, std::vector<uint8_t>& output);
+
+    void ReleaseKeyframes();
+
+    void RecordStage(WriteStage stage, bool succeeded, std::chrono::steady_clock::time_point start);
+
+    FrameWriterConfig m_config;
+    std::vector<DeviceProcessingContext*> m_processingContexts;
+    std::vector<std::thread> m_threads;
+    CaptureContainerWriter m_container;
+
+    // Bounded ring of jobs, shared by all encoder threads
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::vector<WriteJob> m_jobs;
+    size_t m_head = 0;
+    size_t m_count = 0;
+    size_t m_maxCount = 0;
+    bool m_isRunning = false;
+    std::vector<DepthKeyframe> m_keyframes;
+
+    std::atomic<uint64_t> m_enqueued{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_blockedUsec{ 0 };
+    std::atomic<uint64_t> m_completed{ 0 };
+    std::array<StageCounters, (size_t)WriteStage::Count> m_stages;
+};
@@ -0,0 +1,116 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+static size_t GetHighestBit(uint64_t value)
+{
+    size_t bit = 0;
+    while (value >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+}
+
+size_t Histogram::GetBucketIndex(uint64_t value)
+{
+    if (value < LinearBucketCount)
+    {
+        return (size_t)value;
+    }
+
+    // The 3 bits below the highest set bit select the sub bucket
+    const size_t exponent = GetHighestBit(value);
+    const size_t subBucket = (size_t)(value >> (exponent - SubBucketBits)) & ((1 << SubBucketBits) - 1);
+    return LinearBucketCount + (exponent - 4) * (1 << SubBucketBits) + subBucket;
+}
+
+uint64_t Histogram::GetBucketLowerBound(size_t index)
+{
+    if (index < LinearBucketCount)
+    {
+        return index;
+    }
+
+    const size_t exponent = (index - LinearBucketCount) / (1 << SubBucketBits) + 4;
+    const uint64_t subBucket = (index - LinearBucketCount) % (1 << SubBucketBits);
+    return (1ull << exponent) | (subBucket << (exponent - SubBucketBits));
+}
+
+void Histogram::Record(uint64_t value)
+{
+    m_buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t minimum = m_min.load(std::memory_order_relaxed);
+    while (value < minimum && !m_min.compare_exchange_weak(minimum, value, std::memory_order_relaxed))
+    {
+    }
+    uint64_t maximum = m_max.load(std::memory_order_relaxed);
+    while (value > maximum && !m_max.compare_exchange_weak(maximum, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Histogram::Reset()
+{
+    for (std::atomic<uint64_t>& bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetPercentile(double percentile) const
+{
+    // Count the buckets themselves, m_count may already include a value whose bucket is not visible yet
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket : m_buckets)
+    {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(percentile / 100.0 * total));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BucketCount; index++)
+    {
+        seen += m_buckets[index].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // Clamp to the exact extremes, which are known
+            return std::min(std::max(GetBucketLowerBound(index), m_min.load(std::memory_order_relaxed)),
+                m_max.load(std::memory_order_relaxed));
+        }
+    }
+    return m_max.load(std::memory_order_relaxed);
+}
+
+HistogramSummary Histogram::GetSummary() const
+{
+    HistogramSummary summary;
+    summary.Count = m_count.load(std::memory_order_relaxed);
+    if (summary.Count == 0)
+    {
+        return summary;
+    }
+
+    summary.Min = m_min.load(std::memory_order_relaxed);
+    summary.Max = m_max.load(std::memory_order_relaxed);
+    summary.Mean = (double)m_sum.load(std::memory_order_relaxed) / summary.Count;
+    summary.P50 = GetPercentile(50);
+    summary.P90 = GetPercentile(90);
+    summary.P99 = GetPercentile(99);
+    return summary;
+}
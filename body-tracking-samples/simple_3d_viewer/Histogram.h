@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Snapshot of a Histogram, values in the unit that was recorded
+struct HistogramSummary
+{
+    uint64_t Count = 0;
+    uint64_t Min = 0;
+    uint64_t Max = 0;
+    double Mean = 0;
+    uint64_t P50 = 0;
+    uint64_t P90 = 0;
+    uint64_t P99 = 0;
+};
+
+// Lock-free histogram of unsigned values. Values below 16 have their own bucket, larger values are grouped into
+// 8 buckets per power of two, so every reported percentile is within 12.5% of the recorded value. Record() only
+// does relaxed atomic increments and can be called from any number of threads while another thread reads a
+// summary; the summary is then approximate but never torn per bucket.
+class Histogram
+{
+public:
+    void Record(uint64_t value);
+
+    void Reset();
+
+    uint64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+
+    // Lower bound of the bucket that contains the given percentile (0..100)
+    uint64_t GetPercentile(double percentile) const;
+
+    HistogramSummary GetSummary() const;
+
+private:
+    static const size_t LinearBucketCount = 16;
+    static const size_t SubBucketBits = 3;
+    static const size_t BucketCount = LinearBucketCount + (64 - 4) * (1 << SubBucketBits);
+
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketLowerBound(size_t index);
+
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_sum{ 0 };
+    std::atomic<uint64_t> m_min{ UINT64_MAX };
+    std::atomic<uint64_t> m_max{ 0 };
+};
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "ImagePool.h"
+
+#include <iostream>
+
+ImagePool::~ImagePool()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeBuffers.size() != m_buffers.size())
+    {
+        std::cout << "Image pool destroyed with " << m_buffers.size() - m_freeBuffers.size()
+            << " images still in use" << std::endl;
+    }
+}
+
+bool ImagePool::Initialize(k4a_image_format_t format, int width, int height, int strideBytes, size_t initialCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_buffers.empty() || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_strideBytes = strideBytes;
+    m_bufferSize = static_cast<size_t>(height) * static_cast<size_t>(strideBytes);
+
+    // Reserve generously so the bookkeeping itself never reallocates when the pool has to grow a little
+    m_buffers.reserve(initialCount * 2);
+    m_freeBuffers.reserve(initialCount * 2);
+    for (size_t i = 0; i < initialCount; i++)
+    {
+        m_freeBuffers.push_back(AllocateBuffer());
+    }
+    return true;
+}
+
+k4a_image_t ImagePool::Acquire()
+{
+    uint8_t* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bufferSize == 0)
+        {
+            return nullptr;
+        }
+
+        if (!m_freeBuffers.empty())
+        {
+            buffer = m_freeBuffers.back();
+            m_freeBuffers.pop_back();
+        }
+        else
+        {
+            buffer = AllocateBuffer();
+            m_freeBuffers.reserve(m_buffers.capacity());
+            m_growCount++;
+        }
+    }
+
+    k4a_image_t image = nullptr;
+    if (K4A_RESULT_SUCCEEDED != k4a_image_create_from_buffer(m_format,
+        m_width,
+        m_height,
+        m_strideBytes,
+        buffer,
+        m_bufferSize,
+        ReleaseBuffer,
+        this,
+        &image))
+    {
+        std::cout << "Failed to create image from pool buffer" << std::endl;
+        ReleaseBuffer(buffer, this);
+        return nullptr;
+    }
+    return image;
+}
+
+size_t ImagePool::GetBufferCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_buffers.size();
+}
+
+size_t ImagePool::GetGrowCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_growCount;
+}
+
+void ImagePool::ReleaseBuffer(void* buffer, void* context)
+{
+    ImagePool* pool = static_cast<ImagePool*>(context);
+    std::lock_guard<std::mutex> lock(pool->m_mutex);
+    pool->m_freeBuffers.push_back(static_cast<uint8_t*>(buffer));
+}
+
+uint8_t* ImagePool::AllocateBuffer()
+{
+    m_buffers.push_back(std::make_unique<uint8_t[]>(m_bufferSize));
+    return m_buffers.back().get();
+}
@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+// Recycling pool of k4a images with identical format and size. Acquire() wraps a preallocated buffer with
+// k4a_image_create_from_buffer. Once the last reference to the image is released, the SDK calls back into the pool
+// and the buffer becomes available again, so the pixel memory is never freed and reallocated while streaming.
+// Images can be released from any thread, but the pool must outlive every image it handed out.
+class ImagePool
+{
+public:
+    ImagePool() = default;
+    ~ImagePool();
+
+    ImagePool(const ImagePool&) = delete;
+    ImagePool& operator=(const ImagePool&) = delete;
+
+    // Preallocate initialCount buffers of height * strideBytes bytes
+    bool Initialize(k4a_image_format_t format, int width, int height, int strideBytes, size_t initialCount);
+
+    // Returns nullptr on failure. If all buffers are in use a new one is allocated and kept for later frames.
+    k4a_image_t Acquire();
+
+    size_t GetBufferCount() const;
+
+    // Number of buffers allocated after Initialize because the pool ran dry
+    size_t GetGrowCount() const;
+
+private:
+    static void ReleaseBuffer(void* buffer, void* context);
+
+    uint8_t* AllocateBuffer();
+
+    k4a_image_format_t m_format = K4A_IMAGE_FORMAT_CUSTOM;
+    int m_width = 0;
+    int m_height = 0;
+    int m_strideBytes = 0;
+    size_t m_bufferSize = 0;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<uint8_t[]>> m_buffers;
+    std::vector<uint8_t*> m_freeBuffers;
+    size_t m_growCount = 0;
+};
@@ -0,0 +1,222 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "MultiDeviceCapture.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "SyncMonitor.h"
+
+MultiDeviceCapture::~MultiDeviceCapture()
+{
+    Stop();
+}
+
+bool MultiDeviceCapture::Start(const RigConfiguration& rigConfig, SyncMonitor* syncMonitor)
+{
+    std::vector<std::unique_ptr<CaptureSource>> sources;
+    for (const CaptureSourceConfig& sourceConfig : rigConfig.Devices)
+    {
+        sources.push_back(CreateCaptureSource(sourceConfig, rigConfig.DeviceConfig));
+    }
+    return Start(rigConfig, std::move(sources), syncMonitor);
+}
+
+bool MultiDeviceCapture::Start(const RigConfiguration& rigConfig,
+    std::vector<std::unique_ptr<CaptureSource>> sources,
+    SyncMonitor* syncMonitor)
+{
+    if (m_isRunning || sources.empty())
+    {
+        return false;
+    }
+    m_syncMonitor = syncMonitor;
+
+    for (std::unique_ptr<CaptureSource>& source : sources)
+    {
+        auto device = std::make_unique<DeviceSlot>(m_devices.size(), rigConfig.QueueCapacity);
+        device->Source = std::move(source);
+        if (!device->Source->Open())
+        {
+            m_devices.clear();
+            return false;
+        }
+        m_devices.push_back(std::move(device));
+    }
+
+    // Subordinates have to be started before the master, otherwise they miss the first sync pulses
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (auto& device : m_devices)
+        {
+            bool isSubordinate = device->Source->GetConfig().SyncMode == K4A_WIRED_SYNC_MODE_SUBORDINATE;
+            if ((pass == 0) != isSubordinate)
+            {
+                continue;
+            }
+
+            if (!device->Source->Start())
+            {
+                for (auto& startedDevice : m_devices)
+                {
+                    startedDevice->Source->Close();
+                }
+                m_devices.clear();
+                return false;
+            }
+        }
+    }
+
+    if (m_syncMonitor != nullptr)
+    {
+        std::vector<const CaptureSource*> sources;
+        for (auto& device : m_devices)
+        {
+            sources.push_back(device->Source.get());
+        }
+        m_syncMonitor->Initialize(rigConfig.Monitor, sources);
+    }
+
+    m_isRunning = true;
+    m_activeSources = m_devices.size();
+    for (auto& device : m_devices)
+    {
+        DeviceSlot* slot = device.get();
+        device->Thread = std::thread([this, slot]() { CaptureThread(*slot); });
+    }
+    return true;
+}
+
+void MultiDeviceCapture::Stop()
+{
+    m_isRunning = false;
+    for (auto& device : m_devices)
+    {
+        if (device->Thread.joinable())
+        {
+            device->Thread.join();
+        }
+    }
+
+    for (auto& device : m_devices)
+    {
+        k4a_capture_t capture = nullptr;
+        while (device->Queue.TryPop(capture))
+        {
+            k4a_capture_release(capture);
+        }
+
+        device->Source->Stop();
+        device->Source->Close();
+    }
+    m_devices.clear();
+    m_activeSources = 0;
+}
+
+bool MultiDeviceCapture::TryPopCapture(size_t deviceSlot, k4a_capture_t* capture)
+{
+    return m_devices[deviceSlot]->Queue.TryPop(*capture);
+}
+
+k4a_capture_t MultiDeviceCapture::PeekCapture(size_t deviceSlot) const
+{
+    const k4a_capture_t* front = m_devices[deviceSlot]->Queue.Front();
+    return front == nullptr ? nullptr : *front;
+}
+
+bool MultiDeviceCapture::WaitForCaptures(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_notifyMutex);
+    bool notified = m_notifyCondition.wait_for(lock, timeout, [this]() {
+        return m_notifySequence != m_consumedSequence || !m_isRunning;
+    });
+    m_consumedSequence = m_notifySequence;
+    return notified;
+}
+
+DeviceCaptureStatistics MultiDeviceCapture::GetStatistics(size_t deviceSlot) const
+{
+    const DeviceSlot& device = *m_devices[deviceSlot];
+    DeviceCaptureStatistics statistics;
+    statistics.Captured = device.Captured.load(std::memory_order_relaxed);
+    statistics.DroppedQueueFull = device.DroppedQueueFull.load(std::memory_order_relaxed);
+    statistics.Timeouts = device.Timeouts.load(std::memory_order_relaxed);
+    statistics.Failures = device.Failures.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void MultiDeviceCapture::CaptureThread(DeviceSlot& device)
+{
+    int consecutiveFailures = 0;
+    while (m_isRunning)
+    {
+        k4a_capture_t capture = nullptr;
+        k4a_wait_result_t result = device.Source->GetCapture(&capture, CaptureTimeoutInMs);
+        if (result != K4A_WAIT_RESULT_FAILED)
+        {
+            consecutiveFailures = 0;
+        }
+
+        if (result == K4A_WAIT_RESULT_SUCCEEDED)
+        {
+            // Recorded before the capture is queued, afterwards the consumer may already have released it
+            if (m_syncMonitor != nullptr)
+            {
+                m_syncMonitor->OnCapture(device.Slot, capture, device.Queue.Size());
+            }
+
+            // Never block the sensor thread: when the consumer is behind, the new capture is dropped and counted
+            if (device.Queue.TryPush(capture))
+            {
+                device.Captured.fetch_add(1, std::memory_order_relaxed);
+                NotifyConsumer();
+            }
+            else
+            {
+                if (m_syncMonitor != nullptr)
+                {
+                    m_syncMonitor->OnQueueFullDrop(device.Slot);
+                }
+                k4a_capture_release(capture);
+                device.DroppedQueueFull.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        else if (result == K4A_WAIT_RESULT_TIMEOUT)
+        {
+            device.Timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (device.Source->IsEndOfStream())
+        {
+            std::cout << device.Source->GetName() << " reached the end of the stream" << std::endl;
+            break;
+        }
+        else
+        {
+            device.Failures.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "Get capture from " << device.Source->GetName() << " returned error: " << result << std::endl;
+
+            // An unplugged device fails every call, it is given up like a stream that ended
+            if (++consecutiveFailures >= MaxConsecutiveFailures)
+            {
+                std::cout << device.Source->GetName() << " failed " << consecutiveFailures << " times in a row, giving up" << std::endl;
+                break;
+            }
+            const int32_t backoffInMs = std::min(MaxFailureBackoffInMs, FailureBackoffInMs << (consecutiveFailures - 1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoffInMs));
+        }
+    }
+
+    device.Active = false;
+    m_activeSources--;
+    NotifyConsumer();
+}
+
+void MultiDeviceCapture::NotifyConsumer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_notifyMutex);
+        m_notifySequence++;
+    }
+    m_notifyCondition.notify_one();
+}
@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#include "CaptureSource.h"
+#include "RigConfiguration.h"
+#include "SpscQueue.h"
+
+class SyncMonitor;
+
+struct DeviceCaptureStatistics
+{
+    uint64_t Captured = 0;          // Captures handed to the consumer queue
+    uint64_t DroppedQueueFull = 0;  // Captures released because the consumer did not keep up
+    uint64_t Timeouts = 0;
+    uint64_t Failures = 0;
+};
+
+// Device-count-agnostic capture engine. Each capture source gets its own capture thread, which pulls captures as
+// soon as they are available and hands them to the consumer through a bounded lock-free queue. A late device
+// therefore never delays the capture of the other devices.
+class MultiDeviceCapture
+{
+public:
+    ~MultiDeviceCapture();
+
+    // Open all sources in configuration order, start subordinates before the master and spawn the capture threads.
+    // The optional sync monitor is initialized with the opened sources before the capture threads start, it gets
+    // every capture on the capture threads and must outlive the capture.
+    bool Start(const RigConfiguration& rigConfig, SyncMonitor* syncMonitor = nullptr);
+
+    // Same as above with sources created by the caller instead of from rigConfig.Devices, one per device slot.
+    // Used by the self tests to run the engine on scripted sources.
+    bool Start(const RigConfiguration& rigConfig,
+        std::vector<std::unique_ptr<CaptureSource>> sources,
+        SyncMonitor* syncMonitor = nullptr);
+
+    // Stop the capture threads and the sources and release all queued captures
+    void Stop();
+
+    size_t GetDeviceCount() const { return m_devices.size(); }
+
+    const CaptureSource& GetSource(size_t deviceSlot) const { return *m_devices[deviceSlot]->Source; }
+
+    const k4a_calibration_t& GetCalibration(size_t deviceSlot) const { return m_devices[deviceSlot]->Source->GetCalibration(); }
+
+    // Consumer side. Must always be called from the same thread. On success the caller owns the capture.
+    bool TryPopCapture(size_t deviceSlot, k4a_capture_t* capture);
+
+    // Consumer side. Returns the oldest queued capture of a device without removing it, or nullptr.
+    k4a_capture_t PeekCapture(size_t deviceSlot) const;
+
+    // Block until a capture thread queued a new capture or the timeout expired
+    bool WaitForCaptures(std::chrono::milliseconds timeout);
+
+    size_t GetQueueDepth(size_t deviceSlot) const { return m_devices[deviceSlot]->Queue.Size(); }
+
+    DeviceCaptureStatistics GetStatistics(size_t deviceSlot) const;
+
+    // False once the source of the device reached its end of stream
+    bool IsDeviceActive(size_t deviceSlot) const { return m_devices[deviceSlot]->Active.load(); }
+
+    // False once every source reached its end of stream
+    bool HasActiveSources() const { return m_activeSources.load() > 0; }
+
+private:
+    struct DeviceSlot
+    {
+        DeviceSlot(size_t slot, size_t queueCapacity) : Slot(slot), Queue(queueCapacity) {}
+
+        size_t Slot;
+        std::unique_ptr<CaptureSource> Source;
+        SpscQueue<k4a_capture_t> Queue;
+        std::thread Thread;
+        std::atomic<bool> Active{ true };
+
+        std::atomic<uint64_t> Captured{ 0 };
+        std::atomic<uint64_t> DroppedQueueFull{ 0 };
+        std::atomic<uint64_t> Timeouts{ 0 };
+        std::atomic<uint64_t> Failures{ 0 };
+    };
+
+    void CaptureThread(DeviceSlot& device);
+
+    void NotifyConsumer();
+
+    std::vector<std::unique_ptr<DeviceSlot>> m_devices;
+    std::atomic<bool> m_isRunning{ false };
+    std::atomic<size_t> m_activeSources{ 0 };
+    SyncMonitor* m_syncMonitor = nullptr;
+
+    // Only used to wake up the consumer, the queues themselves are lock-free
+    std::mutex m_notifyMutex;
+    std::condition_variable m_notifyCondition;
+    uint64_t m_notifySequence = 0;
+    uint64_t m_consumedSequence = 0;
+
+    const int32_t CaptureTimeoutInMs = 250;
+
+    // A failing device is retried with a doubling wait and given up after this many failures in a row
+    const int MaxConsecutiveFailures = 8;
+    const int32_t FailureBackoffInMs = 10;
+    const int32_t MaxFailureBackoffInMs = 500;
+};
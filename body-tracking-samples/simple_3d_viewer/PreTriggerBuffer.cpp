@@ -0,0 +1,124 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "PreTriggerBuffer.h"
+
+#include <algorithm>
+
+static uint64_t GetImageBytes(k4a_image_t image)
+{
+    if (image == nullptr)
+    {
+        return 0;
+    }
+    uint64_t size = k4a_image_get_size(image);
+    k4a_image_release(image);
+    return size;
+}
+
+static uint64_t GetCaptureGroupBytes(const CaptureGroup& group)
+{
+    uint64_t bytes = 0;
+    for (size_t deviceSlot = 0; deviceSlot < group.GetDeviceCount(); deviceSlot++)
+    {
+        k4a_capture_t capture = group.GetCapture(deviceSlot);
+        if (capture != nullptr)
+        {
+            bytes += GetImageBytes(k4a_capture_get_depth_image(capture));
+            bytes += GetImageBytes(k4a_capture_get_color_image(capture));
+            bytes += GetImageBytes(k4a_capture_get_ir_image(capture));
+        }
+    }
+    return bytes;
+}
+
+PreTriggerBuffer::PreTriggerBuffer(const RecordingConfig& config)
+    : m_config(config)
+{
+}
+
+void PreTriggerBuffer::Push(CaptureGroup& group, std::time_t timestamp)
+{
+    BufferedGroup bufferedGroup;
+    bufferedGroup.Bytes = GetCaptureGroupBytes(group);
+    bufferedGroup.Group = std::move(group);
+    bufferedGroup.Timestamp = timestamp;
+
+    m_bytes += bufferedGroup.Bytes;
+    m_groups.push_back(std::move(bufferedGroup));
+
+    m_statistics.MaxBytes = std::max(m_statistics.MaxBytes, m_bytes);
+    m_statistics.MaxGroups = std::max(m_statistics.MaxGroups, m_groups.size());
+
+    Evict();
+}
+
+void PreTriggerBuffer::SetTriggered(bool triggered)
+{
+    if (m_isTriggered && !triggered && !m_groups.empty())
+    {
+        // Everything buffered up to now belongs to the event that just ended
+        m_eventEndGroupId = m_groups.back().Group.GetGroupId() + 1;
+        m_hasEventEnd = true;
+    }
+    m_isTriggered = triggered;
+}
+
+bool PreTriggerBuffer::TryPop(CaptureGroup& group, std::time_t& timestamp)
+{
+    if (m_groups.empty() || !IsPartOfEvent(m_groups.front()))
+    {
+        return false;
+    }
+
+    BufferedGroup& front = m_groups.front();
+    group = std::move(front.Group);
+    timestamp = front.Timestamp;
+    m_bytes -= front.Bytes;
+    m_groups.pop_front();
+    m_statistics.Released++;
+    return true;
+}
+
+uint64_t PreTriggerBuffer::GetDurationUsec() const
+{
+    if (m_groups.size() < 2)
+    {
+        return 0;
+    }
+
+    // Device timestamps go back when a device restarts, the groups are in arrival order, so the buffer then covers
+    // no measurable duration instead of a wrapped around one that would evict all of it
+    const uint64_t frontUsec = m_groups.front().Group.GetDeviceTimestampUsec(0);
+    const uint64_t backUsec = m_groups.back().Group.GetDeviceTimestampUsec(0);
+    return backUsec > frontUsec ? backUsec - frontUsec : 0;
+}
+
+bool PreTriggerBuffer::IsPartOfEvent(const BufferedGroup& bufferedGroup) const
+{
+    return m_isTriggered || (m_hasEventEnd && bufferedGroup.Group.GetGroupId() < m_eventEndGroupId);
+}
+
+void PreTriggerBuffer::Evict()
+{
+    // The memory bound always holds, even if that loses frames of an event the writer could not keep up with
+    while (m_groups.size() > 1 && m_bytes > m_config.PreTriggerMemoryBytes)
+    {
+        if (IsPartOfEvent(m_groups.front()))
+        {
+            m_statistics.EvictedRecording++;
+        }
+        m_bytes -= m_groups.front().Bytes;
+        m_groups.pop_front();
+        m_statistics.Evicted++;
+    }
+
+    // The duration bound only trims the pre-roll, groups of an event wait until they are written
+    const uint64_t maxDurationUsec = (uint64_t)m_config.PreTriggerMsec * 1000;
+    while (!m_groups.empty() && !IsPartOfEvent(m_groups.front()) && GetDurationUsec() > maxDurationUsec)
+    {
+        m_bytes -= m_groups.front().Bytes;
+        m_groups.pop_front();
+        m_statistics.Evicted++;
+    }
+}
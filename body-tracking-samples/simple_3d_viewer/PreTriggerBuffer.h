@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <ctime>
+#include <deque>
+
+#include "RigConfiguration.h"
+#include "SyncGrouper.h"
+
+struct PreTriggerStatistics
+{
+    uint64_t Evicted = 0;           // Groups released unwritten because the history exceeded its duration or memory
+    uint64_t EvictedRecording = 0;  // Of those, groups that were part of an event: the writer fell too far behind
+    uint64_t Released = 0;          // Groups handed out for writing
+    uint64_t MaxBytes = 0;
+    size_t MaxGroups = 0;
+};
+
+// In-memory history of the last capture groups for triggered recording. The groups keep their references on the
+// captures, so buffering does not copy any image. While the trigger is off the history is trimmed to the
+// configured duration and memory; when it turns on the buffered pre-roll is released oldest first, followed by the
+// live groups, until the trigger turns off again and the groups of the event have been released.
+//
+// The consumer pulls groups with TryPop() whenever the writer has room, so flushing seconds of pre-roll never
+// stalls the capture loop. Not thread-safe, used from the thread that consumes the groups.
+class PreTriggerBuffer
+{
+public:
+    explicit PreTriggerBuffer(const RecordingConfig& config);
+
+    // Takes over the captures of the group, group is left empty
+    void Push(CaptureGroup& group, std::time_t timestamp);
+
+    // Called every iteration with the current trigger state
+    void SetTriggered(bool triggered);
+
+    // Oldest group that has to be written, if any
+    bool TryPop(CaptureGroup& group, std::time_t& timestamp);
+
+    size_t GetGroupCount() const { return m_groups.size(); }
+
+    uint64_t GetBytes() const { return m_bytes; }
+
+    // Duration covered by the buffered groups, from the device timestamps of the first device
+    uint64_t GetDurationUsec() const;
+
+    const PreTriggerStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+    struct BufferedGroup
+    {
+        CaptureGroup Group;
+        std::time_t Timestamp = 0;
+        uint64_t Bytes = 0;
+    };
+
+    void Evict();
+
+    bool IsPartOfEvent(const BufferedGroup& bufferedGroup) const;
+
+    RecordingConfig m_config;
+    std::deque<BufferedGroup> m_groups;
+    uint64_t m_bytes = 0;
+
+    bool m_isTriggered = false;
+
+    // Groups below this id were pushed before the last event ended and still have to be written
+    uint64_t m_eventEndGroupId = 0;
+    bool m_hasEventEnd = false;
+
+    PreTriggerStatistics m_statistics;
+};
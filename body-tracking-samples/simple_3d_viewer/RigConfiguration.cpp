@@ -0,0 +1,414 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "RigConfiguration.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <jsoncons/json.hpp>
+
+RigConfiguration CreateDefaultRigConfiguration(k4a_depth_mode_t depthMode)
+{
+    RigConfiguration rigConfig;
+    rigConfig.DeviceConfig.depth_mode = depthMode;
+    rigConfig.DeviceConfig.color_resolution = K4A_COLOR_RESOLUTION_720P;
+    rigConfig.DeviceConfig.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32; //K4A_IMAGE_FORMAT_COLOR_MJPG
+    rigConfig.DeviceConfig.synchronized_images_only = true;
+    rigConfig.DeviceConfig.camera_fps = K4A_FRAMES_PER_SECOND_5;
+
+    for (uint32_t deviceIndex = 0; deviceIndex < 3; deviceIndex++)
+    {
+        CaptureSourceConfig device;
+        device.Type = CaptureSourceType::Device;
+        device.DeviceIndex = deviceIndex;
+        device.SyncMode = deviceIndex == 0 ? K4A_WIRED_SYNC_MODE_MASTER : K4A_WIRED_SYNC_MODE_SUBORDINATE;
+        rigConfig.Devices.push_back(device);
+    }
+    return rigConfig;
+}
+
+static bool ParseDepthMode(const std::string& value, k4a_depth_mode_t& depthMode)
+{
+    if (value == "NFOV_2X2BINNED") depthMode = K4A_DEPTH_MODE_NFOV_2X2BINNED;
+    else if (value == "NFOV_UNBINNED") depthMode = K4A_DEPTH_MODE_NFOV_UNBINNED;
+    else if (value == "WFOV_2X2BINNED" || value == "WFOV_BINNED") depthMode = K4A_DEPTH_MODE_WFOV_2X2BINNED;
+    else if (value == "WFOV_UNBINNED") depthMode = K4A_DEPTH_MODE_WFOV_UNBINNED;
+    else return false;
+    return true;
+}
+
+static bool ParseColorResolution(const std::string& value, k4a_color_resolution_t& colorResolution)
+{
+    if (value == "OFF") colorResolution = K4A_COLOR_RESOLUTION_OFF;
+    else if (value == "720P") colorResolution = K4A_COLOR_RESOLUTION_720P;
+    else if (value == "1080P") colorResolution = K4A_COLOR_RESOLUTION_1080P;
+    else if (value == "1440P") colorResolution = K4A_COLOR_RESOLUTION_1440P;
+    else if (value == "1536P") colorResolution = K4A_COLOR_RESOLUTION_1536P;
+    else if (value == "2160P") colorResolution = K4A_COLOR_RESOLUTION_2160P;
+    else if (value == "3072P") colorResolution = K4A_COLOR_RESOLUTION_3072P;
+    else return false;
+    return true;
+}
+
+static bool ParseFps(int value, k4a_fps_t& fps)
+{
+    switch (value)
+    {
+    case 5: fps = K4A_FRAMES_PER_SECOND_5; return true;
+    case 15: fps = K4A_FRAMES_PER_SECOND_15; return true;
+    case 30: fps = K4A_FRAMES_PER_SECOND_30; return true;
+    default: return false;
+    }
+}
+
+static bool ParseSyncMode(const std::string& value, k4a_wired_sync_mode_t& syncMode)
+{
+    if (value == "master") syncMode = K4A_WIRED_SYNC_MODE_MASTER;
+    else if (value == "subordinate") syncMode = K4A_WIRED_SYNC_MODE_SUBORDINATE;
+    else if (value == "standalone") syncMode = K4A_WIRED_SYNC_MODE_STANDALONE;
+    else return false;
+    return true;
+}
+
+static bool ParseSourceType(const std::string& value, CaptureSourceType& type)
+{
+    if (value == "device") type = CaptureSourceType::Device;
+    else if (value == "playback") type = CaptureSourceType::Playback;
+    else if (value == "synthetic") type = CaptureSourceType::Synthetic;
+    else return false;
+    return true;
+}
+
+static bool ParseSyncPolicy(const std::string& value, SyncGroupPolicy& policy)
+{
+    if (value == "drop_oldest") policy = SyncGroupPolicy::DropOldest;
+    else if (value == "wait_for_all") policy = SyncGroupPolicy::WaitForAll;
+    else return false;
+    return true;
+}
+
+static bool ParseWriterPolicy(const std::string& value, FrameWriterQueuePolicy& policy)
+{
+    if (value == "block") policy = FrameWriterQueuePolicy::Block;
+    else if (value == "drop") policy = FrameWriterQueuePolicy::Drop;
+    else return false;
+    return true;
+}
+
+static bool ParseWriterOutput(const std::string& value, FrameWriterOutput& output)
+{
+    if (value == "files") output = FrameWriterOutput::Files;
+    else if (value == "container") output = FrameWriterOutput::Container;
+    else return false;
+    return true;
+}
+
+static bool ParseDepthEncoding(const std::string& value, FrameWriterDepthEncoding& encoding)
+{
+    if (value == "standard") encoding = FrameWriterDepthEncoding::Standard;
+    else if (value == "codec") encoding = FrameWriterDepthEncoding::Codec;
+    else return false;
+    return true;
+}
+
+static bool ParseRecordingMode(const std::string& value, RecordingMode& mode)
+{
+    if (value == "triggered") mode = RecordingMode::Triggered;
+    else if (value == "continuous") mode = RecordingMode::Continuous;
+    else return false;
+    return true;
+}
+
+static bool ParseMonitorFormat(const std::string& value, SyncMonitorFormat& format)
+{
+    if (value == "json") format = SyncMonitorFormat::Json;
+    else if (value == "csv") format = SyncMonitorFormat::Csv;
+    else return false;
+    return true;
+}
+
+static bool ParseExtrinsics(const jsoncons::json& value, k4a_calibration_extrinsics_t& extrinsics)
+{
+    if (!value.contains("rotation") || value["rotation"].size() != 9 ||
+        !value.contains("translation_mm") || value["translation_mm"].size() != 3)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < 9; i++)
+    {
+        extrinsics.rotation[i] = value["rotation"][i].as<float>();
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+        extrinsics.translation[i] = value["translation_mm"][i].as<float>();
+    }
+    return true;
+}
+
+static bool ParseRenderLayout(const std::string& value, SessionRenderLayout& layout)
+{
+    if (value == "main_view") layout = SessionRenderLayout::MainView;
+    else if (value == "four_views") layout = SessionRenderLayout::FourViews;
+    else return false;
+    return true;
+}
+
+bool LoadRigConfiguration(const std::string& path, RigConfiguration& rigConfig)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cout << "Cannot open rig configuration " << path << std::endl;
+        return false;
+    }
+
+    try
+    {
+        jsoncons::json root = jsoncons::json::parse(file);
+        k4a_device_configuration_t& deviceConfig = rigConfig.DeviceConfig;
+
+        if (root.contains("depth_mode") && !ParseDepthMode(root["depth_mode"].as<std::string>(), deviceConfig.depth_mode))
+        {
+            std::cout << "Unknown depth_mode in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("color_resolution") && !ParseColorResolution(root["color_resolution"].as<std::string>(), deviceConfig.color_resolution))
+        {
+            std::cout << "Unknown color_resolution in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("camera_fps") && !ParseFps(root["camera_fps"].as<int>(), deviceConfig.camera_fps))
+        {
+            std::cout << "camera_fps must be 5, 15 or 30 in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("depth_delay_off_color_usec"))
+        {
+            deviceConfig.depth_delay_off_color_usec = root["depth_delay_off_color_usec"].as<int32_t>();
+        }
+        if (root.contains("queue_capacity"))
+        {
+            rigConfig.QueueCapacity = root["queue_capacity"].as<size_t>();
+            if (rigConfig.QueueCapacity == 0 || (rigConfig.QueueCapacity & (rigConfig.QueueCapacity - 1)) != 0)
+            {
+                std::cout << "queue_capacity must be a power of two in " << path << std::endl;
+                return false;
+            }
+        }
+        if (root.contains("sync_policy") && !ParseSyncPolicy(root["sync_policy"].as<std::string>(), rigConfig.Sync.Policy))
+        {
+            std::cout << "sync_policy must be drop_oldest or wait_for_all in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("sync_tolerance_usec"))
+        {
+            rigConfig.Sync.ToleranceUsec = root["sync_tolerance_usec"].as<uint32_t>();
+        }
+        if (root.contains("sync_max_pending_captures"))
+        {
+            rigConfig.Sync.MaxPendingCaptures = root["sync_max_pending_captures"].as<size_t>();
+        }
+        if (root.contains("writer_output") && !ParseWriterOutput(root["writer_output"].as<std::string>(), rigConfig.Writer.Output))
+        {
+            std::cout << "writer_output must be files or container in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("depth_encoding") && !ParseDepthEncoding(root["depth_encoding"].as<std::string>(), rigConfig.Writer.DepthEncoding))
+        {
+            std::cout << "depth_encoding must be standard or codec in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("depth_keyframe_interval"))
+        {
+            rigConfig.Writer.DepthKeyframeInterval = std::max<size_t>(root["depth_keyframe_interval"].as<size_t>(), 1);
+        }
+        if (root.contains("container_path"))
+        {
+            rigConfig.Writer.ContainerPath = root["container_path"].as<std::string>();
+        }
+        if (root.contains("container_chunk_size_mb"))
+        {
+            rigConfig.Writer.ContainerChunkSize = root["container_chunk_size_mb"].as<uint64_t>() * 1024 * 1024;
+        }
+        if (root.contains("writer_policy") && !ParseWriterPolicy(root["writer_policy"].as<std::string>(), rigConfig.Writer.Policy))
+        {
+            std::cout << "writer_policy must be block or drop in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("writer_queue_depth"))
+        {
+            rigConfig.Writer.QueueDepth = root["writer_queue_depth"].as<size_t>();
+            if (rigConfig.Writer.QueueDepth == 0)
+            {
+                std::cout << "writer_queue_depth must be at least 1 in " << path << std::endl;
+                return false;
+            }
+        }
+        if (root.contains("writer_threads"))
+        {
+            rigConfig.Writer.ThreadCount = root["writer_threads"].as<size_t>();
+            if (rigConfig.Writer.ThreadCount == 0)
+            {
+                std::cout << "writer_threads must be at least 1 in " << path << std::endl;
+                return false;
+            }
+        }
+        if (root.contains("recording_mode") && !ParseRecordingMode(root["recording_mode"].as<std::string>(), rigConfig.Recording.Mode))
+        {
+            std::cout << "recording_mode must be triggered or continuous in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("pre_trigger_seconds"))
+        {
+            rigConfig.Recording.PreTriggerMsec = (uint32_t)(root["pre_trigger_seconds"].as<double>() * 1000);
+        }
+        if (root.contains("pre_trigger_memory_mb"))
+        {
+            rigConfig.Recording.PreTriggerMemoryBytes = root["pre_trigger_memory_mb"].as<uint64_t>() * 1024 * 1024;
+        }
+        if (root.contains("monitor_path"))
+        {
+            rigConfig.Monitor.Path = root["monitor_path"].as<std::string>();
+        }
+        if (root.contains("monitor_format") && !ParseMonitorFormat(root["monitor_format"].as<std::string>(), rigConfig.Monitor.Format))
+        {
+            std::cout << "monitor_format must be json or csv in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("monitor_interval_seconds"))
+        {
+            rigConfig.Monitor.IntervalMsec = (uint32_t)(root["monitor_interval_seconds"].as<double>() * 1000);
+        }
+        if (root.contains("render_output_directory"))
+        {
+            rigConfig.Render.OutputDirectory = root["render_output_directory"].as<std::string>();
+        }
+        if (root.contains("render_workers"))
+        {
+            rigConfig.Render.WorkerCount = root["render_workers"].as<size_t>();
+        }
+        if (root.contains("render_slice_seconds"))
+        {
+            rigConfig.Render.SliceSeconds = root["render_slice_seconds"].as<uint32_t>();
+        }
+        if (root.contains("render_width"))
+        {
+            rigConfig.Render.Width = root["render_width"].as<int>();
+        }
+        if (root.contains("render_height"))
+        {
+            rigConfig.Render.Height = root["render_height"].as<int>();
+        }
+        if (root.contains("render_layout") && !ParseRenderLayout(root["render_layout"].as<std::string>(), rigConfig.Render.Layout))
+        {
+            std::cout << "render_layout must be main_view or four_views in " << path << std::endl;
+            return false;
+        }
+        if (root.contains("render_joint_frames"))
+        {
+            rigConfig.Render.JointFrames = root["render_joint_frames"].as<bool>();
+        }
+        if (root.contains("render_body_tracking"))
+        {
+            rigConfig.Render.BodyTracking = root["render_body_tracking"].as<bool>();
+        }
+        if (root.contains("render_codec"))
+        {
+            rigConfig.Render.Codec = root["render_codec"].as<std::string>();
+            if (rigConfig.Render.Codec.size() != 4)
+            {
+                std::cout << "render_codec must be a FourCC like MJPG in " << path << std::endl;
+                return false;
+            }
+        }
+        if (root.contains("render_encoder_queue_depth"))
+        {
+            rigConfig.Render.EncoderQueueDepth = std::max<size_t>(root["render_encoder_queue_depth"].as<size_t>(), 1);
+        }
+
+        uint32_t defaultSubordinateDelayUsec = 0;
+        if (root.contains("subordinate_delay_off_master_usec"))
+        {
+            defaultSubordinateDelayUsec = root["subordinate_delay_off_master_usec"].as<uint32_t>();
+        }
+
+        if (root.contains("devices"))
+        {
+            rigConfig.Devices.clear();
+            uint32_t slot = 0;
+            for (const auto& entry : root["devices"].array_range())
+            {
+                CaptureSourceConfig device;
+                device.DeviceIndex = slot;
+                device.SubordinateDelayOffMasterUsec = defaultSubordinateDelayUsec;
+
+                if (entry.contains("source") && !ParseSourceType(entry["source"].as<std::string>(), device.Type))
+                {
+                    std::cout << "Unknown source type for device " << slot << " in " << path << std::endl;
+                    return false;
+                }
+                if (entry.contains("role") && !ParseSyncMode(entry["role"].as<std::string>(), device.SyncMode))
+                {
+                    std::cout << "Unknown role for device " << slot << " in " << path << std::endl;
+                    return false;
+                }
+                if (entry.contains("index"))
+                {
+                    device.DeviceIndex = entry["index"].as<uint32_t>();
+                }
+                if (entry.contains("path"))
+                {
+                    device.Path = entry["path"].as<std::string>();
+                }
+                if (entry.contains("subordinate_delay_off_master_usec"))
+                {
+                    device.SubordinateDelayOffMasterUsec = entry["subordinate_delay_off_master_usec"].as<uint32_t>();
+                }
+                if (entry.contains("real_time"))
+                {
+                    device.RealTime = entry["real_time"].as<bool>();
+                }
+                if (entry.contains("loop"))
+                {
+                    device.Loop = entry["loop"].as<bool>();
+                }
+                if (entry.contains("depth_to_rig") && !ParseExtrinsics(entry["depth_to_rig"], device.DepthToRig))
+                {
+                    std::cout << "depth_to_rig of device " << slot << " needs 9 rotation and 3 translation_mm values in " << path << std::endl;
+                    return false;
+                }
+
+                if (device.Type == CaptureSourceType::Playback && device.Path.empty())
+                {
+                    std::cout << "Playback device " << slot << " needs a path in " << path << std::endl;
+                    return false;
+                }
+
+                rigConfig.Devices.push_back(device);
+                slot++;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Failed to parse rig configuration " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    if (rigConfig.Devices.empty())
+    {
+        std::cout << "Rig configuration " << path << " does not contain any device" << std::endl;
+        return false;
+    }
+
+    // A group is written as one job per device, the pre-trigger buffer only hands over complete groups
+    if (rigConfig.Writer.QueueDepth < rigConfig.Devices.size())
+    {
+        std::cout << "writer_queue_depth must be at least the number of devices (" << rigConfig.Devices.size() << ") in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,215 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#include "CaptureSource.h"
+
+enum class SyncGroupPolicy
+{
+    DropOldest = 0, // Discard the oldest partial group once a device falls behind by more than MaxPendingCaptures
+    WaitForAll      // Keep waiting until every device delivered a matching capture
+};
+
+// Matching of captures across devices by device timestamp. The expected subordinate delay is removed from
+// the subordinate timestamps before comparing them.
+struct SyncGroupConfig
+{
+    SyncGroupPolicy Policy = SyncGroupPolicy::DropOldest;
+
+    // Maximum difference between the (delay compensated) device timestamps of one group
+    uint32_t ToleranceUsec = 100;
+
+    // DropOldest: number of captures any device may have queued while another device has none
+    size_t MaxPendingCaptures = 2;
+};
+
+enum class FrameWriterQueuePolicy
+{
+    Block = 0,  // The capture loop waits for space in the write queue, nothing is lost
+    Drop        // Frames that do not fit into the write queue are not written
+};
+
+enum class FrameWriterOutput
+{
+    Files = 0,  // Depth PNG, registered color JPEG and PLY files per frame
+    Container   // Raw depth and color images of all devices appended to one session container
+};
+
+enum class FrameWriterDepthEncoding
+{
+    Standard = 0,   // 16 bit PNG files, raw DEPTH16 payloads in the container
+    Codec           // Lossless DepthCodec streams (.k4dz files, Depth16Codec payloads in the container)
+};
+
+// Background encoding and writing of the captured frames
+struct FrameWriterConfig
+{
+    FrameWriterOutput Output = FrameWriterOutput::Files;
+
+    FrameWriterDepthEncoding DepthEncoding = FrameWriterDepthEncoding::Standard;
+
+    // Codec: every n-th depth frame of a device is coded on its own, the frames in between may predict from it.
+    // 1 disables temporal prediction.
+    size_t DepthKeyframeInterval = 30;
+
+    // Container: path prefix of the index and chunk files. Empty selects session_<time>.
+    std::string ContainerPath;
+
+    uint64_t ContainerChunkSize = 1024ull * 1024 * 1024;
+
+    FrameWriterQueuePolicy Policy = FrameWriterQueuePolicy::Block;
+
+    // Number of device frames that can wait for an encoder thread, at least the number of devices
+    size_t QueueDepth = 16;
+
+    size_t ThreadCount = 3;
+};
+
+enum class RecordingMode
+{
+    Triggered = 0,  // Keep a pre-trigger history in memory, write it and the live frames while writing mode is on
+    Continuous      // Write every group, regardless of writing mode
+};
+
+// When frames are written. In triggered mode the history is bounded by both its duration and its memory.
+struct RecordingConfig
+{
+    RecordingMode Mode = RecordingMode::Triggered;
+
+    uint32_t PreTriggerMsec = 5000;
+
+    uint64_t PreTriggerMemoryBytes = 2048ull * 1024 * 1024;
+};
+
+enum class SyncMonitorFormat
+{
+    Json = 0,   // Latest snapshot, the file is rewritten on every dump
+    Csv         // One block of rows per dump appended to the file
+};
+
+// Periodic dump of the sync quality histograms
+struct SyncMonitorConfig
+{
+    // Empty disables the dumps, the summary is still printed on exit
+    std::string Path;
+
+    SyncMonitorFormat Format = SyncMonitorFormat::Json;
+
+    uint32_t IntervalMsec = 5000;
+};
+
+enum class SessionRenderLayout
+{
+    MainView = 0,   // The main 3d view only
+    FourViews       // Left, right, main and top view in one frame
+};
+
+// Every body tracker holds its model in GPU memory and shares the GPU with the others
+const size_t DefaultRenderWorkerCount = 2;
+
+// Offline rendering of recordings into video files (RENDER mode)
+struct SessionRenderConfig
+{
+    // Receives one video file per recording or time slice
+    std::string OutputDirectory = ".";
+
+    // Parallel workers, each with its own offscreen context, body tracker and encoder thread. 0 uses one per core
+    // without body tracking and DefaultRenderWorkerCount with it.
+    size_t WorkerCount = DefaultRenderWorkerCount;
+
+    // Recordings are split into slices of this length that are rendered in parallel. 0 renders every recording as
+    // a single slice.
+    uint32_t SliceSeconds = 60;
+
+    int Width = 1280;
+    int Height = 720;
+
+    SessionRenderLayout Layout = SessionRenderLayout::FourViews;
+
+    bool JointFrames = false;
+
+    // Without body tracking only the point clouds are rendered
+    bool BodyTracking = true;
+
+    // FourCC of the video codec
+    std::string Codec = "MJPG";
+
+    // Rendered frames of a worker that can wait for its encoder thread
+    size_t EncoderQueueDepth = 8;
+};
+
+// Describes a multi-device rig. The order of Devices defines the device slot of every capture source, which is
+// used for file naming and for grouping. Roles (master/subordinate) are part of each entry.
+struct RigConfiguration
+{
+    // Camera settings shared by all devices. wired_sync_mode/subordinate_delay_off_master_usec are overridden
+    // per device from the entries in Devices.
+    k4a_device_configuration_t DeviceConfig = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+
+    std::vector<CaptureSourceConfig> Devices;
+
+    // Number of captures each device can buffer before new captures are dropped, a power of two
+    size_t QueueCapacity = 8;
+
+    SyncGroupConfig Sync;
+
+    FrameWriterConfig Writer;
+
+    RecordingConfig Recording;
+
+    SyncMonitorConfig Monitor;
+
+    SessionRenderConfig Render;
+};
+
+// The historical 3 camera rig: device 0 is master, device 1 and 2 are subordinates
+RigConfiguration CreateDefaultRigConfiguration(k4a_depth_mode_t depthMode);
+
+// Load a rig description from a json file, overriding the fields present in the file. Example:
+// {
+//     "depth_mode": "NFOV_UNBINNED",
+//     "color_resolution": "720P",
+//     "camera_fps": 5,
+//     "subordinate_delay_off_master_usec": 160,
+//     "queue_capacity": 8,
+//     "sync_policy": "drop_oldest",
+//     "sync_tolerance_usec": 100,
+//     "sync_max_pending_captures": 2,
+//     "writer_output": "container",
+//     "depth_encoding": "codec",
+//     "depth_keyframe_interval": 30,
+//     "container_path": "session",
+//     "container_chunk_size_mb": 1024,
+//     "writer_policy": "block",
+//     "writer_queue_depth": 16,
+//     "writer_threads": 3,
+//     "recording_mode": "triggered",
+//     "pre_trigger_seconds": 5,
+//     "pre_trigger_memory_mb": 2048,
+//     "monitor_path": "sync_quality.json",
+//     "monitor_format": "json",
+//     "monitor_interval_seconds": 5,
+//     "render_output_directory": "videos",
+//     "render_workers": 2,
+//     "render_slice_seconds": 60,
+//     "render_width": 1280,
+//     "render_height": 720,
+//     "render_layout": "four_views",
+//     "render_joint_frames": false,
+//     "render_body_tracking": true,
+//     "render_codec": "MJPG",
+//     "render_encoder_queue_depth": 8,
+//     "devices": [
+//         { "source": "device", "index": 0, "role": "master" },
+//         { "source": "playback", "path": "sub1.mkv", "role": "subordinate",
+//           "depth_to_rig": { "rotation": [0, 0, -1, 0, 1, 0, 1, 0, 0], "translation_mm": [1500, 0, 1500] } },
+//         { "source": "synthetic", "role": "subordinate", "real_time": true }
+//     ]
+// }
+bool LoadRigConfiguration(const std::string& path, RigConfiguration& rigConfig);
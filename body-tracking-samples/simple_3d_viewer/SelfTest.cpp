@@ -0,0 +1,523 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "SelfTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <BrownConradyCamera.h>
+
+#include "CaptureContainer.h"
+#include "DepthCodec.h"
+#include "MultiDeviceCapture.h"
+#include "RigConfiguration.h"
+#include "SpscQueue.h"
+#include "SyncGrouper.h"
+
+// Reports the failed condition and fails the current test
+#define SELF_TEST_CHECK(condition)                                                          \
+    if (!(condition))                                                                       \
+    {                                                                                       \
+        std::cout << "  " << __FILE__ << "(" << __LINE__ << "): " #condition << std::endl;  \
+        return false;                                                                       \
+    }
+
+/**************************************** SpscQueue ****************************************/
+
+static bool TestSpscQueueWraparound()
+{
+    SpscQueue<int> queue(5);
+    SELF_TEST_CHECK(queue.Capacity() == 8);
+
+    // The indices run many times around the slots, with the queue empty, partially filled and full
+    int pushed = 0;
+    int popped = 0;
+    for (int round = 0; round < 100; round++)
+    {
+        const int count = round % 9;
+        for (int i = 0; i < count; i++)
+        {
+            SELF_TEST_CHECK(queue.TryPush(pushed));
+            pushed++;
+        }
+        SELF_TEST_CHECK(queue.Size() == (size_t)count);
+        if (count == 8)
+        {
+            SELF_TEST_CHECK(!queue.TryPush(-1));
+            SELF_TEST_CHECK(queue.Size() == 8);
+        }
+
+        SELF_TEST_CHECK(count == 0 ? queue.Front() == nullptr : *queue.Front() == popped);
+        int item = -1;
+        while (queue.TryPop(item))
+        {
+            SELF_TEST_CHECK(item == popped);
+            popped++;
+        }
+        SELF_TEST_CHECK(queue.Size() == 0);
+    }
+    SELF_TEST_CHECK(pushed == popped);
+    return true;
+}
+
+static bool TestSpscQueueThreads()
+{
+    const int ItemCount = 200000;
+    SpscQueue<int> queue(16);
+    std::atomic<bool> sizeInRange{ true };
+    std::atomic<bool> isRunning{ true };
+
+    std::thread producer([&]() {
+        for (int i = 0; i < ItemCount; i++)
+        {
+            while (!queue.TryPush(i))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // Size() from a third thread is approximate, but never beyond the capacity
+    std::thread observer([&]() {
+        while (isRunning)
+        {
+            if (queue.Size() > queue.Capacity())
+            {
+                sizeInRange = false;
+            }
+        }
+    });
+
+    int expected = 0;
+    bool inOrder = true;
+    while (expected < ItemCount)
+    {
+        int item = 0;
+        if (queue.TryPop(item))
+        {
+            inOrder = inOrder && item == expected;
+            expected++;
+        }
+    }
+    producer.join();
+    isRunning = false;
+    observer.join();
+
+    SELF_TEST_CHECK(inOrder);
+    SELF_TEST_CHECK(sizeInRange);
+    SELF_TEST_CHECK(queue.Size() == 0);
+    return true;
+}
+
+/**************************************** SyncGrouper ****************************************/
+
+// Delivers a depth-only capture for every scripted device timestamp as fast as possible, then ends the stream
+class ScriptedCaptureSource : public CaptureSource
+{
+public:
+    ScriptedCaptureSource(const CaptureSourceConfig& config,
+        const k4a_device_configuration_t& deviceConfig,
+        std::vector<uint64_t> timestampsUsec)
+        : CaptureSource(config, deviceConfig)
+        , m_timestampsUsec(std::move(timestampsUsec))
+    {
+        m_name = "scripted";
+    }
+
+    bool Open() override { return true; }
+    bool Start() override { return true; }
+    void Stop() override {}
+    void Close() override {}
+
+    k4a_wait_result_t GetCapture(k4a_capture_t* capture, int32_t /*timeoutInMs*/) override
+    {
+        if (m_next >= m_timestampsUsec.size())
+        {
+            return K4A_WAIT_RESULT_FAILED;
+        }
+
+        k4a_image_t depthImage = nullptr;
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16, 2, 2, 4, &depthImage))
+        {
+            return K4A_WAIT_RESULT_FAILED;
+        }
+        if (K4A_RESULT_SUCCEEDED != k4a_capture_create(capture))
+        {
+            k4a_image_release(depthImage);
+            return K4A_WAIT_RESULT_FAILED;
+        }
+        k4a_image_set_device_timestamp_usec(depthImage, m_timestampsUsec[m_next++]);
+        k4a_capture_set_depth_image(*capture, depthImage);
+        k4a_image_release(depthImage);
+        return K4A_WAIT_RESULT_SUCCEEDED;
+    }
+
+    bool IsEndOfStream() const override { return m_next >= m_timestampsUsec.size(); }
+
+private:
+    std::vector<uint64_t> m_timestampsUsec;
+    size_t m_next = 0;
+};
+
+// Master and two subordinates with a delay of 160 usec. Device 2 misses frame 3, device 1 is off by 300 usec in
+// frame 5 and by exactly the tolerance in frame 7, and device 2 ends one frame early. All captures are queued before
+// grouping starts, so the result does not depend on thread timing.
+static bool TestSyncGrouper(SyncGroupPolicy policy)
+{
+    const uint64_t FramePeriodUsec = 33333;
+    const uint64_t DelayUsec = 160;
+    const uint32_t ToleranceUsec = 100;
+    const uint64_t FrameCount = 12;
+
+    RigConfiguration rigConfig;
+    rigConfig.QueueCapacity = 32;
+    rigConfig.Sync.Policy = policy;
+    rigConfig.Sync.ToleranceUsec = ToleranceUsec;
+
+    std::vector<std::unique_ptr<CaptureSource>> sources;
+    for (size_t deviceSlot = 0; deviceSlot < 3; deviceSlot++)
+    {
+        CaptureSourceConfig sourceConfig;
+        sourceConfig.SyncMode = deviceSlot == 0 ? K4A_WIRED_SYNC_MODE_MASTER : K4A_WIRED_SYNC_MODE_SUBORDINATE;
+        sourceConfig.SubordinateDelayOffMasterUsec = deviceSlot == 0 ? 0 : (uint32_t)DelayUsec;
+
+        std::vector<uint64_t> timestampsUsec;
+        for (uint64_t frame = 0; frame < FrameCount; frame++)
+        {
+            uint64_t timestampUsec = 1000000 + frame * FramePeriodUsec + (deviceSlot == 0 ? 0 : DelayUsec);
+            if (deviceSlot == 1 && frame == 5)
+            {
+                timestampUsec += 300;
+            }
+            if (deviceSlot == 1 && frame == 7)
+            {
+                timestampUsec += ToleranceUsec;
+            }
+            if (deviceSlot == 2 && (frame == 3 || frame == FrameCount - 1))
+            {
+                continue;
+            }
+            timestampsUsec.push_back(timestampUsec);
+        }
+        sources.push_back(std::make_unique<ScriptedCaptureSource>(sourceConfig, rigConfig.DeviceConfig, timestampsUsec));
+    }
+
+    MultiDeviceCapture multiDeviceCapture;
+    SELF_TEST_CHECK(multiDeviceCapture.Start(rigConfig, std::move(sources)));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (multiDeviceCapture.HasActiveSources() && std::chrono::steady_clock::now() < deadline)
+    {
+        multiDeviceCapture.WaitForCaptures(std::chrono::milliseconds(10));
+    }
+    SELF_TEST_CHECK(!multiDeviceCapture.HasActiveSources());
+
+    SyncGrouper syncGrouper(multiDeviceCapture, rigConfig.Sync);
+    CaptureGroup group;
+    std::vector<uint64_t> frames;
+    bool complete = true;
+    while (syncGrouper.TryGetGroup(group))
+    {
+        frames.push_back((group.GetDeviceTimestampUsec(0) - 1000000) / FramePeriodUsec);
+        for (size_t deviceSlot = 0; deviceSlot < group.GetDeviceCount(); deviceSlot++)
+        {
+            complete = complete && group.GetCapture(deviceSlot) != nullptr;
+        }
+    }
+    bool drained = true;
+    for (size_t deviceSlot = 0; deviceSlot < multiDeviceCapture.GetDeviceCount(); deviceSlot++)
+    {
+        drained = drained && multiDeviceCapture.PeekCapture(deviceSlot) == nullptr;
+    }
+    const SyncGroupStatistics statistics = syncGrouper.GetStatistics();
+    group.Reset();
+    multiDeviceCapture.Stop();
+
+    // Frames 3 and 5 can not be matched and the last frame never completes
+    SELF_TEST_CHECK(frames == std::vector<uint64_t>({ 0, 1, 2, 4, 6, 7, 8, 9, 10 }));
+    SELF_TEST_CHECK(complete);
+    SELF_TEST_CHECK(drained);
+    SELF_TEST_CHECK(statistics.Groups == frames.size());
+    SELF_TEST_CHECK(statistics.MaxSkewUsec == ToleranceUsec);
+    SELF_TEST_CHECK(statistics.DroppedCaptures == std::vector<uint64_t>({ 3, 3, 1 }));
+    return true;
+}
+
+/**************************************** DepthCodec ****************************************/
+
+// Flat wall with noise, a box and invalid (zero) pixels, like a real depth image
+static void FillDepth(std::vector<uint16_t>& depth, int width, int height, int strideBytes, int frame, std::mt19937& random)
+{
+    const int stridePixels = strideBytes / (int)sizeof(uint16_t);
+    depth.assign((size_t)stridePixels * height, 0xABCD);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const bool insideBox = x >= frame && x < frame + width / 4 && y >= height / 3 && y < 2 * height / 3;
+            uint16_t value = insideBox ? (uint16_t)(1500 + x - frame) : (uint16_t)(3000 + y / 4 + random() % 4);
+            if (random() % 50 == 0)
+            {
+                value = 0;
+            }
+            depth[(size_t)y * stridePixels + x] = value;
+        }
+    }
+}
+
+static bool EqualRows(const std::vector<uint16_t>& a, const std::vector<uint16_t>& b, int width, int height, int strideBytes)
+{
+    const int stridePixels = strideBytes / (int)sizeof(uint16_t);
+    for (int y = 0; y < height; y++)
+    {
+        if (memcmp(&a[(size_t)y * stridePixels], &b[(size_t)y * stridePixels], (size_t)width * sizeof(uint16_t)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool TestDepthCodecRoundTrip(size_t threadCount)
+{
+    // Odd sizes with a padded stride and a last tile shorter than the others
+    const int width = 321;
+    const int height = 77;
+    const int strideBytes = 336 * (int)sizeof(uint16_t);
+    std::mt19937 random(7);
+
+    DepthCodec codec(threadCount, 8);
+    std::vector<uint16_t> keyframe;
+    std::vector<uint16_t> frame;
+    std::vector<uint16_t> decoded;
+    std::vector<uint8_t> encoded;
+    FillDepth(keyframe, width, height, strideBytes, 0, random);
+
+    SELF_TEST_CHECK(codec.Encode(keyframe.data(), width, height, strideBytes, nullptr, 41, encoded));
+    SELF_TEST_CHECK(encoded.size() <= DepthCodec::GetMaxEncodedSize(width, height, 8));
+    DepthCodecHeader header;
+    SELF_TEST_CHECK(DepthCodec::ReadHeader(encoded.data(), encoded.size(), header));
+    SELF_TEST_CHECK(header.Width == width && header.Height == height && header.ReferenceId == 41);
+    SELF_TEST_CHECK((header.Flags & DepthCodecFlagTemporal) == 0);
+    decoded.assign(keyframe.size(), 0);
+    SELF_TEST_CHECK(codec.Decode(encoded.data(), encoded.size(), nullptr, decoded.data(), strideBytes));
+    SELF_TEST_CHECK(EqualRows(decoded, keyframe, width, height, strideBytes));
+
+    // Mostly the same frame with a moved box, temporal prediction has to win in the static tiles
+    for (int i = 1; i <= 10; i++)
+    {
+        frame = keyframe;
+        std::vector<uint16_t> moved;
+        FillDepth(moved, width, height, strideBytes, i * 3, random);
+        const int stridePixels = strideBytes / (int)sizeof(uint16_t);
+        for (int y = height / 3; y < 2 * height / 3; y++)
+        {
+            memcpy(&frame[(size_t)y * stridePixels], &moved[(size_t)y * stridePixels], (size_t)width * sizeof(uint16_t));
+        }
+
+        SELF_TEST_CHECK(codec.Encode(frame.data(), width, height, strideBytes, keyframe.data(), 41, encoded));
+        SELF_TEST_CHECK(DepthCodec::ReadHeader(encoded.data(), encoded.size(), header));
+        SELF_TEST_CHECK((header.Flags & DepthCodecFlagTemporal) != 0);
+        SELF_TEST_CHECK(!codec.Decode(encoded.data(), encoded.size(), nullptr, decoded.data(), strideBytes));
+        SELF_TEST_CHECK(codec.Decode(encoded.data(), encoded.size(), keyframe.data(), decoded.data(), strideBytes));
+        SELF_TEST_CHECK(EqualRows(decoded, frame, width, height, strideBytes));
+    }
+
+    // Truncated and corrupted streams are rejected instead of read past their end
+    SELF_TEST_CHECK(!codec.Decode(encoded.data(), encoded.size() - 1, keyframe.data(), decoded.data(), strideBytes));
+    SELF_TEST_CHECK(!codec.Decode(encoded.data(), sizeof(DepthCodecHeader) - 1, keyframe.data(), decoded.data(), strideBytes));
+    encoded[0] = 'X';
+    SELF_TEST_CHECK(!DepthCodec::ReadHeader(encoded.data(), encoded.size(), header));
+    return true;
+}
+
+/**************************************** CaptureContainer ****************************************/
+
+static bool TestCaptureContainer()
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "simple_3d_viewer_self_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::string path = (directory / "session").string();
+
+    std::vector<k4a_calibration_t> calibrations(2);
+    for (size_t deviceSlot = 0; deviceSlot < calibrations.size(); deviceSlot++)
+    {
+        memset(&calibrations[deviceSlot], 0, sizeof(k4a_calibration_t));
+        calibrations[deviceSlot].depth_camera_calibration.resolution_width = 320 + (int)deviceSlot;
+    }
+
+    // Payload bytes depend on group, device and type, so a payload read from the wrong place is detected
+    auto makePayload = [](uint64_t groupId, size_t deviceSlot, ContainerPayloadType type) {
+        std::vector<uint8_t> payload(type == ContainerPayloadType::Depth16 ? 640 : 100 + (size_t)(groupId % 7) * 13);
+        for (size_t i = 0; i < payload.size(); i++)
+        {
+            payload[i] = (uint8_t)(groupId * 31 + deviceSlot * 7 + (size_t)type * 3 + i);
+        }
+        return payload;
+    };
+
+    // Sparse group ids beyond 32 bits, and a chunk size that forces several chunks
+    const uint64_t firstGroupId = 5000000000ull;
+    const uint64_t groupCount = 20;
+    {
+        CaptureContainerWriter writer;
+        SELF_TEST_CHECK(writer.Open(path, calibrations, 4096));
+        for (uint64_t group = 0; group < groupCount; group++)
+        {
+            const uint64_t groupId = firstGroupId + group * 3;
+            for (size_t deviceSlot = 0; deviceSlot < calibrations.size(); deviceSlot++)
+            {
+                for (ContainerPayloadType type : { ContainerPayloadType::Depth16, ContainerPayloadType::Mjpg })
+                {
+                    const std::vector<uint8_t> payload = makePayload(groupId, deviceSlot, type);
+                    SELF_TEST_CHECK(writer.Append(groupId, deviceSlot, groupId / 1000, type, 16, 20, 32, payload.data(), payload.size()));
+                }
+            }
+        }
+        SELF_TEST_CHECK(!writer.Append(firstGroupId, 0, 0, ContainerPayloadType::Mjpg, 0, 0, 0, nullptr, 4097));
+        SELF_TEST_CHECK(writer.Close());
+    }
+    SELF_TEST_CHECK(std::filesystem::exists(path + ".chunk001"));
+
+    {
+        CaptureContainerReader reader;
+        SELF_TEST_CHECK(reader.Open(path));
+        SELF_TEST_CHECK(reader.GetDeviceCount() == calibrations.size());
+        for (size_t deviceSlot = 0; deviceSlot < calibrations.size(); deviceSlot++)
+        {
+            SELF_TEST_CHECK(memcmp(&reader.GetCalibration(deviceSlot), &calibrations[deviceSlot], sizeof(k4a_calibration_t)) == 0);
+        }
+        SELF_TEST_CHECK(reader.GetEntryCount() == groupCount * calibrations.size() * 2);
+        SELF_TEST_CHECK(reader.GetFirstGroupId() == firstGroupId);
+        SELF_TEST_CHECK(reader.GetEndGroupId() == firstGroupId + (groupCount - 1) * 3 + 1);
+
+        for (uint64_t group = 0; group < groupCount; group++)
+        {
+            const uint64_t groupId = firstGroupId + group * 3;
+            for (size_t deviceSlot = 0; deviceSlot < calibrations.size(); deviceSlot++)
+            {
+                for (ContainerPayloadType type : { ContainerPayloadType::Depth16, ContainerPayloadType::Mjpg })
+                {
+                    const ContainerIndexEntry* entry = reader.FindEntry(groupId, deviceSlot, type);
+                    SELF_TEST_CHECK(entry != nullptr);
+                    SELF_TEST_CHECK(entry->GroupId == groupId && entry->DeviceSlot == deviceSlot && entry->PayloadType == (uint8_t)type);
+                    SELF_TEST_CHECK(entry->DeviceTimestampUsec == groupId / 1000 && entry->StrideBytes == 32);
+
+                    const std::vector<uint8_t> payload = makePayload(groupId, deviceSlot, type);
+                    const uint8_t* data = reader.GetPayload(*entry);
+                    SELF_TEST_CHECK(data != nullptr && entry->Size == payload.size());
+                    SELF_TEST_CHECK(memcmp(data, payload.data(), payload.size()) == 0);
+                }
+            }
+            SELF_TEST_CHECK(reader.FindEntry(groupId + 1, 0, ContainerPayloadType::Depth16) == nullptr);
+            SELF_TEST_CHECK(reader.FindEntry(groupId, 0, ContainerPayloadType::Bgra32) == nullptr);
+        }
+        SELF_TEST_CHECK(reader.FindEntry(firstGroupId - 1, 0, ContainerPayloadType::Depth16) == nullptr);
+        SELF_TEST_CHECK(reader.FindEntry(firstGroupId, calibrations.size(), ContainerPayloadType::Depth16) == nullptr);
+    }
+
+    CaptureContainerReader missing;
+    SELF_TEST_CHECK(!missing.Open((directory / "missing").string()));
+
+    std::filesystem::remove_all(directory);
+    return true;
+}
+
+/**************************************** BrownConradyCamera ****************************************/
+
+// Depth camera calibration of a device in WFOV unbinned mode, the camera and rational 6KT lens model of the SDK
+static k4a_calibration_t CreateTestCalibration()
+{
+    k4a_calibration_t calibration;
+    memset(&calibration, 0, sizeof(calibration));
+    calibration.depth_mode = K4A_DEPTH_MODE_WFOV_UNBINNED;
+    calibration.color_resolution = K4A_COLOR_RESOLUTION_OFF;
+    for (int camera = 0; camera < K4A_CALIBRATION_TYPE_NUM; camera++)
+    {
+        float* rotation = calibration.extrinsics[camera][camera].rotation;
+        rotation[0] = rotation[4] = rotation[8] = 1.f;
+    }
+
+    k4a_calibration_camera_t& depthCamera = calibration.depth_camera_calibration;
+    depthCamera.extrinsics = calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_DEPTH];
+    depthCamera.resolution_width = 1024;
+    depthCamera.resolution_height = 1024;
+    depthCamera.metric_radius = 1.74f;
+    depthCamera.intrinsics.type = K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT;
+    depthCamera.intrinsics.parameter_count = 14;
+
+    auto& parameters = depthCamera.intrinsics.parameters.param;
+    parameters.cx = 520.9f;
+    parameters.cy = 516.3f;
+    parameters.fx = 504.5f;
+    parameters.fy = 504.6f;
+    parameters.k1 = 3.0f;
+    parameters.k2 = 1.9f;
+    parameters.k3 = 0.09f;
+    parameters.k4 = 3.35f;
+    parameters.k5 = 2.9f;
+    parameters.k6 = 0.49f;
+    parameters.p1 = -3.9e-5f;
+    parameters.p2 = 5.8e-5f;
+    parameters.metric_radius = depthCamera.metric_radius;
+    return calibration;
+}
+
+static bool TestBrownConradyCamera()
+{
+    const k4a_calibration_t calibration = CreateTestCalibration();
+
+    // Every other pixel in both directions, the rows go through all lanes and the remainder path of the batch functions
+    BrownConradyCamera::Validation validation;
+    SELF_TEST_CHECK(BrownConradyCamera::Validate(calibration, K4A_CALIBRATION_TYPE_DEPTH, 2, validation));
+    SELF_TEST_CHECK(validation.SampleCount == 512 * 512);
+    SELF_TEST_CHECK(validation.IsWithinTolerance());
+
+    // The corners of the wide field of view are outside of the metric radius, the centre is on the optical axis
+    BrownConradyCamera camera;
+    SELF_TEST_CHECK(camera.Initialize(calibration.depth_camera_calibration));
+    const k4a_float2_t pixels[2] = { { { 0.f, 0.f } }, { { 520.9f, 516.3f } } };
+    k4a_float3_t points[2];
+    int valid[2];
+    camera.Unproject(pixels, 2.f, points, valid, 2);
+    SELF_TEST_CHECK(valid[0] == 0 && valid[1] != 0);
+    SELF_TEST_CHECK(std::fabs(points[1].xyz.x) < 1e-4f && std::fabs(points[1].xyz.y) < 1e-4f && points[1].xyz.z == 2.f);
+    return true;
+}
+
+bool RunSelfTests()
+{
+    struct SelfTest
+    {
+        const char* Name;
+        bool (*Run)();
+    };
+    const SelfTest tests[] = {
+        { "SpscQueue wraparound", TestSpscQueueWraparound },
+        { "SpscQueue producer/consumer threads", TestSpscQueueThreads },
+        { "SyncGrouper drop oldest", []() { return TestSyncGrouper(SyncGroupPolicy::DropOldest); } },
+        { "SyncGrouper wait for all", []() { return TestSyncGrouper(SyncGroupPolicy::WaitForAll); } },
+        { "DepthCodec round trip", []() { return TestDepthCodecRoundTrip(1); } },
+        { "DepthCodec round trip, tile pool", []() { return TestDepthCodecRoundTrip(4); } },
+        { "CaptureContainer write/index/read", TestCaptureContainer },
+        { "BrownConradyCamera against the SDK", TestBrownConradyCamera },
+    };
+
+    size_t failed = 0;
+    for (const SelfTest& test : tests)
+    {
+        const bool succeeded = test.Run();
+        std::cout << (succeeded ? "[  OK  ] " : "[FAILED] ") << test.Name << std::endl;
+        failed += succeeded ? 0 : 1;
+    }
+    std::cout << (sizeof(tests) / sizeof(tests[0]) - failed) << " of " << sizeof(tests) / sizeof(tests[0]) << " self tests passed" << std::endl;
+    return failed == 0;
+}
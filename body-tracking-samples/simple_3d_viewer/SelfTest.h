@@ -0,0 +1,10 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+// Hardware free checks of the capture engine and the writers: SpscQueue wraparound, SyncGrouper grouping of
+// synthetic sources, DepthCodec round trips and a CaptureContainer write/read round trip. Also compares the batch
+// BrownConradyCamera of the lookup tables with the SDK on a fixed calibration. Prints one line per test and returns
+// false when any of them failed.
+bool RunSelfTests();
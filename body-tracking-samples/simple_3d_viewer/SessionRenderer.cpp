@@ -0,0 +1,351 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "SessionRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <k4abt.h>
+#include <BodyTrackingHelpers.h>
+#include <Window3dWrapper.h>
+
+#include "CaptureSource.h"
+#include "VideoEncoder.h"
+
+using namespace std::chrono;
+
+class SessionRenderer::Worker
+{
+public:
+    Window3dWrapper Window3d;
+    std::thread Thread;
+};
+
+SessionRenderer::SessionRenderer()
+{
+}
+
+SessionRenderer::~SessionRenderer()
+{
+}
+
+static std::unique_ptr<CaptureSource> OpenRecording(const std::string& path, uint64_t startOffsetUsec, uint64_t endOffsetUsec)
+{
+    CaptureSourceConfig sourceConfig;
+    sourceConfig.Type = CaptureSourceType::Playback;
+    sourceConfig.Path = path;
+    sourceConfig.RealTime = false;
+    sourceConfig.StartOffsetUsec = startOffsetUsec;
+    sourceConfig.EndOffsetUsec = endOffsetUsec;
+
+    k4a_device_configuration_t deviceConfig = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+    std::unique_ptr<CaptureSource> source = CreateCaptureSource(sourceConfig, deviceConfig);
+    if (source == nullptr || !source->Open())
+    {
+        return nullptr;
+    }
+    return source;
+}
+
+// File name of the recording without directory and extension
+static std::string GetRecordingName(const std::string& path)
+{
+    const size_t nameStart = path.find_last_of("/\\") == std::string::npos ? 0 : path.find_last_of("/\\") + 1;
+    const size_t extensionStart = path.find_last_of('.');
+    if (extensionStart == std::string::npos || extensionStart < nameStart)
+    {
+        return path.substr(nameStart);
+    }
+    return path.substr(nameStart, extensionStart - nameStart);
+}
+
+bool SessionRenderer::CreateJobs(const SessionRenderConfig& config,
+    const std::vector<std::string>& recordingPaths,
+    std::vector<SessionRenderJob>& jobs)
+{
+    jobs.clear();
+    const uint64_t sliceUsec = (uint64_t)config.SliceSeconds * 1000000;
+    for (const std::string& recordingPath : recordingPaths)
+    {
+        std::unique_ptr<CaptureSource> source = OpenRecording(recordingPath, 0, 0);
+        if (source == nullptr)
+        {
+            return false;
+        }
+        const uint64_t durationUsec = source->GetDurationUsec();
+        const std::string name = config.OutputDirectory + "/" + GetRecordingName(recordingPath);
+
+        if (sliceUsec == 0 || durationUsec <= sliceUsec)
+        {
+            SessionRenderJob job;
+            job.RecordingPath = recordingPath;
+            job.OutputPath = name + ".avi";
+            jobs.push_back(job);
+            continue;
+        }
+
+        size_t sliceIndex = 0;
+        for (uint64_t startUsec = 0; startUsec < durationUsec; startUsec += sliceUsec, sliceIndex++)
+        {
+            std::stringstream outputPath;
+            outputPath << name << "_" << std::setw(3) << std::setfill('0') << sliceIndex << ".avi";
+
+            SessionRenderJob job;
+            job.RecordingPath = recordingPath;
+            job.StartOffsetUsec = startUsec;
+            job.EndOffsetUsec = startUsec + sliceUsec < durationUsec ? startUsec + sliceUsec : 0;
+            job.OutputPath = outputPath.str();
+            jobs.push_back(job);
+        }
+    }
+    return true;
+}
+
+bool SessionRenderer::Run(const SessionRenderConfig& config, const std::vector<SessionRenderJob>& jobs)
+{
+    if (jobs.empty())
+    {
+        return true;
+    }
+
+    m_config = config;
+    m_jobs = jobs;
+    m_nextJob = 0;
+
+    // Every worker with body tracking owns a tracker that runs its network on the GPU and holds a model in GPU memory,
+    // so only point cloud rendering scales with the cores
+    size_t workerCount = config.WorkerCount;
+    if (workerCount == 0)
+    {
+        workerCount = config.BodyTracking ?
+            DefaultRenderWorkerCount : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    workerCount = std::min(workerCount, jobs.size());
+
+    // The contexts are created with the calibration of the first recording, every job sets the one of its recording
+    std::unique_ptr<CaptureSource> firstRecording = OpenRecording(jobs.front().RecordingPath, 0, 0);
+    if (firstRecording == nullptr)
+    {
+        return false;
+    }
+
+    // Contexts are created on this thread, a hidden window can not be created anywhere else. Each one is released
+    // afterwards so that its worker can make it current.
+    for (size_t workerIndex = 0; workerIndex < workerCount; workerIndex++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+        Window3dWrapper& window3d = m_workers.back()->Window3d;
+        window3d.CreateOffscreen(firstRecording->GetCalibration(), config.Width, config.Height);
+        window3d.SetLayout3d(config.Layout == SessionRenderLayout::FourViews ?
+            Visualization::Layout3d::FourViews : Visualization::Layout3d::OnlyMainView);
+        window3d.SetJointFrameVisualization(config.JointFrames);
+
+        // With two frames in flight a frame is read back before its upload buffer segment is reused, so no capture
+        // is dropped because the GPU is behind
+        window3d.SetAsyncReadbackDepth(2);
+        window3d.ReleaseContext();
+    }
+    firstRecording.reset();
+
+    std::cout << "Rendering " << jobs.size() << " jobs on " << workerCount << " workers" << std::endl;
+    for (std::unique_ptr<Worker>& worker : m_workers)
+    {
+        worker->Thread = std::thread(&SessionRenderer::WorkerThread, this, std::ref(*worker));
+    }
+    for (std::unique_ptr<Worker>& worker : m_workers)
+    {
+        worker->Thread.join();
+    }
+
+    for (std::unique_ptr<Worker>& worker : m_workers)
+    {
+        worker->Window3d.Delete();
+    }
+    m_workers.clear();
+
+    return m_failedJobs == 0;
+}
+
+SessionRenderStatistics SessionRenderer::GetStatistics() const
+{
+    SessionRenderStatistics statistics;
+    statistics.Jobs = m_completedJobs.load();
+    statistics.FailedJobs = m_failedJobs.load();
+    statistics.Captures = m_captures.load();
+    statistics.Frames = m_frames.load();
+    statistics.TrackingUsec = m_trackingUsec.load();
+    statistics.RenderUsec = m_renderUsec.load();
+    statistics.EncodeUsec = m_encodeUsec.load();
+    statistics.EncoderBlockedUsec = m_encoderBlockedUsec.load();
+    return statistics;
+}
+
+void SessionRenderer::WorkerThread(Worker& worker)
+{
+    while (true)
+    {
+        const size_t jobIndex = m_nextJob++;
+        if (jobIndex >= m_jobs.size())
+        {
+            break;
+        }
+
+        const SessionRenderJob& job = m_jobs[jobIndex];
+        if (RenderJob(worker, job))
+        {
+            m_completedJobs++;
+        }
+        else
+        {
+            m_failedJobs++;
+            std::cout << "Failed to render " << job.OutputPath << std::endl;
+        }
+    }
+
+    // The main thread deletes the context
+    worker.Window3d.ReleaseContext();
+}
+
+// Track the bodies of the capture and add them to the scene. The body frame is returned for the segmentation colors of
+// the point cloud, the caller releases it.
+static bool AddTrackedBodies(Window3dWrapper& window3d, k4abt_tracker_t tracker, k4a_capture_t capture, k4abt_frame_t* bodyFrame)
+{
+    if (K4A_WAIT_RESULT_SUCCEEDED != k4abt_tracker_enqueue_capture(tracker, capture, K4A_WAIT_INFINITE))
+    {
+        return false;
+    }
+
+    if (K4A_WAIT_RESULT_SUCCEEDED != k4abt_tracker_pop_result(tracker, bodyFrame, K4A_WAIT_INFINITE))
+    {
+        return false;
+    }
+
+    const size_t numBodies = k4abt_frame_get_num_bodies(*bodyFrame);
+    for (size_t i = 0; i < numBodies; i++)
+    {
+        k4abt_body_t body;
+        if (K4A_RESULT_SUCCEEDED != k4abt_frame_get_body_skeleton(*bodyFrame, i, &body.skeleton))
+        {
+            continue;
+        }
+        body.id = k4abt_frame_get_body_id(*bodyFrame, i);
+
+        window3d.AddBody(body, g_bodyColors[body.id % g_bodyColors.size()]);
+    }
+    return true;
+}
+
+bool SessionRenderer::RenderJob(Worker& worker, const SessionRenderJob& job)
+{
+    std::unique_ptr<CaptureSource> source = OpenRecording(job.RecordingPath, job.StartOffsetUsec, job.EndOffsetUsec);
+    if (source == nullptr || !source->Start())
+    {
+        return false;
+    }
+
+    const k4a_calibration_t& calibration = source->GetCalibration();
+    Window3dWrapper& window3d = worker.Window3d;
+    window3d.SetCalibration(calibration);
+
+    k4abt_tracker_t tracker = nullptr;
+    if (m_config.BodyTracking && K4A_RESULT_SUCCEEDED != k4abt_tracker_create(&calibration, &tracker))
+    {
+        std::cout << "Body tracker initialization failed for " << job.RecordingPath << std::endl;
+        return false;
+    }
+
+    // The video plays at the frame rate of the recording
+    const double fps = 1000000.0 / GetFramePeriod(source->GetDeviceConfig().camera_fps).count();
+    VideoEncoder encoder;
+    bool succeeded = encoder.Open(job.OutputPath, m_config.Codec, fps, m_config.Width, m_config.Height, m_config.EncoderQueueDepth);
+
+    Visualization::RenderedFrame frame;
+    uint64_t frameCount = 0;
+    const uint64_t droppedFramesBefore = window3d.GetDroppedReadbackCount();
+    k4a_capture_t capture = nullptr;
+    while (succeeded && source->GetCapture(&capture, K4A_WAIT_INFINITE) == K4A_WAIT_RESULT_SUCCEEDED)
+    {
+        m_captures++;
+        k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+        if (depthImage == nullptr)
+        {
+            k4a_capture_release(capture);
+            continue;
+        }
+
+        window3d.CleanJointsAndBones();
+        k4abt_frame_t bodyFrame = nullptr;
+        if (tracker != nullptr)
+        {
+            auto trackingStart = steady_clock::now();
+            if (!AddTrackedBodies(window3d, tracker, capture, &bodyFrame))
+            {
+                std::cout << "Body tracking failed for " << job.RecordingPath << std::endl;
+                succeeded = false;
+            }
+            m_trackingUsec += duration_cast<microseconds>(steady_clock::now() - trackingStart).count();
+        }
+        k4a_capture_release(capture);
+
+        auto renderStart = steady_clock::now();
+        if (bodyFrame != nullptr)
+        {
+            // The body pixels get the colors of their skeletons on the GPU
+            window3d.UpdatePointClouds(depthImage, bodyFrame);
+            k4abt_frame_release(bodyFrame);
+        }
+        else
+        {
+            window3d.UpdatePointClouds(depthImage);
+        }
+        k4a_image_release(depthImage);
+        const bool hasFrame = window3d.RenderAsync(frame);
+        m_renderUsec += duration_cast<microseconds>(steady_clock::now() - renderStart).count();
+
+        if (hasFrame)
+        {
+            encoder.Enqueue(frame);
+            frameCount++;
+        }
+    }
+    succeeded = succeeded && source->IsEndOfStream();
+
+    // Frames still in flight belong to the video as well
+    while (window3d.FlushAsyncRender(frame))
+    {
+        encoder.Enqueue(frame);
+        frameCount++;
+    }
+    encoder.Close();
+
+    // A video with missing frames plays too fast
+    const uint64_t droppedFrames = window3d.GetDroppedReadbackCount() - droppedFramesBefore;
+    if (droppedFrames > 0)
+    {
+        std::cout << droppedFrames << " frames of " << job.OutputPath << " could not be read back" << std::endl;
+        succeeded = false;
+    }
+    source->Close();
+
+    if (tracker != nullptr)
+    {
+        k4abt_tracker_shutdown(tracker);
+        k4abt_tracker_destroy(tracker);
+    }
+
+    const VideoEncoderStatistics encoderStatistics = encoder.GetStatistics();
+    m_frames += frameCount;
+    m_encodeUsec += encoderStatistics.EncodeUsec;
+    m_encoderBlockedUsec += encoderStatistics.BlockedUsec;
+
+    if (succeeded)
+    {
+        std::cout << "Rendered " << job.OutputPath << ": " << frameCount << " frames" << std::endl;
+    }
+    return succeeded;
+}
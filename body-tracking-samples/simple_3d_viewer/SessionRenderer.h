@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RigConfiguration.h"
+
+// One time slice of a recording that is rendered into one video file
+struct SessionRenderJob
+{
+    std::string RecordingPath;
+    uint64_t StartOffsetUsec = 0;
+    uint64_t EndOffsetUsec = 0;     // 0 renders until the end of the recording
+    std::string OutputPath;
+};
+
+struct SessionRenderStatistics
+{
+    uint64_t Jobs = 0;
+    uint64_t FailedJobs = 0;
+    uint64_t Captures = 0;
+    uint64_t Frames = 0;            // Rendered frames handed to the encoders
+    uint64_t TrackingUsec = 0;
+    uint64_t RenderUsec = 0;
+    uint64_t EncodeUsec = 0;
+    uint64_t EncoderBlockedUsec = 0;
+};
+
+// Offline renderer for recordings: point clouds, and skeletons when body tracking is enabled, are rendered into
+// video files without a window. Every worker thread owns an offscreen context, a body tracker and a video encoder
+// with its own encoder thread, and takes the next job (a time slice of a recording) from a shared list until all
+// jobs are done. Recordings are read as fast as possible, so the run time scales with the number of workers
+// instead of the length of the recordings.
+class SessionRenderer
+{
+public:
+    SessionRenderer();
+    ~SessionRenderer();
+
+    // Split the recordings into slices of config.SliceSeconds, one output file per slice
+    static bool CreateJobs(const SessionRenderConfig& config,
+        const std::vector<std::string>& recordingPaths,
+        std::vector<SessionRenderJob>& jobs);
+
+    // Render all jobs and return when they are done. Has to be called on the main thread, the contexts are created
+    // there before they are handed to the workers.
+    bool Run(const SessionRenderConfig& config, const std::vector<SessionRenderJob>& jobs);
+
+    SessionRenderStatistics GetStatistics() const;
+
+private:
+    class Worker;
+
+    void WorkerThread(Worker& worker);
+
+    bool RenderJob(Worker& worker, const SessionRenderJob& job);
+
+    SessionRenderConfig m_config;
+    std::vector<SessionRenderJob> m_jobs;
+    std::atomic<size_t> m_nextJob{ 0 };
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::atomic<uint64_t> m_completedJobs{ 0 };
+    std::atomic<uint64_t> m_failedJobs{ 0 };
+    std::atomic<uint64_t> m_captures{ 0 };
+    std::atomic<uint64_t> m_frames{ 0 };
+    std::atomic<uint64_t> m_trackingUsec{ 0 };
+    std::atomic<uint64_t> m_renderUsec{ 0 };
+    std::atomic<uint64_t> m_encodeUsec{ 0 };
+    std::atomic<uint64_t> m_encoderBlockedUsec{ 0 };
+};
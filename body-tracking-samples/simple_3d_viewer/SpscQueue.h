@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The capacity is rounded up to the next power of two so that the slot index is a mask instead of a modulo.
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity = 8)
+    {
+        size_t roundedCapacity = 1;
+        while (roundedCapacity < capacity)
+        {
+            roundedCapacity <<= 1;
+        }
+        m_slots.resize(roundedCapacity);
+        m_mask = roundedCapacity - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. Returns false without modifying the queue when it is full.
+    bool TryPush(const T& item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+        {
+            return false;
+        }
+
+        m_slots[head & m_mask] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool TryPop(T& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = m_slots[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns a pointer to the oldest item without removing it, or nullptr when the queue is empty.
+    const T* Front() const
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &m_slots[tail & m_mask];
+    }
+
+    // Approximate when called from a thread other than the producer or the consumer. The tail is loaded first: the
+    // head never falls behind a tail that was already read, so the difference can not wrap around, and pops and
+    // pushes between the two loads are clamped to the capacity.
+    size_t Size() const
+    {
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return std::min(head - tail, m_mask + 1);
+    }
+
+    size_t Capacity() const { return m_mask + 1; }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask = 0;
+
+    // Keep the producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> m_head{ 0 };
+    alignas(64) std::atomic<size_t> m_tail{ 0 };
+};
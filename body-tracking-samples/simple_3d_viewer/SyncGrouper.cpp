@@ -0,0 +1,202 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "SyncGrouper.h"
+
+#include <algorithm>
+#include <limits>
+
+CaptureGroup::~CaptureGroup()
+{
+    Reset();
+}
+
+CaptureGroup::CaptureGroup(CaptureGroup&& other) noexcept
+    : m_captures(std::move(other.m_captures))
+    , m_deviceTimestampsUsec(std::move(other.m_deviceTimestampsUsec))
+    , m_groupId(other.m_groupId)
+    , m_skewUsec(other.m_skewUsec)
+{
+    other.m_captures.clear();
+}
+
+CaptureGroup& CaptureGroup::operator=(CaptureGroup&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        std::swap(m_captures, other.m_captures);
+        std::swap(m_deviceTimestampsUsec, other.m_deviceTimestampsUsec);
+        m_groupId = other.m_groupId;
+        m_skewUsec = other.m_skewUsec;
+    }
+    return *this;
+}
+
+void CaptureGroup::Reset()
+{
+    for (k4a_capture_t& capture : m_captures)
+    {
+        if (capture != nullptr)
+        {
+            k4a_capture_release(capture);
+            capture = nullptr;
+        }
+    }
+}
+
+SyncGrouper::SyncGrouper(MultiDeviceCapture& multiDeviceCapture, const SyncGroupConfig& config)
+    : m_multiDeviceCapture(multiDeviceCapture)
+    , m_config(config)
+    , m_deviceCount(multiDeviceCapture.GetDeviceCount())
+    , m_expectedDelayUsec(m_deviceCount, 0)
+    , m_frontTimestampsUsec(m_deviceCount, 0)
+    , m_frontDeviceTimestampsUsec(m_deviceCount, 0)
+    , m_hasFront(m_deviceCount, false)
+{
+    m_statistics.DroppedCaptures.assign(m_deviceCount, 0);
+
+    // Subordinates expose at their sync pulse plus their configured delay, remove it before comparing
+    for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+    {
+        const CaptureSourceConfig& sourceConfig = m_multiDeviceCapture.GetSource(deviceSlot).GetConfig();
+        if (sourceConfig.SyncMode == K4A_WIRED_SYNC_MODE_SUBORDINATE)
+        {
+            m_expectedDelayUsec[deviceSlot] = sourceConfig.SubordinateDelayOffMasterUsec;
+        }
+    }
+}
+
+bool SyncGrouper::PeekTimestamp(size_t deviceSlot, int64_t& timestampUsec, uint64_t& deviceTimestampUsec)
+{
+    k4a_capture_t capture = m_multiDeviceCapture.PeekCapture(deviceSlot);
+    if (capture == nullptr)
+    {
+        return false;
+    }
+
+    // The depth image carries the timestamp of the sync pulse. Fall back to the other images for color only configurations.
+    k4a_image_t image = k4a_capture_get_depth_image(capture);
+    if (image == nullptr)
+    {
+        image = k4a_capture_get_color_image(capture);
+    }
+    if (image == nullptr)
+    {
+        image = k4a_capture_get_ir_image(capture);
+    }
+    if (image == nullptr)
+    {
+        // Nothing to match this capture with
+        DropCapture(deviceSlot);
+        return PeekTimestamp(deviceSlot, timestampUsec, deviceTimestampUsec);
+    }
+
+    deviceTimestampUsec = k4a_image_get_device_timestamp_usec(image);
+    timestampUsec = static_cast<int64_t>(deviceTimestampUsec) - m_expectedDelayUsec[deviceSlot];
+    k4a_image_release(image);
+    return true;
+}
+
+void SyncGrouper::DropCapture(size_t deviceSlot)
+{
+    k4a_capture_t capture = nullptr;
+    if (m_multiDeviceCapture.TryPopCapture(deviceSlot, &capture))
+    {
+        k4a_capture_release(capture);
+        m_statistics.DroppedCaptures[deviceSlot]++;
+    }
+}
+
+bool SyncGrouper::TryGetGroup(CaptureGroup& group)
+{
+    const int64_t toleranceUsec = m_config.ToleranceUsec;
+
+    for (;;)
+    {
+        size_t availableCount = 0;
+        int64_t oldestUsec = std::numeric_limits<int64_t>::max();
+        int64_t newestUsec = std::numeric_limits<int64_t>::min();
+        for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+        {
+            m_hasFront[deviceSlot] = PeekTimestamp(deviceSlot, m_frontTimestampsUsec[deviceSlot], m_frontDeviceTimestampsUsec[deviceSlot]);
+            if (m_hasFront[deviceSlot])
+            {
+                availableCount++;
+                oldestUsec = std::min(oldestUsec, m_frontTimestampsUsec[deviceSlot]);
+                newestUsec = std::max(newestUsec, m_frontTimestampsUsec[deviceSlot]);
+            }
+        }
+
+        if (availableCount == 0)
+        {
+            return false;
+        }
+
+        // Queues are ordered by time, so a capture that is older than the newest queued capture of another device
+        // by more than the tolerance can never be matched anymore
+        if (newestUsec - oldestUsec > toleranceUsec)
+        {
+            for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+            {
+                if (m_hasFront[deviceSlot] && newestUsec - m_frontTimestampsUsec[deviceSlot] > toleranceUsec)
+                {
+                    DropCapture(deviceSlot);
+                }
+            }
+            m_statistics.IncompleteGroups++;
+            continue;
+        }
+
+        if (availableCount == m_deviceCount)
+        {
+            group.Reset();
+            group.m_captures.resize(m_deviceCount, nullptr);
+            group.m_deviceTimestampsUsec.resize(m_deviceCount, 0);
+            for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+            {
+                m_multiDeviceCapture.TryPopCapture(deviceSlot, &group.m_captures[deviceSlot]);
+                group.m_deviceTimestampsUsec[deviceSlot] = m_frontDeviceTimestampsUsec[deviceSlot];
+            }
+            group.m_groupId = m_nextGroupId++;
+            group.m_skewUsec = static_cast<uint64_t>(newestUsec - oldestUsec);
+
+            m_statistics.Groups++;
+            m_statistics.MaxSkewUsec = std::max(m_statistics.MaxSkewUsec, group.m_skewUsec);
+            return true;
+        }
+
+        // Some devices have not delivered yet. Give up on the partial group when it can never complete because
+        // the source ended, or when the drop-oldest policy decides the missing device is too far behind.
+        bool discardPartialGroup = false;
+        for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+        {
+            if (!m_hasFront[deviceSlot] &&
+                !m_multiDeviceCapture.IsDeviceActive(deviceSlot) &&
+                m_multiDeviceCapture.PeekCapture(deviceSlot) == nullptr)
+            {
+                discardPartialGroup = true;
+            }
+            else if (m_hasFront[deviceSlot] &&
+                m_config.Policy == SyncGroupPolicy::DropOldest &&
+                m_multiDeviceCapture.GetQueueDepth(deviceSlot) > m_config.MaxPendingCaptures)
+            {
+                discardPartialGroup = true;
+            }
+        }
+
+        if (!discardPartialGroup)
+        {
+            return false;
+        }
+
+        for (size_t deviceSlot = 0; deviceSlot < m_deviceCount; deviceSlot++)
+        {
+            if (m_hasFront[deviceSlot])
+            {
+                DropCapture(deviceSlot);
+            }
+        }
+        m_statistics.IncompleteGroups++;
+    }
+}
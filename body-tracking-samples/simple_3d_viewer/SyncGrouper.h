@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#include "MultiDeviceCapture.h"
+#include "RigConfiguration.h"
+
+// One capture per device whose device timestamps matched. Owns the captures and releases them on Reset() or
+// destruction, so a group can never leak captures regardless of how the consumer leaves its loop.
+class CaptureGroup
+{
+public:
+    CaptureGroup() = default;
+    ~CaptureGroup();
+
+    CaptureGroup(const CaptureGroup&) = delete;
+    CaptureGroup& operator=(const CaptureGroup&) = delete;
+    CaptureGroup(CaptureGroup&& other) noexcept;
+    CaptureGroup& operator=(CaptureGroup&& other) noexcept;
+
+    // Release all captures. The storage is kept so reusing a group does not allocate.
+    void Reset();
+
+    size_t GetDeviceCount() const { return m_captures.size(); }
+
+    // The group keeps ownership of the returned capture
+    k4a_capture_t GetCapture(size_t deviceSlot) const { return m_captures[deviceSlot]; }
+
+    // Raw device timestamp of the capture of one device
+    uint64_t GetDeviceTimestampUsec(size_t deviceSlot) const { return m_deviceTimestampsUsec[deviceSlot]; }
+
+    // Sequential id of the group, starting at 0
+    uint64_t GetGroupId() const { return m_groupId; }
+
+    // Difference between the latest and earliest delay compensated timestamp of the group
+    uint64_t GetSkewUsec() const { return m_skewUsec; }
+
+private:
+    friend class SyncGrouper;
+
+    std::vector<k4a_capture_t> m_captures;
+    std::vector<uint64_t> m_deviceTimestampsUsec;
+    uint64_t m_groupId = 0;
+    uint64_t m_skewUsec = 0;
+};
+
+struct SyncGroupStatistics
+{
+    uint64_t Groups = 0;                    // Complete groups handed to the consumer
+    uint64_t IncompleteGroups = 0;          // Partial groups discarded because a device had no matching capture
+    uint64_t MaxSkewUsec = 0;               // Largest skew of a complete group
+    std::vector<uint64_t> DroppedCaptures;  // Per device: captures released without being part of a group
+};
+
+// Consumer side stage that turns the per-device capture queues of MultiDeviceCapture into groups of captures
+// that belong to the same sync pulse. Captures are matched by k4a_image_get_device_timestamp_usec after removing
+// the expected subordinate delay of each device. Must be called from the thread that consumes the captures.
+class SyncGrouper
+{
+public:
+    SyncGrouper(MultiDeviceCapture& multiDeviceCapture, const SyncGroupConfig& config);
+
+    // Try to assemble the next complete group from the queued captures. Captures that can never be part of a
+    // complete group are released on the way. Returns false when not enough captures are queued yet.
+    bool TryGetGroup(CaptureGroup& group);
+
+    const SyncGroupStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+    // Delay compensated device timestamp of the oldest queued capture of a device
+    bool PeekTimestamp(size_t deviceSlot, int64_t& timestampUsec, uint64_t& deviceTimestampUsec);
+
+    void DropCapture(size_t deviceSlot);
+
+    MultiDeviceCapture& m_multiDeviceCapture;
+    SyncGroupConfig m_config;
+    size_t m_deviceCount = 0;
+
+    std::vector<int64_t> m_expectedDelayUsec;
+    std::vector<int64_t> m_frontTimestampsUsec;
+    std::vector<uint64_t> m_frontDeviceTimestampsUsec;
+    std::vector<bool> m_hasFront;
+
+    uint64_t m_nextGroupId = 0;
+    SyncGroupStatistics m_statistics;
+};
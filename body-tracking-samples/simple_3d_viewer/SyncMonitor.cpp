@@ -0,0 +1,328 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "SyncMonitor.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "SyncGrouper.h"
+
+static const char* GetSyncModeName(k4a_wired_sync_mode_t syncMode)
+{
+    switch (syncMode)
+    {
+    case K4A_WIRED_SYNC_MODE_MASTER: return "master";
+    case K4A_WIRED_SYNC_MODE_SUBORDINATE: return "subordinate";
+    default: return "standalone";
+    }
+}
+
+// Same image choice as the grouping: depth carries the timestamp of the sync pulse
+static bool GetCaptureTimestamps(k4a_capture_t capture, uint64_t& deviceTimestampUsec, uint64_t& systemTimestampNsec)
+{
+    k4a_image_t image = k4a_capture_get_depth_image(capture);
+    if (image == nullptr)
+    {
+        image = k4a_capture_get_color_image(capture);
+    }
+    if (image == nullptr)
+    {
+        image = k4a_capture_get_ir_image(capture);
+    }
+    if (image == nullptr)
+    {
+        return false;
+    }
+
+    deviceTimestampUsec = k4a_image_get_device_timestamp_usec(image);
+    systemTimestampNsec = k4a_image_get_system_timestamp_nsec(image);
+    k4a_image_release(image);
+    return true;
+}
+
+static void UpdateMin(std::atomic<int64_t>& minimum, int64_t value)
+{
+    int64_t current = minimum.load(std::memory_order_relaxed);
+    while (value < current && !minimum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void UpdateMax(std::atomic<int64_t>& maximum, int64_t value)
+{
+    int64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void SyncMonitor::Initialize(const SyncMonitorConfig& config, const std::vector<const CaptureSource*>& sources)
+{
+    m_config = config;
+    m_framePeriodUsec = sources.empty() ? 0 : (uint64_t)GetFramePeriod(sources.front()->GetDeviceConfig().camera_fps).count();
+    m_startTime = std::chrono::steady_clock::now();
+    m_lastDumpTime = m_startTime;
+
+    m_devices.clear();
+    m_referenceSlot = 0;
+    bool hasReference = false;
+    for (size_t deviceSlot = 0; deviceSlot < sources.size(); deviceSlot++)
+    {
+        const CaptureSourceConfig& sourceConfig = sources[deviceSlot]->GetConfig();
+        m_devices.push_back(std::make_unique<DeviceMonitor>());
+        m_devices.back()->SyncMode = sourceConfig.SyncMode;
+        if (sourceConfig.SyncMode == K4A_WIRED_SYNC_MODE_SUBORDINATE)
+        {
+            m_devices.back()->DelayUsec = sourceConfig.SubordinateDelayOffMasterUsec;
+        }
+        if (sourceConfig.SyncMode == K4A_WIRED_SYNC_MODE_MASTER && !hasReference)
+        {
+            m_referenceSlot = deviceSlot;
+            hasReference = true;
+        }
+    }
+}
+
+void SyncMonitor::OnCapture(size_t deviceSlot, k4a_capture_t capture, size_t queueDepth)
+{
+    DeviceMonitor& device = *m_devices[deviceSlot];
+    device.Captures.fetch_add(1, std::memory_order_relaxed);
+    device.QueueDepth.Record(queueDepth);
+
+    uint64_t deviceTimestampUsec = 0;
+    uint64_t systemTimestampNsec = 0;
+    if (!GetCaptureTimestamps(capture, deviceTimestampUsec, systemTimestampNsec))
+    {
+        return;
+    }
+
+    // Playback timestamps come from another session, only plausible latencies are recorded
+    const uint64_t nowNsec = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (systemTimestampNsec != 0 && systemTimestampNsec <= nowNsec && nowNsec - systemTimestampNsec < 10000000000ull)
+    {
+        device.HostLatencyUsec.Record((nowNsec - systemTimestampNsec) / 1000);
+    }
+
+    if (device.HasPrevious && deviceTimestampUsec > device.PreviousDeviceTimestampUsec)
+    {
+        const uint64_t gapUsec = deviceTimestampUsec - device.PreviousDeviceTimestampUsec;
+        device.FrameGapUsec.Record(gapUsec);
+
+        // A gap of n frame periods means n - 1 frames never reached the host
+        if (m_framePeriodUsec > 0 && gapUsec > m_framePeriodUsec * 3 / 2)
+        {
+            device.MissedFrames.fetch_add((gapUsec + m_framePeriodUsec / 2) / m_framePeriodUsec - 1, std::memory_order_relaxed);
+        }
+        if (systemTimestampNsec > device.PreviousSystemTimestampNsec)
+        {
+            device.SystemGapUsec.Record((systemTimestampNsec - device.PreviousSystemTimestampNsec) / 1000);
+        }
+    }
+
+    device.PreviousDeviceTimestampUsec = deviceTimestampUsec;
+    device.PreviousSystemTimestampNsec = systemTimestampNsec;
+    device.HasPrevious = true;
+    device.LastDeviceTimestampUsec.store(deviceTimestampUsec, std::memory_order_relaxed);
+    device.LastSystemTimestampNsec.store(systemTimestampNsec, std::memory_order_relaxed);
+}
+
+void SyncMonitor::OnQueueFullDrop(size_t deviceSlot)
+{
+    m_devices[deviceSlot]->QueueFullDrops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SyncMonitor::OnGroup(const CaptureGroup& group, size_t writerQueueDepth)
+{
+    m_groups.fetch_add(1, std::memory_order_relaxed);
+    m_groupSkewUsec.Record(group.GetSkewUsec());
+    m_writerQueueDepth.Record(writerQueueDepth);
+
+    const int64_t referenceUsec = (int64_t)group.GetDeviceTimestampUsec(m_referenceSlot) - m_devices[m_referenceSlot]->DelayUsec;
+    for (size_t deviceSlot = 0; deviceSlot < group.GetDeviceCount() && deviceSlot < m_devices.size(); deviceSlot++)
+    {
+        if (deviceSlot == m_referenceSlot)
+        {
+            continue;
+        }
+
+        DeviceMonitor& device = *m_devices[deviceSlot];
+        const int64_t offsetUsec = (int64_t)group.GetDeviceTimestampUsec(deviceSlot) - device.DelayUsec - referenceUsec;
+        device.OffsetUsec.Record((uint64_t)(offsetUsec < 0 ? -offsetUsec : offsetUsec));
+        UpdateMin(device.MinOffsetUsec, offsetUsec);
+        UpdateMax(device.MaxOffsetUsec, offsetUsec);
+    }
+}
+
+double SyncMonitor::GetElapsedSeconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+bool SyncMonitor::DumpIfDue()
+{
+    if (m_config.Path.empty())
+    {
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastDumpTime < std::chrono::milliseconds(m_config.IntervalMsec))
+    {
+        return true;
+    }
+    m_lastDumpTime = now;
+    return Dump();
+}
+
+bool SyncMonitor::Dump()
+{
+    if (m_config.Path.empty())
+    {
+        return true;
+    }
+
+    bool succeeded = m_config.Format == SyncMonitorFormat::Json ? WriteJson(m_config.Path) : WriteCsv(m_config.Path);
+    if (!succeeded)
+    {
+        std::cout << "Cannot write sync monitor output " << m_config.Path << std::endl;
+    }
+    return succeeded;
+}
+
+static void WriteJsonSummary(std::ostream& stream, const char* name, const Histogram& histogram)
+{
+    HistogramSummary summary = histogram.GetSummary();
+    stream << "\"" << name << "\": { \"count\": " << summary.Count
+        << ", \"min\": " << summary.Min
+        << ", \"mean\": " << summary.Mean
+        << ", \"p50\": " << summary.P50
+        << ", \"p90\": " << summary.P90
+        << ", \"p99\": " << summary.P99
+        << ", \"max\": " << summary.Max << " }";
+}
+
+bool SyncMonitor::WriteJson(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\n";
+    file << "    \"elapsed_seconds\": " << GetElapsedSeconds() << ",\n";
+    file << "    \"frame_period_usec\": " << m_framePeriodUsec << ",\n";
+    file << "    \"reference_device\": " << m_referenceSlot << ",\n";
+    file << "    \"groups\": " << m_groups.load(std::memory_order_relaxed) << ",\n";
+    file << "    ";
+    WriteJsonSummary(file, "group_skew_usec", m_groupSkewUsec);
+    file << ",\n    ";
+    WriteJsonSummary(file, "writer_queue_depth", m_writerQueueDepth);
+    file << ",\n    \"devices\": [\n";
+
+    for (size_t deviceSlot = 0; deviceSlot < m_devices.size(); deviceSlot++)
+    {
+        const DeviceMonitor& device = *m_devices[deviceSlot];
+        const bool hasOffset = device.OffsetUsec.GetCount() > 0;
+        file << "        {\n";
+        file << "            \"slot\": " << deviceSlot << ",\n";
+        file << "            \"role\": \"" << GetSyncModeName(device.SyncMode) << "\",\n";
+        file << "            \"delay_usec\": " << device.DelayUsec << ",\n";
+        file << "            \"captures\": " << device.Captures.load(std::memory_order_relaxed) << ",\n";
+        file << "            \"missed_frames\": " << device.MissedFrames.load(std::memory_order_relaxed) << ",\n";
+        file << "            \"queue_full_drops\": " << device.QueueFullDrops.load(std::memory_order_relaxed) << ",\n";
+        file << "            \"last_device_timestamp_usec\": " << device.LastDeviceTimestampUsec.load(std::memory_order_relaxed) << ",\n";
+        file << "            \"last_system_timestamp_nsec\": " << device.LastSystemTimestampNsec.load(std::memory_order_relaxed) << ",\n";
+        file << "            \"min_offset_usec\": " << (hasOffset ? device.MinOffsetUsec.load(std::memory_order_relaxed) : 0) << ",\n";
+        file << "            \"max_offset_usec\": " << (hasOffset ? device.MaxOffsetUsec.load(std::memory_order_relaxed) : 0) << ",\n";
+        file << "            ";
+        WriteJsonSummary(file, "frame_gap_usec", device.FrameGapUsec);
+        file << ",\n            ";
+        WriteJsonSummary(file, "system_gap_usec", device.SystemGapUsec);
+        file << ",\n            ";
+        WriteJsonSummary(file, "host_latency_usec", device.HostLatencyUsec);
+        file << ",\n            ";
+        WriteJsonSummary(file, "queue_depth", device.QueueDepth);
+        file << ",\n            ";
+        WriteJsonSummary(file, "offset_usec", device.OffsetUsec);
+        file << "\n        }" << (deviceSlot + 1 < m_devices.size() ? "," : "") << "\n";
+    }
+
+    file << "    ]\n}\n";
+    return file.good();
+}
+
+static void WriteCsvSummary(std::ostream& stream, double elapsedSeconds, const std::string& scope, const char* name, const Histogram& histogram)
+{
+    HistogramSummary summary = histogram.GetSummary();
+    stream << elapsedSeconds << "," << scope << "," << name << "," << summary.Count << "," << summary.Min << ","
+        << summary.Mean << "," << summary.P50 << "," << summary.P90 << "," << summary.P99 << "," << summary.Max << "\n";
+}
+
+static void WriteCsvCounter(std::ostream& stream, double elapsedSeconds, const std::string& scope, const char* name, uint64_t value)
+{
+    stream << elapsedSeconds << "," << scope << "," << name << "," << value << ",,,,,,\n";
+}
+
+bool SyncMonitor::WriteCsv(const std::string& path)
+{
+    // Every dump appends its rows, the elapsed time column separates the dumps
+    std::ofstream file(path, m_hasCsvHeader ? std::ios::app : std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    if (!m_hasCsvHeader)
+    {
+        file << "elapsed_seconds,scope,metric,count,min,mean,p50,p90,p99,max\n";
+        m_hasCsvHeader = true;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    const double elapsedSeconds = GetElapsedSeconds();
+    WriteCsvCounter(file, elapsedSeconds, "rig", "groups", m_groups.load(std::memory_order_relaxed));
+    WriteCsvSummary(file, elapsedSeconds, "rig", "group_skew_usec", m_groupSkewUsec);
+    WriteCsvSummary(file, elapsedSeconds, "rig", "writer_queue_depth", m_writerQueueDepth);
+
+    for (size_t deviceSlot = 0; deviceSlot < m_devices.size(); deviceSlot++)
+    {
+        const DeviceMonitor& device = *m_devices[deviceSlot];
+        const std::string scope = "device" + std::to_string(deviceSlot);
+        WriteCsvCounter(file, elapsedSeconds, scope, "captures", device.Captures.load(std::memory_order_relaxed));
+        WriteCsvCounter(file, elapsedSeconds, scope, "missed_frames", device.MissedFrames.load(std::memory_order_relaxed));
+        WriteCsvCounter(file, elapsedSeconds, scope, "queue_full_drops", device.QueueFullDrops.load(std::memory_order_relaxed));
+        WriteCsvSummary(file, elapsedSeconds, scope, "frame_gap_usec", device.FrameGapUsec);
+        WriteCsvSummary(file, elapsedSeconds, scope, "system_gap_usec", device.SystemGapUsec);
+        WriteCsvSummary(file, elapsedSeconds, scope, "host_latency_usec", device.HostLatencyUsec);
+        WriteCsvSummary(file, elapsedSeconds, scope, "queue_depth", device.QueueDepth);
+        WriteCsvSummary(file, elapsedSeconds, scope, "offset_usec", device.OffsetUsec);
+    }
+    return file.good();
+}
+
+void SyncMonitor::PrintSummary() const
+{
+    HistogramSummary skew = m_groupSkewUsec.GetSummary();
+    std::cout << "Sync: " << m_groups.load(std::memory_order_relaxed) << " groups, skew p50 " << skew.P50
+        << " / p99 " << skew.P99 << " / max " << skew.Max << " usec" << std::endl;
+
+    for (size_t deviceSlot = 0; deviceSlot < m_devices.size(); deviceSlot++)
+    {
+        const DeviceMonitor& device = *m_devices[deviceSlot];
+        HistogramSummary gap = device.FrameGapUsec.GetSummary();
+        HistogramSummary offset = device.OffsetUsec.GetSummary();
+        std::cout << "  device " << deviceSlot << " (" << GetSyncModeName(device.SyncMode) << "): missed frames "
+            << device.MissedFrames.load(std::memory_order_relaxed)
+            << ", frame gap p50 " << gap.P50 << " / max " << gap.Max << " usec";
+        if (deviceSlot != m_referenceSlot)
+        {
+            std::cout << ", offset to device " << m_referenceSlot << " p50 " << offset.P50 << " / p99 " << offset.P99 << " usec";
+        }
+        std::cout << std::endl;
+    }
+}
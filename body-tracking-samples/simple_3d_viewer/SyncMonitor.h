@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <k4a/k4a.h>
+
+#include "CaptureSource.h"
+#include "Histogram.h"
+#include "RigConfiguration.h"
+
+class CaptureGroup;
+
+// Sync quality instrumentation of a rig. Every capture is recorded on its capture thread (device and system
+// timestamps, gap to the previous capture of the device, consumer queue depth), every complete group on the
+// consumer thread (skew, offset of each device to the reference device, writer queue depth). All results go into
+// lock-free histograms and counters, so recording never takes a lock on the capture threads.
+//
+// Frames missing in the device timestamp sequence point to the device or its USB controller dropping frames,
+// a wide offset distribution of one subordinate to a bad sync cable.
+class SyncMonitor
+{
+public:
+    // Called with the opened sources before their capture threads start, the roles, delays and frame rates of
+    // recordings are the ones read from the files. The reference device is the first master, or slot 0 when there
+    // is none.
+    void Initialize(const SyncMonitorConfig& config, const std::vector<const CaptureSource*>& sources);
+
+    // Capture thread of the device, before the capture is queued. queueDepth is the depth the capture found.
+    void OnCapture(size_t deviceSlot, k4a_capture_t capture, size_t queueDepth);
+
+    // Capture thread of the device: the capture was released because the consumer queue was full
+    void OnQueueFullDrop(size_t deviceSlot);
+
+    // Consumer thread, for every complete group
+    void OnGroup(const CaptureGroup& group, size_t writerQueueDepth);
+
+    // Consumer thread. Dumps to the configured file when the dump interval has passed.
+    bool DumpIfDue();
+
+    bool Dump();
+
+    void PrintSummary() const;
+
+private:
+    struct DeviceMonitor
+    {
+        k4a_wired_sync_mode_t SyncMode = K4A_WIRED_SYNC_MODE_STANDALONE;
+        uint32_t DelayUsec = 0;
+
+        Histogram FrameGapUsec;         // Between consecutive device timestamps
+        Histogram SystemGapUsec;        // Between consecutive system (host arrival) timestamps
+        Histogram HostLatencyUsec;      // From the system timestamp until the capture thread queued the capture
+        Histogram QueueDepth;
+        Histogram OffsetUsec;           // |delay compensated timestamp - reference timestamp| within a group
+
+        std::atomic<uint64_t> Captures{ 0 };
+        std::atomic<uint64_t> MissedFrames{ 0 };
+        std::atomic<uint64_t> QueueFullDrops{ 0 };
+        std::atomic<uint64_t> LastDeviceTimestampUsec{ 0 };
+        std::atomic<uint64_t> LastSystemTimestampNsec{ 0 };
+        std::atomic<int64_t> MinOffsetUsec{ INT64_MAX };
+        std::atomic<int64_t> MaxOffsetUsec{ INT64_MIN };
+
+        // Only touched by the capture thread of the device
+        uint64_t PreviousDeviceTimestampUsec = 0;
+        uint64_t PreviousSystemTimestampNsec = 0;
+        bool HasPrevious = false;
+    };
+
+    bool WriteJson(const std::string& path) const;
+
+    bool WriteCsv(const std::string& path);
+
+    double GetElapsedSeconds() const;
+
+    SyncMonitorConfig m_config;
+    uint64_t m_framePeriodUsec = 0;
+    size_t m_referenceSlot = 0;
+    std::vector<std::unique_ptr<DeviceMonitor>> m_devices;
+
+    Histogram m_groupSkewUsec;
+    Histogram m_writerQueueDepth;
+    std::atomic<uint64_t> m_groups{ 0 };
+
+    std::chrono::steady_clock::time_point m_startTime;
+    std::chrono::steady_clock::time_point m_lastDumpTime;
+    bool m_hasCsvHeader = false;
+};
@@ -0,0 +1,123 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "VideoEncoder.h"
+
+#include <chrono>
+#include <iostream>
+
+VideoEncoder::~VideoEncoder()
+{
+    Close();
+}
+
+bool VideoEncoder::Open(const std::string& path, const std::string& codec, double fps, int width, int height, size_t queueDepth)
+{
+    if (m_isOpen || codec.size() != 4 || queueDepth == 0)
+    {
+        return false;
+    }
+
+    const int fourcc = cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]);
+    if (!m_writer.open(path, fourcc, fps, cv::Size(width, height)))
+    {
+        std::cout << "Failed to open video " << path << " with codec " << codec << std::endl;
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_frames.assign(queueDepth, Visualization::RenderedFrame());
+    m_head = 0;
+    m_count = 0;
+    m_isOpen = true;
+    m_thread = std::thread(&VideoEncoder::EncoderThread, this);
+    return true;
+}
+
+void VideoEncoder::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isOpen = false;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    m_writer.release();
+}
+
+void VideoEncoder::Enqueue(Visualization::RenderedFrame& frame)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_count == m_frames.size() && m_isOpen)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_notFull.wait(lock, [this]() { return m_count < m_frames.size() || !m_isOpen; });
+        m_blockedUsec += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (!m_isOpen)
+    {
+        return;
+    }
+
+    std::swap(m_frames[(m_head + m_count) % m_frames.size()], frame);
+    m_count++;
+
+    lock.unlock();
+    m_notEmpty.notify_one();
+}
+
+VideoEncoderStatistics VideoEncoder::GetStatistics() const
+{
+    VideoEncoderStatistics statistics;
+    statistics.Encoded = m_encoded.load();
+    statistics.EncodeUsec = m_encodeUsec.load();
+    statistics.BlockedUsec = m_blockedUsec.load();
+    return statistics;
+}
+
+void VideoEncoder::EncoderThread()
+{
+    Visualization::RenderedFrame frame;
+    cv::Mat flipped;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this]() { return m_count > 0 || !m_isOpen; });
+
+            // Close() only returns after the queued frames are written
+            if (m_count == 0)
+            {
+                return;
+            }
+
+            // The slot keeps the buffer of the previous frame for the next Enqueue
+            std::swap(m_frames[m_head], frame);
+            m_head = (m_head + 1) % m_frames.size();
+            m_count--;
+        }
+        m_notFull.notify_one();
+
+        if (frame.Width != m_width || frame.Height != m_height)
+        {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        // Rendered rows are bottom-up
+        cv::Mat pixels(frame.Height, frame.Width, CV_8UC3, frame.PixelsBgr.data());
+        cv::flip(pixels, flipped, 0);
+        m_writer.write(flipped);
+
+        m_encodeUsec += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        m_encoded++;
+    }
+}
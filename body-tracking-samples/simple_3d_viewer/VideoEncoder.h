@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include <WindowController3dTypes.h>
+
+struct VideoEncoderStatistics
+{
+    uint64_t Encoded = 0;
+    uint64_t EncodeUsec = 0;
+    uint64_t BlockedUsec = 0;       // Time the renderer waited for space in the queue
+};
+
+// Writes rendered frames into a video file on a background thread. Enqueue() swaps the pixels of the frame into a
+// bounded ring and only waits while the ring is full, so the renderer keeps working while earlier frames are flipped
+// and encoded. The caller gets the buffer of an already encoded frame back, no pixels are copied or reallocated.
+class VideoEncoder
+{
+public:
+    ~VideoEncoder();
+
+    // codec is a FourCC like MJPG
+    bool Open(const std::string& path, const std::string& codec, double fps, int width, int height, size_t queueDepth);
+
+    // Encode the remaining frames, close the file and join the encoder thread
+    void Close();
+
+    // Frames of another size than the one given to Open are skipped by the encoder
+    void Enqueue(Visualization::RenderedFrame& frame);
+
+    VideoEncoderStatistics GetStatistics() const;
+
+private:
+    void EncoderThread();
+
+    cv::VideoWriter m_writer;
+    std::thread m_thread;
+    int m_width = 0;
+    int m_height = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::vector<Visualization::RenderedFrame> m_frames;
+    size_t m_head = 0;
+    size_t m_count = 0;
+    bool m_isOpen = false;
+
+    std::atomic<uint64_t> m_encoded{ 0 };
+    std::atomic<uint64_t> m_encodeUsec{ 0 };
+    std::atomic<uint64_t> m_blockedUsec{ 0 };
+};
@@ -3,6 +3,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 #define _SILENCE_CXX17_ITERATOR_BASE_CLASS_DEPRECATION_WARNING
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <map>
@@ -40,6 +41,16 @@
 
 #include <jsoncons/json.hpp>
 #include "transformation_helpers.h"
+#include "CaptureExport.h"
+#include "DeviceProcessingContext.h"
+#include "FrameWriter.h"
+#include "PreTriggerBuffer.h"
+#include "SyncMonitor.h"
+#include "MultiDeviceCapture.h"
+#include "RigConfiguration.h"
+#include "SelfTest.h"
+#include "SessionRenderer.h"
+#include "SyncGrouper.h"
 
 using bsoncxx::builder::basic::kvp;
 using bsoncxx::builder::basic::make_array;
@@ -48,175 +59,6 @@ using bsoncxx::builder::basic::make_document;
 using namespace cv;
 
 
-static bool color_to_depth_camera(k4a_transformation_t& transformation_handle,
-	const k4a_image_t& depth_image,
-	const k4a_image_t& color_image,
-	k4a_image_t* image_handle
-
-) {
-	int depth_image_width_pixels = k4a_image_get_width_pixels(depth_image);
-	int depth_image_height_pixels = k4a_image_get_height_pixels(depth_image);
-	k4a_image_t transformed_color_image = nullptr;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32,
-		depth_image_width_pixels,
-		depth_image_height_pixels,
-		depth_image_width_pixels * 4 * (int)sizeof(uint8_t),
-		&transformed_color_image))
-	{
-		printf("Failed to create transformed color image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED != k4a_transformation_color_image_to_depth_camera(transformation_handle,
-		depth_image,
-		color_image,
-		transformed_color_image))
-	{
-		printf("Failed to compute transformed color image\n");
-		return false;
-	}
-
-	*image_handle = transformed_color_image;
-	return true;
-}
-
-k4a_image_t depth_to_color_camera(k4a_transformation_t transformation_handle,
-	const k4a_image_t depth_image,
-	const k4a_image_t color_image
-
-) {
-	int color_image_width_pixels = k4a_image_get_width_pixels(color_image);
-	int color_image_height_pixels = k4a_image_get_height_pixels(color_image);
-	k4a_image_t transformed_depth_image = NULL;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16,
-		color_image_width_pixels,
-		color_image_height_pixels,
-		color_image_width_pixels * (int)sizeof(uint16_t),
-		&transformed_depth_image))
-	{
-		printf("Failed to create transformed depth image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED !=
-		k4a_transformation_depth_image_to_color_camera(transformation_handle, depth_image, transformed_depth_image))
-	{
-		printf("Failed to compute transformed depth image\n");
-		return false;
-	}
-
-	return transformed_depth_image;
-}
-
-static bool point_cloud_color_to_depth(k4a_transformation_t transformation_handle,
-	const k4a_image_t depth_image,
-	const k4a_image_t color_image,
-	std::string file_name)
-{
-	int depth_image_width_pixels = k4a_image_get_width_pixels(depth_image);
-	int depth_image_height_pixels = k4a_image_get_height_pixels(depth_image);
-	k4a_image_t transformed_color_image = NULL;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32,
-		depth_image_width_pixels,
-		depth_image_height_pixels,
-		depth_image_width_pixels * 4 * (int)sizeof(uint8_t),
-		&transformed_color_image))
-	{
-		printf("Failed to create transformed color image\n");
-		return false;
-	}
-
-	k4a_image_t point_cloud_image = NULL;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-		depth_image_width_pixels,
-		depth_image_height_pixels,
-		depth_image_width_pixels * 3 * (int)sizeof(int16_t),
-		&point_cloud_image))
-	{
-		printf("Failed to create point cloud image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED != k4a_transformation_color_image_to_depth_camera(transformation_handle,
-		depth_image,
-		color_image,
-		transformed_color_image))
-	{
-		printf("Failed to compute transformed color image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED != k4a_transformation_depth_image_to_point_cloud(transformation_handle,
-		depth_image,
-		K4A_CALIBRATION_TYPE_DEPTH,
-		point_cloud_image))
-	{
-		printf("Failed to compute point cloud\n");
-		return false;
-	}
-
-	tranformation_helpers_write_point_cloud(point_cloud_image, transformed_color_image, file_name.c_str());
-
-	k4a_image_release(transformed_color_image);
-	k4a_image_release(point_cloud_image);
-
-	return true;
-}
-
-static bool point_cloud_depth_to_color(k4a_transformation_t transformation_handle,
-	const k4a_image_t depth_image,
-	const k4a_image_t color_image,
-	std::string file_name)
-{
-	// transform color image into depth camera geometry
-	int color_image_width_pixels = k4a_image_get_width_pixels(color_image);
-	int color_image_height_pixels = k4a_image_get_height_pixels(color_image);
-	k4a_image_t transformed_depth_image = NULL;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16,
-		color_image_width_pixels,
-		color_image_height_pixels,
-		color_image_width_pixels * (int)sizeof(uint16_t),
-		&transformed_depth_image))
-	{
-		printf("Failed to create transformed depth image\n");
-		return false;
-	}
-
-	k4a_image_t point_cloud_image = NULL;
-	if (K4A_RESULT_SUCCEEDED != k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-		color_image_width_pixels,
-		color_image_height_pixels,
-		color_image_width_pixels * 3 * (int)sizeof(int16_t),
-		&point_cloud_image))
-	{
-		printf("Failed to create point cloud image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED !=
-		k4a_transformation_depth_image_to_color_camera(transformation_handle, depth_image, transformed_depth_image))
-	{
-		printf("Failed to compute transformed depth image\n");
-		return false;
-	}
-
-	if (K4A_RESULT_SUCCEEDED != k4a_transformation_depth_image_to_point_cloud(transformation_handle,
-		transformed_depth_image,
-		K4A_CALIBRATION_TYPE_COLOR,
-		point_cloud_image))
-	{
-		printf("Failed to compute point cloud\n");
-		return false;
-	}
-
-	tranformation_helpers_write_point_cloud(point_cloud_image, color_image, file_name.c_str());
-
-	k4a_image_release(transformed_depth_image);
-	k4a_image_release(point_cloud_image);
-
-	return true;
-}
-
 template<typename T>
 inline void ConvertToGrayScaleImage(const T* imgDat, const int size, const int vmin, const int vmax, uint8_t* img)
 {
@@ -255,6 +97,15 @@ void PrintAppUsage()
 	printf(" h: help\n");
 	printf(" b: body visualization mode\n");
 	printf(" k: 3d window layout\n");
+	printf(" p: toggle writing mode (triggered recording also writes the seconds before the toggle)\n");
+	printf(" F6: render statistics overlay, the window title shows the frame times\n");
+	printf(" t: write the render statistics of the last frames to render_statistics.csv\n");
+	printf("\n");
+	printf(" Usage: simple_3d_viewer.exe [NFOV_UNBINNED|WFOV_BINNED] [rig_config.json]\n");
+	printf(" Offline rendering of recordings into videos: simple_3d_viewer.exe RENDER [render_config.json] recording.mkv [...]\n");
+	printf(" Decoding of written depth codec files into PNG files: simple_3d_viewer.exe DECODE depth.k4dz [...]\n");
+	printf(" Hardware free self tests of the capture engine and the writers: simple_3d_viewer.exe TEST\n");
+	printf(" Export of a session container into PNG and JPEG files: simple_3d_viewer.exe EXPORT container_path [output_directory]\n");
 	printf("\n");
 }
 
@@ -263,6 +114,7 @@ bool s_isRunning = true;
 Visualization::Layout3d s_layoutMode = Visualization::Layout3d::OnlyMainView;
 bool s_visualizeJointFrame = false;
 bool writing_mode = false;
+bool s_writeRenderStatistics = false;
 
 int64_t ProcessKey(void* /*context*/, int key)
 {
@@ -282,6 +134,9 @@ int64_t ProcessKey(void* /*context*/, int key)
 	case GLFW_KEY_H:
 		PrintAppUsage();
 		break;
+	case GLFW_KEY_T:
+		s_writeRenderStatistics = true;
+		break;
 	case GLFW_KEY_P:
 		writing_mode = !writing_mode;
 		if (writing_mode) {
@@ -323,263 +178,331 @@ k4a_depth_mode_t ParseDepthModeFromArg(int argc, char** argv)
 	return depthCameraMode;
 }
 
+// Wraps the buffer without copying it, the Mat is only valid as long as the buffer
 template<typename T> Mat create_mat_from_buffer(T* data, int width, int height, int channels = 1)
 {
-	Mat mat(height, width, CV_MAKETYPE(DataType<T>::type, channels));
-	memcpy(mat.data, data, width * height * channels * sizeof(T));
-	return mat;
+	return Mat(height, width, CV_MAKETYPE(DataType<T>::type, channels), data);
 }
 
-int main(int argc, char** argv)
+// The point cloud is only written for the first device
+void EnqueueCaptureGroup(FrameWriter& frameWriter, const CaptureGroup& captureGroup, std::time_t timestamp)
 {
-
-
-	k4a_depth_mode_t depthCameraMode = ParseDepthModeFromArg(argc, argv);
-	if (depthCameraMode == K4A_DEPTH_MODE_OFF)
+	uint64_t timestamp_usec = captureGroup.GetDeviceTimestampUsec(0);
+	for (size_t deviceSlot = 0; deviceSlot < captureGroup.GetDeviceCount(); deviceSlot++)
 	{
-		return -1;
+		frameWriter.Enqueue(deviceSlot, captureGroup.GetCapture(deviceSlot), captureGroup.GetGroupId(), timestamp, timestamp_usec, deviceSlot == 0);
 	}
-	PrintAppUsage();
-
-	k4a_device_t device0 = nullptr;
-	k4a_device_t device1 = nullptr;
-	k4a_device_t device2 = nullptr;
+}
 
-	k4a_device_open(1, &device1);
-	k4a_device_open(2, &device2);
-	k4a_device_open(0, &device0);
+// The point clouds of all devices are rendered in the 3d window, placed by the depth_to_rig pose of every device
+size_t AddRigDepthSources(Window3dWrapper& window3d, const MultiDeviceCapture& multiDeviceCapture)
+{
+	const size_t sourceCount = std::min<size_t>(multiDeviceCapture.GetDeviceCount(), Visualization::PointCloudRenderer::MaxDepthSources);
+	if (sourceCount < multiDeviceCapture.GetDeviceCount())
+	{
+		std::cout << "Only the point clouds of the first " << sourceCount << " devices are rendered" << std::endl;
+	}
 
+	window3d.SetDepthSourceTransform(0, multiDeviceCapture.GetSource(0).GetConfig().DepthToRig);
+	for (size_t deviceSlot = 1; deviceSlot < sourceCount; deviceSlot++)
+	{
+		window3d.AddDepthSource(multiDeviceCapture.GetCalibration(deviceSlot), multiDeviceCapture.GetSource(deviceSlot).GetConfig().DepthToRig);
+	}
+	return sourceCount;
+}
 
-	// Start camera. Make sure depth camera is enabled.
-	k4a_device_configuration_t deviceConfig0 = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-	deviceConfig0.wired_sync_mode = K4A_WIRED_SYNC_MODE_MASTER;
-	deviceConfig0.depth_mode = depthCameraMode;
-	deviceConfig0.color_resolution = K4A_COLOR_RESOLUTION_720P;
-	deviceConfig0.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32; //K4A_IMAGE_FORMAT_COLOR_MJPG
-	deviceConfig0.synchronized_images_only = true;
-	deviceConfig0.camera_fps = K4A_FRAMES_PER_SECOND_5;
+void UpdateRigPointClouds(Window3dWrapper& window3d, const CaptureGroup& captureGroup, size_t sourceCount)
+{
+	for (size_t deviceSlot = 0; deviceSlot < sourceCount; deviceSlot++)
+	{
+		k4a_capture_t capture = captureGroup.GetCapture(deviceSlot);
+		k4a_image_t depthImage = capture != nullptr ? k4a_capture_get_depth_image(capture) : nullptr;
+		if (depthImage != nullptr)
+		{
+			window3d.UpdateDepthSource(static_cast<uint32_t>(deviceSlot), depthImage);
+			k4a_image_release(depthImage);
+		}
+	}
+}
 
-	k4a_device_configuration_t deviceConfig1 = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-	deviceConfig1.wired_sync_mode = K4A_WIRED_SYNC_MODE_SUBORDINATE;
-	deviceConfig1.depth_mode = depthCameraMode;
-	deviceConfig1.color_resolution = K4A_COLOR_RESOLUTION_720P;
-	deviceConfig1.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32; //K4A_IMAGE_FORMAT_COLOR_MJPG
-	deviceConfig1.synchronized_images_only = true;
-	deviceConfig1.camera_fps = K4A_FRAMES_PER_SECOND_5;
+// Render recordings into video files without a window, the render_* settings come from the optional json file
+int RenderRecordings(int argc, char** argv)
+{
+	RigConfiguration rigConfig = CreateDefaultRigConfiguration(K4A_DEPTH_MODE_NFOV_UNBINNED);
+	std::vector<std::string> recordingPaths;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string inputArg(argv[i]);
+		if (inputArg.size() > 5 && inputArg.substr(inputArg.size() - 5) == ".json")
+		{
+			EXIT_IF(!LoadRigConfiguration(inputArg, rigConfig), "Load render configuration failed!");
+		}
+		else
+		{
+			recordingPaths.push_back(inputArg);
+		}
+	}
+	EXIT_IF(recordingPaths.empty(), "No recordings to render!");
 
-	k4a_device_configuration_t deviceConfig2 = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-	deviceConfig2.wired_sync_mode = K4A_WIRED_SYNC_MODE_SUBORDINATE;
-	deviceConfig2.depth_mode = depthCameraMode;
-	deviceConfig2.color_resolution = K4A_COLOR_RESOLUTION_720P;
-	deviceConfig2.color_format = K4A_IMAGE_FORMAT_COLOR_BGRA32; //K4A_IMAGE_FORMAT_COLOR_MJPG
-	deviceConfig2.synchronized_images_only = true;
-	deviceConfig2.camera_fps = K4A_FRAMES_PER_SECOND_5;
+	std::vector<SessionRenderJob> jobs;
+	EXIT_IF(!SessionRenderer::CreateJobs(rigConfig.Render, recordingPaths, jobs), "Create render jobs failed!");
 
-	k4a_device_start_cameras(device1, &deviceConfig1);
-	k4a_device_start_cameras(device2, &deviceConfig2);
-	k4a_device_start_cameras(device0, &deviceConfig0);
+	auto start = std::chrono::steady_clock::now();
+	SessionRenderer sessionRenderer;
+	const bool succeeded = sessionRenderer.Run(rigConfig.Render, jobs);
+	const auto elapsedMsec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
 
+	SessionRenderStatistics statistics = sessionRenderer.GetStatistics();
+	std::cout << "Rendered " << statistics.Jobs << " of " << jobs.size() << " jobs (" << statistics.FailedJobs << " failed)"
+		<< ", " << statistics.Frames << " frames from " << statistics.Captures << " captures in " << elapsedMsec << " ms" << std::endl;
+	if (statistics.Frames > 0)
+	{
+		std::cout << "  tracking " << statistics.TrackingUsec / statistics.Frames << " usec/frame"
+			<< ", render " << statistics.RenderUsec / statistics.Frames << " usec/frame"
+			<< ", encode " << statistics.EncodeUsec / statistics.Frames << " usec/frame"
+			<< ", encoder blocked " << statistics.EncoderBlockedUsec / 1000 << " ms" << std::endl;
+	}
+	return succeeded ? 0 : -1;
+}
 
+// Decode depth codec files written in the writing mode into 16 bit PNG files next to them
+int DecodeDepth(int argc, char** argv)
+{
+	std::vector<std::string> paths(argv + 2, argv + argc);
+	EXIT_IF(paths.empty(), "No depth codec files to decode!");
 
-	// Get calibration information
+	CaptureExportStatistics statistics;
+	auto start = std::chrono::steady_clock::now();
+	const bool succeeded = DecodeDepthFiles(paths, statistics);
+	const auto elapsedMsec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
 
-	k4a_calibration_t sensorCalibration2;
-	k4a_device_get_calibration(device2, deviceConfig2.depth_mode, deviceConfig2.color_resolution, &sensorCalibration2);
+	std::cout << "Decoded " << statistics.DepthFrames << " of " << paths.size() << " depth frames (" << statistics.Failures << " failed)"
+		<< " in " << elapsedMsec << " ms" << std::endl;
+	if (statistics.EncodedBytes > 0)
+	{
+		std::cout << "  compression ratio " << (double)statistics.DecodedBytes / statistics.EncodedBytes << std::endl;
+	}
+	return succeeded ? 0 : -1;
+}
 
-	k4a_calibration_t sensorCalibration1;
-	k4a_device_get_calibration(device1, deviceConfig1.depth_mode, deviceConfig1.color_resolution, &sensorCalibration1);
+// Export the payloads of a session container into the loose files of the writing mode
+int ExportCaptureContainer(int argc, char** argv)
+{
+	EXIT_IF(argc < 3, "No container to export!");
+	const std::string containerPath(argv[2]);
+	const std::string outputDirectory(argc > 3 ? argv[3] : ".");
+
+	CaptureExportStatistics statistics;
+	auto start = std::chrono::steady_clock::now();
+	const bool succeeded = ExportContainer(containerPath, outputDirectory, statistics);
+	const auto elapsedMsec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Exported " << statistics.DepthFrames << " depth and " << statistics.ColorFrames << " color frames ("
+		<< statistics.Failures << " failed) in " << elapsedMsec << " ms" << std::endl;
+	return succeeded ? 0 : -1;
+}
 
-	k4a_calibration_t sensorCalibration0;
-	k4a_device_get_calibration(device0, deviceConfig0.depth_mode, deviceConfig0.color_resolution, &sensorCalibration0);
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::string(argv[1]) == "RENDER")
+	{
+		return RenderRecordings(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "DECODE")
+	{
+		return DecodeDepth(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "EXPORT")
+	{
+		return ExportCaptureContainer(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "TEST")
+	{
+		return RunSelfTests() ? 0 : -1;
+	}
 
+	k4a_depth_mode_t depthCameraMode = ParseDepthModeFromArg(argc, argv);
+	if (depthCameraMode == K4A_DEPTH_MODE_OFF)
+	{
+		return -1;
+	}
+	PrintAppUsage();
 
-	int depthWidth2 = sensorCalibration2.depth_camera_calibration.resolution_width;
-	int depthHeight2 = sensorCalibration2.depth_camera_calibration.resolution_height;
+	// Device order and master/subordinate roles come from the rig configuration (second argument)
+	RigConfiguration rigConfig = CreateDefaultRigConfiguration(depthCameraMode);
+	if (argc > 2)
+	{
+		EXIT_IF(!LoadRigConfiguration(argv[2], rigConfig), "Load rig configuration failed!");
+	}
 
-	int depthWidth1 = sensorCalibration1.depth_camera_calibration.resolution_width;
-	int depthHeight1 = sensorCalibration1.depth_camera_calibration.resolution_height;
+	// Sync quality of every capture and group, dumped periodically when monitor_path is configured. Start()
+	// initializes it with the opened sources, recordings bring their own roles and delays.
+	SyncMonitor syncMonitor;
 
-	int depthWidth0 = sensorCalibration0.depth_camera_calibration.resolution_width;
-	int depthHeight0 = sensorCalibration0.depth_camera_calibration.resolution_height;
+	// Start one capture thread per device
+	MultiDeviceCapture multiDeviceCapture;
+	EXIT_IF(!multiDeviceCapture.Start(rigConfig, &syncMonitor), "Start multi device capture failed!");
+	const size_t deviceCount = multiDeviceCapture.GetDeviceCount();
 
 	// Initialize the 3d window controller
 	Window3dWrapper window3d;
-	window3d.Create("3D Visualization", sensorCalibration0);
+	window3d.Create("3D Visualization", multiDeviceCapture.GetCalibration(0));
 	window3d.SetCloseCallback(CloseCallback);
 	window3d.SetKeyCallback(ProcessKey);
+	const size_t depthSourceCount = AddRigDepthSources(window3d, multiDeviceCapture);
 
-	while (s_isRunning)
+	// Transformations and output images are created once per device and reused for every frame. Every encoder
+	// thread can hold one image of each kind.
+	std::vector<std::unique_ptr<DeviceProcessingContext>> processingContexts;
+	std::vector<DeviceProcessingContext*> processingContextPointers;
+	for (size_t deviceSlot = 0; deviceSlot < deviceCount; deviceSlot++)
 	{
+		processingContexts.push_back(std::make_unique<DeviceProcessingContext>());
+		EXIT_IF(!processingContexts.back()->Initialize(multiDeviceCapture.GetCalibration(deviceSlot), rigConfig.Writer.ThreadCount),
+			"Initialize device processing context failed!");
+		processingContextPointers.push_back(processingContexts.back().get());
+	}
 
+	// Encoding and writing the files happens on the frame writer threads
+	FrameWriter frameWriter;
+	EXIT_IF(!frameWriter.Start(rigConfig.Writer, processingContextPointers), "Start frame writer failed!");
 
+	// Match the captures of all devices by device timestamp
+	SyncGrouper syncGrouper(multiDeviceCapture, rigConfig.Sync);
+	CaptureGroup captureGroup;
 
-		k4a_capture_t sensorCapture0 = nullptr;
-		k4a_wait_result_t getCaptureResult0 = k4a_device_get_capture(device0, &sensorCapture0, 250); // timeout_in_ms is set to 0
-
-		k4a_capture_t sensorCapture1 = nullptr;
-		k4a_wait_result_t getCaptureResult1 = k4a_device_get_capture(device1, &sensorCapture1, 250); // timeout_in_ms is set to 0
-
-		k4a_capture_t sensorCapture2 = nullptr;
-		k4a_wait_result_t getCaptureResult2 = k4a_device_get_capture(device2, &sensorCapture2, 250); // timeout_in_ms is set to 0
+	// Triggered recording keeps the last seconds of groups in memory and only writes while writing mode is on
+	const bool isTriggered = rigConfig.Recording.Mode == RecordingMode::Triggered;
+	PreTriggerBuffer preTriggerBuffer(rigConfig.Recording);
+	bool wasWriting = false;
 
-		std::string dateTimeString{};
-		std::string filename_depth_0{};
-		std::string filename_color_0{};
-		std::string filename_point_cloud{};
-		std::string filename_depth_1{};
-		std::string filename_color_1{};
-		std::string filename_depth_2{};
-		std::string filename_color_2{};
+	while (s_isRunning && multiDeviceCapture.HasActiveSources())
+	{
+		multiDeviceCapture.WaitForCaptures(std::chrono::milliseconds(10));
 
-		if (getCaptureResult0 == K4A_WAIT_RESULT_SUCCEEDED 
-			&& getCaptureResult1 == K4A_WAIT_RESULT_SUCCEEDED && getCaptureResult2 == K4A_WAIT_RESULT_SUCCEEDED
-			)
+		if (syncGrouper.TryGetGroup(captureGroup))
 		{
+			syncMonitor.OnGroup(captureGroup, frameWriter.GetQueueDepth());
+			UpdateRigPointClouds(window3d, captureGroup, depthSourceCount);
 
-			k4a_transformation_t transformation0 = k4a_transformation_create(&sensorCalibration0);
-
-			k4a_image_t colorImage0 = k4a_capture_get_color_image(sensorCapture0);
-			k4a_image_t depthImage0 = k4a_capture_get_depth_image(sensorCapture0);
-			k4a_image_t transformed_color_image0;
-			color_to_depth_camera(transformation0, depthImage0, colorImage0, &transformed_color_image0);
-
-			uint8_t* depthBuffer0 = k4a_image_get_buffer(depthImage0);
-			//uint16_t* depthBuffer0 = reinterpret_cast<uint16_t*>(_depthBuffer0);
-			uint8_t* colorBuffer0 = k4a_image_get_buffer(transformed_color_image0);
-
-
-			uint64_t timestamp_usec = k4a_image_get_timestamp_usec(depthImage0);
 			auto now = std::chrono::system_clock::now();
 			std::time_t timestamp = std::chrono::system_clock::to_time_t(now);
 
-			std::stringstream ssd0;
-			ssd0 << "d0_" << timestamp << "_" << timestamp_usec << ".png";
-			filename_depth_0 = ssd0.str();
-
-			std::stringstream ssc0;
-			ssc0 << "c0_" << timestamp << "_" << timestamp_usec << ".jpg";
-			filename_color_0 = ssc0.str();
-
-			std::stringstream ssp0;
-			ssp0 << "pc_" << timestamp_usec << ".ply";
-			filename_point_cloud = ssp0.str();
-			//std::cout << filename_depth_0 << std::endl;
-
-			//imwrite(filename_depth_0, create_mat_from_buffer<uint16_t>(depthBuffer0, depthWidth0, depthHeight0));
-			const Mat depthImg0(depthHeight0, depthWidth0, CV_16UC1, depthBuffer0);
-			imwrite(filename_depth_0, depthImg0);
-
-			const Mat _colorImg0(depthHeight0, depthWidth0, CV_8UC4, colorBuffer0);
-			Mat colorImg0; cvtColor(_colorImg0, colorImg0, COLOR_BGRA2BGR); imwrite(filename_color_0, colorImg0);
-
-			point_cloud_depth_to_color(transformation0, depthImage0, colorImage0, filename_point_cloud);
-
-			k4a_transformation_destroy(transformation0);
-
-
-			////////////////////////////////////////////////////////////////////////////////////////////////
-
-
-			k4a_transformation_t transformation1 = k4a_transformation_create(&sensorCalibration1);
-
-			k4a_image_t colorImage1 = k4a_capture_get_color_image(sensorCapture1);
-			k4a_image_t depthImage1 = k4a_capture_get_depth_image(sensorCapture1);
-			k4a_image_t transformed_color_image1;
-			color_to_depth_camera(transformation1, depthImage1, colorImage1, &transformed_color_image1);
-
-			uint8_t* depthBuffer1 = k4a_image_get_buffer(depthImage1);
-			////uint16_t* depthBuffer1 = reinterpret_cast<uint16_t*>(_depthBuffer1);
-			uint8_t* colorBuffer1 = k4a_image_get_buffer(transformed_color_image1);
-
-			std::stringstream ssd1;
-			ssd1 << "d1_" << timestamp << "_" << timestamp_usec << ".png";
-			filename_depth_1 = ssd1.str();
-
-			std::stringstream ssc1;
-			ssc1 << "c1_" << timestamp << "_" << timestamp_usec << ".jpg";
-			filename_color_1 = ssc1.str();
-
-			//imwrite(filename_depth_1, create_mat_from_buffer<uint16_t>(depthBuffer1, depthWidth1, depthHeight1));
-
-			const Mat depthImg1(depthHeight1, depthWidth1, CV_16UC1, depthBuffer1);
-			imwrite(filename_depth_1, depthImg1);
-
-			const Mat _colorImg1(depthHeight1, depthWidth1, CV_8UC4, colorBuffer1);
-			Mat colorImg1; cvtColor(_colorImg1, colorImg1, COLOR_BGRA2BGR); imwrite(filename_color_1, colorImg1);
-
-			k4a_transformation_destroy(transformation1);*/
-
-
-
-			/////////////////////////////////////////////////////////////////////////////////////////
-
-
-			k4a_transformation_t transformation2 = k4a_transformation_create(&sensorCalibration2);
-
-			k4a_image_t colorImage2 = k4a_capture_get_color_image(sensorCapture2);
-			k4a_image_t depthImage2 = k4a_capture_get_depth_image(sensorCapture2);
-			k4a_image_t transformed_color_image2;
-			color_to_depth_camera(transformation2, depthImage2, colorImage2, &transformed_color_image2);
-
-			uint8_t* depthBuffer2 = k4a_image_get_buffer(depthImage2);
-			////uint16_t* depthBuffer1 = reinterpret_cast<uint16_t*>(_depthBuffer1);
-			uint8_t* colorBuffer2 = k4a_image_get_buffer(transformed_color_image2);
-
-			std::stringstream ssd2;
-			ssd2 << "d2_" << timestamp << "_" << timestamp_usec << ".png";
-			filename_depth_2 = ssd2.str();
-
-			std::stringstream ssc2;
-			ssc2 << "c2_" << timestamp << "_" << timestamp_usec << ".jpg";
-			filename_color_2 = ssc2.str();
-
-			//imwrite(filename_depth_1, create_mat_from_buffer<uint16_t>(depthBuffer1, depthWidth1, depthHeight1));
-
-			const Mat depthImg2(depthHeight2, depthWidth2, CV_16UC1, depthBuffer2);
-			imwrite(filename_depth_2, depthImg2);
+			if (isTriggered)
+			{
+				preTriggerBuffer.Push(captureGroup, timestamp);
+			}
+			else
+			{
+				EnqueueCaptureGroup(frameWriter, captureGroup, timestamp);
+				captureGroup.Reset();
+			}
+		}
 
-			const Mat _colorImg2(depthHeight2, depthWidth2, CV_8UC4, colorBuffer2);
-			Mat colorImg2; cvtColor(_colorImg2, colorImg2, COLOR_BGRA2BGR); imwrite(filename_color_2, colorImg2);
+		if (isTriggered)
+		{
+			if (writing_mode && !wasWriting)
+			{
+				std::cout << "Writing " << preTriggerBuffer.GetGroupCount() << " buffered groups ("
+					<< preTriggerBuffer.GetDurationUsec() / 1000 << " ms) before the trigger" << std::endl;
+			}
+			wasWriting = writing_mode;
+			preTriggerBuffer.SetTriggered(writing_mode);
+
+			// Hand over only what fits into the writer queue, the rest of the pre-roll follows in the next iterations
+			std::time_t timestamp;
+			while (frameWriter.HasCapacity(deviceCount) && preTriggerBuffer.TryPop(captureGroup, timestamp))
+			{
+				EnqueueCaptureGroup(frameWriter, captureGroup, timestamp);
+				captureGroup.Reset();
+			}
+		}
 
-			k4a_transformation_destroy(transformation2);
+		syncMonitor.DumpIfDue();
+		window3d.Render();
 
+		if (s_writeRenderStatistics)
+		{
+			// The first request only starts collecting, the file gets the frames since then
+			window3d.EnableRenderStatistics(true);
+			if (window3d.GetRenderStatistics().FrameCount == 0)
+			{
+				std::cout << "Collecting render statistics, press t again to write them." << std::endl;
+			}
+			else if (window3d.WriteRenderStatisticsCsv("render_statistics.csv"))
+			{
+				std::cout << "Render statistics written to render_statistics.csv" << std::endl;
+			}
+			s_writeRenderStatistics = false;
+		}
+	}
 
-			////imwrite(filename0, create_mat_from_buffer<uint16_t>(depthBuffer0, depthWidth, depthHeight));
-			////point_cloud_depth_to_color(transformation0, depthImage0, colorImage0, filename0);
+	// Groups of an event that is still running or has not been written completely are not lost on exit
+	std::time_t timestamp;
+	preTriggerBuffer.SetTriggered(false);
+	while (preTriggerBuffer.TryPop(captureGroup, timestamp))
+	{
+		EnqueueCaptureGroup(frameWriter, captureGroup, timestamp);
+		captureGroup.Reset();
+	}
 
-			k4a_image_release(colorImage0);
-			k4a_image_release(depthImage0);
-			k4a_image_release(transformed_color_image0);
+	captureGroup.Reset();
+	frameWriter.Stop();
 
-			k4a_image_release(colorImage1);
-			k4a_image_release(depthImage1);
-			k4a_image_release(transformed_color_image1);
+	FrameWriterStatistics writerStatistics = frameWriter.GetStatistics();
+	std::cout << "Writer: enqueued " << writerStatistics.Enqueued
+		<< ", dropped " << writerStatistics.Dropped
+		<< ", written " << writerStatistics.Completed
+		<< ", max queue depth " << writerStatistics.MaxQueueDepth
+		<< ", blocked " << writerStatistics.BlockedUsec / 1000 << " ms" << std::endl;
+	for (size_t stage = 0; stage < (size_t)WriteStage::Count; stage++)
+	{
+		const WriteStageStatistics& stageStatistics = writerStatistics.Stages[stage];
+		std::cout << "  " << GetWriteStageName((WriteStage)stage) << ": " << stageStatistics.Count
+			<< " (" << stageStatistics.Failures << " failed), average "
+			<< (stageStatistics.Count > 0 ? stageStatistics.TotalUsec / stageStatistics.Count : 0) << " usec" << std::endl;
+	}
 
-			k4a_image_release(colorImage2);
-			k4a_image_release(depthImage2);
-			k4a_image_release(transformed_color_image2);
+	if (isTriggered)
+	{
+		const PreTriggerStatistics& preTriggerStatistics = preTriggerBuffer.GetStatistics();
+		std::cout << "Pre-trigger buffer: written " << preTriggerStatistics.Released
+			<< ", evicted " << preTriggerStatistics.Evicted
+			<< " (" << preTriggerStatistics.EvictedRecording << " while writing)"
+			<< ", max " << preTriggerStatistics.MaxGroups << " groups / "
+			<< preTriggerStatistics.MaxBytes / (1024 * 1024) << " MB" << std::endl;
+	}
 
-			k4a_capture_release(sensorCapture0);
-			k4a_capture_release(sensorCapture1);
-			k4a_capture_release(sensorCapture2);
+	const SyncGroupStatistics& groupStatistics = syncGrouper.GetStatistics();
+	std::cout << "Groups: " << groupStatistics.Groups
+		<< ", incomplete " << groupStatistics.IncompleteGroups
+		<< ", max skew " << groupStatistics.MaxSkewUsec << " usec" << std::endl;
 
+	syncMonitor.Dump();
+	syncMonitor.PrintSummary();
 
-		}
-		else
+	for (size_t deviceSlot = 0; deviceSlot < deviceCount; deviceSlot++)
+	{
+		if (processingContexts[deviceSlot]->GetPoolGrowCount() > 0)
 		{
-			std::cout << "Get depth capture returned error: " << getCaptureResult0 << std::endl;
-			//std::cout << "Get depth capture returned error: " << getCaptureResult1 << std::endl;
+			std::cout << "Image pools of device " << deviceSlot << " had to grow "
+				<< processingContexts[deviceSlot]->GetPoolGrowCount() << " times" << std::endl;
 		}
 
-
+		DeviceCaptureStatistics statistics = multiDeviceCapture.GetStatistics(deviceSlot);
+		std::cout << multiDeviceCapture.GetSource(deviceSlot).GetName()
+			<< ": captured " << statistics.Captured
+			<< ", dropped " << statistics.DroppedQueueFull
+			<< ", unmatched " << groupStatistics.DroppedCaptures[deviceSlot]
+			<< ", timeouts " << statistics.Timeouts
+			<< ", failures " << statistics.Failures << std::endl;
 	}
 
 	std::cout << "Finished body tracking processing!!!!" << std::endl;
 
 	window3d.Delete();
 
-	k4a_device_stop_cameras(device0);
-	k4a_device_close(device0);
+	multiDeviceCapture.Stop();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -3,81 +3,82 @@
 
 #include "transformation_helpers.h"
 
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstring>
 
-#include <vector>
-
-struct color_point_t
+static void add_point_cloud_properties(PlyWriter& writer, PlyPropertyType coordinate_type)
 {
-	int16_t xyz[3];
-	uint8_t rgb[3];
-};
+	writer.AddProperty("x", coordinate_type);
+	writer.AddProperty("y", coordinate_type);
+	writer.AddProperty("z", coordinate_type);
+	writer.AddProperty("red", PlyPropertyType::UInt8);
+	writer.AddProperty("green", PlyPropertyType::UInt8);
+	writer.AddProperty("blue", PlyPropertyType::UInt8);
+}
 
-void tranformation_helpers_write_point_cloud(const k4a_image_t point_cloud_image,
+bool tranformation_helpers_write_point_cloud(const k4a_image_t point_cloud_image,
 	const k4a_image_t color_image,
-	const char* file_name)
+	const char* file_name,
+	PlyPropertyType coordinate_type)
 {
-	std::vector<color_point_t> points;
+	// One writer per thread and layout, so the output buffer is reused from frame to frame
+	thread_local PlyWriter float_writer;
+	thread_local PlyWriter int16_writer;
+	const bool quantized = coordinate_type == PlyPropertyType::Int16;
+	PlyWriter& writer = quantized ? int16_writer : float_writer;
+	if (writer.GetVertexSize() == 0)
+	{
+		add_point_cloud_properties(writer, quantized ? PlyPropertyType::Int16 : PlyPropertyType::Float32);
+	}
 
 	int width = k4a_image_get_width_pixels(point_cloud_image);
 	int height = k4a_image_get_height_pixels(color_image);
 
-	int16_t* point_cloud_image_data = (int16_t*)(void*)k4a_image_get_buffer(point_cloud_image);
-	uint8_t* color_image_data = k4a_image_get_buffer(color_image);
+	const int16_t* point_cloud_image_data = (const int16_t*)(void*)k4a_image_get_buffer(point_cloud_image);
+	const uint8_t* color_image_data = k4a_image_get_buffer(color_image);
 
+	if (!writer.Open(file_name))
+	{
+		return false;
+	}
+
+	// Single pass straight from the k4a buffers into the output buffer
 	for (int i = 0; i < width * height; i++)
 	{
-		color_point_t point;
-		point.xyz[0] = point_cloud_image_data[3 * i + 0];
-		point.xyz[1] = point_cloud_image_data[3 * i + 1];
-		point.xyz[2] = point_cloud_image_data[3 * i + 2];
-		if (point.xyz[2] == 0)
+		const int16_t* xyz = point_cloud_image_data + 3 * i;
+		const uint8_t* bgra = color_image_data + 4 * i;
+		if (xyz[2] == 0)
 		{
 			continue;
 		}
 
-		point.rgb[0] = color_image_data[4 * i + 0];
-		point.rgb[1] = color_image_data[4 * i + 1];
-		point.rgb[2] = color_image_data[4 * i + 2];
-		uint8_t alpha = color_image_data[4 * i + 3];
-
-		if (point.rgb[0] == 0 && point.rgb[1] == 0 && point.rgb[2] == 0 && alpha == 0)
+		if (bgra[0] == 0 && bgra[1] == 0 && bgra[2] == 0 && bgra[3] == 0)
 		{
 			continue;
 		}
 
-		points.push_back(point);
-	}
-
-#define PLY_START_HEADER "ply"
-#define PLY_END_HEADER "end_header"
-#define PLY_ASCII "format ascii 1.0"
-#define PLY_ELEMENT_VERTEX "element vertex"
+		uint8_t* vertex = writer.BeginVertex();
+		if (vertex == nullptr)
+		{
+			break;
+		}
 
-	// save to the ply file
-	std::ofstream ofs(file_name); // text mode first
-	ofs << PLY_START_HEADER << std::endl;
-	ofs << PLY_ASCII << std::endl;
-	ofs << PLY_ELEMENT_VERTEX << " " << points.size() << std::endl;
-	ofs << "property float x" << std::endl;
-	ofs << "property float y" << std::endl;
-	ofs << "property float z" << std::endl;
-	ofs << "property uchar red" << std::endl;
-	ofs << "property uchar green" << std::endl;
-	ofs << "property uchar blue" << std::endl;
-	ofs << PLY_END_HEADER << std::endl;
-	ofs.close();
+		if (quantized)
+		{
+			memcpy(vertex, xyz, 3 * sizeof(int16_t));
+			vertex += 3 * sizeof(int16_t);
+		}
+		else
+		{
+			const float coordinates[3] = { (float)xyz[0], (float)xyz[1], (float)xyz[2] };
+			memcpy(vertex, coordinates, sizeof(coordinates));
+			vertex += sizeof(coordinates);
+		}
 
-	std::stringstream ss;
-	for (size_t i = 0; i < points.size(); ++i)
-	{
 		// image data is BGR
-		ss << (float)points[i].xyz[0] << " " << (float)points[i].xyz[1] << " " << (float)points[i].xyz[2];
-		ss << " " << (float)points[i].rgb[2] << " " << (float)points[i].rgb[1] << " " << (float)points[i].rgb[0];
-		ss << std::endl;
+		vertex[0] = bgra[2];
+		vertex[1] = bgra[1];
+		vertex[2] = bgra[0];
 	}
-	std::ofstream ofs_text(file_name, std::ios::out | std::ios::app);
-	ofs_text.write(ss.str().c_str(), (std::streamsize)ss.str().length());
+
+	return writer.Close();
 }
\ No newline at end of file
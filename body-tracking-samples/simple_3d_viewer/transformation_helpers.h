@@ -3,7 +3,11 @@
 
 #pragma once
 #include <k4a/k4a.h>
+#include <PlyWriter.h>
 
-void tranformation_helpers_write_point_cloud(const k4a_image_t point_cloud_image,
+// Write the valid points of a k4a point cloud image (int16 xyz in millimeters) with the colors of a BGRA image of
+// the same geometry as binary PLY. coordinate_type selects float (default) or quantized int16 coordinates.
+bool tranformation_helpers_write_point_cloud(const k4a_image_t point_cloud_image,
 	const k4a_image_t color_image,
-	const char* file_name);
\ No newline at end of file
+	const char* file_name,
+	PlyPropertyType coordinate_type = PlyPropertyType::Float32);
\ No newline at end of file
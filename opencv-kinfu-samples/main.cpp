@@ -2,10 +2,19 @@
 // Licensed under the MIT License.
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <k4a/k4a.h>
+#include <BrownConradyCamera.h>
+#include <CalibrationLutCache.h>
+#include <PlyWriter.h>
 
 using namespace std;
 
@@ -35,11 +44,10 @@ void initialize_kinfu_params(kinfu::Params &params,
     params.depthFactor = 1000.0f;
 }
 
+// Wraps the buffer without copying it, the Mat is only valid as long as the buffer
 template<typename T> Mat create_mat_from_buffer(T *data, int width, int height, int channels = 1)
 {
-    Mat mat(height, width, CV_MAKETYPE(DataType<T>::type, channels));
-    memcpy(mat.data, data, width * height * channels * sizeof(T));
-    return mat;
+    return Mat(height, width, CV_MAKETYPE(DataType<T>::type, channels), data);
 }
 #endif
 
@@ -55,13 +63,6 @@ typedef struct _pinhole_t
     int height;
 } pinhole_t;
 
-typedef struct _coordinate_t
-{
-    int x;
-    int y;
-    float weight[4];
-} coordinate_t;
-
 typedef enum
 {
     INTERPOLATION_NEARESTNEIGHBOR, /**< Nearest neighbor interpolation */
@@ -70,6 +71,109 @@ typedef enum
                                                 data with value 0 */
 } interpolation_t;
 
+// Undistortion lookup table, one entry per pixel of the undistorted image in separate arrays so the remap kernels
+// load 8 entries with one instruction. The bilinear weights are recomputed from the fractional part of the distorted
+// point with the same float operations as before, fixed point weights would change the rounding of the output.
+typedef struct _remap_lut_t
+{
+    interpolation_t type;
+
+    // Size of the undistorted image
+    int width;
+    int height;
+
+    // Size of the distorted source image
+    int src_width;
+    int src_height;
+
+    // The arrays below, mapped from the calibration lut cache
+    CalibrationLut storage;
+
+    // y * src_width + x of the source pixel (bilinear: of the upper left neighbor), INVALID without a valid source
+    const int32_t* src_index;
+
+    // Bilinear only: distance of the distorted point to the upper left neighbor
+    const float* weight_x;
+    const float* weight_y;
+} remap_lut_t;
+
+// Initializes the batch camera model of the camera and checks it against the SDK on a grid of pixels. Returns false
+// for lens models it does not support and when it differs from the SDK, the callers then use the SDK per point.
+static bool initialize_batch_camera(const k4a_calibration_t* calibration,
+    const k4a_calibration_type_t camera,
+    BrownConradyCamera& batch_camera)
+{
+    const k4a_calibration_camera_t& camera_calibration = camera == K4A_CALIBRATION_TYPE_COLOR ?
+        calibration->color_camera_calibration : calibration->depth_camera_calibration;
+    if (!batch_camera.Initialize(camera_calibration))
+    {
+        return false;
+    }
+
+    BrownConradyCamera::Validation validation;
+    if (!BrownConradyCamera::Validate(*calibration, camera, 16, validation))
+    {
+        return false;
+    }
+    if (!validation.IsWithinTolerance())
+    {
+        printf("Batch camera model differs from the SDK: unproject %g, project %g pixels, %zu of %zu validity mismatches\n",
+            validation.MaxUnprojectError,
+            validation.MaxProjectError,
+            validation.ValidityMismatches,
+            validation.SampleCount);
+        return false;
+    }
+    return true;
+}
+
+// Unprojects count pixels from (u, v) on in steps of (du, dv) and returns the ray of the last pixel before the first
+// invalid one. Returns false when already the first pixel is invalid.
+static bool search_last_valid_ray(const k4a_calibration_t* calibration,
+    const k4a_calibration_type_t camera,
+    const BrownConradyCamera* batch_camera,
+    const float u,
+    const float v,
+    const float du,
+    const float dv,
+    const size_t count,
+    k4a_float3_t& last_ray)
+{
+    std::vector<k4a_float2_t> pixels(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        pixels[i].xy.x = u + i * du;
+        pixels[i].xy.y = v + i * dv;
+    }
+
+    std::vector<k4a_float3_t> rays(count);
+    std::vector<int> valid(count, 0);
+    if (batch_camera != nullptr)
+    {
+        // All pixels of the path at once, the path is at most a few thousand pixels long
+        batch_camera->Unproject(pixels.data(), 1.f, rays.data(), valid.data(), count);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            k4a_calibration_2d_to_3d(calibration, &pixels[i], 1.f, camera, camera, &rays[i], &valid[i]);
+            if (!valid[i])
+            {
+                break;
+            }
+        }
+    }
+
+    const size_t valid_count = std::find(valid.begin(), valid.end(), 0) - valid.begin();
+    if (valid_count == 0)
+    {
+        return false;
+    }
+    last_ray = rays[valid_count - 1];
+    return true;
+}
+
 // Compute a conservative bounding box on the unit plane in which all the points have valid projections
 static void compute_xy_range(const k4a_calibration_t* calibration,
     const k4a_calibration_type_t camera,
@@ -90,63 +194,30 @@ static void compute_xy_range(const k4a_calibration_t* calibration,
     const float center_u = 0.5f * width;
     const float center_v = 0.5f * height;
 
-    int valid;
-    k4a_float2_t p;
-    k4a_float3_t ray;
+    // Number of steps from the centre point that stay within the bounds, the centre point included
+    const size_t steps_to_min_u = (size_t)((center_u - min_u) / step_u) + 1;
+    const size_t steps_to_max_u = center_u <= max_u ? (size_t)((max_u - center_u) / step_u) + 1 : 0;
+    const size_t steps_to_min_v = (size_t)((center_v - min_v) / step_v) + 1;
+    const size_t steps_to_max_v = center_v <= max_v ? (size_t)((max_v - center_v) / step_v) + 1 : 0;
 
-    // search x_min
-    for (float uv[2] = { center_u, center_v }; uv[0] >= min_u; uv[0] -= step_u)
-    {
-        p.xy.x = uv[0];
-        p.xy.y = uv[1];
-        k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
+    BrownConradyCamera batch_camera;
+    const BrownConradyCamera* batch = initialize_batch_camera(calibration, camera, batch_camera) ? &batch_camera : nullptr;
 
-        if (!valid)
-        {
-            break;
-        }
+    k4a_float3_t ray;
+    if (search_last_valid_ray(calibration, camera, batch, center_u, center_v, -step_u, 0.f, steps_to_min_u, ray))
+    {
         x_min = ray.xyz.x;
     }
-
-    // search x_max
-    for (float uv[2] = { center_u, center_v }; uv[0] <= max_u; uv[0] += step_u)
+    if (search_last_valid_ray(calibration, camera, batch, center_u, center_v, step_u, 0.f, steps_to_max_u, ray))
     {
-        p.xy.x = uv[0];
-        p.xy.y = uv[1];
-        k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-        if (!valid)
-        {
-            break;
-        }
         x_max = ray.xyz.x;
     }
-
-    // search y_min
-    for (float uv[2] = { center_u, center_v }; uv[1] >= min_v; uv[1] -= step_v)
+    if (search_last_valid_ray(calibration, camera, batch, center_u, center_v, 0.f, -step_v, steps_to_min_v, ray))
     {
-        p.xy.x = uv[0];
-        p.xy.y = uv[1];
-        k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-        if (!valid)
-        {
-            break;
-        }
         y_min = ray.xyz.y;
     }
-
-    // search y_max
-    for (float uv[2] = { center_u, center_v }; uv[1] <= max_v; uv[1] += step_v)
+    if (search_last_valid_ray(calibration, camera, batch, center_u, center_v, 0.f, step_v, steps_to_max_v, ray))
     {
-        p.xy.x = uv[0];
-        p.xy.y = uv[1];
-        k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-        if (!valid)
-        {
-            break;
-        }
         y_max = ray.xyz.y;
     }
 }
@@ -181,137 +252,745 @@ static pinhole_t create_pinhole_from_xy_range(const k4a_calibration_t* calibrati
     return pinhole;
 }
 
-static void create_undistortion_lut(const k4a_calibration_t* calibration,
+// Computes the rows [row_begin, row_end) of the lut, see create_undistortion_lut. The rays of a row are distorted by
+// the batch camera model, or one by one by the SDK without it.
+static void compute_undistortion_lut_rows(const k4a_calibration_t* calibration,
     const k4a_calibration_type_t camera,
+    const BrownConradyCamera* batch_camera,
     const pinhole_t* pinhole,
-    k4a_image_t lut,
-    interpolation_t type)
+    const int src_width,
+    const int src_height,
+    const bool bilinear,
+    int32_t* lut_src_index,
+    float* lut_weight_x,
+    float* lut_weight_y,
+    const int row_begin,
+    const int row_end)
 {
-    coordinate_t* lut_data = (coordinate_t*)(void*)k4a_image_get_buffer(lut);
-
-    k4a_float3_t ray;
-    ray.xyz.z = 1.f;
-
-    int src_width = calibration->depth_camera_calibration.resolution_width;
-    int src_height = calibration->depth_camera_calibration.resolution_height;
-    if (camera == K4A_CALIBRATION_TYPE_COLOR)
+    // The lower right neighbor of a bilinear source has to be inside of the source image
+    const int64_t src_size = (int64_t)src_width * src_height;
+
+    // Rays of the row on the unit plane and their distorted pixels
+    std::vector<float> ray_x(pinhole->width);
+    std::vector<float> ray_y(pinhole->width);
+    std::vector<float> distorted_x(pinhole->width);
+    std::vector<float> distorted_y(pinhole->width);
+    std::vector<int> distorted_valid(pinhole->width);
+    for (int x = 0; x < pinhole->width; x++)
     {
-        src_width = calibration->color_camera_calibration.resolution_width;
-        src_height = calibration->color_camera_calibration.resolution_height;
+        ray_x[x] = ((float)x - pinhole->px) / pinhole->fx;
     }
 
-    for (int y = 0, idx = 0; y < pinhole->height; y++)
+    for (int y = row_begin, idx = row_begin * pinhole->width; y < row_end; y++)
     {
-        ray.xyz.y = ((float)y - pinhole->py) / pinhole->fy;
+        std::fill(ray_y.begin(), ray_y.end(), ((float)y - pinhole->py) / pinhole->fy);
 
-        for (int x = 0; x < pinhole->width; x++, idx++)
+        if (batch_camera != nullptr)
         {
-            ray.xyz.x = ((float)x - pinhole->px) / pinhole->fx;
+            batch_camera->Distort(ray_x.data(), ray_y.data(), distorted_x.data(), distorted_y.data(),
+                distorted_valid.data(), pinhole->width);
+        }
+        else
+        {
+            for (int x = 0; x < pinhole->width; x++)
+            {
+                k4a_float3_t ray;
+                ray.xyz.x = ray_x[x];
+                ray.xyz.y = ray_y[x];
+                ray.xyz.z = 1.f;
+
+                k4a_float2_t distorted;
+                k4a_calibration_3d_to_2d(calibration, &ray, camera, camera, &distorted, &distorted_valid[x]);
+                distorted_x[x] = distorted.xy.x;
+                distorted_y[x] = distorted.xy.y;
+            }
+        }
 
-            k4a_float2_t distorted;
-            int valid;
-            k4a_calibration_3d_to_2d(calibration, &ray, camera, camera, &distorted, &valid);
+        for (int x = 0; x < pinhole->width; x++, idx++)
+        {
+            const float distorted_u = distorted_x[x];
+            const float distorted_v = distorted_y[x];
+            const int valid = distorted_valid[x];
 
-            coordinate_t src;
-            if (type == INTERPOLATION_NEARESTNEIGHBOR)
+            lut_src_index[idx] = INVALID;
+            if (bilinear)
             {
-                // Remapping via nearest neighbor interpolation
-                src.x = (int)floorf(distorted.xy.x + 0.5f);
-                src.y = (int)floorf(distorted.xy.y + 0.5f);
+                lut_weight_x[idx] = 0.f;
+                lut_weight_y[idx] = 0.f;
             }
-            else if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
+
+            int src_x;
+            int src_y;
+            if (bilinear)
             {
                 // Remapping via bilinear interpolation
-                src.x = (int)floorf(distorted.xy.x);
-                src.y = (int)floorf(distorted.xy.y);
+                src_x = (int)floorf(distorted_u);
+                src_y = (int)floorf(distorted_v);
             }
             else
             {
-                printf("Unexpected interpolation type!\n");
-                exit(-1);
+                // Remapping via nearest neighbor interpolation
+                src_x = (int)floorf(distorted_u + 0.5f);
+                src_y = (int)floorf(distorted_v + 0.5f);
             }
 
-            if (valid && src.x >= 0 && src.x < src_width && src.y >= 0 && src.y < src_height)
+            if (!valid || src_x < 0 || src_x >= src_width || src_y < 0 || src_y >= src_height)
             {
-                lut_data[idx] = src;
+                continue;
+            }
 
-                if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
-                {
-                    // Compute the floating point weights, using the distance from projected point src to the
-                    // image coordinate of the upper left neighbor
-                    float w_x = distorted.xy.x - src.x;
-                    float w_y = distorted.xy.y - src.y;
-                    float w0 = (1.f - w_x) * (1.f - w_y);
-                    float w1 = w_x * (1.f - w_y);
-                    float w2 = (1.f - w_x) * w_y;
-                    float w3 = w_x * w_y;
-
-                    // Fill into lut
-                    lut_data[idx].weight[0] = w0;
-                    lut_data[idx].weight[1] = w1;
-                    lut_data[idx].weight[2] = w2;
-                    lut_data[idx].weight[3] = w3;
-                }
+            const int64_t src_index = (int64_t)src_y * src_width + src_x;
+            if (bilinear && src_index + src_width + 1 >= src_size)
+            {
+                continue;
             }
-            else
+            lut_src_index[idx] = (int32_t)src_index;
+
+            if (bilinear)
             {
-                lut_data[idx].x = INVALID;
-                lut_data[idx].y = INVALID;
+                // Distance from projected point src to the image coordinate of the upper left neighbor
+                lut_weight_x[idx] = distorted_u - src_x;
+                lut_weight_y[idx] = distorted_v - src_y;
             }
         }
     }
 }
 
-static void remap(const k4a_image_t src, const k4a_image_t lut, k4a_image_t dst, interpolation_t type)
+// The lut is computed on all cores on the first launch with a calibration and mapped from the calibration lut
+// cache on later launches
+static void create_undistortion_lut(const k4a_calibration_t* calibration,
+    const k4a_calibration_type_t camera,
+    const pinhole_t* pinhole,
+    remap_lut_t* lut,
+    interpolation_t type)
 {
-    int src_width = k4a_image_get_width_pixels(src);
-    int dst_width = k4a_image_get_width_pixels(dst);
-    int dst_height = k4a_image_get_height_pixels(dst);
+    int src_width = calibration->depth_camera_calibration.resolution_width;
+    int src_height = calibration->depth_camera_calibration.resolution_height;
+    if (camera == K4A_CALIBRATION_TYPE_COLOR)
+    {
+        src_width = calibration->color_camera_calibration.resolution_width;
+        src_height = calibration->color_camera_calibration.resolution_height;
+    }
 
-    uint16_t* src_data = (uint16_t*)(void*)k4a_image_get_buffer(src);
-    uint16_t* dst_data = (uint16_t*)(void*)k4a_image_get_buffer(dst);
-    coordinate_t* lut_data = (coordinate_t*)(void*)k4a_image_get_buffer(lut);
+    const bool bilinear = type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH;
+    if (!bilinear && type != INTERPOLATION_NEARESTNEIGHBOR)
+    {
+        printf("Unexpected interpolation type!\n");
+        exit(-1);
+    }
+
+    lut->type = type;
+    lut->width = pinhole->width;
+    lut->height = pinhole->height;
+    lut->src_width = src_width;
+    lut->src_height = src_height;
+
+    // Source indices followed by the x and the y weights of the bilinear types
+    const size_t lut_size = (size_t)pinhole->width * (size_t)pinhole->height;
+    const size_t weights_size = bilinear ? lut_size * sizeof(float) : 0;
+
+    // Everything the lut depends on besides the calibration, both bilinear types share the same lut
+    struct
+    {
+        pinhole_t pinhole;
+        int32_t camera;
+        int32_t bilinear;
+    } lut_parameters = { *pinhole, (int32_t)camera, (int32_t)bilinear };
+
+    BrownConradyCamera batch_camera;
+    const bool use_batch_camera = initialize_batch_camera(calibration, camera, batch_camera);
+
+    lut->storage.LoadOrCreate(*calibration, "undistortion_lut", 2, &lut_parameters, sizeof(lut_parameters),
+        lut_size * sizeof(int32_t) + 2 * weights_size, pinhole->height,
+        [&](uint8_t* data, int row_begin, int row_end) {
+            compute_undistortion_lut_rows(calibration,
+                camera,
+                use_batch_camera ? &batch_camera : nullptr,
+                pinhole,
+                src_width,
+                src_height,
+                bilinear,
+                (int32_t*)data,
+                (float*)(data + lut_size * sizeof(int32_t)),
+                (float*)(data + lut_size * sizeof(int32_t) + weights_size),
+                row_begin,
+                row_end);
+            return true;
+        });
+
+    const uint8_t* data = lut->storage.GetData();
+    lut->src_index = (const int32_t*)data;
+    lut->weight_x = bilinear ? (const float*)(data + lut_size * sizeof(int32_t)) : nullptr;
+    lut->weight_y = bilinear ? (const float*)(data + lut_size * sizeof(int32_t) + weights_size) : nullptr;
+}
 
-    memset(dst_data, 0, (size_t)dst_width * (size_t)dst_height * sizeof(uint16_t));
+// Remap kernels, instantiated per interpolation type so the per pixel work has no branch on the type.
+// All kernels produce the same output, the vector kernels repeat the float operations of remap_pixel in the same order.
+template<interpolation_t type> static inline uint16_t remap_pixel(const uint16_t* src_data, const remap_lut_t* lut, int i)
+{
+    const int32_t src_index = lut->src_index[i];
+    if (src_index == INVALID)
+    {
+        return 0;
+    }
+
+    if (type == INTERPOLATION_NEARESTNEIGHBOR)
+    {
+        return src_data[src_index];
+    }
+
+    const int src_width = lut->src_width;
+    const uint16_t neighbors[4]{ src_data[src_index],
+                                 src_data[src_index + 1],
+                                 src_data[src_index + src_width],
+                                 src_data[src_index + src_width + 1] };
+
+    // If the image contains invalid data, e.g. depth image contains value 0, ignore the bilinear
+    // interpolation for current target pixel if one of the neighbors contains invalid data to avoid
+    // introduce noise on the edge. If the image is color or ir images, user should use
+    // INTERPOLATION_BILINEAR
+    if (type == INTERPOLATION_BILINEAR_DEPTH)
+    {
+        if (neighbors[0] == 0 || neighbors[1] == 0 || neighbors[2] == 0 || neighbors[3] == 0)
+            return 0;
+    }
+
+    const float w_x = lut->weight_x[i];
+    const float w_y = lut->weight_y[i];
+    const float w0 = (1.f - w_x) * (1.f - w_y);
+    const float w1 = w_x * (1.f - w_y);
+    const float w2 = (1.f - w_x) * w_y;
+    const float w3 = w_x * w_y;
 
-    for (int i = 0; i < dst_width * dst_height; i++)
+    return (uint16_t)(neighbors[0] * w0 + neighbors[1] * w1 + neighbors[2] * w2 + neighbors[3] * w3 + 0.5f);
+}
+
+template<interpolation_t type>
+static void remap_pixels_scalar(const uint16_t* src_data, const remap_lut_t* lut, uint16_t* dst_data, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
     {
-        if (lut_data[i].x != INVALID && lut_data[i].y != INVALID)
+        dst_data[i] = remap_pixel<type>(src_data, lut, i);
+    }
+}
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define REMAP_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#define REMAP_AVX2_FUNCTION
+#else
+#define REMAP_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#include <immintrin.h>
+
+static bool cpu_supports_avx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // AVX2 needs the OS to save the ymm registers
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// 8 pixels per iteration, the source pixels are gathered 32 bit wide: one gather loads the upper left and upper right
+// neighbor, a second one the lower ones
+template<interpolation_t type>
+REMAP_AVX2_FUNCTION static void remap_pixels_avx2(const uint16_t* src_data, const remap_lut_t* lut, uint16_t* dst_data, int begin, int end)
+{
+    const int* src_words = (const int*)src_data;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low_mask = _mm256_set1_epi32(0xffff);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256i src_index = _mm256_loadu_si256((const __m256i*)(lut->src_index + i));
+        // INVALID is the only negative index, the gathers skip the lanes without the sign bit in valid
+        __m256i valid = _mm256_cmpgt_epi32(src_index, _mm256_set1_epi32(-1));
+        __m256i value;
+
+        if (type == INTERPOLATION_NEARESTNEIGHBOR)
+        {
+            // The 32 bit load of the last source pixel would read past the image, it is taken from the upper half of
+            // the word before it instead
+            const int32_t last_index = lut->src_width * lut->src_height - 1;
+            const __m256i is_last = _mm256_cmpeq_epi32(src_index, _mm256_set1_epi32(last_index));
+            const __m256i word_index = _mm256_min_epi32(src_index, _mm256_set1_epi32(last_index - 1));
+            const __m256i word = _mm256_mask_i32gather_epi32(zero, src_words, word_index, valid, 2);
+            value = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(is_last, _mm256_set1_epi32(16))), low_mask);
+        }
+        else
         {
-            if (type == INTERPOLATION_NEARESTNEIGHBOR)
+            const __m256i top = _mm256_mask_i32gather_epi32(zero, src_words, src_index, valid, 2);
+            const __m256i bottom = _mm256_mask_i32gather_epi32(zero, src_words,
+                _mm256_add_epi32(src_index, _mm256_set1_epi32(lut->src_width)), valid, 2);
+
+            const __m256i n0 = _mm256_and_si256(top, low_mask);
+            const __m256i n1 = _mm256_srli_epi32(top, 16);
+            const __m256i n2 = _mm256_and_si256(bottom, low_mask);
+            const __m256i n3 = _mm256_srli_epi32(bottom, 16);
+
+            if (type == INTERPOLATION_BILINEAR_DEPTH)
             {
-                dst_data[i] = src_data[lut_data[i].y * src_width + lut_data[i].x];
+                const __m256i any_zero = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi32(n0, zero), _mm256_cmpeq_epi32(n1, zero)),
+                    _mm256_or_si256(_mm256_cmpeq_epi32(n2, zero), _mm256_cmpeq_epi32(n3, zero)));
+                valid = _mm256_andnot_si256(any_zero, valid);
             }
-            else if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
-            {
-                const uint16_t neighbors[4]{ src_data[lut_data[i].y * src_width + lut_data[i].x],
-                                             src_data[lut_data[i].y * src_width + lut_data[i].x + 1],
-                                             src_data[(lut_data[i].y + 1) * src_width + lut_data[i].x],
-                                             src_data[(lut_data[i].y + 1) * src_width + lut_data[i].x + 1] };
-
-                // If the image contains invalid data, e.g. depth image contains value 0, ignore the bilinear
-                // interpolation for current target pixel if one of the neighbors contains invalid data to avoid
-                // introduce noise on the edge. If the image is color or ir images, user should use
-                // INTERPOLATION_BILINEAR
-                if (type == INTERPOLATION_BILINEAR_DEPTH)
-                {
-                    if (neighbors[0] == 0 || neighbors[1] == 0 || neighbors[2] == 0 || neighbors[3] == 0)
-                        continue;
-                }
 
-                dst_data[i] = (uint16_t)(neighbors[0] * lut_data[i].weight[0] + neighbors[1] * lut_data[i].weight[1] +
-                    neighbors[2] * lut_data[i].weight[2] + neighbors[3] * lut_data[i].weight[3] +
-                    0.5f);
-            }
-            else
+            const __m256 one = _mm256_set1_ps(1.f);
+            const __m256 w_x = _mm256_loadu_ps(lut->weight_x + i);
+            const __m256 w_y = _mm256_loadu_ps(lut->weight_y + i);
+            const __m256 w0 = _mm256_mul_ps(_mm256_sub_ps(one, w_x), _mm256_sub_ps(one, w_y));
+            const __m256 w1 = _mm256_mul_ps(w_x, _mm256_sub_ps(one, w_y));
+            const __m256 w2 = _mm256_mul_ps(_mm256_sub_ps(one, w_x), w_y);
+            const __m256 w3 = _mm256_mul_ps(w_x, w_y);
+
+            // Same evaluation order as remap_pixel, without fused multiply adds
+            __m256 sum = _mm256_mul_ps(_mm256_cvtepi32_ps(n0), w0);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(n1), w1));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(n2), w2));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(n3), w3));
+            sum = _mm256_add_ps(sum, _mm256_set1_ps(0.5f));
+            value = _mm256_cvttps_epi32(sum);
+        }
+
+        value = _mm256_and_si256(value, valid);
+
+        // Pack to 16 bit, packus works per 128 bit lane
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(value, value), 0x08);
+        _mm_storeu_si128((__m128i*)(dst_data + i), _mm256_castsi256_si128(packed));
+    }
+
+    remap_pixels_scalar<type>(src_data, lut, dst_data, i, end);
+}
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define REMAP_NEON
+#include <arm_neon.h>
+
+// 4 pixels per iteration. NEON has no gather, the neighbors are loaded per lane and interpolated in vector registers.
+// Nearest neighbor is a plain copy and stays scalar.
+template<interpolation_t type>
+static void remap_pixels_neon(const uint16_t* src_data, const remap_lut_t* lut, uint16_t* dst_data, int begin, int end)
+{
+    if (type == INTERPOLATION_NEARESTNEIGHBOR)
+    {
+        remap_pixels_scalar<type>(src_data, lut, dst_data, begin, end);
+        return;
+    }
+
+    const int src_width = lut->src_width;
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        uint16_t neighbors[4][4];
+        uint32_t lane_valid[4];
+        for (int lane = 0; lane < 4; lane++)
+        {
+            // Invalid lanes read the first pixels of the image and are masked below
+            const int32_t src_index = lut->src_index[i + lane];
+            const int32_t index = src_index == INVALID ? 0 : src_index;
+            neighbors[0][lane] = src_data[index];
+            neighbors[1][lane] = src_data[index + 1];
+            neighbors[2][lane] = src_data[index + src_width];
+            neighbors[3][lane] = src_data[index + src_width + 1];
+            lane_valid[lane] = src_index == INVALID ? 0 : 0xffffffff;
+        }
+
+        const uint32x4_t n0 = vmovl_u16(vld1_u16(neighbors[0]));
+        const uint32x4_t n1 = vmovl_u16(vld1_u16(neighbors[1]));
+        const uint32x4_t n2 = vmovl_u16(vld1_u16(neighbors[2]));
+        const uint32x4_t n3 = vmovl_u16(vld1_u16(neighbors[3]));
+        uint32x4_t valid = vld1q_u32(lane_valid);
+
+        if (type == INTERPOLATION_BILINEAR_DEPTH)
+        {
+            const uint32x4_t any_zero = vorrq_u32(vorrq_u32(vceqzq_u32(n0), vceqzq_u32(n1)),
+                vorrq_u32(vceqzq_u32(n2), vceqzq_u32(n3)));
+            valid = vbicq_u32(valid, any_zero);
+        }
+
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t w_x = vld1q_f32(lut->weight_x + i);
+        const float32x4_t w_y = vld1q_f32(lut->weight_y + i);
+        const float32x4_t w0 = vmulq_f32(vsubq_f32(one, w_x), vsubq_f32(one, w_y));
+        const float32x4_t w1 = vmulq_f32(w_x, vsubq_f32(one, w_y));
+        const float32x4_t w2 = vmulq_f32(vsubq_f32(one, w_x), w_y);
+        const float32x4_t w3 = vmulq_f32(w_x, w_y);
+
+        // Same evaluation order as remap_pixel, without fused multiply adds
+        float32x4_t sum = vmulq_f32(vcvtq_f32_u32(n0), w0);
+        sum = vaddq_f32(sum, vmulq_f32(vcvtq_f32_u32(n1), w1));
+        sum = vaddq_f32(sum, vmulq_f32(vcvtq_f32_u32(n2), w2));
+        sum = vaddq_f32(sum, vmulq_f32(vcvtq_f32_u32(n3), w3));
+        sum = vaddq_f32(sum, vdupq_n_f32(0.5f));
+
+        const uint32x4_t value = vandq_u32(vcvtq_u32_f32(sum), valid);
+        vst1_u16(dst_data + i, vmovn_u32(value));
+    }
+
+    remap_pixels_scalar<type>(src_data, lut, dst_data, i, end);
+}
+#endif
+
+template<interpolation_t type>
+static void remap_pixels(const uint16_t* src_data, const remap_lut_t* lut, uint16_t* dst_data, int begin, int end)
+{
+#if defined(REMAP_AVX2)
+    static const bool has_avx2 = cpu_supports_avx2();
+    if (has_avx2)
+    {
+        remap_pixels_avx2<type>(src_data, lut, dst_data, begin, end);
+        return;
+    }
+#elif defined(REMAP_NEON)
+    remap_pixels_neon<type>(src_data, lut, dst_data, begin, end);
+    return;
+#endif
+    remap_pixels_scalar<type>(src_data, lut, dst_data, begin, end);
+}
+
+// Remaps the rows [row_begin, row_end) of the undistorted image
+static void remap_rows(const uint16_t* src_data, const remap_lut_t* lut, uint16_t* dst_data, int row_begin, int row_end)
+{
+    const int begin = row_begin * lut->width;
+    const int end = row_end * lut->width;
+    switch (lut->type)
+    {
+    case INTERPOLATION_NEARESTNEIGHBOR:
+        remap_pixels<INTERPOLATION_NEARESTNEIGHBOR>(src_data, lut, dst_data, begin, end);
+        break;
+    case INTERPOLATION_BILINEAR:
+        remap_pixels<INTERPOLATION_BILINEAR>(src_data, lut, dst_data, begin, end);
+        break;
+    case INTERPOLATION_BILINEAR_DEPTH:
+        remap_pixels<INTERPOLATION_BILINEAR_DEPTH>(src_data, lut, dst_data, begin, end);
+        break;
+    default:
+        printf("Unexpected interpolation type!\n");
+        exit(-1);
+    }
+}
+
+// Every pixel of dst is written, pixels without a valid source are 0
+static void remap(const k4a_image_t src, const remap_lut_t* lut, k4a_image_t dst)
+{
+    if (k4a_image_get_width_pixels(src) != lut->src_width || k4a_image_get_height_pixels(src) != lut->src_height ||
+        k4a_image_get_width_pixels(dst) != lut->width || k4a_image_get_height_pixels(dst) != lut->height)
+    {
+        printf("Image sizes do not match the undistortion lut!\n");
+        exit(-1);
+    }
+
+    const uint16_t* src_data = (const uint16_t*)(void*)k4a_image_get_buffer(src);
+    uint16_t* dst_data = (uint16_t*)(void*)k4a_image_get_buffer(dst);
+
+#ifdef HAVE_OPENCV
+    // Bands of rows on the OpenCV thread pool, about 4 bands per thread to even out the bands with many invalid pixels
+    const int bands = std::max(1, std::min(lut->height, getNumThreads() * 4));
+    parallel_for_(Range(0, lut->height), [&](const Range& rows) {
+        remap_rows(src_data, lut, dst_data, rows.start, rows.end);
+    }, bands);
+#else
+    remap_rows(src_data, lut, dst_data, 0, lut->height);
+#endif
+}
+
+#ifdef HAVE_OPENCV
+// The KinFu loop is split into three stages on their own threads: acquire captures the depth frames, undistort
+// remaps them into the pinhole camera of KinFu, fuse updates and renders KinFu on the main thread (the OpenCV windows
+// need it). The stages are connected by single frame slots, so every stage works on the newest frame of the
+// previous one and a slow KinFu update skips frames instead of backing up the device queue.
+typedef std::chrono::steady_clock pipeline_clock_t;
+
+// Single slot between two pipeline stages that always hands out the newest frame
+template<typename T> class newest_frame_slot_t
+{
+public:
+    // Returns true when a frame the next stage did not take yet was replaced, it is returned in replaced
+    bool put(const T& frame, T& replaced)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const bool was_full = m_full;
+        if (was_full)
+        {
+            replaced = m_frame;
+        }
+        m_frame = frame;
+        m_full = true;
+        m_condition.notify_one();
+        return was_full;
+    }
+
+    // Waits up to timeout_in_ms for a frame, returns false without one
+    bool take(T& frame, int timeout_in_ms)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_condition.wait_for(lock, std::chrono::milliseconds(timeout_in_ms), [this] { return m_full; }))
+        {
+            return false;
+        }
+        frame = m_frame;
+        m_frame = T();
+        m_full = false;
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    T m_frame = T();
+    bool m_full = false;
+};
+
+// Undistorted depth frames whose memory is shared by a k4a image and the Mat header KinFu reads. remap writes into
+// the buffer KinFu consumes, there is no copy and no allocation per frame. A buffer goes back to the pool when its
+// k4a image is released, the pool only grows while more frames are in flight than ever before.
+class depth_frame_pool_t
+{
+public:
+    depth_frame_pool_t(int width, int height)
+        : m_width(width), m_height(height)
+    {
+    }
+
+    ~depth_frame_pool_t()
+    {
+        // All images of the pool have to be released before
+        for (void* buffer : m_buffers)
+        {
+            fastFree(buffer);
+        }
+    }
+
+    depth_frame_pool_t(const depth_frame_pool_t&) = delete;
+    depth_frame_pool_t& operator=(const depth_frame_pool_t&) = delete;
+
+    // Returns NULL when the image could not be created
+    k4a_image_t create_image()
+    {
+        const size_t size = (size_t)m_width * m_height * sizeof(uint16_t);
+        void* buffer = NULL;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_free_buffers.empty())
             {
-                printf("Unexpected interpolation type!\n");
-                exit(-1);
+                // OpenCV aligns the allocation for its vector loads
+                m_buffers.push_back(fastMalloc(size));
+                m_free_buffers.push_back(m_buffers.back());
             }
+            buffer = m_free_buffers.back();
+            m_free_buffers.pop_back();
         }
+
+        k4a_image_t image = NULL;
+        if (K4A_RESULT_SUCCEEDED != k4a_image_create_from_buffer(K4A_IMAGE_FORMAT_DEPTH16,
+                                                                 m_width,
+                                                                 m_height,
+                                                                 m_width * (int)sizeof(uint16_t),
+                                                                 (uint8_t*)buffer,
+                                                                 size,
+                                                                 release_buffer,
+                                                                 this,
+                                                                 &image))
+        {
+            release_buffer(buffer, this);
+            return NULL;
+        }
+        return image;
+    }
+
+    // Header of the image of the pool, valid until the image is released
+    Mat get_mat(k4a_image_t image) const
+    {
+        return create_mat_from_buffer<uint16_t>((uint16_t*)(void*)k4a_image_get_buffer(image), m_width, m_height);
     }
+
+private:
+    static void release_buffer(void* buffer, void* context)
+    {
+        depth_frame_pool_t* pool = (depth_frame_pool_t*)context;
+        std::lock_guard<std::mutex> lock(pool->m_mutex);
+        pool->m_free_buffers.push_back(buffer);
+    }
+
+    const int m_width;
+    const int m_height;
+    std::mutex m_mutex;
+    std::vector<void*> m_buffers;
+    std::vector<void*> m_free_buffers;
+};
+
+typedef struct _captured_frame_t
+{
+    k4a_image_t depth_image;
+    pipeline_clock_t::time_point acquired;
+} captured_frame_t;
+
+// depth is a header on the buffer of depth_image from the depth frame pool
+typedef struct _undistorted_frame_t
+{
+    k4a_image_t depth_image;
+    Mat depth;
+    pipeline_clock_t::time_point acquired;
+} undistorted_frame_t;
+
+// Counters of a stage, skipped are its frames the next stage never took
+typedef struct _stage_stats_t
+{
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> skipped{ 0 };
+    std::atomic<uint64_t> busy_us{ 0 };
+} stage_stats_t;
+
+typedef struct _pipeline_t
+{
+    newest_frame_slot_t<captured_frame_t> captured;
+    newest_frame_slot_t<undistorted_frame_t> undistorted;
+
+    stage_stats_t acquire_stats;
+    stage_stats_t undistort_stats;
+    stage_stats_t fuse_stats;
+
+    // From the capture to the shown KinFu rendering of the fused frames
+    std::atomic<uint64_t> latency_us{ 0 };
+    std::atomic<uint64_t> max_latency_us{ 0 };
+
+    pipeline_clock_t::time_point start;
+    std::atomic<bool> stop{ false };
+    std::atomic<bool> failed{ false };
+} pipeline_t;
+
+static uint64_t elapsed_us(pipeline_clock_t::time_point begin)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(pipeline_clock_t::now() - begin).count();
+}
+
+static void record_stage_frame(stage_stats_t* stats, pipeline_clock_t::time_point begin)
+{
+    stats->busy_us += elapsed_us(begin);
+    stats->frames++;
 }
 
+// Acquire stage, drains the device queue as fast as the device delivers frames
+static void acquire_depth_frames(k4a_device_t device, pipeline_t* pipeline)
+{
+    const int32_t TIMEOUT_IN_MS = 1000;
+    while (!pipeline->stop)
+    {
+        // Get a depth frame
+        k4a_capture_t capture = NULL;
+        switch (k4a_device_get_capture(device, &capture, TIMEOUT_IN_MS))
+        {
+        case K4A_WAIT_RESULT_SUCCEEDED:
+            break;
+        case K4A_WAIT_RESULT_TIMEOUT:
+            printf("Timed out waiting for a capture\n");
+            continue;
+        case K4A_WAIT_RESULT_FAILED:
+            printf("Failed to read a capture\n");
+            pipeline->failed = true;
+            return;
+        }
+
+        const pipeline_clock_t::time_point begin = pipeline_clock_t::now();
+
+        // Retrieve depth image, it keeps its own reference after the capture is released
+        captured_frame_t frame = { k4a_capture_get_depth_image(capture), begin };
+        k4a_capture_release(capture);
+        if (frame.depth_image == NULL)
+        {
+            printf("Depth16 None\n");
+            continue;
+        }
+
+        captured_frame_t replaced;
+        if (pipeline->captured.put(frame, replaced))
+        {
+            k4a_image_release(replaced.depth_image);
+            pipeline->acquire_stats.skipped++;
+        }
+        record_stage_frame(&pipeline->acquire_stats, begin);
+    }
+}
+
+// Undistort stage, remaps the newest depth frame into the pinhole camera of KinFu
+static void undistort_depth_frames(const remap_lut_t* lut, depth_frame_pool_t* pool, pipeline_t* pipeline)
+{
+    const int32_t TIMEOUT_IN_MS = 100;
+    captured_frame_t captured;
+    while (!pipeline->stop)
+    {
+        if (!pipeline->captured.take(captured, TIMEOUT_IN_MS))
+        {
+            continue;
+        }
+
+        const pipeline_clock_t::time_point begin = pipeline_clock_t::now();
+
+        undistorted_frame_t frame;
+        frame.depth_image = pool->create_image();
+        if (frame.depth_image == NULL)
+        {
+            printf("Failed to create an undistorted depth image\n");
+            k4a_image_release(captured.depth_image);
+            continue;
+        }
+        frame.depth = pool->get_mat(frame.depth_image);
+        frame.acquired = captured.acquired;
+
+        remap(captured.depth_image, lut, frame.depth_image);
+        k4a_image_release(captured.depth_image);
+
+        undistorted_frame_t replaced;
+        if (pipeline->undistorted.put(frame, replaced))
+        {
+            k4a_image_release(replaced.depth_image);
+            pipeline->undistort_stats.skipped++;
+        }
+        record_stage_frame(&pipeline->undistort_stats, begin);
+    }
+}
+
+static void print_stage_stats(const char* name, const stage_stats_t* stats, double seconds)
+{
+    const uint64_t frames = stats->frames;
+    printf("    %-10s %6.1f fps %7.2f ms per frame %8llu frames %8llu skipped by the next stage\n",
+           name,
+           seconds > 0 ? frames / seconds : 0.0,
+           frames > 0 ? stats->busy_us / 1000.0 / frames : 0.0,
+           (unsigned long long)frames,
+           (unsigned long long)stats->skipped);
+}
+
+static void print_pipeline_stats(const pipeline_t* pipeline)
+{
+    const double seconds = elapsed_us(pipeline->start) / 1e6;
+    const uint64_t fused_frames = pipeline->fuse_stats.frames;
+
+    printf("Pipeline statistics after %.1f s:\n", seconds);
+    print_stage_stats("acquire", &pipeline->acquire_stats, seconds);
+    print_stage_stats("undistort", &pipeline->undistort_stats, seconds);
+    print_stage_stats("fuse", &pipeline->fuse_stats, seconds);
+    printf("    latency %.2f ms average, %.2f ms max\n",
+           fused_frames > 0 ? pipeline->latency_us / 1000.0 / fused_frames : 0.0,
+           pipeline->max_latency_us / 1000.0);
+}
+#endif
+
 void PrintUsage() 
 {
     printf("Usage: kinfu_example.exe [Optional]<Mode>\n");
@@ -320,6 +999,7 @@ void PrintUsage()
     printf("            r - Reset KinFu\n");
     printf("            v - Enable Viz Render Cloud (default is OFF, enable it will slow down frame rate)\n");
     printf("            w - Write out the kf_output.ply point cloud file in the running folder\n");
+    printf("            s - Print the frame rates, timings and skipped frames of the pipeline stages\n");
     printf("    * Please ensure to uncomment HAVE_OPENCV pound define to enable the opencv code that runs kinfu\n");
     printf("    * Please ensure to copy opencv/opencv_contrib/vtk dlls to the running folder\n\n");
 }
@@ -432,14 +1112,8 @@ int main(int argc, char** argv)
     distCoeffs(6) = intrinsics->param.k5;
     distCoeffs(7) = intrinsics->param.k6;
 
-    k4a_image_t lut = NULL;
-    k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-                     pinhole.width,
-                     pinhole.height,
-                     pinhole.width * (int)sizeof(coordinate_t),
-                     &lut);
-
-    create_undistortion_lut(&calibration, K4A_CALIBRATION_TYPE_DEPTH, &pinhole, lut, interpolation_type);
+    remap_lut_t lut;
+    create_undistortion_lut(&calibration, K4A_CALIBRATION_TYPE_DEPTH, &pinhole, &lut, interpolation_type);
 
     // Create KinectFusion module instance
     Ptr<kinfu::KinFu> kf;
@@ -449,95 +1123,71 @@ int main(int argc, char** argv)
 
     bool stop = false;
     bool renderViz = false;
-    k4a_capture_t capture = NULL;
-    k4a_image_t depth_image = NULL;
-    k4a_image_t undistorted_depth_image = NULL;
-    const int32_t TIMEOUT_IN_MS = 1000;
-    while (!stop && !visualization.wasStopped())
-    {
-        // Get a depth frame
-        switch (k4a_device_get_capture(device, &capture, TIMEOUT_IN_MS))
-        {
-        case K4A_WAIT_RESULT_SUCCEEDED:
-            break;
-        case K4A_WAIT_RESULT_TIMEOUT:
-            printf("Timed out waiting for a capture\n");
-            continue;
-            break;
-        case K4A_WAIT_RESULT_FAILED:
-            printf("Failed to read a capture\n");
-            k4a_device_close(device);
-            return 1;
-        }
 
-        // Retrieve depth image
-        depth_image = k4a_capture_get_depth_image(capture);
-        if (depth_image == NULL)
-        {
-            printf("Depth16 None\n");
-            k4a_capture_release(capture);
-            continue;
-        }
+    // Declared before the pipeline, the frames of the pipeline return their buffers to it
+    depth_frame_pool_t depth_frame_pool(pinhole.width, pinhole.height);
 
-        k4a_image_create(K4A_IMAGE_FORMAT_DEPTH16,
-                         pinhole.width,
-                         pinhole.height,
-                         pinhole.width * (int)sizeof(uint16_t),
-                         &undistorted_depth_image);
-        remap(depth_image, lut, undistorted_depth_image, interpolation_type);
+    pipeline_t pipeline;
+    pipeline.start = pipeline_clock_t::now();
+    std::thread acquire_thread(acquire_depth_frames, device, &pipeline);
+    std::thread undistort_thread(undistort_depth_frames, &lut, &depth_frame_pool, &pipeline);
 
-        // Create frame from depth buffer
-        uint8_t *buffer = k4a_image_get_buffer(undistorted_depth_image);
-        uint16_t *depth_buffer = reinterpret_cast<uint16_t *>(buffer);
-        UMat undistortedFrame;
-        create_mat_from_buffer<uint16_t>(depth_buffer, width, height).copyTo(undistortedFrame);
+    // Last fused point cloud and normals
+    UMat points;
+    UMat normals;
 
-        if (undistortedFrame.empty())
+    const int32_t TIMEOUT_IN_MS = 5;
+    while (!stop && !visualization.wasStopped() && !pipeline.failed)
+    {
+        undistorted_frame_t frame;
+        if (pipeline.undistorted.take(frame, TIMEOUT_IN_MS))
         {
-            k4a_image_release(depth_image);
-            k4a_image_release(undistorted_depth_image);
-            k4a_capture_release(capture);
-            continue;
-        }
+            const pipeline_clock_t::time_point begin = pipeline_clock_t::now();
 
-        // Update KinectFusion
-        if (!kf->update(undistortedFrame))
-        {
-            printf("Reset KinectFusion\n");
-            kf->reset();
-            k4a_image_release(depth_image);
-            k4a_image_release(undistorted_depth_image);
-            k4a_capture_release(capture);
-            continue;
-        }
+            // Update KinectFusion
+            if (!kf->update(frame.depth))
+            {
+                printf("Reset KinectFusion\n");
+                kf->reset();
+            }
+            else
+            {
+                // Retrieve rendered TSDF
+                UMat tsdfRender;
+                kf->render(tsdfRender);
+
+                // Retrieve fused point cloud and normals
+                kf->getCloud(points, normals);
 
-        // Retrieve rendered TSDF
-        UMat tsdfRender;
-        kf->render(tsdfRender);
+                // Show TSDF rendering
+                imshow("AzureKinect KinectFusion Example", tsdfRender);
 
-        // Retrieve fused point cloud and normals
-        UMat points;
-        UMat normals;
-        kf->getCloud(points, normals);
+                // Show fused point cloud and normals
+                if (!points.empty() && !normals.empty() && renderViz)
+                {
+                    viz::WCloud cloud(points, viz::Color::white());
+                    viz::WCloudNormals cloudNormals(points, normals, 1, 0.01, viz::Color::cyan());
+                    visualization.showWidget("cloud", cloud);
+                    visualization.showWidget("normals", cloudNormals);
+                    visualization.showWidget("worldAxes", viz::WCoordinateSystem());
+                    Vec3d volSize = kf->getParams().voxelSize * kf->getParams().volumeDims;
+                    visualization.showWidget("cube", viz::WCube(Vec3d::all(0), volSize), kf->getParams().volumePose);
+                    visualization.spinOnce(1, true);
+                }
 
-        // Show TSDF rendering
-        imshow("AzureKinect KinectFusion Example", tsdfRender);
+                const uint64_t latency_us = elapsed_us(frame.acquired);
+                pipeline.latency_us += latency_us;
+                pipeline.max_latency_us = std::max((uint64_t)pipeline.max_latency_us, latency_us);
+                record_stage_frame(&pipeline.fuse_stats, begin);
+            }
 
-        // Show fused point cloud and normals
-        if (!points.empty() && !normals.empty() && renderViz)
-        {
-            viz::WCloud cloud(points, viz::Color::white());
-            viz::WCloudNormals cloudNormals(points, normals, 1, 0.01, viz::Color::cyan());
-            visualization.showWidget("cloud", cloud);
-            visualization.showWidget("normals", cloudNormals);
-            visualization.showWidget("worldAxes", viz::WCoordinateSystem());
-            Vec3d volSize = kf->getParams().voxelSize * kf->getParams().volumeDims;
-            visualization.showWidget("cube", viz::WCube(Vec3d::all(0), volSize), kf->getParams().volumePose);
-            visualization.spinOnce(1, true);
+            // KinFu keeps no reference to the depth frame, the buffer goes back to the pool
+            frame.depth.release();
+            k4a_image_release(frame.depth_image);
         }
 
         // Key controls
-        const int32_t key = waitKey(5);
+        const int32_t key = waitKey(1);
         if (key == 'r')
         {
             printf("Reset KinectFusion\n");
@@ -547,61 +1197,73 @@ int main(int argc, char** argv)
         {
             renderViz = true;
         }
-        else if (key == 'w')
+        else if (key == 's')
+        {
+            print_pipeline_stats(&pipeline);
+        }
+        else if (key == 'w' && !points.empty() && !normals.empty())
         {
             // Output the fused point cloud from KinectFusion
-            Mat out_points;
-            Mat out_normals;
-            points.copyTo(out_points);
-            normals.copyTo(out_normals);
+            // Map the UMats for reading instead of copying them
+            Mat out_points = points.getMat(ACCESS_READ);
+            Mat out_normals = normals.getMat(ACCESS_READ);
 
             printf("Saving fused point cloud into ply file ...\n");
 
-            // Save to the ply file
-#define PLY_START_HEADER "ply"
-#define PLY_END_HEADER "end_header"
-#define PLY_ASCII "format ascii 1.0"
-#define PLY_ELEMENT_VERTEX "element vertex"
-            string output_file_name = "kf_output.ply";
-            ofstream ofs(output_file_name); // text mode first
-            ofs << PLY_START_HEADER << endl;
-            ofs << PLY_ASCII << endl;
-            ofs << PLY_ELEMENT_VERTEX << " " << out_points.rows << endl;
-            ofs << "property float x" << endl;
-            ofs << "property float y" << endl;
-            ofs << "property float z" << endl;
-            ofs << "property float nx" << endl;
-            ofs << "property float ny" << endl;
-            ofs << "property float nz" << endl;
-            ofs << PLY_END_HEADER << endl;
-            ofs.close();
-
-            stringstream ss;
-            for (int i = 0; i < out_points.rows; ++i)
+            // Save to the ply file, written straight from the KinectFusion output
+            PlyWriter ply_writer;
+            ply_writer.AddProperty("x", PlyPropertyType::Float32);
+            ply_writer.AddProperty("y", PlyPropertyType::Float32);
+            ply_writer.AddProperty("z", PlyPropertyType::Float32);
+            ply_writer.AddProperty("nx", PlyPropertyType::Float32);
+            ply_writer.AddProperty("ny", PlyPropertyType::Float32);
+            ply_writer.AddProperty("nz", PlyPropertyType::Float32);
+            if (ply_writer.Open("kf_output.ply"))
             {
-                ss << out_points.at<float>(i, 0) << " "
-                    << out_points.at<float>(i, 1) << " "
-                    << out_points.at<float>(i, 2) << " "
-                    << out_normals.at<float>(i, 0) << " "
-                    << out_normals.at<float>(i, 1) << " "
-                    << out_normals.at<float>(i, 2) << endl;
+                for (int i = 0; i < out_points.rows; ++i)
+                {
+                    uint8_t* vertex = ply_writer.BeginVertex();
+                    if (vertex == nullptr)
+                    {
+                        break;
+                    }
+                    memcpy(vertex, out_points.ptr<float>(i), 3 * sizeof(float));
+                    memcpy(vertex + 3 * sizeof(float), out_normals.ptr<float>(i), 3 * sizeof(float));
+                }
+                ply_writer.Close();
             }
-            ofstream ofs_text(output_file_name, ios::out | ios::app);
-            ofs_text.write(ss.str().c_str(), (streamsize)ss.str().length());
         }
         else if (key == 'q')
         {
             stop = true;
         }
+    }
 
-        k4a_image_release(depth_image);
-        k4a_image_release(undistorted_depth_image);
-        k4a_capture_release(capture);
+    // The acquire stage stops within the capture timeout
+    pipeline.stop = true;
+    acquire_thread.join();
+    undistort_thread.join();
+
+    captured_frame_t captured;
+    if (pipeline.captured.take(captured, 0))
+    {
+        k4a_image_release(captured.depth_image);
+    }
+    undistorted_frame_t undistorted;
+    if (pipeline.undistorted.take(undistorted, 0))
+    {
+        k4a_image_release(undistorted.depth_image);
     }
 
-    k4a_image_release(lut);
+    print_pipeline_stats(&pipeline);
 
     destroyAllWindows();
+
+    if (pipeline.failed)
+    {
+        k4a_device_close(device);
+        return 1;
+    }
 #endif
 
     k4a_device_close(device);